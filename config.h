@@ -0,0 +1,17 @@
+#define SPDK_CONFIG_PREFIX /usr/local
+#undef SPDK_CONFIG_DEBUG
+#undef SPDK_CONFIG_WERROR
+#undef SPDK_CONFIG_LTO
+#undef SPDK_CONFIG_COVERAGE
+#undef SPDK_CONFIG_ASAN
+#undef SPDK_CONFIG_UBSAN
+#undef SPDK_CONFIG_TSAN
+#define SPDK_CONFIG_ENV /root/repo/lib/env_linux
+#define SPDK_CONFIG_DPDK_DIR $(SPDK_ROOT_DIR)/dpdk/build
+#undef SPDK_CONFIG_FIO_PLUGIN
+#define SPDK_FIO_SOURCE_DIR /usr/src/fio
+#undef SPDK_CONFIG_RDMA
+#undef SPDK_CONFIG_RBD
+#undef SPDK_CONFIG_VHOST
+#undef SPDK_CONFIG_VIRTIO
+#undef SPDK_CONFIG_NVML
@@ -79,6 +79,7 @@ enum cli_action_type {
 	CLI_CREATE_BLOB,
 	CLI_LIST_BDEVS,
 	CLI_LIST_BLOBS,
+	CLI_FSCK,
 	CLI_INIT_BS,
 	CLI_SHELL_EXIT,
 	CLI_HELP,
@@ -104,6 +105,7 @@ struct cli_context_t {
 	struct spdk_io_channel *channel;
 	uint8_t *buff;
 	uint64_t page_size;
+	uint64_t io_units_per_page;
 	uint64_t page_count;
 	uint64_t blob_pages;
 	uint64_t bytes_so_far;
@@ -123,6 +125,7 @@ struct cli_context_t {
 	char *argv[MAX_ARGS];
 	bool app_started;
 	char script_file[BUFSIZE + 1];
+	struct spdk_bs_fsck_report fsck_report;
 };
 
 /* we store a bunch of stuff in a global struct for use by scripting mode */
@@ -150,6 +153,7 @@ print_cmds(void)
 	printf("\t-f <blobid> value - fill a blob with a decimal value\n");
 	printf("\t-h - this help screen\n");
 	printf("\t-i - initialize a blobstore\n");
+	printf("\t-k - check the blobstore metadata for consistency\n");
 	printf("\t-l bdevs | blobs - list either available bdevs or existing blobs\n");
 	printf("\t-m <blobid> filename - import contents of a file to a blob\n");
 	printf("\t-n <# clusters> - create new blob\n");
@@ -389,6 +393,9 @@ show_bs_cb(void *arg1, spdk_blob_id blobid, int bserrno)
 
 	printf("\tpage size: %" PRIu64 "\n", cli_context->page_size);
 
+	val = spdk_bs_get_io_unit_size(cli_context->bs);
+	printf("\tio unit size: %" PRIu64 "\n", val);
+
 	val = spdk_bs_get_cluster_size(cli_context->bs);
 	printf("\tcluster size: %" PRIu64 "\n", val);
 
@@ -596,8 +603,9 @@ read_dump_cb(void *arg1, int bserrno)
 	if (++cli_context->page_count < cli_context->blob_pages) {
 		/* perform another read */
 		spdk_bs_io_read_blob(cli_context->blob, cli_context->channel,
-				     cli_context->buff, cli_context->page_count,
-				     NUM_PAGES, read_dump_cb, cli_context);
+				     cli_context->buff,
+				     cli_context->page_count * cli_context->io_units_per_page,
+				     NUM_PAGES * cli_context->io_units_per_page, read_dump_cb, cli_context);
 	} else {
 		/* done reading */
 		printf("\nFile write complete (to %s).\n", cli_context->file);
@@ -644,8 +652,9 @@ write_imp_cb(void *arg1, int bserrno)
 	if (++cli_context->page_count < cli_context->blob_pages) {
 		printf(".");
 		spdk_bs_io_write_blob(cli_context->blob, cli_context->channel,
-				      cli_context->buff, cli_context->page_count,
-				      NUM_PAGES, write_imp_cb, cli_context);
+				      cli_context->buff,
+				      cli_context->page_count * cli_context->io_units_per_page,
+				      NUM_PAGES * cli_context->io_units_per_page, write_imp_cb, cli_context);
 	} else {
 		/* done writing */
 		printf("\nBlob import complete (from %s).\n", cli_context->file);
@@ -696,8 +705,9 @@ dump_imp_open_cb(void *cb_arg, struct spdk_blob *blob, int bserrno)
 
 		/* read a page of data from the blob */
 		spdk_bs_io_read_blob(cli_context->blob, cli_context->channel,
-				     cli_context->buff, cli_context->page_count,
-				     NUM_PAGES, read_dump_cb, cli_context);
+				     cli_context->buff,
+				     cli_context->page_count * cli_context->io_units_per_page,
+				     NUM_PAGES * cli_context->io_units_per_page, read_dump_cb, cli_context);
 	} else {
 		cli_context->fp = fopen(cli_context->file, "r");
 		if (cli_context->fp == NULL) {
@@ -724,8 +734,9 @@ dump_imp_open_cb(void *cb_arg, struct spdk_blob *blob, int bserrno)
 		}
 
 		spdk_bs_io_write_blob(cli_context->blob, cli_context->channel,
-				      cli_context->buff, cli_context->page_count,
-				      NUM_PAGES, write_imp_cb, cli_context);
+				      cli_context->buff,
+				      cli_context->page_count * cli_context->io_units_per_page,
+				      NUM_PAGES * cli_context->io_units_per_page, write_imp_cb, cli_context);
 	}
 }
 
@@ -745,8 +756,9 @@ write_cb(void *arg1, int bserrno)
 	printf(".");
 	if (++cli_context->page_count < cli_context->blob_pages) {
 		spdk_bs_io_write_blob(cli_context->blob, cli_context->channel,
-				      cli_context->buff, cli_context->page_count,
-				      NUM_PAGES, write_cb, cli_context);
+				      cli_context->buff,
+				      cli_context->page_count * cli_context->io_units_per_page,
+				      NUM_PAGES * cli_context->io_units_per_page, write_cb, cli_context);
 	} else {
 		/* done writing */
 		printf("\nBlob fill complete (with 0x%x).\n", cli_context->fill_value);
@@ -784,7 +796,58 @@ fill_blob_cb(void *arg1, struct spdk_blob *blob, int bserrno)
 	printf("Working");
 	spdk_bs_io_write_blob(cli_context->blob, cli_context->channel,
 			      cli_context->buff,
-			      STARTING_PAGE, NUM_PAGES, write_cb, cli_context);
+			      STARTING_PAGE * cli_context->io_units_per_page,
+			      NUM_PAGES * cli_context->io_units_per_page, write_cb, cli_context);
+}
+
+/*
+ * Callback for checking the blobstore metadata, prints what was found.
+ */
+static void
+fsck_cb(void *arg1, int bserrno)
+{
+	struct cli_context_t *cli_context = arg1;
+	struct spdk_bs_fsck_report *report = &cli_context->fsck_report;
+	uint64_t errors;
+
+	if (bserrno) {
+		unload_bs(cli_context, "Error in fsck callback",
+			  bserrno);
+		return;
+	}
+
+	printf("Blobstore Metadata Check:\n");
+	printf("\tMetadata length (pages): %d\n", cli_context->bs->md_len);
+	printf("\t# blobs: %" PRIu64 "\n", report->num_blobs);
+	printf("\t# metadata pages: %" PRIu64 "\n", report->num_md_pages);
+	printf("\t# allocated clusters: %" PRIu64 "\n", report->num_clusters);
+	printf("\t# free clusters: %" PRIu64 "\n",
+	       spdk_bs_free_cluster_count(cli_context->bs));
+
+	printf("\nErrors:\n");
+	printf("\torphan metadata pages: %" PRIu64 "\n", report->orphan_md_pages);
+	printf("\tunmarked metadata pages: %" PRIu64 "\n", report->unmarked_md_pages);
+	printf("\tmetadata pages with bad CRC: %" PRIu64 "\n", report->crc_md_pages);
+	printf("\tinvalid metadata pages: %" PRIu64 "\n", report->invalid_md_pages);
+	printf("\torphan blob IDs: %" PRIu64 "\n", report->orphan_blobids);
+	printf("\tunmarked blob IDs: %" PRIu64 "\n", report->unmarked_blobids);
+	printf("\tleaked clusters: %" PRIu64 "\n", report->leaked_clusters);
+	printf("\tunmarked clusters: %" PRIu64 "\n", report->unmarked_clusters);
+	printf("\tshared clusters: %" PRIu64 "\n", report->shared_clusters);
+
+	errors = report->orphan_md_pages + report->unmarked_md_pages +
+		 report->crc_md_pages + report->invalid_md_pages +
+		 report->orphan_blobids + report->unmarked_blobids +
+		 report->leaked_clusters + report->unmarked_clusters +
+		 report->shared_clusters;
+	if (errors) {
+		unload_bs(cli_context, "Blobstore metadata is inconsistent",
+			  -EILSEQ);
+		return;
+	}
+
+	printf("\nBlobstore metadata is consistent.\n");
+	unload_bs(cli_context, "", 0);
 }
 
 /*
@@ -805,6 +868,8 @@ load_bs_cb(void *arg1, struct spdk_blob_store *bs, int bserrno)
 
 	cli_context->bs = bs;
 	cli_context->page_size = spdk_bs_get_page_size(cli_context->bs);
+	cli_context->io_units_per_page = cli_context->page_size /
+					 spdk_bs_get_io_unit_size(cli_context->bs);
 	cli_context->channel = spdk_bs_alloc_io_channel(cli_context->bs);
 	if (cli_context->channel == NULL) {
 		unload_bs(cli_context, "Error in allocating channel",
@@ -842,6 +907,10 @@ load_bs_cb(void *arg1, struct spdk_blob_store *bs, int bserrno)
 		spdk_bs_open_blob(cli_context->bs, cli_context->blobid,
 				  fill_blob_cb, cli_context);
 		break;
+	case CLI_FSCK:
+		spdk_bs_fsck(cli_context->bs, &cli_context->fsck_report,
+			     fsck_cb, cli_context);
+		break;
 
 	default:
 		/* should never get here */
@@ -964,7 +1033,7 @@ cmd_parser(int argc, char **argv, struct cli_context_t *cli_context)
 	int cmd_chosen = 0;
 	char resp;
 
-	while ((op = getopt(argc, argv, "b:c:d:f:hil:m:n:p:r:s:ST:Xx:")) != -1) {
+	while ((op = getopt(argc, argv, "b:c:d:f:hikl:m:n:p:r:s:ST:Xx:")) != -1) {
 		switch (op) {
 		case 'b':
 			if (strcmp(cli_context->bdev_name, "") == 0) {
@@ -1024,6 +1093,10 @@ cmd_parser(int argc, char **argv, struct cli_context_t *cli_context)
 				cli_context->action = CLI_INIT_BS;
 			}
 			break;
+		case 'k':
+			cmd_chosen++;
+			cli_context->action = CLI_FSCK;
+			break;
 		case 'r':
 			if (argv[optind] != NULL) {
 				cmd_chosen++;
@@ -1365,6 +1438,7 @@ cli_start(void *arg1, void *arg2)
 	case CLI_DUMP_BLOB:
 	case CLI_IMPORT_BLOB:
 	case CLI_FILL:
+	case CLI_FSCK:
 		load_bs(cli_context);
 		break;
 	case CLI_INIT_BS:
@@ -0,0 +1,633 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/bdev.h"
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/blob_bdev.h"
+#include "spdk/blob.h"
+#include "spdk/log.h"
+
+/*
+ * blob_perf initializes a blobstore on the given bdev, destroying whatever is
+ * on it, and then times each of the blob metadata operations over a number of
+ * blobs, keeping up to a queue depth of them outstanding.  It finishes with a
+ * data path run of reads or writes against one blob filling the blobstore.
+ */
+
+enum perf_phase {
+	PERF_CREATE,
+	PERF_OPEN,
+	PERF_RESIZE,
+	PERF_SYNC_MD,
+	PERF_CLOSE,
+	PERF_DELETE,
+	PERF_NUM_MD_PHASES,
+};
+
+static const char *g_phase_names[PERF_NUM_MD_PHASES] = {
+	"create", "open", "resize", "sync_md", "close", "delete",
+};
+
+struct perf_context_t;
+
+struct perf_blob {
+	struct perf_context_t *perf_context;
+	spdk_blob_id blobid;
+	struct spdk_blob *blob;
+};
+
+struct perf_task {
+	struct perf_context_t *perf_context;
+	uint8_t *buf;
+	uint64_t offset;
+};
+
+struct perf_context_t {
+	struct spdk_blob_store *bs;
+	struct spdk_io_channel *channel;
+	uint64_t io_unit_size;
+
+	/* Metadata phases */
+	enum perf_phase phase;
+	struct perf_blob *blobs;
+	uint32_t submitted;
+	uint32_t completed;
+	uint32_t outstanding;
+	bool in_submit;
+	uint64_t start_tsc;
+
+	/* Data path run */
+	struct spdk_blob *blob;
+	spdk_blob_id blobid;
+	struct perf_task *tasks;
+	uint64_t io_units;
+	uint64_t io_units_per_op;
+	uint64_t next_offset;
+	uint64_t end_tsc;
+	uint64_t io_completed;
+	uint32_t io_outstanding;
+
+	int rc;
+};
+
+static const char *g_config_file = "blob_perf.conf";
+static const char *g_bdev_name = "Malloc0";
+static uint32_t g_num_blobs = 512;
+static uint64_t g_num_clusters = 1;
+static uint32_t g_queue_depth = 32;
+static uint32_t g_io_size = 4096;
+static int g_time_in_sec = 5;
+static bool g_is_write = true;
+static bool g_is_random = true;
+
+static void
+usage(char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-c configuration file (default %s)]\n", g_config_file);
+	printf("\t[-b bdev to initialize the blobstore on (default %s)]\n", g_bdev_name);
+	printf("\t[-n number of blobs for the metadata phases (default %u)]\n", g_num_blobs);
+	printf("\t[-C clusters to resize each blob to (default %" PRIu64 ")]\n", g_num_clusters);
+	printf("\t[-q queue depth (default %u)]\n", g_queue_depth);
+	printf("\t[-s io size in bytes (default %u)]\n", g_io_size);
+	printf("\t[-t time in seconds of the data path run (default %d)]\n", g_time_in_sec);
+	printf("\t[-w io pattern type, must be one of\n");
+	printf("\t\t(read, write, randread, randwrite) (default randwrite)]\n");
+	printf("All data on the bdev is destroyed.\n");
+}
+
+static void
+perf_cleanup(struct perf_context_t *perf_context)
+{
+	uint32_t i;
+
+	if (perf_context->tasks) {
+		for (i = 0; i < g_queue_depth; i++) {
+			spdk_dma_free(perf_context->tasks[i].buf);
+		}
+		free(perf_context->tasks);
+	}
+	free(perf_context->blobs);
+	free(perf_context);
+}
+
+static double
+perf_elapsed_sec(uint64_t start_tsc)
+{
+	return (double)(spdk_get_ticks() - start_tsc) / spdk_get_ticks_hz();
+}
+
+static void
+unload_complete(void *cb_arg, int bserrno)
+{
+	struct perf_context_t *perf_context = cb_arg;
+
+	if (bserrno) {
+		SPDK_ERRLOG("Error %d unloading the blobstore\n", bserrno);
+		perf_context->rc = bserrno;
+	}
+
+	spdk_app_stop(perf_context->rc);
+}
+
+static void
+unload_bs(struct perf_context_t *perf_context, char *msg, int bserrno)
+{
+	if (bserrno) {
+		SPDK_ERRLOG("%s (err %d)\n", msg, bserrno);
+		perf_context->rc = bserrno;
+	}
+
+	if (perf_context->bs) {
+		if (perf_context->channel) {
+			spdk_bs_free_io_channel(perf_context->channel);
+			perf_context->channel = NULL;
+		}
+		spdk_bs_unload(perf_context->bs, unload_complete, perf_context);
+	} else {
+		spdk_app_stop(bserrno);
+	}
+}
+
+/*
+ * Data path run.
+ */
+static void io_submit(struct perf_task *task);
+
+static void
+io_blob_delete_complete(void *arg1, int bserrno)
+{
+	struct perf_context_t *perf_context = arg1;
+
+	if (bserrno) {
+		unload_bs(perf_context, "Error deleting the io blob", bserrno);
+		return;
+	}
+
+	unload_bs(perf_context, "", 0);
+}
+
+static void
+io_blob_close_complete(void *arg1, int bserrno)
+{
+	struct perf_context_t *perf_context = arg1;
+
+	if (bserrno) {
+		unload_bs(perf_context, "Error closing the io blob", bserrno);
+		return;
+	}
+
+	spdk_bs_delete_blob(perf_context->bs, perf_context->blobid,
+			    io_blob_delete_complete, perf_context);
+}
+
+static void
+io_done(struct perf_context_t *perf_context)
+{
+	double sec = perf_elapsed_sec(perf_context->start_tsc);
+	double iops = perf_context->io_completed / sec;
+
+	printf("%-10s %10" PRIu64 " ios in %8.3f s: %12.2f IO/s %10.2f MiB/s\n",
+	       g_is_write ? "write" : "read", perf_context->io_completed, sec,
+	       iops, iops * g_io_size / (1024 * 1024));
+
+	spdk_blob_close(perf_context->blob, io_blob_close_complete, perf_context);
+}
+
+static void
+io_complete(void *arg1, int bserrno)
+{
+	struct perf_task *task = arg1;
+	struct perf_context_t *perf_context = task->perf_context;
+
+	if (bserrno && perf_context->rc == 0) {
+		SPDK_ERRLOG("I/O at offset %" PRIu64 " failed (err %d)\n", task->offset, bserrno);
+		perf_context->rc = bserrno;
+	}
+
+	perf_context->io_completed++;
+	if (perf_context->rc == 0 && spdk_get_ticks() < perf_context->end_tsc) {
+		io_submit(task);
+		return;
+	}
+
+	if (--perf_context->io_outstanding == 0) {
+		io_done(perf_context);
+	}
+}
+
+static void
+io_submit(struct perf_task *task)
+{
+	struct perf_context_t *perf_context = task->perf_context;
+	uint64_t num_ops = perf_context->io_units / perf_context->io_units_per_op;
+
+	if (g_is_random) {
+		task->offset = (rand() % num_ops) * perf_context->io_units_per_op;
+	} else {
+		task->offset = perf_context->next_offset;
+		perf_context->next_offset += perf_context->io_units_per_op;
+		if (perf_context->next_offset + perf_context->io_units_per_op > perf_context->io_units) {
+			perf_context->next_offset = 0;
+		}
+	}
+
+	if (g_is_write) {
+		spdk_bs_io_write_blob(perf_context->blob, perf_context->channel, task->buf,
+				      task->offset, perf_context->io_units_per_op,
+				      io_complete, task);
+	} else {
+		spdk_bs_io_read_blob(perf_context->blob, perf_context->channel, task->buf,
+				     task->offset, perf_context->io_units_per_op,
+				     io_complete, task);
+	}
+}
+
+static void
+io_start(struct perf_context_t *perf_context)
+{
+	uint32_t i;
+
+	perf_context->io_units_per_op = g_io_size / perf_context->io_unit_size;
+	perf_context->io_units = spdk_blob_get_num_clusters(perf_context->blob) *
+				 spdk_bs_get_cluster_size(perf_context->bs) / perf_context->io_unit_size;
+	if (perf_context->io_units < perf_context->io_units_per_op) {
+		SPDK_ERRLOG("No room on the blobstore for the data path run\n");
+		perf_context->rc = -ENOSPC;
+		spdk_blob_close(perf_context->blob, io_blob_close_complete, perf_context);
+		return;
+	}
+
+	perf_context->tasks = calloc(g_queue_depth, sizeof(*perf_context->tasks));
+	if (perf_context->tasks == NULL) {
+		perf_context->rc = -ENOMEM;
+		spdk_blob_close(perf_context->blob, io_blob_close_complete, perf_context);
+		return;
+	}
+
+	for (i = 0; i < g_queue_depth; i++) {
+		perf_context->tasks[i].perf_context = perf_context;
+		perf_context->tasks[i].buf = spdk_dma_zmalloc(g_io_size, 0x1000, NULL);
+		if (perf_context->tasks[i].buf == NULL) {
+			SPDK_ERRLOG("Could not allocate I/O buffers\n");
+			perf_context->rc = -ENOMEM;
+			spdk_blob_close(perf_context->blob, io_blob_close_complete, perf_context);
+			return;
+		}
+		memset(perf_context->tasks[i].buf, 0x5A, g_io_size);
+	}
+
+	perf_context->start_tsc = spdk_get_ticks();
+	perf_context->end_tsc = perf_context->start_tsc + g_time_in_sec * spdk_get_ticks_hz();
+
+	perf_context->io_outstanding = g_queue_depth;
+	for (i = 0; i < g_queue_depth; i++) {
+		io_submit(&perf_context->tasks[i]);
+	}
+}
+
+static void
+io_blob_sync_complete(void *arg1, int bserrno)
+{
+	struct perf_context_t *perf_context = arg1;
+
+	if (bserrno) {
+		perf_context->rc = bserrno;
+		spdk_blob_close(perf_context->blob, io_blob_close_complete, perf_context);
+		return;
+	}
+
+	io_start(perf_context);
+}
+
+static void
+io_blob_open_complete(void *arg1, struct spdk_blob *blob, int bserrno)
+{
+	struct perf_context_t *perf_context = arg1;
+	int rc;
+
+	if (bserrno) {
+		unload_bs(perf_context, "Error opening the io blob", bserrno);
+		return;
+	}
+
+	perf_context->blob = blob;
+	/* Fill the blobstore, so the run covers the whole device */
+	rc = spdk_blob_resize(blob, spdk_bs_free_cluster_count(perf_context->bs));
+	if (rc) {
+		perf_context->rc = rc;
+		spdk_blob_close(blob, io_blob_close_complete, perf_context);
+		return;
+	}
+
+	spdk_blob_sync_md(blob, io_blob_sync_complete, perf_context);
+}
+
+static void
+io_blob_create_complete(void *arg1, spdk_blob_id blobid, int bserrno)
+{
+	struct perf_context_t *perf_context = arg1;
+
+	if (bserrno) {
+		unload_bs(perf_context, "Error creating the io blob", bserrno);
+		return;
+	}
+
+	perf_context->blobid = blobid;
+	spdk_bs_open_blob(perf_context->bs, blobid, io_blob_open_complete, perf_context);
+}
+
+/*
+ * Metadata phases.  Each one issues one operation per blob, keeping up to
+ *  the queue depth of them outstanding.
+ */
+static void md_phase_continue(struct perf_context_t *perf_context);
+
+static void
+md_op_complete(struct perf_blob *perf_blob, int bserrno)
+{
+	struct perf_context_t *perf_context = perf_blob->perf_context;
+
+	if (bserrno && perf_context->rc == 0) {
+		SPDK_ERRLOG("%s failed (err %d)\n", g_phase_names[perf_context->phase], bserrno);
+		perf_context->rc = bserrno;
+	}
+
+	perf_context->outstanding--;
+	perf_context->completed++;
+	if (!perf_context->in_submit) {
+		md_phase_continue(perf_context);
+	}
+}
+
+static void
+md_create_complete(void *arg1, spdk_blob_id blobid, int bserrno)
+{
+	struct perf_blob *perf_blob = arg1;
+
+	perf_blob->blobid = blobid;
+	md_op_complete(perf_blob, bserrno);
+}
+
+static void
+md_open_complete(void *arg1, struct spdk_blob *blob, int bserrno)
+{
+	struct perf_blob *perf_blob = arg1;
+
+	perf_blob->blob = blob;
+	md_op_complete(perf_blob, bserrno);
+}
+
+static void
+md_op_generic_complete(void *arg1, int bserrno)
+{
+	md_op_complete(arg1, bserrno);
+}
+
+static void
+md_op_submit(struct perf_context_t *perf_context, struct perf_blob *perf_blob)
+{
+	switch (perf_context->phase) {
+	case PERF_CREATE:
+		spdk_bs_create_blob(perf_context->bs, md_create_complete, perf_blob);
+		break;
+	case PERF_OPEN:
+		spdk_bs_open_blob(perf_context->bs, perf_blob->blobid, md_open_complete, perf_blob);
+		break;
+	case PERF_RESIZE:
+		md_op_complete(perf_blob, spdk_blob_resize(perf_blob->blob, g_num_clusters));
+		break;
+	case PERF_SYNC_MD:
+		spdk_blob_sync_md(perf_blob->blob, md_op_generic_complete, perf_blob);
+		break;
+	case PERF_CLOSE:
+		spdk_blob_close(perf_blob->blob, md_op_generic_complete, perf_blob);
+		break;
+	case PERF_DELETE:
+		spdk_bs_delete_blob(perf_context->bs, perf_blob->blobid, md_op_generic_complete, perf_blob);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
+static void
+md_phase_start(struct perf_context_t *perf_context, enum perf_phase phase)
+{
+	perf_context->phase = phase;
+	perf_context->submitted = 0;
+	perf_context->completed = 0;
+	perf_context->start_tsc = spdk_get_ticks();
+	md_phase_continue(perf_context);
+}
+
+static void
+md_phase_done(struct perf_context_t *perf_context)
+{
+	double sec = perf_elapsed_sec(perf_context->start_tsc);
+
+	if (perf_context->rc) {
+		unload_bs(perf_context, "Metadata phase failed", perf_context->rc);
+		return;
+	}
+
+	printf("%-10s %10u ops in %8.3f s: %12.2f ops/s\n", g_phase_names[perf_context->phase],
+	       perf_context->completed, sec, perf_context->completed / sec);
+
+	if (perf_context->phase + 1 < PERF_NUM_MD_PHASES) {
+		md_phase_start(perf_context, perf_context->phase + 1);
+		return;
+	}
+
+	spdk_bs_create_blob(perf_context->bs, io_blob_create_complete, perf_context);
+}
+
+static void
+md_phase_continue(struct perf_context_t *perf_context)
+{
+	/* Operations completing inline are picked up by this loop */
+	perf_context->in_submit = true;
+	while (perf_context->rc == 0 && perf_context->outstanding < g_queue_depth &&
+	       perf_context->submitted < g_num_blobs) {
+		perf_context->outstanding++;
+		md_op_submit(perf_context, &perf_context->blobs[perf_context->submitted++]);
+	}
+	perf_context->in_submit = false;
+
+	if (perf_context->outstanding == 0 &&
+	    (perf_context->rc != 0 || perf_context->submitted == g_num_blobs)) {
+		md_phase_done(perf_context);
+	}
+}
+
+static void
+bs_init_complete(void *cb_arg, struct spdk_blob_store *bs, int bserrno)
+{
+	struct perf_context_t *perf_context = cb_arg;
+	uint32_t i;
+
+	if (bserrno) {
+		unload_bs(perf_context, "Error initializing the blobstore", bserrno);
+		return;
+	}
+
+	perf_context->bs = bs;
+	perf_context->io_unit_size = spdk_bs_get_io_unit_size(bs);
+	if (g_io_size % perf_context->io_unit_size) {
+		unload_bs(perf_context, "I/O size must be a multiple of the io unit size", -EINVAL);
+		return;
+	}
+
+	perf_context->channel = spdk_bs_alloc_io_channel(bs);
+	if (perf_context->channel == NULL) {
+		unload_bs(perf_context, "Error allocating a channel", -ENOMEM);
+		return;
+	}
+
+	perf_context->blobs = calloc(g_num_blobs, sizeof(*perf_context->blobs));
+	if (perf_context->blobs == NULL) {
+		unload_bs(perf_context, "Error allocating blobs", -ENOMEM);
+		return;
+	}
+	for (i = 0; i < g_num_blobs; i++) {
+		perf_context->blobs[i].perf_context = perf_context;
+	}
+
+	printf("Blobstore on %s: %" PRIu64 " clusters of %" PRIu64 " bytes, queue depth %u\n",
+	       g_bdev_name, spdk_bs_free_cluster_count(bs), spdk_bs_get_cluster_size(bs),
+	       g_queue_depth);
+	md_phase_start(perf_context, PERF_CREATE);
+}
+
+static void
+perf_start(void *arg1, void *arg2)
+{
+	struct perf_context_t *perf_context = arg1;
+	struct spdk_bdev *bdev;
+	struct spdk_bs_dev *bs_dev;
+
+	bdev = spdk_bdev_get_by_name(g_bdev_name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("Could not find bdev %s\n", g_bdev_name);
+		spdk_app_stop(-1);
+		return;
+	}
+
+	bs_dev = spdk_bdev_create_bs_dev(bdev, NULL, NULL);
+	if (bs_dev == NULL) {
+		SPDK_ERRLOG("Could not create blob bdev!!\n");
+		spdk_app_stop(-1);
+		return;
+	}
+
+	spdk_bs_init(bs_dev, NULL, bs_init_complete, perf_context);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts = {};
+	struct perf_context_t *perf_context;
+	const char *workload_type = "randwrite";
+	int op, rc;
+
+	while ((op = getopt(argc, argv, "b:c:C:n:q:s:t:w:")) != -1) {
+		switch (op) {
+		case 'b':
+			g_bdev_name = optarg;
+			break;
+		case 'c':
+			g_config_file = optarg;
+			break;
+		case 'C':
+			g_num_clusters = strtoull(optarg, NULL, 10);
+			break;
+		case 'n':
+			g_num_blobs = atoi(optarg);
+			break;
+		case 'q':
+			g_queue_depth = atoi(optarg);
+			break;
+		case 's':
+			g_io_size = atoi(optarg);
+			break;
+		case 't':
+			g_time_in_sec = atoi(optarg);
+			break;
+		case 'w':
+			workload_type = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (g_num_blobs == 0 || g_queue_depth == 0 || g_io_size == 0 || g_time_in_sec <= 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	if (!strcmp(workload_type, "read") || !strcmp(workload_type, "randread")) {
+		g_is_write = false;
+	} else if (strcmp(workload_type, "write") && strcmp(workload_type, "randwrite")) {
+		fprintf(stderr, "io pattern type must be one of\n"
+			"(read, write, randread, randwrite)\n");
+		exit(1);
+	}
+	g_is_random = !strncmp(workload_type, "rand", 4);
+
+	spdk_app_opts_init(&opts);
+	opts.name = "blob_perf";
+	opts.config_file = g_config_file;
+	opts.rpc_addr = NULL;
+
+	perf_context = calloc(1, sizeof(*perf_context));
+	if (perf_context == NULL) {
+		SPDK_ERRLOG("Could not alloc perf_context struct!!\n");
+		return -ENOMEM;
+	}
+
+	rc = spdk_app_start(&opts, perf_start, perf_context, NULL);
+	if (rc == 0) {
+		rc = perf_context->rc;
+	}
+
+	perf_cleanup(perf_context);
+	spdk_app_fini();
+	return rc;
+}
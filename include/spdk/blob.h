@@ -152,7 +152,7 @@ struct spdk_bs_opts {
 	uint32_t cluster_sz; /* In bytes. Must be multiple of page size. */
 	uint32_t num_md_pages; /* Count of the number of pages reserved for metadata */
 	uint32_t max_md_ops; /* Maximum simultaneous metadata operations */
-	uint32_t max_channel_ops; /* Maximum simultaneous operations per channel */
+	uint32_t max_channel_ops; /* Operations each channel is sized for; more are allocated on demand */
 	struct spdk_bs_type bstype; /* Blobstore type */
 };
 
@@ -175,6 +175,31 @@ void spdk_bs_destroy(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn,
 /* Flush all volatile data to disk and free in-memory structures. */
 void spdk_bs_unload(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn, void *cb_arg);
 
+struct spdk_bs_fsck_report {
+	uint64_t num_blobs;		/* Blobs found in the metadata region */
+	uint64_t num_md_pages;		/* Metadata pages belonging to those blobs */
+	uint64_t num_clusters;		/* Clusters allocated to those blobs */
+
+	uint64_t orphan_md_pages;	/* Marked used, but not part of any blob */
+	uint64_t unmarked_md_pages;	/* Part of a blob, but marked free */
+	uint64_t crc_md_pages;		/* Marked used, but failing their CRC */
+	uint64_t invalid_md_pages;	/* Part of a blob, but not parseable */
+	uint64_t orphan_blobids;	/* Marked used, but without a root page */
+	uint64_t unmarked_blobids;	/* With a root page, but marked free */
+	uint64_t leaked_clusters;	/* Marked used, but not allocated to any blob */
+	uint64_t unmarked_clusters;	/* Allocated to a blob, but marked free */
+	uint64_t shared_clusters;	/* Allocated more than once, or overlapping the metadata */
+};
+
+/* Check the metadata region of a blob store against its used page, blobid and
+ * cluster masks, filling in report.  The check only reads from the device.
+ * bserrno is nonzero only if the check itself could not be completed; any
+ * inconsistency found is counted in report.  Call it from the metadata thread
+ * while no blobs are open, e.g. right after spdk_bs_load().
+ */
+void spdk_bs_fsck(struct spdk_blob_store *bs, struct spdk_bs_fsck_report *report,
+		  spdk_bs_op_complete cb_fn, void *cb_arg);
+
 /* Set the given blob as the super blob. This will be retrievable immediately after an
  * spdk_bs_load on the next initialization.
  */
@@ -188,9 +213,13 @@ void spdk_bs_get_super(struct spdk_blob_store *bs,
 /* Get the cluster size in bytes. Used in the extend operation. */
 uint64_t spdk_bs_get_cluster_size(struct spdk_blob_store *bs);
 
-/* Get the page size in bytes. This is the write and read granularity of blobs. */
+/* Get the page size in bytes. This is the granularity of blob metadata. */
 uint64_t spdk_bs_get_page_size(struct spdk_blob_store *bs);
 
+/* Get the io_unit size in bytes. This is the write and read granularity of blobs,
+ * equal to the block size of the backing device. */
+uint64_t spdk_bs_get_io_unit_size(struct spdk_blob_store *bs);
+
 /* Get the number of free clusters. */
 uint64_t spdk_bs_free_cluster_count(struct spdk_blob_store *bs);
 
@@ -203,11 +232,29 @@ spdk_blob_id spdk_blob_get_id(struct spdk_blob *blob);
 /* Return the number of pages allocated to the blob */
 uint64_t spdk_blob_get_num_pages(struct spdk_blob *blob);
 
+/* Return the number of io_units allocated to the blob */
+uint64_t spdk_blob_get_num_io_units(struct spdk_blob *blob);
+
 /* Return the number of clusters allocated to the blob */
 uint64_t spdk_blob_get_num_clusters(struct spdk_blob *blob);
 
+/* Return the number of clusters actually backed by the blobstore.  This is
+ * lower than spdk_blob_get_num_clusters() for a thin provisioned blob that
+ * has not been written everywhere yet. */
+uint64_t spdk_blob_get_num_allocated_clusters(struct spdk_blob *blob);
+
+/* Return true if clusters of the blob are only allocated on first write */
+bool spdk_blob_is_thin_provisioned(struct spdk_blob *blob);
+
 struct spdk_blob_opts {
 	uint64_t  num_clusters;
+
+	/* Do not claim any clusters when the blob is created or resized.
+	 * Unallocated clusters read back as zeroes and are claimed by
+	 * the first write that touches them. The cluster map is persisted
+	 * together with the rest of the metadata by spdk_blob_sync_md()
+	 * or spdk_blob_close(). */
+	bool	  thin_provision;
 };
 
 /* Initialize an spdk_blob_opts structure to the default blob option values. */
@@ -221,7 +268,65 @@ void spdk_bs_create_blob_ext(struct spdk_blob_store *bs, const struct spdk_blob_
 void spdk_bs_create_blob(struct spdk_blob_store *bs,
 			 spdk_blob_op_with_id_complete cb_fn, void *cb_arg);
 
-/* Delete an existing blob. */
+/* Extended attributes to set on a blob as part of its creation.  The
+ * structure is copied, but names and ctx must stay valid until the
+ * creation completes. */
+struct spdk_blob_xattr_opts {
+	/* Number of attributes */
+	size_t	count;
+	/* Array of attribute names */
+	char	**names;
+	/* Context passed to get_value */
+	void	*ctx;
+	/* Return the value of the attribute with the given name */
+	void (*get_value)(void *xattr_ctx, const char *name, const void **value, size_t *value_len);
+};
+
+/* Create a read-only snapshot of a blob.
+ *
+ * The snapshot takes over the clusters of the blob, which becomes a thin
+ * provisioned clone of the snapshot: reads of clusters the blob has not
+ * written since go to the snapshot, and the first write to such a cluster
+ * copies it.  Only metadata is written, so this is fast regardless of the
+ * size of the blob.  The caller must not have I/O outstanding to the blob
+ * while the snapshot is taken.  xattrs may be NULL. */
+void spdk_bs_create_snapshot(struct spdk_blob_store *bs, spdk_blob_id blobid,
+			     const struct spdk_blob_xattr_opts *xattrs,
+			     spdk_blob_op_with_id_complete cb_fn, void *cb_arg);
+
+/* Create a thin provisioned clone of a snapshot.  The clone shares all data
+ * with the snapshot until it is written.  xattrs may be NULL. */
+void spdk_bs_create_clone(struct spdk_blob_store *bs, spdk_blob_id snapshot_id,
+			  const struct spdk_blob_xattr_opts *xattrs,
+			  spdk_blob_op_with_id_complete cb_fn, void *cb_arg);
+
+/* Copy every cluster a blob reads from its snapshot, or that is unallocated,
+ * into the blob and remove the dependency on the snapshot.  The blob is
+ * fully provisioned afterwards.  I/O to the blob may continue meanwhile. */
+void spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg);
+
+/* Copy only the clusters a blob reads from its immediate snapshot into the
+ * blob, and make the snapshot's own parent, if any, the parent of the blob.
+ * The blob stays thin provisioned.  I/O to the blob may continue meanwhile. */
+void spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+				  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg);
+
+/* Return true if the blob is a read-only snapshot */
+bool spdk_blob_is_snapshot(struct spdk_blob *blob);
+
+/* Return true if the blob reads unwritten clusters from a snapshot */
+bool spdk_blob_is_clone(struct spdk_blob *blob);
+
+/* Return the id of the snapshot the blob was cloned from, or
+ * SPDK_BLOBID_INVALID if it has none */
+spdk_blob_id spdk_blob_get_parent_snapshot(struct spdk_blob *blob);
+
+/* Return the number of blobs cloned from this snapshot */
+uint64_t spdk_blob_get_num_clones(struct spdk_blob *blob);
+
+/* Delete an existing blob.  Fails with -EBUSY for a snapshot that still
+ * has clones. */
 void spdk_bs_delete_blob(struct spdk_blob_store *bs, spdk_blob_id blobid,
 			 spdk_blob_op_complete cb_fn, void *cb_arg);
 
@@ -237,8 +342,10 @@ int spdk_blob_resize(struct spdk_blob *blob, size_t sz);
 
 /* Sync a blob */
 /* Make a blob persistent. This applies to resize, set xattr,
- * and remove xattr. These operations will not be persistent until
- * the blob has been synced.
+ * remove xattr and clusters allocated by writes to a thin provisioned
+ * blob. These operations will not be persistent until the blob has
+ * been synced. If a sync is already in progress, the blob is synced
+ * again once it completes.
  */
 void spdk_blob_sync_md(struct spdk_blob *blob, spdk_blob_op_complete cb_fn, void *cb_arg);
 
@@ -249,34 +356,40 @@ struct spdk_io_channel *spdk_bs_alloc_io_channel(struct spdk_blob_store *bs);
 
 void spdk_bs_free_io_channel(struct spdk_io_channel *channel);
 
-/* Write data to a blob. Offset is in pages from the beginning of the blob. */
+/* Write data to a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_write_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			   void *payload, uint64_t offset, uint64_t length,
 			   spdk_blob_op_complete cb_fn, void *cb_arg);
 
-/* Read data from a blob. Offset is in pages from the beginning of the blob. */
+/* Read data from a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_read_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			  void *payload, uint64_t offset, uint64_t length,
 			  spdk_blob_op_complete cb_fn, void *cb_arg);
 
-/* Write data to a blob. Offset is in pages from the beginning of the blob. */
+/* Write data to a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_writev_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			    struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
 			    spdk_blob_op_complete cb_fn, void *cb_arg);
 
-/* Read data from a blob. Offset is in pages from the beginning of the blob. */
+/* Read data from a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_readv_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			   struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
 			   spdk_blob_op_complete cb_fn, void *cb_arg);
 
-/* Unmap area of a blob. Offset is in pages from the beginning of the blob. */
+/* Unmap area of a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_unmap_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			   uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg);
 
-/* Write zeros into area of a blob. Offset is in pages from the beginning of the blob. */
+/* Write zeros into area of a blob. Offset is in io_units from the beginning of the blob. */
 void spdk_bs_io_write_zeroes_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 				  uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg);
 
+/* Persist the clusters allocated by writes to the blob that have completed so far
+ * and flush the device. Unlike spdk_blob_sync_md(), this may be called from any
+ * thread with an I/O channel. */
+void spdk_bs_io_flush_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
+			   spdk_blob_op_complete cb_fn, void *cb_arg);
+
 /* Iterate through all blobs */
 void spdk_bs_iter_first(struct spdk_blob_store *bs,
 			spdk_blob_op_with_handle_complete cb_fn, void *cb_arg);
@@ -85,12 +85,32 @@ struct spdk_io_channel *spdk_fs_alloc_io_channel(struct spdk_filesystem *fs);
  */
 struct spdk_io_channel *spdk_fs_alloc_io_channel_sync(struct spdk_filesystem *fs);
 
+typedef void (*fs_send_io_request_fn)(uint32_t thread_index, fs_request_fn, void *);
+
+/*
+ * Spread the data path requests of files - cache flushes, readahead, and reads and writes
+ *  that bypass the cache - across num_threads threads instead of sending them all through
+ *  the send_request_fn given to spdk_fs_init() or spdk_fs_load().  Each file is hashed to
+ *  one thread, so its requests stay in order.  send_io_request_fn must run the request on
+ *  the thread with the given index, from 0 to num_threads - 1, and those threads must be
+ *  SPDK threads.  Metadata requests still go through send_request_fn.  Call this before
+ *  opening any files.
+ */
+int spdk_fs_set_io_threads(struct spdk_filesystem *fs, uint32_t num_threads,
+			   fs_send_io_request_fn send_io_request_fn);
+
 void spdk_fs_free_io_channel(struct spdk_io_channel *channel);
 
 int spdk_fs_file_stat(struct spdk_filesystem *fs, struct spdk_io_channel *channel,
 		      const char *name, struct spdk_file_stat *stat);
 
 #define SPDK_BLOBFS_OPEN_CREATE	(1ULL << 0)
+/*
+ * Bypass the cache - reads and appends go straight to the blob, in a single request that
+ *  uses the caller's buffers when they are DMA-able and aligned to the blobstore io unit.
+ *  The flag applies to the file until all of its users have closed it.
+ */
+#define SPDK_BLOBFS_OPEN_DIRECT	(1ULL << 1)
 
 int spdk_fs_create_file(struct spdk_filesystem *fs, struct spdk_io_channel *channel,
 			const char *name);
@@ -106,6 +126,18 @@ int spdk_fs_rename_file(struct spdk_filesystem *fs, struct spdk_io_channel *chan
 int spdk_fs_delete_file(struct spdk_filesystem *fs, struct spdk_io_channel *channel,
 			const char *name);
 
+typedef void (*spdk_fs_dir_entry_fn)(void *ctx, const char *name, bool is_dir);
+
+/*
+ * Call fn for each file and subdirectory of a directory, with the entry name relative to
+ *  the directory.  Directories are the paths before the last '/' of file names, and exist
+ *  as long as they hold files.  "" or "/" is the root directory.  fn runs on the metadata
+ *  thread, so it must not call back into the filesystem.  Returns -ENOENT if the directory
+ *  does not exist.
+ */
+int spdk_fs_read_dir(struct spdk_filesystem *fs, struct spdk_io_channel *channel,
+		     const char *name, spdk_fs_dir_entry_fn fn, void *ctx);
+
 spdk_fs_iter spdk_fs_iter_first(struct spdk_filesystem *fs);
 spdk_fs_iter spdk_fs_iter_next(spdk_fs_iter iter);
 #define spdk_fs_iter_get_file(iter)	((struct spdk_file *)(iter))
@@ -113,6 +145,14 @@ spdk_fs_iter spdk_fs_iter_next(spdk_fs_iter iter);
 void spdk_file_truncate(struct spdk_file *file, struct spdk_io_channel *channel,
 			uint64_t length);
 
+/*
+ * Reserve blobstore space for the file to grow to length bytes, without changing its length.
+ *  Appends grow files geometrically as well.  Space past the end of the file is released
+ *  when its last user closes it.
+ */
+int spdk_file_allocate(struct spdk_file *file, struct spdk_io_channel *channel,
+		       uint64_t length);
+
 const char *spdk_file_get_name(struct spdk_file *file);
 
 uint64_t spdk_file_get_length(struct spdk_file *file);
@@ -123,14 +163,113 @@ int spdk_file_write(struct spdk_file *file, struct spdk_io_channel *channel,
 int64_t spdk_file_read(struct spdk_file *file, struct spdk_io_channel *channel,
 		       void *payload, uint64_t offset, uint64_t length);
 
+/*
+ * Vectored versions of spdk_file_write() and spdk_file_read(), for the total length of
+ *  the iovecs.
+ */
+int spdk_file_writev(struct spdk_file *file, struct spdk_io_channel *channel,
+		     struct iovec *iovs, int iovcnt, uint64_t offset);
+
+int64_t spdk_file_readv(struct spdk_file *file, struct spdk_io_channel *channel,
+			struct iovec *iovs, int iovcnt, uint64_t offset);
+
+struct spdk_file_read_req {
+	void		*payload;
+	uint64_t	offset;
+	uint64_t	length;
+	/* Set to the number of bytes read, short at the end of the file, or a negative errno */
+	int64_t		result;
+};
+
+/*
+ * Read several ranges of a file at once.  The reads of all ranges are sent before waiting
+ *  for any of them, so cache misses are read from the blob concurrently.  Returns 0, or
+ *  the first error of any range.
+ */
+int spdk_file_read_batch(struct spdk_file *file, struct spdk_io_channel *channel,
+			 struct spdk_file_read_req *reqs, uint32_t count);
+
+/*
+ * Start reading a range of a file into the cache without waiting for it, within the limit
+ *  on read ahead buffers set by spdk_fs_set_readahead_limits().  Files opened with
+ *  SPDK_BLOBFS_OPEN_DIRECT are not prefetched.
+ */
+void spdk_file_prefetch(struct spdk_file *file, uint64_t offset, uint64_t length);
+
+/*
+ * Lend the cache buffer holding the data at offset instead of copying it.  On success,
+ *  *data points to the cached data and the number of bytes available there is returned,
+ *  at most length and never past the end of the cache buffer.  The buffer stays in the
+ *  cache until spdk_file_unpin_buffer() is called with any offset within it, which must
+ *  happen before the file is closed.  Returns -ENODATA if the data is not cached, in which
+ *  case it should be read with spdk_file_read().
+ */
+int64_t spdk_file_pin_buffer(struct spdk_file *file, uint64_t offset, uint64_t length,
+			     const void **data);
+void spdk_file_unpin_buffer(struct spdk_file *file, uint64_t offset);
+
+/*
+ * Set the size of the cache shared by all filesystems.  The cache memory is allocated when
+ *  the first filesystem is initialized or loaded, split across the NUMA sockets of the SPDK
+ *  cores, and buffers are taken from the socket of the caller first.  While it is allocated,
+ *  raising the size allocates more memory, and lowering it evicts clean buffers down to the
+ *  new size but keeps the memory for later growth.
+ */
 void spdk_fs_set_cache_size(uint64_t size_in_mb);
 uint64_t spdk_fs_get_cache_size(void);
 
+struct spdk_fs_cache_stats {
+	/* Bytes of cache buffers currently holding file data */
+	uint64_t	bytes_cached;
+	/* Cached reads, counted per cache buffer read from */
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	evictions;
+	/* Buffers filled by readahead, and how many of those were read before being evicted */
+	uint64_t	readahead_buffers;
+	uint64_t	readahead_hits;
+};
+
+void spdk_fs_get_cache_stats(struct spdk_fs_cache_stats *stats);
+
 #define SPDK_FILE_PRIORITY_LOW	0 /* default */
 #define SPDK_FILE_PRIORITY_HIGH	1
 
+/*
+ * Cache buffers of low priority files are evicted before those of high priority files.
+ *  The priority applies to buffers the file caches after it is set.
+ */
 void spdk_file_set_priority(struct spdk_file *file, uint32_t priority);
 
+/*
+ * Limit readahead to file_max bytes ahead of the reader of a file, and the cache buffers
+ *  filled by readahead and not yet read to total_max bytes across all files.  A file_max
+ *  of 0 disables readahead.  A total_max of 0 restores the default of a quarter of the cache.
+ */
+void spdk_fs_set_readahead_limits(uint64_t file_max, uint64_t total_max);
+
+#define SPDK_FILE_ACCESS_NORMAL		0 /* default */
+#define SPDK_FILE_ACCESS_RANDOM		1
+#define SPDK_FILE_ACCESS_SEQUENTIAL	2
+
+/*
+ * Normal files are read ahead once they are read sequentially, with a window that grows
+ *  as long as the reads stay sequential.  Random files are never read ahead, and sequential
+ *  files are always read ahead by the largest window.  The hint is shared by all users
+ *  of the file.
+ */
+void spdk_file_set_access_hint(struct spdk_file *file, uint32_t hint);
+
+/*
+ * Drop the clean cache buffers of a file that lie entirely within the given range.  A
+ *  length of 0, or a range past the end of the file, extends the range to the end of the file.
+ */
+void spdk_file_invalidate_cache(struct spdk_file *file, uint64_t offset, uint64_t length);
+
+/*
+ * Write the cached data of a file to the blobstore and persist its length.  Returns the
+ *  error of a failed flush; the data stays cached and is flushed again by the next sync.
+ */
 int spdk_file_sync(struct spdk_file *file, struct spdk_io_channel *channel);
 
 #ifdef __cplusplus
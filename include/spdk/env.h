@@ -250,6 +250,15 @@ uint32_t spdk_env_get_next_core(uint32_t prev_core);
  */
 uint32_t spdk_env_get_socket_id(uint32_t core);
 
+/**
+ * \brief Return the socket ID of the given OS CPU.
+ *
+ * Unlike spdk_env_get_socket_id(), the CPU does not need to be one of the SPDK cores.
+ *
+ * \return the socket ID, or SPDK_ENV_SOCKET_ID_ANY if it cannot be determined.
+ */
+int spdk_env_get_socket_id_of_cpu(uint32_t cpu);
+
 typedef int (*thread_start_fn)(void *);
 
 /**
@@ -95,6 +95,12 @@ struct spdk_app_opts {
 	 * specified in microseconds.
 	 */
 	uint64_t		max_delay_us;
+
+	/* When a reactor is idle and all of its pollers can be woken by a
+	 * file descriptor, block in epoll instead of polling.  Reactors still
+	 * poll while they have work to do.
+	 */
+	bool			interrupt_mode;
 };
 
 /**
@@ -197,6 +203,134 @@ void spdk_reactor_enable_context_switch_monitor(bool enabled);
  */
 bool spdk_reactor_context_switch_monitor_enabled(void);
 
+/**
+ * \brief Busy and idle time accounting for a reactor.
+ */
+struct spdk_reactor_stats {
+	/* Ticks spent running events and pollers that reported work. */
+	uint64_t	busy_tsc;
+
+	/* Ticks spent running pollers that found no work, or sleeping. */
+	uint64_t	idle_tsc;
+
+	/* Percentage of the last scheduler period that the reactor was busy. */
+	uint32_t	load;
+};
+
+/**
+ * \brief Get the busy and idle time accounting for the reactor on the given lcore.
+ *
+ * \return 0 on success, -EINVAL if there is no reactor on that lcore.
+ */
+int spdk_reactor_get_stats(uint32_t lcore, struct spdk_reactor_stats *stats);
+
+/**
+ * \brief Callback used by the reactor scheduler to move work off a busy reactor.
+ *
+ * Called on the busy reactor's lcore.  The handler should hand off some of the
+ *  work it owns on the current lcore to dst_lcore.
+ *
+ * \return 0 if work was moved, or a negated errno if the handler had nothing to move.
+ */
+typedef int (*spdk_reactor_migrate_fn)(uint32_t dst_lcore, void *ctx);
+
+/**
+ * \brief Register a handler that can move work between reactors on behalf of the scheduler.
+ *
+ * When the scheduler decides to move work from one reactor to another, handlers are
+ *  called in registration order until one of them reports that it moved something.
+ */
+int spdk_reactor_register_migrate_handler(spdk_reactor_migrate_fn fn, void *ctx);
+
+/**
+ * \brief Unregister a handler previously registered with spdk_reactor_register_migrate_handler().
+ *
+ * A call of the handler already in progress on another reactor is not waited for.
+ */
+void spdk_reactor_unregister_migrate_handler(spdk_reactor_migrate_fn fn, void *ctx);
+
+/**
+ * \brief Select the reactor scheduler policy.
+ *
+ * \param name Name of a registered scheduler, e.g. "static" or "balanced".
+ * \param period_us How often the scheduler examines reactor load, in microseconds.
+ *                  0 selects the default period.
+ *
+ * \return 0 on success, -ENOENT if no scheduler with that name is registered.
+ */
+int spdk_reactor_set_scheduler(const char *name, uint64_t period_us);
+
+/**
+ * \brief Get the name and period of the active reactor scheduler.
+ */
+const char *spdk_reactor_get_scheduler(uint64_t *period_us);
+
+enum spdk_reactor_sched_result {
+	/* The busy reactor has not processed the request yet. */
+	SPDK_REACTOR_SCHED_PENDING,
+
+	/* A migrate handler moved work to the destination reactor. */
+	SPDK_REACTOR_SCHED_MIGRATED,
+
+	/* No migrate handler had anything to move. */
+	SPDK_REACTOR_SCHED_NO_WORK,
+};
+
+/**
+ * \brief A decision made by the reactor scheduler to move work between reactors.
+ */
+struct spdk_reactor_sched_decision {
+	uint64_t			tsc;
+	uint32_t			src_lcore;
+	uint32_t			dst_lcore;
+	enum spdk_reactor_sched_result	result;
+};
+
+/**
+ * \brief Copy out the most recent scheduler decisions, newest first.
+ *
+ * \return Number of decisions copied, at most max_decisions.
+ */
+uint32_t spdk_reactor_get_sched_decisions(struct spdk_reactor_sched_decision *decisions,
+		uint32_t max_decisions);
+
+/**
+ * \brief Create a lightweight thread scheduled by the reactor on the given lcore.
+ *
+ * Each reactor runs any number of lightweight threads next to its default thread.
+ *  A lightweight thread has its own pollers, messages and I/O channels, so it can
+ *  be moved to another reactor, by spdk_reactor_move_thread() or by the reactor
+ *  scheduler, without tearing any of them down.  The thread starts running once
+ *  the reactor picks it up; send it a message with spdk_thread_send_msg() to run
+ *  code on it.
+ *
+ * \param name Human-readable name for the thread.  May be NULL.
+ * \param lcore Core whose reactor should run the thread.
+ *
+ * \return The new thread, or NULL on failure.
+ */
+struct spdk_thread *spdk_reactor_create_thread(const char *name, uint32_t lcore);
+
+/**
+ * \brief Exit the current lightweight thread.
+ *
+ * Must be called from a message or poller running on a thread created with
+ *  spdk_reactor_create_thread().  The thread is freed once it returns to the
+ *  reactor and any messages already sent to it have run.  Its pollers must be
+ *  unregistered and its I/O channels released first.
+ */
+void spdk_reactor_exit_thread(void);
+
+/**
+ * \brief Move a lightweight thread to the reactor on the given lcore.
+ *
+ * The move happens asynchronously, between two polls of the thread, so messages
+ *  and pollers never run concurrently with themselves.
+ *
+ * \return 0 if the move was requested, -EINVAL if there is no reactor on that lcore.
+ */
+int spdk_reactor_move_thread(struct spdk_thread *thread, uint32_t lcore);
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,12 +55,14 @@ typedef void (*spdk_thread_fn)(void *ctx);
 typedef void (*spdk_thread_pass_msg)(spdk_thread_fn fn, void *ctx,
 				     void *thread_ctx);
 
-typedef void (*spdk_poller_fn)(void *ctx);
+typedef int (*spdk_poller_fn)(void *ctx);
 typedef struct spdk_poller *(*spdk_start_poller)(void *thread_ctx,
 		spdk_poller_fn fn,
 		void *arg,
 		uint64_t period_microseconds);
 typedef void (*spdk_stop_poller)(struct spdk_poller *poller, void *thread_ctx);
+typedef int (*spdk_poller_interrupt_fd)(struct spdk_poller *poller, int fd, bool enable,
+					void *thread_ctx);
 
 typedef int (*spdk_io_channel_create_cb)(void *io_device, void *ctx_buf);
 typedef void (*spdk_io_channel_destroy_cb)(void *io_device, void *ctx_buf);
@@ -96,6 +98,50 @@ struct spdk_thread *spdk_allocate_thread(spdk_thread_pass_msg msg_fn,
  */
 void spdk_free_thread(void);
 
+/**
+ * \brief Create a thread that is not tied to the calling pthread.
+ *
+ * Unlike spdk_allocate_thread(), the new thread only becomes the current thread
+ *  once it is passed to spdk_set_thread().  This lets a single pthread schedule
+ *  many threads, each with its own pollers, messages and I/O channels.  The
+ *  parameters are the same as for spdk_allocate_thread().
+ */
+struct spdk_thread *spdk_thread_create(spdk_thread_pass_msg msg_fn,
+				       spdk_start_poller start_poller_fn,
+				       spdk_stop_poller stop_poller_fn,
+				       void *thread_ctx,
+				       const char *name);
+
+/**
+ * \brief Release a thread created with spdk_thread_create().
+ *
+ * All I/O channel references related to the thread must be released first.
+ */
+void spdk_thread_destroy(struct spdk_thread *thread);
+
+/**
+ * \brief Make thread the current thread of the calling pthread.
+ *
+ * Until the next call, spdk_get_thread() on the calling pthread returns thread,
+ *  and pollers and I/O channels are registered and allocated on its behalf.
+ *  Passing NULL reverts to the thread allocated with spdk_allocate_thread(), if any.
+ *
+ * \return The thread that was previously set, or NULL.
+ */
+struct spdk_thread *spdk_set_thread(struct spdk_thread *thread);
+
+/**
+ * \brief Allow pollers on the calling thread to register interrupt file descriptors.
+ *
+ * Threads that can block waiting on file descriptors while idle call this after
+ *  spdk_allocate_thread().  Without it, spdk_poller_add_interrupt_fd() on this thread
+ *  returns -ENOTSUP.
+ *
+ * @param interrupt_fd_fn Called on the thread to start (enable == true) or stop
+ *                        (enable == false) watching fd on behalf of poller.
+ */
+void spdk_thread_set_interrupt_fd_fn(spdk_poller_interrupt_fd interrupt_fd_fn);
+
 /**
  * \brief Get a handle to the current thread. This handle may be passed
  * to other threads and used as the target of spdk_thread_send_msg().
@@ -136,11 +182,14 @@ void spdk_for_each_thread(spdk_thread_fn fn, void *ctx, spdk_thread_fn cpl);
  * \brief Register a poller on the current thread. The poller can be
  * unregistered by calling spdk_poller_unregister().
  *
- * @param fn This function will be called every `period_microseconds`
+ * @param fn This function will be called every `period_microseconds`. It should
+ *           return a positive value if it did work, 0 if it found nothing to do,
+ *           or a negative value on error. The return value is used to account
+ *           busy and idle time for the thread.
  * @param arg Passed to fn
  * @param period_microseconds How often to call `fn`. If 0, call `fn` as often as possible.
  */
-struct spdk_poller *spdk_poller_register(spdk_thread_fn fn,
+struct spdk_poller *spdk_poller_register(spdk_poller_fn fn,
 		void *arg,
 		uint64_t period_microseconds);
 
@@ -151,6 +200,27 @@ struct spdk_poller *spdk_poller_register(spdk_thread_fn fn,
  */
 void spdk_poller_unregister(struct spdk_poller **ppoller);
 
+/**
+ * \brief Tell the current thread that poller only has work to do once fd is readable.
+ *
+ * A thread that supports it may stop calling an idle poller and block until one of
+ *  the poller's interrupt fds becomes readable.  The poller must consume whatever made
+ *  the fd readable, and must remove the fd before it is closed or the poller is
+ *  unregistered.  A poller may register more than one fd.
+ *
+ * @param poller A poller registered on the current thread.
+ * @param fd File descriptor to watch for readability.
+ *
+ * \return 0 on success, -ENOTSUP if the current thread always polls, or a negated
+ *  errno on failure.
+ */
+int spdk_poller_add_interrupt_fd(struct spdk_poller *poller, int fd);
+
+/**
+ * \brief Stop watching an fd added with spdk_poller_add_interrupt_fd().
+ */
+void spdk_poller_remove_interrupt_fd(struct spdk_poller *poller, int fd);
+
 /**
  * \brief Register the opaque io_device context as an I/O device.
  *
@@ -70,6 +70,12 @@ typedef void (*spdk_jsonrpc_handle_request_fn)(
 struct spdk_jsonrpc_server *spdk_jsonrpc_server_listen(int domain, int protocol,
 		struct sockaddr *listen_addr, socklen_t addrlen, spdk_jsonrpc_handle_request_fn handle_request);
 
+/**
+ * Accept new connections, receive requests and send the queued responses of a server.
+ *
+ * \return the number of connections accepted, reads that received data and
+ *  responses sent.
+ */
 int spdk_jsonrpc_server_poll(struct spdk_jsonrpc_server *server);
 
 void spdk_jsonrpc_server_shutdown(struct spdk_jsonrpc_server *server);
@@ -143,12 +143,58 @@ int spdk_lvs_destroy(struct spdk_lvol_store *lvol_store,
  * \param lvs Handle to lvolstore
  * \param name Name of lvol
  * \param sz size of lvol in bytes
+ * \param thin_provision Claim clusters on first write instead of at creation
  * \param cb_fn Completion callback
  * \param cb_arg Completion callback custom arguments
  * \return error
  */
 int spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, uint64_t sz,
-		     spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+		     bool thin_provision, spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Create a read-only snapshot of an lvol
+ *
+ * The snapshot takes over the data of the lvol, which becomes a thin provisioned
+ * clone of the snapshot.  Only metadata is written.  I/O to the lvol must be
+ * quiesced while the snapshot is taken.
+ *
+ * \param origlvol Handle to lvol
+ * \param snapshot_name Name of the new snapshot lvol
+ * \param cb_fn Completion callback, called with the open snapshot lvol
+ * \param cb_arg Completion callback custom arguments
+ * \return error
+ */
+int spdk_lvol_create_snapshot(struct spdk_lvol *origlvol, const char *snapshot_name,
+			      spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Create a thin provisioned, writable clone of a snapshot lvol
+ * \param snapshot Handle to the snapshot lvol
+ * \param clone_name Name of the new clone lvol
+ * \param cb_fn Completion callback, called with the open clone lvol
+ * \param cb_arg Completion callback custom arguments
+ * \return error
+ */
+int spdk_lvol_create_clone(struct spdk_lvol *snapshot, const char *clone_name,
+			   spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Copy all data an lvol reads from its snapshots into the lvol and
+ * detach it from them.  The lvol is fully provisioned afterwards.
+ * \param lvol Handle to lvol
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ */
+void spdk_lvol_inflate(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Copy the data an lvol reads from its immediate snapshot into the lvol
+ * and make the parent of that snapshot, if any, the parent of the lvol.
+ * \param lvol Handle to lvol
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ */
+void spdk_lvol_decouple_parent(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg);
 
 /**
  * \brief Closes lvol and removes information about lvol from its lvolstore.
@@ -107,8 +107,10 @@ typedef void (*new_qpair_fn)(struct spdk_nvmf_qpair *qpair);
  * The new_qpair_fn cb_fn will be called for each newly discovered
  * qpair. The user is expected to add that qpair to a poll group
  * to establish the connection.
+ *
+ * \return the number of connection events processed.
  */
-void spdk_nvmf_tgt_accept(struct spdk_nvmf_tgt *tgt, new_qpair_fn cb_fn);
+int spdk_nvmf_tgt_accept(struct spdk_nvmf_tgt *tgt, new_qpair_fn cb_fn);
 
 /**
  * Create a poll group.
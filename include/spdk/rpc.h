@@ -43,7 +43,7 @@ extern "C" {
 #endif
 
 int spdk_rpc_listen(const char *listen_addr);
-void spdk_rpc_accept(void);
+int spdk_rpc_accept(void);
 void spdk_rpc_close(void);
 
 typedef void (*spdk_rpc_method_handler)(struct spdk_jsonrpc_request *request,
@@ -126,9 +126,38 @@ struct spdk_bdev_module_if {
 	 */
 	bool async_fini;
 
+	/**
+	 * Denotes if the module_init function may complete asynchronously.
+	 */
+	bool async_init;
+
+	/**
+	 * Initialization state and startup time accounting. Used by generic bdev
+	 * layer and must not be modified by bdev modules.
+	 */
+	bool init_started;
+	bool init_done;
+	uint64_t init_start_tsc;
+	uint64_t init_tsc;
+	uint32_t examine_in_progress;
+	uint32_t examine_count;
+	uint64_t examine_start_tsc;
+	uint64_t examine_tsc;
+
 	TAILQ_ENTRY(spdk_bdev_module_if) tailq;
 };
 
+/**
+ * Declares that a module must not be initialized until another module has
+ * finished initializing. Modules without such a dependency are initialized
+ * in list order, and those that initialize asynchronously overlap.
+ */
+struct spdk_bdev_module_depend {
+	const char *name;
+	const char *depends_on;
+	TAILQ_ENTRY(spdk_bdev_module_depend) tailq;
+};
+
 typedef void (*spdk_bdev_unregister_cb)(void *cb_arg, int rc);
 
 /**
@@ -448,6 +477,7 @@ void spdk_scsi_nvme_translate(const struct spdk_bdev_io *bdev_io,
 			      int *sc, int *sk, int *asc, int *ascq);
 
 void spdk_bdev_module_list_add(struct spdk_bdev_module_if *bdev_module);
+void spdk_bdev_module_depend_add(struct spdk_bdev_module_depend *depend);
 
 static inline struct spdk_bdev_io *
 spdk_bdev_io_from_ctx(void *ctx)
@@ -529,6 +559,7 @@ void spdk_bdev_part_submit_request(struct spdk_bdev_part_channel *ch, struct spd
 	__attribute__((constructor)) static void name ## _async_init(void)			\
 	{											\
 		SPDK_GET_BDEV_MODULE(name)->action_in_progress = 1;				\
+		SPDK_GET_BDEV_MODULE(name)->async_init = true;					\
 	}
 
 /*
@@ -541,6 +572,19 @@ void spdk_bdev_part_submit_request(struct spdk_bdev_part_channel *ch, struct spd
 		SPDK_GET_BDEV_MODULE(name)->async_fini = true;					\
 	}
 
+/*
+ * Delay initialization of module _name until module _depends_on has finished initializing.
+ */
+#define SPDK_BDEV_MODULE_DEPEND(_name, _depends_on)						\
+	static struct spdk_bdev_module_depend _name ## _depend_on_ ## _depends_on = {		\
+	.name = #_name,										\
+	.depends_on = #_depends_on,								\
+	};											\
+	__attribute__((constructor)) static void _name ## _depend_on_ ## _depends_on ## _add(void) \
+	{											\
+		spdk_bdev_module_depend_add(&_name ## _depend_on_ ## _depends_on);		\
+	}
+
 /*
  * Modules are not required to use this macro.  It allows modules to reference the module with
  * SPDK_GET_BDEV_MODULE() before it is defined by SPDK_BDEV_MODULE_REGISTER.
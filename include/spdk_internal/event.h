@@ -45,7 +45,7 @@ struct spdk_event {
 	void			*arg2;
 };
 
-int spdk_reactors_init(unsigned int max_delay_us);
+int spdk_reactors_init(unsigned int max_delay_us, bool interrupt_mode);
 void spdk_reactors_fini(void);
 
 void spdk_reactors_start(void);
@@ -53,10 +53,23 @@ void spdk_reactors_stop(void *arg1, void *arg2);
 
 struct spdk_subsystem {
 	const char *name;
-	/* User must call spdk_subsystem_init_next() when they are done with their initialization. */
+	/*
+	 * User must call spdk_subsystem_init_done() when they are done with their initialization,
+	 *  either from within init or later.
+	 */
 	void (*init)(void);
 	void (*fini)(void);
 	void (*config)(FILE *fp);
+
+	/*
+	 * Initialization state, managed by the framework.  A subsystem is initialized as soon
+	 *  as everything it depends on is, so independent subsystems initialize concurrently.
+	 */
+	bool init_started;
+	bool init_done;
+	uint64_t init_start_tsc;
+	uint64_t init_tsc;
+
 	TAILQ_ENTRY(spdk_subsystem) tailq;
 };
 
@@ -72,10 +85,31 @@ void spdk_add_subsystem_depend(struct spdk_subsystem_depend *depend);
 
 void spdk_subsystem_init(struct spdk_event *app_start_event);
 void spdk_subsystem_fini(struct spdk_event *app_finish_event);
-void spdk_subsystem_init_next(int rc);
+void spdk_subsystem_init_done(struct spdk_subsystem *subsystem, int rc);
 void spdk_subsystem_fini_next(void);
 void spdk_subsystem_config(FILE *fp);
 
+struct spdk_reactor_load {
+	uint32_t	lcore;
+	uint64_t	busy_tsc;
+	uint64_t	idle_tsc;
+};
+
+struct spdk_reactor_scheduler {
+	const char *name;
+	/*
+	 * Called once per scheduler period with the busy and idle ticks each reactor
+	 *  accumulated during that period.  Return true and fill in src_lcore and dst_lcore
+	 *  to ask the migrate handlers to move work between the two reactors.
+	 *  May be NULL for a scheduler that never moves work.
+	 */
+	bool (*balance)(const struct spdk_reactor_load *loads, uint32_t count,
+			uint32_t *src_lcore, uint32_t *dst_lcore);
+	TAILQ_ENTRY(spdk_reactor_scheduler) tailq;
+};
+
+void spdk_reactor_scheduler_register(struct spdk_reactor_scheduler *scheduler);
+
 void spdk_rpc_initialize(const char *listen_addr);
 void spdk_rpc_finish(void);
 void spdk_rpc_config_text(FILE *fp);
@@ -95,6 +129,18 @@ void spdk_rpc_config_text(FILE *fp);
 		spdk_add_subsystem(&__spdk_subsystem_ ## _name);		\
 	}
 
+/**
+ * \brief Reference a subsystem registered with SPDK_SUBSYSTEM_REGISTER, e.g. to
+ *  pass to spdk_subsystem_init_done().
+ */
+#define SPDK_GET_SUBSYSTEM(_name) (&__spdk_subsystem_ ## _name)
+
+/**
+ * \brief Allow SPDK_GET_SUBSYSTEM() to be used before SPDK_SUBSYSTEM_REGISTER.
+ */
+#define SPDK_DECLARE_SUBSYSTEM(_name)						\
+	extern struct spdk_subsystem __spdk_subsystem_ ## _name;
+
 /**
  * \brief Declare that a subsystem depends on another subsystem.
  */
@@ -110,4 +156,17 @@ void spdk_rpc_config_text(FILE *fp);
 		spdk_add_subsystem_depend(&__subsystem_ ## _name ## _depend_on ## _depends_on); \
 	}
 
+/**
+ * \brief Register a new reactor scheduler policy
+ */
+#define SPDK_REACTOR_SCHEDULER_REGISTER(_name, _balance)			\
+	static struct spdk_reactor_scheduler __spdk_reactor_scheduler_ ## _name = {	\
+	.name = #_name,								\
+	.balance = _balance,							\
+	};									\
+	__attribute__((constructor)) static void _name ## _scheduler_register(void)	\
+	{									\
+		spdk_reactor_scheduler_register(&__spdk_reactor_scheduler_ ## _name); \
+	}
+
 #endif /* SPDK_INTERNAL_EVENT_H */
@@ -55,6 +55,8 @@ struct spdk_lvol_req {
 	spdk_lvol_op_complete    cb_fn;
 	void                    *cb_arg;
 	struct spdk_lvol	*lvol;
+	struct spdk_io_channel	*channel;
+	bool			decouple;
 };
 
 struct spdk_lvs_with_handle_req {
@@ -102,6 +104,7 @@ struct spdk_lvol {
 	char				*old_name;
 	char				name[SPDK_LVOL_NAME_MAX];
 	bool				close_only;
+	bool				thin_provision;
 	struct spdk_bdev		*bdev;
 	int				ref_count;
 	bool				action_in_progress;
@@ -46,6 +46,8 @@
 
 #include "spdk_internal/log.h"
 
+#include <sys/eventfd.h>
+
 static int bdev_aio_initialize(void);
 static void aio_free_disk(struct file_disk *fdisk);
 static void bdev_aio_get_spdk_running_config(FILE *fp);
@@ -119,6 +121,9 @@ bdev_aio_readv(struct file_disk *fdisk, struct spdk_io_channel *ch,
 	int rc;
 
 	io_prep_preadv(iocb, fdisk->fd, iov, iovcnt, offset);
+	if (aio_ch->efd >= 0) {
+		io_set_eventfd(iocb, aio_ch->efd);
+	}
 	iocb->data = aio_task;
 	aio_task->len = nbytes;
 
@@ -149,6 +154,9 @@ bdev_aio_writev(struct file_disk *fdisk, struct spdk_io_channel *ch,
 	int rc;
 
 	io_prep_pwritev(iocb, fdisk->fd, iov, iovcnt, offset);
+	if (aio_ch->efd >= 0) {
+		io_set_eventfd(iocb, aio_ch->efd);
+	}
 	iocb->data = aio_task;
 	aio_task->len = len;
 
@@ -205,7 +213,7 @@ bdev_aio_initialize_io_channel(struct bdev_aio_io_channel *ch)
 	return 0;
 }
 
-static void
+static int
 bdev_aio_poll(void *arg)
 {
 	struct bdev_aio_io_channel *ch = arg;
@@ -214,16 +222,25 @@ bdev_aio_poll(void *arg)
 	struct bdev_aio_task *aio_task;
 	struct timespec timeout;
 	struct io_event events[SPDK_AIO_QUEUE_DEPTH];
+	uint64_t efd_count;
 
 	timeout.tv_sec = 0;
 	timeout.tv_nsec = 0;
 
+	/*
+	 * Reset the completion counter before reaping, so that any completion that
+	 *  arrives after io_getevents() leaves the eventfd readable.
+	 */
+	if (ch->efd >= 0 && read(ch->efd, &efd_count, sizeof(efd_count)) < 0 && errno != EAGAIN) {
+		SPDK_ERRLOG("%s: read from eventfd failed\n", __func__);
+	}
+
 	nr = io_getevents(ch->io_ctx, 1, SPDK_AIO_QUEUE_DEPTH,
 			  events, &timeout);
 
 	if (nr < 0) {
 		SPDK_ERRLOG("%s: io_getevents returned %d\n", __func__, nr);
-		return;
+		return -1;
 	}
 
 	for (i = 0; i < nr; i++) {
@@ -237,6 +254,8 @@ bdev_aio_poll(void *arg)
 		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task), status);
 		ch->io_inflight--;
 	}
+
+	return nr;
 }
 
 static void
@@ -253,7 +272,7 @@ _bdev_aio_get_io_inflight(struct spdk_io_channel_iter *i)
 	spdk_for_each_channel_continue(i, 0);
 }
 
-static void
+static int
 bdev_aio_reset_retry_timer(void *arg);
 
 static void
@@ -269,7 +288,7 @@ _bdev_aio_get_io_inflight_done(struct spdk_io_channel_iter *i, int status)
 	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(fdisk->reset_task), SPDK_BDEV_IO_STATUS_SUCCESS);
 }
 
-static void
+static int
 bdev_aio_reset_retry_timer(void *arg)
 {
 	struct file_disk *fdisk = arg;
@@ -282,6 +301,8 @@ bdev_aio_reset_retry_timer(void *arg)
 			      _bdev_aio_get_io_inflight,
 			      fdisk,
 			      _bdev_aio_get_io_inflight_done);
+
+	return 1;
 }
 
 static void
@@ -368,6 +389,17 @@ bdev_aio_create_cb(void *io_device, void *ctx_buf)
 	}
 
 	ch->poller = spdk_poller_register(bdev_aio_poll, ch, 0);
+
+	/*
+	 * Completions can wake up a reactor running in interrupt mode.  If that is
+	 *  not possible, there is no point paying for the eventfd on every I/O.
+	 */
+	ch->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ch->efd >= 0 && spdk_poller_add_interrupt_fd(ch->poller, ch->efd) != 0) {
+		close(ch->efd);
+		ch->efd = -1;
+	}
+
 	return 0;
 }
 
@@ -377,6 +409,10 @@ bdev_aio_destroy_cb(void *io_device, void *ctx_buf)
 	struct bdev_aio_io_channel *io_channel = ctx_buf;
 
 	io_destroy(io_channel->io_ctx);
+	if (io_channel->efd >= 0) {
+		spdk_poller_remove_interrupt_fd(io_channel->poller, io_channel->efd);
+		close(io_channel->efd);
+	}
 	spdk_poller_unregister(&io_channel->poller);
 }
 
@@ -53,6 +53,8 @@ struct bdev_aio_io_channel {
 	io_context_t		io_ctx;
 	struct spdk_poller	*poller;
 	uint64_t		io_inflight;
+	/* Signalled by the kernel on each completion, or -1 if unavailable. */
+	int			efd;
 };
 
 struct file_disk {
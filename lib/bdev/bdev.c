@@ -74,10 +74,16 @@ struct spdk_bdev_mgr {
 
 	TAILQ_HEAD(, spdk_bdev_module_if) bdev_modules;
 
+	TAILQ_HEAD(, spdk_bdev_module_depend) bdev_module_depends;
+
 	TAILQ_HEAD(, spdk_bdev) bdevs;
 
 	bool init_complete;
 	bool module_init_complete;
+	bool module_init_scanning;
+	bool module_init_rescan;
+	bool module_init_failed;
+	uint64_t init_start_tsc;
 
 #ifdef SPDK_CONFIG_VTUNE
 	__itt_domain	*domain;
@@ -86,6 +92,7 @@ struct spdk_bdev_mgr {
 
 static struct spdk_bdev_mgr g_bdev_mgr = {
 	.bdev_modules = TAILQ_HEAD_INITIALIZER(g_bdev_mgr.bdev_modules),
+	.bdev_module_depends = TAILQ_HEAD_INITIALIZER(g_bdev_mgr.bdev_module_depends),
 	.bdevs = TAILQ_HEAD_INITIALIZER(g_bdev_mgr.bdevs),
 	.init_complete = false,
 	.module_init_complete = false,
@@ -400,12 +407,38 @@ spdk_bdev_mgmt_channel_destroy(void *io_device, void *ctx_buf)
 	spdk_bdev_mgmt_channel_free_resources(ch);
 }
 
+static void
+spdk_bdev_init_log_times(void)
+{
+	struct spdk_bdev_module_if *m;
+	uint64_t ticks_per_ms = spdk_get_ticks_hz() / 1000;
+	char buf[1024];
+	int len = 0;
+
+	buf[0] = '\0';
+	TAILQ_FOREACH(m, &g_bdev_mgr.bdev_modules, tailq) {
+		if (len >= (int)sizeof(buf)) {
+			break;
+		}
+		len += snprintf(buf + len, sizeof(buf) - len, " %s=%" PRIu64 "/%" PRIu64 "ms(%u)",
+				m->name, m->init_tsc / ticks_per_ms, m->examine_tsc / ticks_per_ms,
+				m->examine_count);
+	}
+
+	SPDK_NOTICELOG("bdev modules initialized in %" PRIu64 " ms, init/examine(examines):%s\n",
+		       (spdk_get_ticks() - g_bdev_mgr.init_start_tsc) / ticks_per_ms, buf);
+}
+
 static void
 spdk_bdev_init_complete(int rc)
 {
 	spdk_bdev_init_cb cb_fn = g_init_cb_fn;
 	void *cb_arg = g_init_cb_arg;
 
+	if (rc == 0) {
+		spdk_bdev_init_log_times();
+	}
+
 	g_bdev_mgr.init_complete = true;
 	g_init_cb_fn = NULL;
 	g_init_cb_arg = NULL;
@@ -454,37 +487,156 @@ spdk_bdev_module_action_done(struct spdk_bdev_module_if *module)
 	spdk_bdev_module_action_complete();
 }
 
+static int spdk_bdev_modules_init(void);
+
+static void
+spdk_bdev_module_init_finished(struct spdk_bdev_module_if *module)
+{
+	module->init_done = true;
+	module->init_tsc = spdk_get_ticks() - module->init_start_tsc;
+}
+
 void
 spdk_bdev_module_init_done(struct spdk_bdev_module_if *module)
 {
+	spdk_bdev_module_init_finished(module);
+
+	/* Modules that depend on this one can now be initialized. */
+	if (!g_bdev_mgr.module_init_complete && !g_bdev_mgr.module_init_failed &&
+	    spdk_bdev_modules_init() != 0) {
+		spdk_bdev_init_complete(-1);
+	}
+
 	spdk_bdev_module_action_done(module);
 }
 
 void
 spdk_bdev_module_examine_done(struct spdk_bdev_module_if *module)
 {
+	assert(module->examine_in_progress > 0);
+	if (--module->examine_in_progress == 0) {
+		module->examine_tsc += spdk_get_ticks() - module->examine_start_tsc;
+	}
+
 	spdk_bdev_module_action_done(module);
 }
 
+static struct spdk_bdev_module_if *
+spdk_bdev_module_find(const char *name)
+{
+	struct spdk_bdev_module_if *module;
+
+	TAILQ_FOREACH(module, &g_bdev_mgr.bdev_modules, tailq) {
+		if (strcmp(module->name, name) == 0) {
+			return module;
+		}
+	}
+
+	return NULL;
+}
+
+static bool
+spdk_bdev_module_deps_initialized(struct spdk_bdev_module_if *module)
+{
+	struct spdk_bdev_module_depend *dep;
+	struct spdk_bdev_module_if *depends_on;
+
+	TAILQ_FOREACH(dep, &g_bdev_mgr.bdev_module_depends, tailq) {
+		if (strcmp(dep->name, module->name) != 0) {
+			continue;
+		}
+		depends_on = spdk_bdev_module_find(dep->depends_on);
+		if (depends_on != NULL && !depends_on->init_done) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Initialize every module whose dependencies have finished initializing.  Modules
+ *  that initialize asynchronously overlap with each other and with the modules
+ *  after them; a module that depends on one of them is started from
+ *  spdk_bdev_module_init_done() once it completes.
+ */
 static int
 spdk_bdev_modules_init(void)
 {
 	struct spdk_bdev_module_if *module;
-	int rc = 0;
+	bool pending = false;
+	int rc;
+
+	if (g_bdev_mgr.module_init_scanning) {
+		g_bdev_mgr.module_init_rescan = true;
+		return 0;
+	}
+
+	g_bdev_mgr.module_init_scanning = true;
+	do {
+		g_bdev_mgr.module_init_rescan = false;
+		TAILQ_FOREACH(module, &g_bdev_mgr.bdev_modules, tailq) {
+			if (module->init_started || !spdk_bdev_module_deps_initialized(module)) {
+				continue;
+			}
+
+			module->init_started = true;
+			module->init_start_tsc = spdk_get_ticks();
+			rc = module->module_init();
+			if (rc != 0) {
+				SPDK_ERRLOG("bdev module %s failed to initialize\n", module->name);
+				g_bdev_mgr.module_init_scanning = false;
+				g_bdev_mgr.module_init_failed = true;
+				return rc;
+			}
+			if (!module->async_init) {
+				spdk_bdev_module_init_finished(module);
+				/* Modules earlier in the list may have been waiting on this one. */
+				g_bdev_mgr.module_init_rescan = true;
+			}
+		}
+	} while (g_bdev_mgr.module_init_rescan);
+	g_bdev_mgr.module_init_scanning = false;
 
 	TAILQ_FOREACH(module, &g_bdev_mgr.bdev_modules, tailq) {
-		rc = module->module_init();
-		if (rc != 0) {
-			break;
+		if (!module->init_started) {
+			pending = true;
+		} else if (!module->init_done) {
+			/* An asynchronous init will start the remaining modules when it completes. */
+			return 0;
 		}
 	}
 
+	if (pending) {
+		SPDK_ERRLOG("bdev module dependencies cannot be satisfied\n");
+		g_bdev_mgr.module_init_failed = true;
+		return -EINVAL;
+	}
+
 	g_bdev_mgr.module_init_complete = true;
-	return rc;
+	return 0;
+}
+
+static int
+spdk_bdev_module_depends_verify(void)
+{
+	struct spdk_bdev_module_depend *dep;
+
+	TAILQ_FOREACH(dep, &g_bdev_mgr.bdev_module_depends, tailq) {
+		if (spdk_bdev_module_find(dep->name) == NULL ||
+		    spdk_bdev_module_find(dep->depends_on) == NULL) {
+			SPDK_ERRLOG("bdev module %s dependency %s is missing\n", dep->name, dep->depends_on);
+			return -ENOENT;
+		}
+	}
+
+	return 0;
 }
+
 void
 spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 {
+	struct spdk_bdev_module_if *module;
 	int cache_size;
 	int rc = 0;
 	char mempool_name[32];
@@ -558,7 +710,16 @@ spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 				spdk_bdev_mgmt_channel_destroy,
 				sizeof(struct spdk_bdev_mgmt_channel));
 
-	rc = spdk_bdev_modules_init();
+	g_bdev_mgr.init_start_tsc = spdk_get_ticks();
+	g_bdev_mgr.module_init_failed = false;
+	TAILQ_FOREACH(module, &g_bdev_mgr.bdev_modules, tailq) {
+		module->init_started = false;
+		module->init_done = false;
+	}
+	rc = spdk_bdev_module_depends_verify();
+	if (rc == 0) {
+		rc = spdk_bdev_modules_init();
+	}
 	if (rc != 0) {
 		SPDK_ERRLOG("bdev modules init failed\n");
 		spdk_bdev_init_complete(-1);
@@ -1929,6 +2090,10 @@ _spdk_bdev_register(struct spdk_bdev *bdev)
 	TAILQ_FOREACH(module, &g_bdev_mgr.bdev_modules, tailq) {
 		if (module->examine) {
 			module->action_in_progress++;
+			if (module->examine_in_progress++ == 0) {
+				module->examine_start_tsc = spdk_get_ticks();
+			}
+			module->examine_count++;
 			module->examine(bdev);
 		}
 	}
@@ -2160,6 +2325,12 @@ spdk_bdev_module_list_add(struct spdk_bdev_module_if *bdev_module)
 	}
 }
 
+void
+spdk_bdev_module_depend_add(struct spdk_bdev_module_depend *depend)
+{
+	TAILQ_INSERT_TAIL(&g_bdev_mgr.bdev_module_depends, depend, tailq);
+}
+
 void
 spdk_bdev_part_base_free(struct spdk_bdev_part_base *base)
 {
@@ -387,6 +387,16 @@ vbdev_get_lvol_by_name(const char *name)
 	return NULL;
 }
 
+struct spdk_lvol *
+vbdev_lvol_get_from_bdev(struct spdk_bdev *bdev)
+{
+	if (!bdev || bdev->module != SPDK_GET_BDEV_MODULE(lvol)) {
+		return NULL;
+	}
+
+	return (struct spdk_lvol *)bdev->ctxt;
+}
+
 static void
 _vbdev_lvol_close_cb(void *cb_arg, int lvserrno)
 {
@@ -445,6 +455,12 @@ vbdev_lvol_destruct(void *ctx)
 
 	assert(lvol != NULL);
 
+	if (!lvol->close_only && spdk_blob_get_num_clones(lvol->blob) > 0) {
+		/* Deleting the snapshot would fail, its clones still read from it */
+		SPDK_ERRLOG("Lvol %s has clones, closing it without deleting\n", lvol->name);
+		lvol->close_only = true;
+	}
+
 	if (lvol->close_only) {
 		free(lvol->bdev->name);
 		free(lvol->bdev);
@@ -502,6 +518,7 @@ vbdev_lvol_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	case SPDK_BDEV_IO_TYPE_RESET:
 	case SPDK_BDEV_IO_TYPE_UNMAP:
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+	case SPDK_BDEV_IO_TYPE_FLUSH:
 		return true;
 	default:
 		return false;
@@ -530,77 +547,88 @@ lvol_op_comp(void *cb_arg, int bserrno)
 static void
 lvol_unmap(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	uint64_t start_page, num_pages;
+	uint64_t start_io_unit, num_io_units;
 	struct spdk_blob *blob = lvol->blob;
 	struct lvol_task *task = (struct lvol_task *)bdev_io->driver_ctx;
 
-	start_page = bdev_io->u.bdev.offset_blocks;
-	num_pages = bdev_io->u.bdev.num_blocks;
+	start_io_unit = bdev_io->u.bdev.offset_blocks;
+	num_io_units = bdev_io->u.bdev.num_blocks;
 
 	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
 
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
-		     "Vbdev doing unmap at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
-		     num_pages, bdev_io->bdev->name);
-	spdk_bs_io_unmap_blob(blob, ch, start_page, num_pages, lvol_op_comp, task);
+		     "Vbdev doing unmap at offset %" PRIu64 " using %" PRIu64 " io_units on device %s\n", start_io_unit,
+		     num_io_units, bdev_io->bdev->name);
+	spdk_bs_io_unmap_blob(blob, ch, start_io_unit, num_io_units, lvol_op_comp, task);
 }
 
 static void
 lvol_write_zeroes(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	uint64_t start_page, num_pages;
+	uint64_t start_io_unit, num_io_units;
 	struct spdk_blob *blob = lvol->blob;
 	struct lvol_task *task = (struct lvol_task *)bdev_io->driver_ctx;
 
-	start_page = bdev_io->u.bdev.offset_blocks;
-	num_pages = bdev_io->u.bdev.num_blocks;
+	start_io_unit = bdev_io->u.bdev.offset_blocks;
+	num_io_units = bdev_io->u.bdev.num_blocks;
 
 	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
 
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
-		     "Vbdev doing write zeros at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
-		     num_pages, bdev_io->bdev->name);
-	spdk_bs_io_write_zeroes_blob(blob, ch, start_page, num_pages, lvol_op_comp, task);
+		     "Vbdev doing write zeros at offset %" PRIu64 " using %" PRIu64 " io_units on device %s\n", start_io_unit,
+		     num_io_units, bdev_io->bdev->name);
+	spdk_bs_io_write_zeroes_blob(blob, ch, start_io_unit, num_io_units, lvol_op_comp, task);
 }
 
 static void
 lvol_read(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	uint64_t start_page, num_pages;
+	uint64_t start_io_unit, num_io_units;
 	struct spdk_lvol *lvol = bdev_io->bdev->ctxt;
 	struct spdk_blob *blob = lvol->blob;
 	struct lvol_task *task = (struct lvol_task *)bdev_io->driver_ctx;
 
-	start_page = bdev_io->u.bdev.offset_blocks;
-	num_pages = bdev_io->u.bdev.num_blocks;
+	start_io_unit = bdev_io->u.bdev.offset_blocks;
+	num_io_units = bdev_io->u.bdev.num_blocks;
 
 	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
 
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
-		     "Vbdev doing read at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
-		     num_pages, bdev_io->bdev->name);
-	spdk_bs_io_readv_blob(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_page,
-			      num_pages,
+		     "Vbdev doing read at offset %" PRIu64 " using %" PRIu64 " io_units on device %s\n", start_io_unit,
+		     num_io_units, bdev_io->bdev->name);
+	spdk_bs_io_readv_blob(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_io_unit,
+			      num_io_units,
 			      lvol_op_comp, task);
 }
 
 static void
 lvol_write(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	uint64_t start_page, num_pages;
+	uint64_t start_io_unit, num_io_units;
 	struct spdk_blob *blob = lvol->blob;
 	struct lvol_task *task = (struct lvol_task *)bdev_io->driver_ctx;
 
-	start_page = bdev_io->u.bdev.offset_blocks;
-	num_pages = bdev_io->u.bdev.num_blocks;
+	start_io_unit = bdev_io->u.bdev.offset_blocks;
+	num_io_units = bdev_io->u.bdev.num_blocks;
 
 	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
 
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
-		     "Vbdev doing write at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
-		     num_pages, bdev_io->bdev->name);
-	spdk_bs_io_writev_blob(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_page,
-			       num_pages, lvol_op_comp, task);
+		     "Vbdev doing write at offset %" PRIu64 " using %" PRIu64 " io_units on device %s\n", start_io_unit,
+		     num_io_units, bdev_io->bdev->name);
+	spdk_bs_io_writev_blob(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_io_unit,
+			       num_io_units, lvol_op_comp, task);
+}
+
+static void
+lvol_flush(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct lvol_task *task = (struct lvol_task *)bdev_io->driver_ctx;
+
+	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+
+	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Vbdev doing flush on device %s\n", bdev_io->bdev->name);
+	spdk_bs_io_flush_blob(lvol->blob, ch, lvol_op_comp, task);
 }
 
 static int
@@ -635,6 +663,9 @@ vbdev_lvol_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
 		lvol_write_zeroes(lvol, ch, bdev_io);
 		break;
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+		lvol_flush(lvol, ch, bdev_io);
+		break;
 	default:
 		SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "lvol: unsupported I/O type %d\n", bdev_io->type);
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
@@ -682,7 +713,7 @@ _create_lvol_disk(struct spdk_lvol *lvol)
 		return NULL;
 	}
 	bdev->product_name = "Logical Volume";
-	bdev->blocklen = spdk_bs_get_page_size(lvol->lvol_store->blobstore);
+	bdev->blocklen = spdk_bs_get_io_unit_size(lvol->lvol_store->blobstore);
 	total_size = lvol->num_clusters * spdk_bs_get_cluster_size(lvol->lvol_store->blobstore);
 	assert((total_size % bdev->blocklen) == 0);
 	bdev->blockcnt = total_size / bdev->blocklen;
@@ -725,7 +756,51 @@ end:
 
 int
 vbdev_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
-		  spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+		  bool thin_provision, spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	int rc;
+
+	req = calloc(1, sizeof(*req));
+	if (req == NULL) {
+		return -ENOMEM;
+	}
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+
+	rc = spdk_lvol_create(lvs, name, sz, thin_provision, _vbdev_lvol_create_cb, req);
+	if (rc != 0) {
+		free(req);
+	}
+
+	return rc;
+}
+
+int
+vbdev_lvol_create_snapshot(struct spdk_lvol *lvol, const char *snapshot_name,
+			   spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	int rc;
+
+	req = calloc(1, sizeof(*req));
+	if (req == NULL) {
+		return -ENOMEM;
+	}
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+
+	rc = spdk_lvol_create_snapshot(lvol, snapshot_name, _vbdev_lvol_create_cb, req);
+	if (rc != 0) {
+		free(req);
+	}
+
+	return rc;
+}
+
+int
+vbdev_lvol_create_clone(struct spdk_lvol *lvol, const char *clone_name,
+			spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
 {
 	struct spdk_lvol_with_handle_req *req;
 	int rc;
@@ -737,7 +812,7 @@ vbdev_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
 	req->cb_fn = cb_fn;
 	req->cb_arg = cb_arg;
 
-	rc = spdk_lvol_create(lvs, name, sz, _vbdev_lvol_create_cb, req);
+	rc = spdk_lvol_create_clone(lvol, clone_name, _vbdev_lvol_create_cb, req);
 	if (rc != 0) {
 		free(req);
 	}
@@ -53,11 +53,40 @@ void vbdev_lvs_destruct(struct spdk_lvol_store *lvs, spdk_lvs_op_complete cb_fn,
 void vbdev_lvs_unload(struct spdk_lvol_store *lvs, spdk_lvs_op_complete cb_fn, void *cb_arg);
 
 int vbdev_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
-		      spdk_lvol_op_with_handle_complete cb_fn,
+		      bool thin_provision, spdk_lvol_op_with_handle_complete cb_fn,
 		      void *cb_arg);
 
 int vbdev_lvol_resize(char *name, size_t sz, spdk_lvol_op_complete cb_fn, void *cb_arg);
 
+/**
+ * \brief Create a snapshot of an lvol and expose it as a read-only bdev
+ * \param lvol Handle to lvol
+ * \param snapshot_name Name of the snapshot lvol
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ * \return error
+ */
+int vbdev_lvol_create_snapshot(struct spdk_lvol *lvol, const char *snapshot_name,
+			       spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Create a clone of a snapshot lvol and expose it as a bdev
+ * \param lvol Handle to the snapshot lvol
+ * \param clone_name Name of the clone lvol
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ * \return error
+ */
+int vbdev_lvol_create_clone(struct spdk_lvol *lvol, const char *clone_name,
+			    spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Get the lvol exposed by a bdev
+ * \param bdev Handle to bdev
+ * \return Handle to spdk_lvol or NULL if the bdev is not an lvol bdev.
+ */
+struct spdk_lvol *vbdev_lvol_get_from_bdev(struct spdk_bdev *bdev);
+
 /**
  * \brief Search for handle lvolstore
  * \param uuid_str UUID of lvolstore
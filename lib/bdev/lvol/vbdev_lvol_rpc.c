@@ -252,6 +252,7 @@ struct rpc_construct_lvol_bdev {
 	char *lvs_name;
 	char *lvol_name;
 	uint64_t size;
+	bool thin_provision;
 };
 
 static void
@@ -267,6 +268,7 @@ static const struct spdk_json_object_decoder rpc_construct_lvol_bdev_decoders[]
 	{"lvs_name", offsetof(struct rpc_construct_lvol_bdev, lvs_name), spdk_json_decode_string, true},
 	{"lvol_name", offsetof(struct rpc_construct_lvol_bdev, lvol_name), spdk_json_decode_string, true},
 	{"size", offsetof(struct rpc_construct_lvol_bdev, size), spdk_json_decode_uint64},
+	{"thin_provision", offsetof(struct rpc_construct_lvol_bdev, thin_provision), spdk_json_decode_bool, true},
 };
 
 static void
@@ -329,7 +331,8 @@ spdk_rpc_construct_lvol_bdev(struct spdk_jsonrpc_request *request,
 
 	sz = (size_t)req.size;
 
-	rc = vbdev_lvol_create(lvs, req.lvol_name, sz, _spdk_rpc_construct_lvol_bdev_cb, request);
+	rc = vbdev_lvol_create(lvs, req.lvol_name, sz, req.thin_provision,
+			       _spdk_rpc_construct_lvol_bdev_cb, request);
 	if (rc < 0) {
 		goto invalid;
 	}
@@ -427,6 +430,200 @@ invalid:
 /* Logical volume resize feature is disabled, as it is currently work in progress
 SPDK_RPC_REGISTER("resize_lvol_bdev", spdk_rpc_resize_lvol_bdev) */
 
+struct rpc_snapshot_lvol_bdev {
+	char *lvol_name;
+	char *snapshot_name;
+};
+
+static void
+free_rpc_snapshot_lvol_bdev(struct rpc_snapshot_lvol_bdev *req)
+{
+	free(req->lvol_name);
+	free(req->snapshot_name);
+}
+
+static const struct spdk_json_object_decoder rpc_snapshot_lvol_bdev_decoders[] = {
+	{"lvol_name", offsetof(struct rpc_snapshot_lvol_bdev, lvol_name), spdk_json_decode_string},
+	{"snapshot_name", offsetof(struct rpc_snapshot_lvol_bdev, snapshot_name), spdk_json_decode_string},
+};
+
+static void
+spdk_rpc_snapshot_lvol_bdev(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct rpc_snapshot_lvol_bdev req = {};
+	struct spdk_lvol *lvol;
+	int rc;
+	char buf[64];
+
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Snapshotting blob\n");
+
+	if (spdk_json_decode_object(params, rpc_snapshot_lvol_bdev_decoders,
+				    SPDK_COUNTOF(rpc_snapshot_lvol_bdev_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		rc = -EINVAL;
+		goto invalid;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(spdk_bdev_get_by_name(req.lvol_name));
+	if (lvol == NULL) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "lvol bdev '%s' does not exist\n", req.lvol_name);
+		rc = -ENODEV;
+		goto invalid;
+	}
+
+	rc = vbdev_lvol_create_snapshot(lvol, req.snapshot_name, _spdk_rpc_construct_lvol_bdev_cb,
+					request);
+	if (rc < 0) {
+		goto invalid;
+	}
+
+	free_rpc_snapshot_lvol_bdev(&req);
+	return;
+
+invalid:
+	spdk_strerror_r(-rc, buf, sizeof(buf));
+	spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, buf);
+	free_rpc_snapshot_lvol_bdev(&req);
+}
+
+SPDK_RPC_REGISTER("snapshot_lvol_bdev", spdk_rpc_snapshot_lvol_bdev)
+
+struct rpc_clone_lvol_bdev {
+	char *snapshot_name;
+	char *clone_name;
+};
+
+static void
+free_rpc_clone_lvol_bdev(struct rpc_clone_lvol_bdev *req)
+{
+	free(req->snapshot_name);
+	free(req->clone_name);
+}
+
+static const struct spdk_json_object_decoder rpc_clone_lvol_bdev_decoders[] = {
+	{"snapshot_name", offsetof(struct rpc_clone_lvol_bdev, snapshot_name), spdk_json_decode_string},
+	{"clone_name", offsetof(struct rpc_clone_lvol_bdev, clone_name), spdk_json_decode_string},
+};
+
+static void
+spdk_rpc_clone_lvol_bdev(struct spdk_jsonrpc_request *request,
+			 const struct spdk_json_val *params)
+{
+	struct rpc_clone_lvol_bdev req = {};
+	struct spdk_lvol *lvol;
+	int rc;
+	char buf[64];
+
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Cloning blob\n");
+
+	if (spdk_json_decode_object(params, rpc_clone_lvol_bdev_decoders,
+				    SPDK_COUNTOF(rpc_clone_lvol_bdev_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		rc = -EINVAL;
+		goto invalid;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(spdk_bdev_get_by_name(req.snapshot_name));
+	if (lvol == NULL) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "lvol bdev '%s' does not exist\n", req.snapshot_name);
+		rc = -ENODEV;
+		goto invalid;
+	}
+
+	rc = vbdev_lvol_create_clone(lvol, req.clone_name, _spdk_rpc_construct_lvol_bdev_cb, request);
+	if (rc < 0) {
+		goto invalid;
+	}
+
+	free_rpc_clone_lvol_bdev(&req);
+	return;
+
+invalid:
+	spdk_strerror_r(-rc, buf, sizeof(buf));
+	spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, buf);
+	free_rpc_clone_lvol_bdev(&req);
+}
+
+SPDK_RPC_REGISTER("clone_lvol_bdev", spdk_rpc_clone_lvol_bdev)
+
+struct rpc_inflate_lvol_bdev {
+	char *name;
+};
+
+static void
+free_rpc_inflate_lvol_bdev(struct rpc_inflate_lvol_bdev *req)
+{
+	free(req->name);
+}
+
+static const struct spdk_json_object_decoder rpc_inflate_lvol_bdev_decoders[] = {
+	{"name", offsetof(struct rpc_inflate_lvol_bdev, name), spdk_json_decode_string},
+};
+
+static void
+_spdk_rpc_inflate_lvol_bdev(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params, bool decouple)
+{
+	struct rpc_inflate_lvol_bdev req = {};
+	struct spdk_lvol *lvol;
+	int rc = 0;
+	char buf[64];
+
+	if (spdk_json_decode_object(params, rpc_inflate_lvol_bdev_decoders,
+				    SPDK_COUNTOF(rpc_inflate_lvol_bdev_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		rc = -EINVAL;
+		goto invalid;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(spdk_bdev_get_by_name(req.name));
+	if (lvol == NULL) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "lvol bdev '%s' does not exist\n", req.name);
+		rc = -ENODEV;
+		goto invalid;
+	}
+
+	if (decouple) {
+		spdk_lvol_decouple_parent(lvol, _spdk_rpc_resize_lvol_bdev_cb, request);
+	} else {
+		spdk_lvol_inflate(lvol, _spdk_rpc_resize_lvol_bdev_cb, request);
+	}
+
+	free_rpc_inflate_lvol_bdev(&req);
+	return;
+
+invalid:
+	spdk_strerror_r(-rc, buf, sizeof(buf));
+	spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, buf);
+	free_rpc_inflate_lvol_bdev(&req);
+}
+
+static void
+spdk_rpc_inflate_lvol_bdev(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Inflating lvol\n");
+
+	_spdk_rpc_inflate_lvol_bdev(request, params, false);
+}
+
+SPDK_RPC_REGISTER("inflate_lvol_bdev", spdk_rpc_inflate_lvol_bdev)
+
+static void
+spdk_rpc_decouple_parent_lvol_bdev(struct spdk_jsonrpc_request *request,
+				   const struct spdk_json_val *params)
+{
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Decoupling parent of lvol\n");
+
+	_spdk_rpc_inflate_lvol_bdev(request, params, true);
+}
+
+SPDK_RPC_REGISTER("decouple_parent_lvol_bdev", spdk_rpc_decouple_parent_lvol_bdev)
+
 static void
 spdk_rpc_get_lvol_stores(struct spdk_jsonrpc_request *request,
 			 const struct spdk_json_val *params)
@@ -455,8 +652,8 @@ spdk_rpc_get_lvol_stores(struct spdk_jsonrpc_request *request,
 
 		bs = lvs_bdev->lvs->blobstore;
 		cluster_size = spdk_bs_get_cluster_size(bs);
-		/* Block size of lvols is always size of blob store page */
-		block_size = spdk_bs_get_page_size(bs);
+		/* Block size of lvols is always the io_unit size of the blob store */
+		block_size = spdk_bs_get_io_unit_size(bs);
 
 		spdk_json_write_object_begin(w);
 
@@ -175,12 +175,13 @@ create_null_bdev(const char *name, uint64_t num_blocks, uint32_t block_size)
 	return &bdev->bdev;
 }
 
-static void
+static int
 null_io_poll(void *arg)
 {
 	struct null_io_channel		*ch = arg;
 	TAILQ_HEAD(, spdk_bdev_io)	io;
 	struct spdk_bdev_io		*bdev_io;
+	int				count = 0;
 
 	TAILQ_INIT(&io);
 	TAILQ_SWAP(&ch->io, &io, spdk_bdev_io, module_link);
@@ -189,7 +190,10 @@ null_io_poll(void *arg)
 		bdev_io = TAILQ_FIRST(&io);
 		TAILQ_REMOVE(&io, bdev_io, module_link);
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		count++;
 	}
+
+	return count;
 }
 
 static int
@@ -301,7 +301,7 @@ bdev_rbd_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	}
 }
 
-static void
+static int
 bdev_rbd_io_poll(void *arg)
 {
 	struct bdev_rbd_io_channel *ch = arg;
@@ -314,7 +314,7 @@ bdev_rbd_io_poll(void *arg)
 
 	/* check the return value of poll since we have only one fd for each channel */
 	if (rc != 1) {
-		return;
+		return 0;
 	}
 
 	rc = rbd_poll_io_events(ch->image, comps, SPDK_RBD_QUEUE_DEPTH);
@@ -338,6 +338,8 @@ bdev_rbd_io_poll(void *arg)
 		rbd_aio_release(comps[i]);
 		spdk_bdev_io_complete(bdev_io, status);
 	}
+
+	return rc;
 }
 
 static void
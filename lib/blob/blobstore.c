@@ -50,6 +50,8 @@
 static int spdk_bs_register_md_thread(struct spdk_blob_store *bs);
 static int spdk_bs_unregister_md_thread(struct spdk_blob_store *bs);
 static void _spdk_blob_close_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno);
+static void _spdk_blob_sync_md(struct spdk_blob_data *blob, spdk_blob_op_complete cb_fn,
+			      void *cb_arg);
 
 static inline size_t
 divide_round_up(size_t num, size_t divisor)
@@ -68,6 +70,10 @@ _spdk_bs_claim_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
 
 	spdk_bit_array_set(bs->used_clusters, cluster_num);
 	bs->num_free_clusters--;
+
+	if (cluster_num == bs->free_cluster_hint) {
+		bs->free_cluster_hint++;
+	}
 }
 
 static void
@@ -81,12 +87,76 @@ _spdk_bs_release_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
 
 	spdk_bit_array_clear(bs->used_clusters, cluster_num);
 	bs->num_free_clusters++;
+
+	if (cluster_num < bs->free_cluster_hint) {
+		bs->free_cluster_hint = cluster_num;
+	}
+}
+
+/*
+ * Return the lowest free cluster, or a value >= total_clusters if there is none.
+ *  Clusters are mostly claimed from the start of the disk, so the search starts
+ *  at the hint instead of rescanning all of the used clusters before it.
+ */
+static uint32_t
+_spdk_bs_find_free_cluster(struct spdk_blob_store *bs)
+{
+	uint32_t cluster_num;
+
+	cluster_num = spdk_bit_array_find_first_clear(bs->used_clusters, bs->free_cluster_hint);
+	bs->free_cluster_hint = spdk_min(cluster_num, bs->total_clusters);
+
+	return cluster_num;
+}
+
+/* Thin provisioned blobs start each new run of clusters on a multiple of this many data clusters */
+#define SPDK_BS_CLUSTER_RUN_ALIGN	8
+
+/*
+ * Pick a free cluster for the cluster at cluster_index of a blob.  Thin
+ *  provisioned blobs written at the same time would otherwise interleave their
+ *  clusters one by one, so a cluster continues the run of the cluster before
+ *  it in the blob when it can.  When it can't, a thin provisioned blob starts a
+ *  new run at the next free aligned cluster, leaving room for the runs of other
+ *  blobs to grow.  The lowest free cluster is the last resort.
+ */
+static uint32_t
+_spdk_blob_find_free_cluster(struct spdk_blob_data *blob, uint64_t cluster_index)
+{
+	struct spdk_blob_store	*bs = blob->bs;
+	uint32_t		first_data_cluster, cluster_num;
+
+	if (cluster_index > 0 && blob->active.clusters[cluster_index - 1] != 0) {
+		cluster_num = _spdk_bs_lba_to_cluster(bs, blob->active.clusters[cluster_index - 1]) + 1;
+		if (cluster_num < bs->total_clusters && !spdk_bit_array_get(bs->used_clusters, cluster_num)) {
+			return cluster_num;
+		}
+	}
+
+	if (blob->invalid_flags & SPDK_BLOB_THIN_PROV) {
+		first_data_cluster = bs->total_clusters - bs->total_data_clusters;
+		cluster_num = spdk_bit_array_find_first_clear(bs->used_clusters, bs->free_cluster_hint);
+		while (cluster_num < bs->total_clusters) {
+			cluster_num = first_data_cluster + divide_round_up(cluster_num - first_data_cluster,
+					SPDK_BS_CLUSTER_RUN_ALIGN) * SPDK_BS_CLUSTER_RUN_ALIGN;
+			if (cluster_num >= bs->total_clusters) {
+				break;
+			}
+			if (!spdk_bit_array_get(bs->used_clusters, cluster_num)) {
+				return cluster_num;
+			}
+			cluster_num = spdk_bit_array_find_first_clear(bs->used_clusters, cluster_num + 1);
+		}
+	}
+
+	return _spdk_bs_find_free_cluster(bs);
 }
 
 void
 spdk_blob_opts_init(struct spdk_blob_opts *opts)
 {
 	opts->num_clusters = 0;
+	opts->thin_provision = false;
 }
 
 static struct spdk_blob_data *
@@ -101,6 +171,7 @@ _spdk_blob_alloc(struct spdk_blob_store *bs, spdk_blob_id id)
 
 	blob->id = id;
 	blob->bs = bs;
+	blob->parent_id = SPDK_BLOBID_INVALID;
 
 	blob->state = SPDK_BLOB_STATE_DIRTY;
 	blob->active.num_pages = 1;
@@ -113,6 +184,7 @@ _spdk_blob_alloc(struct spdk_blob_store *bs, spdk_blob_id id)
 	blob->active.pages[0] = _spdk_bs_blobid_to_page(id);
 
 	TAILQ_INIT(&blob->xattrs);
+	TAILQ_INIT(&blob->sync_waiters);
 
 	return blob;
 }
@@ -123,11 +195,13 @@ _spdk_blob_free(struct spdk_blob_data *blob)
 	struct spdk_xattr 	*xattr, *xattr_tmp;
 
 	assert(blob != NULL);
+	assert(TAILQ_EMPTY(&blob->sync_waiters));
 
 	free(blob->active.clusters);
 	free(blob->clean.clusters);
 	free(blob->active.pages);
 	free(blob->clean.pages);
+	free(blob->failed_pages);
 
 	TAILQ_FOREACH_SAFE(xattr, &blob->xattrs, link, xattr_tmp) {
 		TAILQ_REMOVE(&blob->xattrs, xattr, link);
@@ -223,6 +297,12 @@ _spdk_blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob_dat
 				blob->md_ro = true;
 			}
 
+			/* Snapshots are never modified by the user */
+			if (desc_flags->data_ro_flags & SPDK_BLOB_READ_ONLY) {
+				blob->data_ro = true;
+				blob->md_ro = true;
+			}
+
 			blob->invalid_flags = desc_flags->invalid_flags;
 			blob->data_ro_flags = desc_flags->data_ro_flags;
 			blob->md_ro_flags = desc_flags->md_ro_flags;
@@ -241,7 +321,9 @@ _spdk_blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob_dat
 
 			for (i = 0; i < desc_extent->length / sizeof(desc_extent->extents[0]); i++) {
 				for (j = 0; j < desc_extent->extents[i].length; j++) {
-					if (!spdk_bit_array_get(blob->bs->used_clusters,
+					/* Cluster index 0 marks a run of unallocated clusters */
+					if (desc_extent->extents[i].cluster_idx != 0 &&
+					    !spdk_bit_array_get(blob->bs->used_clusters,
 								desc_extent->extents[i].cluster_idx + j)) {
 						return -EINVAL;
 					}
@@ -261,8 +343,12 @@ _spdk_blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob_dat
 
 			for (i = 0; i < desc_extent->length / sizeof(desc_extent->extents[0]); i++) {
 				for (j = 0; j < desc_extent->extents[i].length; j++) {
-					blob->active.clusters[blob->active.num_clusters++] = _spdk_bs_cluster_to_lba(blob->bs,
-							desc_extent->extents[i].cluster_idx + j);
+					if (desc_extent->extents[i].cluster_idx == 0) {
+						blob->active.clusters[blob->active.num_clusters++] = 0;
+					} else {
+						blob->active.clusters[blob->active.num_clusters++] = _spdk_bs_cluster_to_lba(blob->bs,
+								desc_extent->extents[i].cluster_idx + j);
+					}
 				}
 			}
 
@@ -303,6 +389,17 @@ _spdk_blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob_dat
 			       desc_xattr->value_length);
 
 			TAILQ_INSERT_TAIL(&blob->xattrs, xattr, link);
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_SNAPSHOT) {
+			struct spdk_blob_md_descriptor_snapshot	*desc_snapshot;
+
+			desc_snapshot = (struct spdk_blob_md_descriptor_snapshot *)desc;
+
+			if (desc_snapshot->length != sizeof(*desc_snapshot) - sizeof(*desc)) {
+				return -EINVAL;
+			}
+
+			blob->parent_id = desc_snapshot->parent_id;
+			blob->num_clones = desc_snapshot->num_clones;
 		} else {
 			/* Unrecognized descriptor type.  Do not fail - just continue to the
 			 *  next descriptor.  If this descriptor is associated with some feature
@@ -467,7 +564,9 @@ _spdk_blob_serialize_extent(const struct spdk_blob_data *blob,
 	lba_count = lba_per_cluster;
 	extent_idx = 0;
 	for (i = start_cluster + 1; i < blob->active.num_clusters; i++) {
-		if ((lba + lba_count) == blob->active.clusters[i]) {
+		/* Unallocated clusters are stored as a run starting at cluster 0 */
+		if ((lba == 0 && blob->active.clusters[i] == 0) ||
+		    (lba != 0 && (lba + lba_count) == blob->active.clusters[i])) {
 			lba_count += lba_per_cluster;
 			continue;
 		}
@@ -520,6 +619,24 @@ _spdk_blob_serialize_flags(const struct spdk_blob_data *blob,
 	*buf_sz -= sizeof(*desc);
 }
 
+static void
+_spdk_blob_serialize_snapshot(const struct spdk_blob_data *blob,
+			      uint8_t *buf, size_t *buf_sz)
+{
+	struct spdk_blob_md_descriptor_snapshot *desc;
+
+	/* Serialized right after the flags, so the first page always has room */
+	assert(*buf_sz >= sizeof(*desc));
+
+	desc = (struct spdk_blob_md_descriptor_snapshot *)buf;
+	desc->type = SPDK_MD_DESCRIPTOR_TYPE_SNAPSHOT;
+	desc->length = sizeof(*desc) - sizeof(struct spdk_blob_md_descriptor);
+	desc->parent_id = blob->parent_id;
+	desc->num_clones = blob->num_clones;
+
+	*buf_sz -= sizeof(*desc);
+}
+
 static int
 _spdk_blob_serialize(const struct spdk_blob_data *blob, struct spdk_blob_md_page **pages,
 		     uint32_t *page_count)
@@ -550,6 +667,13 @@ _spdk_blob_serialize(const struct spdk_blob_data *blob, struct spdk_blob_md_page
 
 	/* Serialize flags */
 	_spdk_blob_serialize_flags(blob, buf, &remaining_sz);
+	buf += sizeof(struct spdk_blob_md_descriptor_flags);
+
+	/* Serialize the snapshot parent and clone count */
+	if (blob->parent_id != SPDK_BLOBID_INVALID || blob->num_clones > 0) {
+		_spdk_blob_serialize_snapshot(blob, buf, &remaining_sz);
+		buf += sizeof(struct spdk_blob_md_descriptor_snapshot);
+	}
 
 	/* Serialize xattrs */
 	TAILQ_FOREACH(xattr, &blob->xattrs, link) {
@@ -749,8 +873,11 @@ struct spdk_blob_persist_ctx {
 
 	uint64_t			idx;
 
+	spdk_bs_sequence_t		*seq;
 	spdk_bs_sequence_cpl		cb_fn;
 	void				*cb_arg;
+
+	TAILQ_ENTRY(spdk_blob_persist_ctx) link;
 };
 
 static void
@@ -761,7 +888,12 @@ _spdk_blob_persist_complete(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 
 	if (bserrno == 0) {
 		_spdk_blob_mark_clean(blob);
+		if (blob->dirty_during_sync) {
+			/* The cluster map changed after it was serialized */
+			blob->state = SPDK_BLOB_STATE_DIRTY;
+		}
 	}
+	blob->dirty_during_sync = false;
 
 	/* Call user callback */
 	ctx->cb_fn(seq, ctx->cb_arg, bserrno);
@@ -784,7 +916,10 @@ _spdk_blob_persist_unmap_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int
 	for (i = blob->active.num_clusters; i < blob->active.cluster_array_size; i++) {
 		uint32_t cluster_num = _spdk_bs_lba_to_cluster(bs, blob->active.clusters[i]);
 
-		_spdk_bs_release_cluster(bs, cluster_num);
+		/* Nothing to release if the cluster was never allocated */
+		if (blob->active.clusters[i] != 0) {
+			_spdk_bs_release_cluster(bs, cluster_num);
+		}
 	}
 
 	if (blob->active.num_clusters == 0) {
@@ -801,6 +936,17 @@ _spdk_blob_persist_unmap_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int
 	_spdk_blob_persist_complete(seq, ctx, bserrno);
 }
 
+static int
+_spdk_bs_lba_cmp(const void *a, const void *b)
+{
+	uint64_t lba_a = *(const uint64_t *)a, lba_b = *(const uint64_t *)b;
+
+	if (lba_a < lba_b) {
+		return -1;
+	}
+	return lba_a > lba_b;
+}
+
 static void
 _spdk_blob_persist_unmap_clusters(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
@@ -816,6 +962,17 @@ _spdk_blob_persist_unmap_clusters(spdk_bs_sequence_t *seq, void *cb_arg, int bse
 	 * at the end, but no changes ever occur in the middle of the list.
 	 */
 
+	/*
+	 * The truncated clusters are released below regardless of their order, so
+	 *  sort them to merge every contiguous run on disk into one unmap.  The
+	 *  unmaps of all runs are submitted together.
+	 */
+	if (blob->active.num_clusters < blob->active.cluster_array_size) {
+		qsort(&blob->active.clusters[blob->active.num_clusters],
+		      blob->active.cluster_array_size - blob->active.num_clusters,
+		      sizeof(blob->active.clusters[0]), _spdk_bs_lba_cmp);
+	}
+
 	batch = spdk_bs_sequence_to_batch(seq, _spdk_blob_persist_unmap_clusters_cpl, ctx);
 
 	/* Unmap all clusters that were truncated */
@@ -825,6 +982,11 @@ _spdk_blob_persist_unmap_clusters(spdk_bs_sequence_t *seq, void *cb_arg, int bse
 		uint64_t next_lba = blob->active.clusters[i];
 		uint32_t next_lba_count = _spdk_bs_cluster_to_lba(bs, 1);
 
+		if (next_lba == 0) {
+			/* Unallocated cluster of a thin provisioned blob */
+			continue;
+		}
+
 		if ((lba + lba_count) == next_lba) {
 			/* This cluster is contiguous with the previous one. */
 			lba_count += next_lba_count;
@@ -869,6 +1031,14 @@ _spdk_blob_persist_zero_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bse
 		spdk_bit_array_clear(bs->used_md_pages, blob->clean.pages[i]);
 	}
 
+	/* The root page on disk no longer points at pages of an earlier failed sync */
+	for (i = 0; i < blob->num_failed_pages; i++) {
+		spdk_bit_array_clear(bs->used_md_pages, blob->failed_pages[i]);
+	}
+	free(blob->failed_pages);
+	blob->failed_pages = NULL;
+	blob->num_failed_pages = 0;
+
 	if (blob->active.num_pages == 0) {
 		uint32_t page_num;
 
@@ -893,18 +1063,35 @@ _spdk_blob_persist_zero_pages(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno
 
 	batch = spdk_bs_sequence_to_batch(seq, _spdk_blob_persist_zero_pages_cpl, ctx);
 
-	lba_count = _spdk_bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE);
-
 	/* This loop starts at 1 because the first page is special and handled
 	 * below. The pages (except the first) are never written in place,
-	 * so any pages in the clean list must be zeroed.
+	 * so any pages in the clean list must be zeroed.  Pages are claimed
+	 * lowest first, so runs of them are usually contiguous.
 	 */
+	lba = 0;
+	lba_count = 0;
 	for (i = 1; i < blob->clean.num_pages; i++) {
-		lba = _spdk_bs_page_to_lba(bs, bs->md_start + blob->clean.pages[i]);
+		uint64_t next_lba = _spdk_bs_page_to_lba(bs, bs->md_start + blob->clean.pages[i]);
+
+		if (lba_count > 0 && lba + lba_count == next_lba) {
+			lba_count += _spdk_bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE);
+			continue;
+		}
+
+		if (lba_count > 0) {
+			spdk_bs_batch_write_zeroes(batch, lba, lba_count);
+		}
+
+		lba = next_lba;
+		lba_count = _spdk_bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE);
+	}
 
+	if (lba_count > 0) {
 		spdk_bs_batch_write_zeroes(batch, lba, lba_count);
 	}
 
+	lba_count = _spdk_bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE);
+
 	/* The first page will only be zeroed if this is a delete. */
 	if (blob->active.num_pages == 0) {
 		uint32_t page_num;
@@ -919,76 +1106,283 @@ _spdk_blob_persist_zero_pages(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno
 	spdk_bs_batch_close(batch);
 }
 
-static void
-_spdk_blob_persist_write_page_root(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
-{
-	struct spdk_blob_persist_ctx	*ctx = cb_arg;
-	struct spdk_blob_data		*blob = ctx->blob;
-	struct spdk_blob_store		*bs = blob->bs;
+/* START metadata group commit */
+
+/*
+ * Metadata writes of all blobs persisted at about the same time are committed
+ *  together.  A commit writes the non-root pages of every blob in the group,
+ *  then all of their root pages, merging pages at adjacent LBAs into a single
+ *  I/O.  As before, a root page is never written before the rest of its chain
+ *  is on disk, and the old pages of a blob are only zeroed after its new root
+ *  page is.  A blob persisted while no commit is in flight is written right
+ *  away; blobs persisted while one is in flight queue up for the next one.
+ */
+
+/* Maximum number of metadata pages merged into one write */
+#define SPDK_BS_MD_COMMIT_MAX_RUN 32
+
+struct spdk_bs_md_commit_page {
 	uint64_t			lba;
-	uint32_t			lba_count;
 	struct spdk_blob_md_page	*page;
+};
 
-	if (blob->active.num_pages == 0) {
-		/* Move on to the next step */
-		_spdk_blob_persist_zero_pages(seq, ctx, 0);
-		return;
+struct spdk_bs_md_commit {
+	struct spdk_blob_store		*bs;
+	TAILQ_HEAD(, spdk_blob_persist_ctx) persists;
+
+	struct spdk_bs_md_commit_page	*pages;
+	uint32_t			num_pages;
+	struct iovec			*iovs;
+	uint32_t			num_blobs;
+	bool				roots_written;
+};
+
+static void _spdk_bs_md_commit_start(struct spdk_blob_store *bs);
+static void _spdk_blob_persist_zero_pages(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno);
+
+static int
+_spdk_bs_md_commit_page_cmp(const void *a, const void *b)
+{
+	const struct spdk_bs_md_commit_page *pa = a, *pb = b;
+
+	if (pa->lba < pb->lba) {
+		return -1;
 	}
+	return pa->lba > pb->lba;
+}
+
+/* Write the pages gathered in the commit, merging runs of adjacent LBAs. */
+static void
+_spdk_bs_md_commit_write_pages(spdk_bs_sequence_t *seq, struct spdk_bs_md_commit *commit,
+			       spdk_bs_sequence_cpl cb_fn)
+{
+	struct spdk_blob_store	*bs = commit->bs;
+	spdk_bs_batch_t		*batch;
+	uint32_t		lba_count = _spdk_bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE);
+	uint32_t		i, start;
+
+	qsort(commit->pages, commit->num_pages, sizeof(*commit->pages), _spdk_bs_md_commit_page_cmp);
+
+	batch = spdk_bs_sequence_to_batch(seq, cb_fn, commit);
 
-	lba_count = _spdk_bs_byte_to_lba(bs, sizeof(*page));
+	start = 0;
+	for (i = 0; i < commit->num_pages; i++) {
+		commit->iovs[i].iov_base = commit->pages[i].page;
+		commit->iovs[i].iov_len = SPDK_BS_PAGE_SIZE;
 
-	page = &ctx->pages[0];
-	/* The first page in the metadata goes where the blobid indicates */
-	lba = _spdk_bs_page_to_lba(bs, bs->md_start + _spdk_bs_blobid_to_page(blob->id));
+		if (i + 1 < commit->num_pages && i + 1 - start < SPDK_BS_MD_COMMIT_MAX_RUN &&
+		    commit->pages[i + 1].lba == commit->pages[i].lba + lba_count) {
+			continue;
+		}
+
+		spdk_bs_batch_writev(batch, &commit->iovs[start], i + 1 - start,
+				     commit->pages[start].lba, (i + 1 - start) * lba_count);
+		bs->md_commit_ios++;
+		start = i + 1;
+	}
+	bs->md_commit_pages += commit->num_pages;
 
-	spdk_bs_sequence_write(seq, page, lba, lba_count,
-			       _spdk_blob_persist_zero_pages, ctx);
+	spdk_bs_batch_close(batch);
 }
 
+/*
+ * A commit that failed before any root page was written leaves the blob's old
+ *  metadata in place, so the pages claimed for the new metadata can be given
+ *  back.  Once root pages were written, some of them may have reached the disk
+ *  and point at the new pages, so those stay claimed until the blob is synced
+ *  successfully.  Either way the next sync serializes the blob again.
+ */
 static void
-_spdk_blob_persist_write_page_chain(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_blob_persist_write_failed(struct spdk_blob_persist_ctx *ctx, int bserrno, bool root_written)
 {
-	struct spdk_blob_persist_ctx 	*ctx = cb_arg;
-	struct spdk_blob_data 		*blob = ctx->blob;
-	struct spdk_blob_store		*bs = blob->bs;
-	uint64_t 			lba;
-	uint32_t			lba_count;
-	struct spdk_blob_md_page	*page;
-	spdk_bs_batch_t			*batch;
-	size_t				i;
+	struct spdk_blob_data	*blob = ctx->blob;
+	uint32_t		*failed_pages;
+	uint64_t		i;
 
-	/* Clusters don't move around in blobs. The list shrinks or grows
-	 * at the end, but no changes ever occur in the middle of the list.
-	 */
+	if (!root_written) {
+		for (i = 1; i < blob->active.num_pages; i++) {
+			spdk_bit_array_clear(blob->bs->used_md_pages, blob->active.pages[i]);
+		}
+	} else if (blob->active.num_pages > 1) {
+		failed_pages = realloc(blob->failed_pages, (blob->num_failed_pages +
+					blob->active.num_pages - 1) * sizeof(*failed_pages));
+		if (failed_pages != NULL) {
+			blob->failed_pages = failed_pages;
+			for (i = 1; i < blob->active.num_pages; i++) {
+				failed_pages[blob->num_failed_pages++] = blob->active.pages[i];
+			}
+		}
+		/* Without memory to remember them, the pages stay claimed until the blobstore is reloaded */
+	}
+	blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob->dirty_during_sync = false;
+
+	ctx->cb_fn(ctx->seq, ctx->cb_arg, bserrno);
+
+	spdk_dma_free(ctx->pages);
+	free(ctx);
+}
 
-	lba_count = _spdk_bs_byte_to_lba(bs, sizeof(*page));
+static void
+_spdk_bs_md_commit_finish(struct spdk_bs_md_commit *commit, spdk_bs_sequence_t *seq, int bserrno)
+{
+	struct spdk_blob_store		*bs = commit->bs;
+	struct spdk_blob_persist_ctx	*ctx;
 
-	batch = spdk_bs_sequence_to_batch(seq, _spdk_blob_persist_write_page_root, ctx);
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Metadata commit of %u blobs done, rc %d "
+		      "(%" PRIu64 " blobs in %" PRIu64 " pages with %" PRIu64 " I/Os so far)\n",
+		      commit->num_blobs, bserrno, bs->md_commit_blobs, bs->md_commit_pages,
+		      bs->md_commit_ios);
 
-	/* This starts at 1. The root page is not written until
-	 * all of the others are finished
-	 */
-	for (i = 1; i < blob->active.num_pages; i++) {
-		page = &ctx->pages[i];
-		assert(page->sequence_num == i);
+	if (seq != NULL) {
+		spdk_bs_sequence_finish(seq, 0);
+	}
 
-		lba = _spdk_bs_page_to_lba(bs, bs->md_start + blob->active.pages[i]);
+	while ((ctx = TAILQ_FIRST(&commit->persists)) != NULL) {
+		TAILQ_REMOVE(&commit->persists, ctx, link);
+		if (bserrno != 0) {
+			_spdk_blob_persist_write_failed(ctx, bserrno, commit->roots_written);
+		} else {
+			/* Move on to zeroing the old pages of the blob */
+			_spdk_blob_persist_zero_pages(ctx->seq, ctx, 0);
+		}
+	}
+
+	free(commit->pages);
+	free(commit->iovs);
+	free(commit);
 
-		spdk_bs_batch_write(batch, page, lba, lba_count);
+	if (TAILQ_EMPTY(&bs->md_commit_pending)) {
+		bs->md_commit_active = false;
+	} else {
+		_spdk_bs_md_commit_start(bs);
 	}
+}
 
-	spdk_bs_batch_close(batch);
+static void
+_spdk_bs_md_commit_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	_spdk_bs_md_commit_finish(cb_arg, seq, bserrno);
+}
+
+static void
+_spdk_bs_md_commit_write_roots(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_md_commit	*commit = cb_arg;
+	struct spdk_blob_store		*bs = commit->bs;
+	struct spdk_blob_persist_ctx	*ctx;
+
+	if (bserrno != 0) {
+		_spdk_bs_md_commit_finish(commit, seq, bserrno);
+		return;
+	}
+
+	/* The chains are all on disk. Now point the root pages at them. */
+	commit->roots_written = true;
+	commit->num_pages = 0;
+	TAILQ_FOREACH(ctx, &commit->persists, link) {
+		commit->pages[commit->num_pages].lba = _spdk_bs_page_to_lba(bs,
+						       bs->md_start + _spdk_bs_blobid_to_page(ctx->blob->id));
+		commit->pages[commit->num_pages].page = &ctx->pages[0];
+		commit->num_pages++;
+	}
+
+	_spdk_bs_md_commit_write_pages(seq, commit, _spdk_bs_md_commit_cpl);
+}
+
+static void
+_spdk_bs_md_commit_start(struct spdk_blob_store *bs)
+{
+	struct spdk_bs_md_commit	*commit;
+	struct spdk_blob_persist_ctx	*ctx;
+	struct spdk_blob_data		*blob;
+	struct spdk_bs_cpl		cpl;
+	spdk_bs_sequence_t		*seq;
+	uint32_t			num_pages = 0;
+	uint64_t			i;
+
+	assert(bs->md_commit_active);
+
+	commit = calloc(1, sizeof(*commit));
+	if (commit == NULL) {
+		TAILQ_HEAD(, spdk_blob_persist_ctx) failed;
+
+		/* Fail everything queued so far */
+		TAILQ_INIT(&failed);
+		TAILQ_SWAP(&failed, &bs->md_commit_pending, spdk_blob_persist_ctx, link);
+		bs->md_commit_active = false;
+		while ((ctx = TAILQ_FIRST(&failed)) != NULL) {
+			TAILQ_REMOVE(&failed, ctx, link);
+			_spdk_blob_persist_write_failed(ctx, -ENOMEM, false);
+		}
+		return;
+	}
+
+	commit->bs = bs;
+	TAILQ_INIT(&commit->persists);
+	TAILQ_SWAP(&commit->persists, &bs->md_commit_pending, spdk_blob_persist_ctx, link);
+
+	TAILQ_FOREACH(ctx, &commit->persists, link) {
+		num_pages += ctx->blob->active.num_pages;
+		commit->num_blobs++;
+	}
+
+	commit->pages = calloc(num_pages, sizeof(*commit->pages));
+	commit->iovs = calloc(num_pages, sizeof(*commit->iovs));
+	if (commit->pages == NULL || commit->iovs == NULL) {
+		_spdk_bs_md_commit_finish(commit, NULL, -ENOMEM);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_NONE;
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (seq == NULL) {
+		_spdk_bs_md_commit_finish(commit, NULL, -ENOMEM);
+		return;
+	}
+
+	/* The root pages are not written until all of the others are finished */
+	TAILQ_FOREACH(ctx, &commit->persists, link) {
+		blob = ctx->blob;
+		for (i = 1; i < blob->active.num_pages; i++) {
+			assert(ctx->pages[i].sequence_num == i);
+			commit->pages[commit->num_pages].lba = _spdk_bs_page_to_lba(bs,
+							       bs->md_start + blob->active.pages[i]);
+			commit->pages[commit->num_pages].page = &ctx->pages[i];
+			commit->num_pages++;
+		}
+	}
+
+	_spdk_bs_md_commit_write_pages(seq, commit, _spdk_bs_md_commit_write_roots);
+}
+
+/* Queue the serialized metadata of a blob for the next group commit. */
+static void
+_spdk_bs_md_commit_queue(struct spdk_blob_store *bs, struct spdk_blob_persist_ctx *ctx)
+{
+	TAILQ_INSERT_TAIL(&bs->md_commit_pending, ctx, link);
+	bs->md_commit_blobs++;
+
+	if (!bs->md_commit_active) {
+		bs->md_commit_active = true;
+		_spdk_bs_md_commit_start(bs);
+	}
 }
 
+/* END metadata group commit */
+
 static int
 _spdk_resize_blob(struct spdk_blob_data *blob, uint64_t sz)
 {
 	uint64_t	i;
 	uint64_t	*tmp;
 	uint64_t	lfc; /* lowest free cluster */
+	uint64_t	run_end;
 	struct spdk_blob_store *bs;
+	bool		thin;
 
 	bs = blob->bs;
+	thin = (blob->invalid_flags & SPDK_BLOB_THIN_PROV) != 0;
 
 	assert(blob->state != SPDK_BLOB_STATE_LOADING &&
 	       blob->state != SPDK_BLOB_STATE_SYNCING);
@@ -997,6 +1391,13 @@ _spdk_resize_blob(struct spdk_blob_data *blob, uint64_t sz)
 		return 0;
 	}
 
+	/* Clusters past num_clusters in the cluster array are still claimed. */
+	if (!thin && sz > blob->active.cluster_array_size &&
+	    sz - blob->active.cluster_array_size > bs->num_free_clusters) {
+		/* Not enough free clusters to satisfy the request */
+		return -ENOSPC;
+	}
+
 	if (blob->active.num_clusters < blob->active.cluster_array_size) {
 		/* If this blob was resized to be larger, then smaller, then
 		 * larger without syncing, then the cluster array already
@@ -1008,21 +1409,6 @@ _spdk_resize_blob(struct spdk_blob_data *blob, uint64_t sz)
 
 	blob->state = SPDK_BLOB_STATE_DIRTY;
 
-	/* Do two passes - one to verify that we can obtain enough clusters
-	 * and another to actually claim them.
-	 */
-
-	lfc = 0;
-	for (i = blob->active.num_clusters; i < sz; i++) {
-		lfc = spdk_bit_array_find_first_clear(bs->used_clusters, lfc);
-		if (lfc >= bs->total_clusters) {
-			/* No more free clusters. Cannot satisfy the request */
-			assert(false);
-			return -1;
-		}
-		lfc++;
-	}
-
 	if (sz > blob->active.num_clusters) {
 		/* Expand the cluster array if necessary.
 		 * We only shrink the array when persisting.
@@ -1036,13 +1422,23 @@ _spdk_resize_blob(struct spdk_blob_data *blob, uint64_t sz)
 		blob->active.cluster_array_size = sz;
 	}
 
-	lfc = 0;
-	for (i = blob->active.num_clusters; i < sz; i++) {
-		lfc = spdk_bit_array_find_first_clear(bs->used_clusters, lfc);
-		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming cluster %lu for blob %lu\n", lfc, blob->id);
-		_spdk_bs_claim_cluster(bs, lfc);
-		blob->active.clusters[i] = _spdk_bs_cluster_to_lba(bs, lfc);
-		lfc++;
+	/* Thin provisioned blobs claim clusters on first write instead. */
+	i = blob->active.num_clusters;
+	while (i < sz && thin) {
+		blob->active.clusters[i++] = 0;
+	}
+
+	while (i < sz) {
+		/* Claim a whole run of free clusters at a time */
+		lfc = _spdk_blob_find_free_cluster(blob, i);
+		assert(lfc < bs->total_clusters);
+		run_end = spdk_min(spdk_bit_array_find_first_set(bs->used_clusters, lfc), bs->total_clusters);
+		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming clusters %lu-%lu for blob %lu\n", lfc,
+			      spdk_min(run_end, lfc + sz - i) - 1, blob->id);
+		for (; lfc < run_end && i < sz; lfc++, i++) {
+			_spdk_bs_claim_cluster(bs, lfc);
+			blob->active.clusters[i] = _spdk_bs_cluster_to_lba(bs, lfc);
+		}
 	}
 
 	blob->active.num_clusters = sz;
@@ -1082,6 +1478,7 @@ _spdk_blob_persist(spdk_bs_sequence_t *seq, struct spdk_blob_data *blob,
 	ctx->cb_arg = cb_arg;
 
 	blob->state = SPDK_BLOB_STATE_SYNCING;
+	blob->dirty_during_sync = false;
 
 	if (blob->active.num_pages == 0) {
 		/* This is the signal that the blob should be deleted.
@@ -1142,1752 +1539,3470 @@ _spdk_blob_persist(spdk_bs_sequence_t *seq, struct spdk_blob_data *blob,
 		page_num++;
 	}
 	ctx->pages[i - 1].crc = _spdk_blob_md_page_calc_crc(&ctx->pages[i - 1]);
-	/* Start writing the metadata from last page to first */
 	ctx->idx = blob->active.num_pages - 1;
-	_spdk_blob_persist_write_page_chain(seq, ctx, 0);
+	ctx->seq = seq;
+	_spdk_bs_md_commit_queue(bs, ctx);
 }
 
-static void
-_spdk_blob_request_submit_op(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
-			     void *payload, uint64_t offset, uint64_t length,
-			     spdk_blob_op_complete cb_fn, void *cb_arg, enum spdk_blob_op_type op_type)
-{
-	struct spdk_blob_data		*blob = __blob_to_data(_blob);
-	spdk_bs_batch_t			*batch;
-	struct spdk_bs_cpl		cpl;
-	uint64_t			lba;
-	uint32_t			lba_count;
-	uint8_t				*buf;
-	uint64_t			page;
+/* START thin provisioning cluster allocation */
 
-	assert(blob != NULL);
+/*
+ * A write that touches an unallocated cluster of a thin provisioned blob is
+ *  parked on its channel while the cluster is allocated, then submitted again
+ *  from scratch.  For a clone, the new cluster is first filled with the data
+ *  of the snapshot cluster it replaces (copy-on-write).
+ */
+struct spdk_bs_user_op {
+	struct spdk_blob		*blob;
+	struct spdk_io_channel		*channel;
+	enum spdk_blob_op_type		op_type;
+	void				*payload;
+	struct iovec			*iov;
+	int				iovcnt;
+	uint64_t			offset;
+	uint64_t			length;
+	spdk_blob_op_complete		cb_fn;
+	void				*cb_arg;
 
-	if (blob->data_ro && op_type != SPDK_BLOB_READ) {
-		cb_fn(cb_arg, -EPERM);
-		return;
-	}
+	TAILQ_ENTRY(spdk_bs_user_op)	link;
+};
 
-	if (offset + length > blob->active.num_clusters * blob->bs->pages_per_cluster) {
-		cb_fn(cb_arg, -EINVAL);
-		return;
-	}
+struct spdk_blob_cluster_alloc_ctx {
+	struct spdk_blob_data		*blob;
+	struct spdk_bs_channel		*channel;
+	struct spdk_thread		*thread;
+	spdk_bs_sequence_t		*seq;
 
-	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
-	cpl.u.blob_basic.cb_fn = cb_fn;
-	cpl.u.blob_basic.cb_arg = cb_arg;
+	/* Index into the blob's cluster map */
+	uint64_t			cluster_index;
 
-	batch = spdk_bs_batch_open(_channel, &cpl);
-	if (!batch) {
-		cb_fn(cb_arg, -ENOMEM);
-		return;
-	}
+	/* Cluster claimed from the blobstore on the metadata thread */
+	uint32_t			new_cluster;
+	bool				claimed;
 
-	length = _spdk_bs_page_to_lba(blob->bs, length);
-	page = offset;
-	buf = payload;
-	while (length > 0) {
-		lba = _spdk_bs_blob_page_to_lba(blob, page);
-		lba_count = spdk_min(length,
-				     _spdk_bs_page_to_lba(blob->bs,
-						     _spdk_bs_num_pages_to_cluster_boundary(blob, page)));
-
-		switch (op_type) {
-		case SPDK_BLOB_READ:
-			spdk_bs_batch_read(batch, buf, lba, lba_count);
-			break;
-		case SPDK_BLOB_WRITE:
-			spdk_bs_batch_write(batch, buf, lba, lba_count);
-			break;
-		case SPDK_BLOB_UNMAP:
-			spdk_bs_batch_unmap(batch, lba, lba_count);
-			break;
-		case SPDK_BLOB_WRITE_ZEROES:
-			spdk_bs_batch_write_zeroes(batch, lba, lba_count);
-			break;
-		}
+	/* Copy of the snapshot cluster being replaced */
+	void				*buf;
 
-		length -= lba_count;
-		page += _spdk_bs_lba_to_page(blob->bs, lba_count);
-		if (op_type == SPDK_BLOB_WRITE || op_type == SPDK_BLOB_READ) {
-			buf += _spdk_bs_lba_to_byte(blob->bs, lba_count);
-		}
-	}
+	int				rc;
+};
 
-	spdk_bs_batch_close(batch);
-}
+static void _spdk_blob_request_submit_op(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
+		void *payload, uint64_t offset, uint64_t length,
+		spdk_blob_op_complete cb_fn, void *cb_arg, enum spdk_blob_op_type op_type);
+static void _spdk_blob_request_submit_rw_iov(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
+		struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
+		spdk_blob_op_complete cb_fn, void *cb_arg, bool read);
 
-struct rw_iov_ctx {
-	struct spdk_blob_data *blob;
-	bool read;
-	int iovcnt;
-	struct iovec *orig_iov;
-	uint64_t page_offset;
-	uint64_t pages_remaining;
-	uint64_t pages_done;
-	struct iovec iov[0];
-};
+/* Number of user ops a channel allocates at a time */
+#define SPDK_BS_USER_OP_CHUNK	32
 
-static void
-_spdk_rw_iov_done(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+static int
+_spdk_bs_channel_add_user_ops(struct spdk_bs_channel *ch, uint32_t count)
 {
-	assert(cb_arg == NULL);
-	spdk_bs_sequence_finish(seq, bserrno);
+	struct spdk_bs_channel_chunk	*chunk;
+	struct spdk_bs_user_op		*ops;
+	uint32_t			i;
+
+	chunk = calloc(1, sizeof(*chunk) + count * sizeof(*ops));
+	if (!chunk) {
+		return -ENOMEM;
+	}
+	TAILQ_INSERT_TAIL(&ch->chunks, chunk, link);
+
+	ops = (struct spdk_bs_user_op *)(chunk + 1);
+	for (i = 0; i < count; i++) {
+		TAILQ_INSERT_TAIL(&ch->user_ops, &ops[i], link);
+	}
+
+	return 0;
 }
 
-static void
-_spdk_rw_iov_split_next(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+static struct spdk_bs_user_op *
+_spdk_bs_user_op_alloc(struct spdk_blob *blob, struct spdk_io_channel *channel,
+		       enum spdk_blob_op_type op_type, void *payload, struct iovec *iov, int iovcnt,
+		       uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
-	struct rw_iov_ctx *ctx = cb_arg;
-	struct iovec *iov, *orig_iov;
-	int iovcnt;
-	size_t orig_iovoff;
-	uint64_t lba;
-	uint64_t page_count, pages_to_boundary;
-	uint32_t lba_count;
-	uint64_t byte_count;
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(channel);
+	struct spdk_bs_user_op *op;
 
-	if (bserrno != 0 || ctx->pages_remaining == 0) {
-		free(ctx);
-		spdk_bs_sequence_finish(seq, bserrno);
-		return;
+	if (TAILQ_EMPTY(&ch->user_ops) &&
+	    _spdk_bs_channel_add_user_ops(ch, SPDK_BS_USER_OP_CHUNK) != 0) {
+		return NULL;
 	}
+	op = TAILQ_FIRST(&ch->user_ops);
+	TAILQ_REMOVE(&ch->user_ops, op, link);
+
+	op->blob = blob;
+	op->channel = channel;
+	op->op_type = op_type;
+	op->payload = payload;
+	op->iov = iov;
+	op->iovcnt = iovcnt;
+	op->offset = offset;
+	op->length = length;
+	op->cb_fn = cb_fn;
+	op->cb_arg = cb_arg;
+
+	return op;
+}
 
-	pages_to_boundary = _spdk_bs_num_pages_to_cluster_boundary(ctx->blob, ctx->page_offset);
-	page_count = spdk_min(ctx->pages_remaining, pages_to_boundary);
-	lba = _spdk_bs_blob_page_to_lba(ctx->blob, ctx->page_offset);
-	lba_count = _spdk_bs_page_to_lba(ctx->blob->bs, page_count);
+static void
+_spdk_bs_user_op_free(struct spdk_bs_user_op *op)
+{
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(op->channel);
 
-	/*
-	 * Get index and offset into the original iov array for our current position in the I/O sequence.
-	 *  byte_count will keep track of how many bytes remaining until orig_iov and orig_iovoff will
-	 *  point to the current position in the I/O sequence.
-	 */
-	byte_count = ctx->pages_done * sizeof(struct spdk_blob_md_page);
-	orig_iov = &ctx->orig_iov[0];
-	orig_iovoff = 0;
-	while (byte_count > 0) {
-		if (byte_count >= orig_iov->iov_len) {
-			byte_count -= orig_iov->iov_len;
-			orig_iov++;
-		} else {
-			orig_iovoff = byte_count;
-			byte_count = 0;
-		}
-	}
+	TAILQ_INSERT_HEAD(&ch->user_ops, op, link);
+}
 
-	/*
-	 * Build an iov array for the next I/O in the sequence.  byte_count will keep track of how many
-	 *  bytes of this next I/O remain to be accounted for in the new iov array.
-	 */
-	byte_count = page_count * sizeof(struct spdk_blob_md_page);
-	iov = &ctx->iov[0];
-	iovcnt = 0;
-	while (byte_count > 0) {
-		iov->iov_len = spdk_min(byte_count, orig_iov->iov_len - orig_iovoff);
-		iov->iov_base = orig_iov->iov_base + orig_iovoff;
-		byte_count -= iov->iov_len;
-		orig_iovoff = 0;
-		orig_iov++;
-		iov++;
-		iovcnt++;
-	}
-
-	ctx->page_offset += page_count;
-	ctx->pages_done += page_count;
-	ctx->pages_remaining -= page_count;
-	iov = &ctx->iov[0];
-
-	if (ctx->read) {
-		spdk_bs_sequence_readv(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_split_next, ctx);
-	} else {
-		spdk_bs_sequence_writev(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_split_next, ctx);
+static void
+_spdk_bs_user_op_execute(struct spdk_bs_user_op *op)
+{
+	struct spdk_bs_user_op	tmp = *op;
+
+	/* Give the op back first, so that the resubmitted I/O can use it if it has to wait again */
+	_spdk_bs_user_op_free(op);
+	op = &tmp;
+
+	switch (op->op_type) {
+	case SPDK_BLOB_READ:
+	case SPDK_BLOB_WRITE:
+	case SPDK_BLOB_UNMAP:
+	case SPDK_BLOB_WRITE_ZEROES:
+		_spdk_blob_request_submit_op(op->blob, op->channel, op->payload, op->offset,
+					     op->length, op->cb_fn, op->cb_arg, op->op_type);
+		break;
+	case SPDK_BLOB_READV:
+	case SPDK_BLOB_WRITEV:
+		_spdk_blob_request_submit_rw_iov(op->blob, op->channel, op->iov, op->iovcnt,
+						 op->offset, op->length, op->cb_fn, op->cb_arg,
+						 op->op_type == SPDK_BLOB_READV);
+		break;
+	case SPDK_BLOB_ALLOCATE:
+		op->cb_fn(op->cb_arg, 0);
+		break;
+	default:
+		assert(false);
+		op->cb_fn(op->cb_arg, -EINVAL);
+		break;
 	}
 }
 
 static void
-_spdk_blob_request_submit_rw_iov(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
-				 struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
-				 spdk_blob_op_complete cb_fn, void *cb_arg, bool read)
+_spdk_bs_user_op_abort(struct spdk_bs_user_op *op, int bserrno)
 {
-	struct spdk_blob_data		*blob = __blob_to_data(_blob);
-	spdk_bs_sequence_t		*seq;
-	struct spdk_bs_cpl		cpl;
+	spdk_blob_op_complete	cb_fn = op->cb_fn;
+	void			*cb_arg = op->cb_arg;
 
-	assert(blob != NULL);
+	_spdk_bs_user_op_free(op);
+	cb_fn(cb_arg, bserrno);
+}
 
-	if (!read && blob->data_ro) {
-		cb_fn(cb_arg, -EPERM);
-		return;
-	}
+/*
+ * Hold an I/O that could not get a request set, or that arrived while others
+ *  were waiting for one, until a request set is released.  Pools grow on
+ *  demand, so this only happens when memory is short.
+ *
+ * An I/O that spdk_bs_channel_resume_io() resubmits was the oldest one waiting,
+ *  so if it still finds no request set it goes back to the head of the queue.
+ */
+static void
+_spdk_bs_queue_io(struct spdk_blob *blob, struct spdk_io_channel *channel,
+		  enum spdk_blob_op_type op_type, void *payload, struct iovec *iov, int iovcnt,
+		  uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg,
+		  bool resubmit)
+{
+	struct spdk_bs_channel	*ch = spdk_io_channel_get_ctx(channel);
+	struct spdk_bs_user_op	*op;
 
-	if (length == 0) {
-		cb_fn(cb_arg, 0);
+	op = _spdk_bs_user_op_alloc(blob, channel, op_type, payload, iov, iovcnt, offset, length,
+				    cb_fn, cb_arg);
+	if (!op) {
+		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
 
-	if (offset + length > blob->active.num_clusters * blob->bs->pages_per_cluster) {
-		cb_fn(cb_arg, -EINVAL);
-		return;
+	if (resubmit) {
+		TAILQ_INSERT_HEAD(&ch->queued_io, op, link);
+	} else {
+		TAILQ_INSERT_TAIL(&ch->queued_io, op, link);
 	}
+}
 
-	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
-	cpl.u.blob_basic.cb_fn = cb_fn;
-	cpl.u.blob_basic.cb_arg = cb_arg;
+/*
+ * New I/O must not pass I/O that is already waiting for a request set, so that
+ *  I/O on a channel is still submitted in order.
+ */
+static inline bool
+_spdk_bs_channel_io_queued(struct spdk_io_channel *channel)
+{
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(channel);
+
+	return spdk_unlikely(!TAILQ_EMPTY(&ch->queued_io));
+}
+
+void
+spdk_bs_channel_resume_io(struct spdk_bs_channel *ch)
+{
+	struct spdk_bs_user_op *op;
 
 	/*
-	 * For now, we implement readv/writev using a sequence (instead of a batch) to account for having
-	 *  to split a request that spans a cluster boundary.  For I/O that do not span a cluster boundary,
-	 *  there will be no noticeable difference compared to using a batch.  For I/O that do span a cluster
-	 *  boundary, the target LBAs (after blob offset to LBA translation) may not be contiguous, so we need
-	 *  to allocate a separate iov array and split the I/O such that none of the resulting
-	 *  smaller I/O cross a cluster boundary.  These smaller I/O will be issued in sequence (not in parallel)
-	 *  but since this case happens very infrequently, any performance impact will be negligible.
-	 *
-	 * This could be optimized in the future to allocate a big enough iov array to account for all of the iovs
-	 *  for all of the smaller I/Os, pre-build all of the iov arrays for the smaller I/Os, then issue them
-	 *  in a batch.  That would also require creating an intermediate spdk_bs_cpl that would get called
-	 *  when the batch was completed, to allow for freeing the memory for the iov arrays.
+	 * An I/O that still finds no request set goes back to the head of the queue,
+	 *  and the empty pool ends the loop, so that the queue keeps its order.
 	 */
-	seq = spdk_bs_sequence_start(_channel, &cpl);
-	if (!seq) {
-		cb_fn(cb_arg, -ENOMEM);
-		return;
+	while (!TAILQ_EMPTY(&ch->reqs) && (op = TAILQ_FIRST(&ch->queued_io)) != NULL) {
+		TAILQ_REMOVE(&ch->queued_io, op, link);
+		ch->resubmitting_io = true;
+		_spdk_bs_user_op_execute(op);
+		ch->resubmitting_io = false;
 	}
+}
 
-	if (spdk_likely(length <= _spdk_bs_num_pages_to_cluster_boundary(blob, offset))) {
-		uint64_t lba = _spdk_bs_blob_page_to_lba(blob, offset);
-		uint32_t lba_count = _spdk_bs_page_to_lba(blob->bs, length);
-
-		if (read) {
-			spdk_bs_sequence_readv(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_done, NULL);
-		} else {
-			spdk_bs_sequence_writev(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_done, NULL);
-		}
-	} else {
-		struct rw_iov_ctx *ctx;
+/* Return true and the index of the first unallocated cluster if the io_unit
+ * range touches a cluster that still needs to be allocated.  With backed_only,
+ * only clusters that read from a snapshot count.
+ */
+static bool
+_spdk_blob_find_unallocated_cluster(struct spdk_blob_data *blob, uint64_t offset,
+				    uint64_t length, bool backed_only, uint64_t *cluster_index)
+{
+	uint64_t i, last, lba;
 
-		ctx = calloc(1, sizeof(struct rw_iov_ctx) + iovcnt * sizeof(struct iovec));
-		if (ctx == NULL) {
-			spdk_bs_sequence_finish(seq, -ENOMEM);
-			return;
-		}
+	if ((blob->invalid_flags & SPDK_BLOB_THIN_PROV) == 0 || length == 0) {
+		return false;
+	}
 
-		ctx->blob = blob;
-		ctx->read = read;
-		ctx->orig_iov = iov;
-		ctx->iovcnt = iovcnt;
-		ctx->page_offset = offset;
-		ctx->pages_remaining = length;
-		ctx->pages_done = 0;
+	if (backed_only && blob->parent == NULL) {
+		return false;
+	}
 
-		_spdk_rw_iov_split_next(seq, ctx, 0);
+	last = _spdk_bs_io_unit_to_cluster_index(blob, offset + length - 1);
+	for (i = _spdk_bs_io_unit_to_cluster_index(blob, offset); i <= last; i++) {
+		if (blob->active.clusters[i] != 0) {
+			continue;
+		}
+		if (backed_only &&
+		    !_spdk_bs_blob_io_unit_to_backing_lba(blob->parent, i * _spdk_bs_io_units_per_cluster(blob),
+				&lba)) {
+			continue;
+		}
+		*cluster_index = i;
+		return true;
 	}
+
+	return false;
 }
 
-static struct spdk_blob_data *
-_spdk_blob_lookup(struct spdk_blob_store *bs, spdk_blob_id blobid)
+static void
+_spdk_blob_allocate_cluster_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data *blob;
+	struct spdk_blob_cluster_alloc_ctx	*ctx = cb_arg;
+	struct spdk_bs_channel			*ch = ctx->channel;
+	struct spdk_bs_user_op			*op;
+	TAILQ_HEAD(, spdk_bs_user_op)		ops;
 
-	TAILQ_FOREACH(blob, &bs->blobs, link) {
-		if (blob->id == blobid) {
-			return blob;
+	spdk_dma_free(ctx->buf);
+	free(ctx);
+
+	/*
+	 * Resubmitting an op may start the next allocation on this channel, which
+	 *  queues on need_cluster_alloc again, so take the waiting ops off first.
+	 */
+	TAILQ_INIT(&ops);
+	TAILQ_SWAP(&ops, &ch->need_cluster_alloc, spdk_bs_user_op, link);
+
+	while (!TAILQ_EMPTY(&ops)) {
+		op = TAILQ_FIRST(&ops);
+		TAILQ_REMOVE(&ops, op, link);
+		if (bserrno == 0) {
+			_spdk_bs_user_op_execute(op);
+		} else {
+			_spdk_bs_user_op_abort(op, bserrno);
 		}
 	}
-
-	return NULL;
 }
 
-static int
-_spdk_bs_channel_create(void *io_device, void *ctx_buf)
+static void
+_spdk_blob_insert_cluster_done(void *arg)
 {
-	struct spdk_blob_store		*bs = io_device;
-	struct spdk_bs_channel		*channel = ctx_buf;
-	struct spdk_bs_dev		*dev;
-	uint32_t			max_ops = bs->max_channel_ops;
-	uint32_t			i;
+	struct spdk_blob_cluster_alloc_ctx *ctx = arg;
 
-	dev = bs->dev;
+	spdk_bs_sequence_finish(ctx->seq, ctx->rc);
+}
 
-	channel->req_mem = calloc(max_ops, sizeof(struct spdk_bs_request_set));
-	if (!channel->req_mem) {
-		return -1;
-	}
+static void
+_spdk_blob_insert_cluster_msg(void *arg)
+{
+	struct spdk_blob_cluster_alloc_ctx	*ctx = arg;
+	struct spdk_blob_data			*blob = ctx->blob;
+	struct spdk_blob_store			*bs = blob->bs;
 
-	TAILQ_INIT(&channel->reqs);
+	if (ctx->rc == 0 && ctx->cluster_index < blob->active.num_clusters &&
+	    blob->active.clusters[ctx->cluster_index] == 0) {
+		blob->active.clusters[ctx->cluster_index] = _spdk_bs_cluster_to_lba(bs, ctx->new_cluster);
 
-	for (i = 0; i < max_ops; i++) {
-		TAILQ_INSERT_TAIL(&channel->reqs, &channel->req_mem[i], link);
+		/* The cluster map is written out by the next sync of the blob */
+		if (blob->state == SPDK_BLOB_STATE_SYNCING) {
+			blob->dirty_during_sync = true;
+		} else {
+			blob->state = SPDK_BLOB_STATE_DIRTY;
+		}
+	} else {
+		/*
+		 * Zeroing failed, another channel allocated the same cluster first,
+		 *  or the blob was shrunk in the meantime.  In the last two cases the
+		 *  resubmitted write sorts itself out.
+		 */
+		_spdk_bs_release_cluster(bs, ctx->new_cluster);
 	}
 
-	channel->bs = bs;
-	channel->dev = dev;
-	channel->dev_channel = dev->create_channel(dev);
+	spdk_thread_send_msg(ctx->thread, _spdk_blob_insert_cluster_done, ctx);
+}
 
-	if (!channel->dev_channel) {
-		SPDK_ERRLOG("Failed to create device channel.\n");
-		free(channel->req_mem);
-		return -1;
-	}
+static void
+_spdk_blob_fill_cluster_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_blob_cluster_alloc_ctx *ctx = cb_arg;
 
-	return 0;
+	ctx->rc = bserrno;
+	spdk_thread_send_msg(ctx->blob->bs->md_thread, _spdk_blob_insert_cluster_msg, ctx);
 }
 
 static void
-_spdk_bs_channel_destroy(void *io_device, void *ctx_buf)
+_spdk_blob_copy_cluster_read_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_bs_channel *channel = ctx_buf;
+	struct spdk_blob_cluster_alloc_ctx	*ctx = cb_arg;
+	struct spdk_blob_store			*bs = ctx->blob->bs;
 
-	free(channel->req_mem);
-	channel->dev->destroy_channel(channel->dev, channel->dev_channel);
+	if (bserrno != 0) {
+		_spdk_blob_fill_cluster_cpl(seq, ctx, bserrno);
+		return;
+	}
+
+	spdk_bs_sequence_write(seq, ctx->buf, _spdk_bs_cluster_to_lba(bs, ctx->new_cluster),
+			       _spdk_bs_cluster_to_lba(bs, 1),
+			       _spdk_blob_fill_cluster_cpl, ctx);
 }
 
 static void
-_spdk_bs_dev_destroy(void *io_device)
+_spdk_blob_claim_cluster_done(void *arg)
 {
-	struct spdk_blob_store *bs = io_device;
-	struct spdk_blob_data	*blob, *blob_tmp;
+	struct spdk_blob_cluster_alloc_ctx	*ctx = arg;
+	struct spdk_blob_store			*bs = ctx->blob->bs;
+	uint64_t				src_lba;
 
-	bs->dev->destroy(bs->dev);
+	if (ctx->rc != 0 || !ctx->claimed) {
+		spdk_bs_sequence_finish(ctx->seq, ctx->rc);
+		return;
+	}
 
-	TAILQ_FOREACH_SAFE(blob, &bs->blobs, link, blob_tmp) {
-		TAILQ_REMOVE(&bs->blobs, blob, link);
-		_spdk_blob_free(blob);
+	if (ctx->blob->parent != NULL &&
+	    _spdk_bs_blob_io_unit_to_backing_lba(ctx->blob->parent,
+			    ctx->cluster_index * _spdk_bs_io_units_per_cluster(ctx->blob), &src_lba)) {
+		/* Copy-on-write: start the new cluster out with the snapshot's data */
+		ctx->buf = spdk_dma_malloc(bs->cluster_sz, SPDK_BS_PAGE_SIZE, NULL);
+		if (!ctx->buf) {
+			_spdk_blob_fill_cluster_cpl(ctx->seq, ctx, -ENOMEM);
+			return;
+		}
+
+		spdk_bs_sequence_read(ctx->seq, ctx->buf, src_lba, _spdk_bs_cluster_to_lba(bs, 1),
+				      _spdk_blob_copy_cluster_read_cpl, ctx);
+		return;
 	}
 
-	spdk_bit_array_free(&bs->used_blobids);
-	spdk_bit_array_free(&bs->used_md_pages);
-	spdk_bit_array_free(&bs->used_clusters);
 	/*
-	 * If this function is called for any reason except a successful unload,
-	 * the unload_cpl type will be NONE and this will be a nop.
+	 * A free cluster may still hold data of a deleted blob.  Zero it before
+	 *  it is inserted into the cluster map, so the parts of it that the
+	 *  write does not cover read back as zeroes on every channel.
 	 */
-	spdk_bs_call_cpl(&bs->unload_cpl, bs->unload_err);
-
-	free(bs);
+	spdk_bs_sequence_write_zeroes(ctx->seq, _spdk_bs_cluster_to_lba(bs, ctx->new_cluster),
+				      _spdk_bs_cluster_to_lba(bs, 1),
+				      _spdk_blob_fill_cluster_cpl, ctx);
 }
 
 static void
-_spdk_bs_free(struct spdk_blob_store *bs)
-{
-	spdk_bs_unregister_md_thread(bs);
-	spdk_io_device_unregister(bs, _spdk_bs_dev_destroy);
-}
-
-void
-spdk_bs_opts_init(struct spdk_bs_opts *opts)
+_spdk_blob_claim_cluster_msg(void *arg)
 {
-	opts->cluster_sz = SPDK_BLOB_OPTS_CLUSTER_SZ;
-	opts->num_md_pages = SPDK_BLOB_OPTS_NUM_MD_PAGES;
-	opts->max_md_ops = SPDK_BLOB_OPTS_MAX_MD_OPS;
-	opts->max_channel_ops = SPDK_BLOB_OPTS_MAX_CHANNEL_OPS;
-	memset(&opts->bstype, 0, sizeof(opts->bstype));
-}
+	struct spdk_blob_cluster_alloc_ctx	*ctx = arg;
+	struct spdk_blob_data			*blob = ctx->blob;
+	struct spdk_blob_store			*bs = blob->bs;
+	uint32_t				cluster_num;
 
-static int
-_spdk_bs_opts_verify(struct spdk_bs_opts *opts)
-{
-	if (opts->cluster_sz == 0 || opts->num_md_pages == 0 || opts->max_md_ops == 0 ||
-	    opts->max_channel_ops == 0) {
-		SPDK_ERRLOG("Blobstore options cannot be set to 0\n");
-		return -1;
+	if (blob->md_ro) {
+		ctx->rc = -EPERM;
+	} else if (ctx->cluster_index >= blob->active.num_clusters) {
+		ctx->rc = -EINVAL;
+	} else if (blob->active.clusters[ctx->cluster_index] == 0) {
+		cluster_num = _spdk_blob_find_free_cluster(blob, ctx->cluster_index);
+		if (cluster_num >= bs->total_clusters) {
+			ctx->rc = -ENOSPC;
+		} else {
+			SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming cluster %u for thin blob %lu\n",
+				      cluster_num, blob->id);
+			_spdk_bs_claim_cluster(bs, cluster_num);
+			ctx->new_cluster = cluster_num;
+			ctx->claimed = true;
+		}
 	}
+	/* Otherwise another channel allocated the cluster already */
 
-	return 0;
+	spdk_thread_send_msg(ctx->thread, _spdk_blob_claim_cluster_done, ctx);
 }
 
-static struct spdk_blob_store *
-_spdk_bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts)
+/*
+ * Allocate the cluster at cluster_index in the blob's cluster map and then
+ *  resubmit op.  The blobstore's cluster bitmap and the blob's cluster map
+ *  are only modified on the metadata thread; this channel keeps running
+ *  other I/O in the meantime.
+ */
+static void
+_spdk_bs_allocate_cluster(struct spdk_bs_user_op *op, uint64_t cluster_index)
 {
-	struct spdk_blob_store	*bs;
-	uint64_t dev_size;
-	int rc;
+	struct spdk_blob_data			*blob = __blob_to_data(op->blob);
+	struct spdk_bs_channel			*ch = spdk_io_channel_get_ctx(op->channel);
+	struct spdk_blob_cluster_alloc_ctx	*ctx;
+	struct spdk_bs_cpl			cpl;
 
-	dev_size = dev->blocklen * dev->blockcnt;
-	if (dev_size < opts->cluster_sz) {
-		/* Device size cannot be smaller than cluster size of blobstore */
-		SPDK_ERRLOG("Device size %" PRIu64 " is smaller than cluster size %d\n", dev_size,
-			    opts->cluster_sz);
-		return NULL;
-	}
-	if (opts->cluster_sz < SPDK_BS_PAGE_SIZE) {
-		/* Cluster size cannot be smaller than page size */
-		SPDK_ERRLOG("Cluster size %d is smaller than page size %d\n",
-			    opts->cluster_sz, SPDK_BS_PAGE_SIZE);
-		return NULL;
+	if (!TAILQ_EMPTY(&ch->need_cluster_alloc)) {
+		/*
+		 * An allocation is already in flight on this channel.  Wait for it;
+		 *  the op is resubmitted when it completes.
+		 */
+		TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
+		return;
 	}
-	bs = calloc(1, sizeof(struct spdk_blob_store));
-	if (!bs) {
-		return NULL;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		_spdk_bs_user_op_abort(op, -ENOMEM);
+		return;
 	}
 
-	TAILQ_INIT(&bs->blobs);
-	bs->dev = dev;
+	ctx->blob = blob;
+	ctx->channel = ch;
+	ctx->thread = spdk_get_thread();
+	ctx->cluster_index = cluster_index;
 
-	/*
-	 * Do not use _spdk_bs_lba_to_cluster() here since blockcnt may not be an
-	 *  even multiple of the cluster size.
-	 */
-	bs->cluster_sz = opts->cluster_sz;
-	bs->total_clusters = dev->blockcnt / (bs->cluster_sz / dev->blocklen);
-	bs->pages_per_cluster = bs->cluster_sz / SPDK_BS_PAGE_SIZE;
-	bs->num_free_clusters = bs->total_clusters;
-	bs->used_clusters = spdk_bit_array_create(bs->total_clusters);
-	if (bs->used_clusters == NULL) {
-		free(bs);
-		return NULL;
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = _spdk_blob_allocate_cluster_cpl;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	ctx->seq = spdk_bs_sequence_start(op->channel, &cpl);
+	if (!ctx->seq) {
+		free(ctx);
+		_spdk_bs_user_op_abort(op, -ENOMEM);
+		return;
 	}
 
-	bs->max_channel_ops = opts->max_channel_ops;
-	bs->super_blob = SPDK_BLOBID_INVALID;
-	memcpy(&bs->bstype, &opts->bstype, sizeof(opts->bstype));
+	TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
 
-	/* The metadata is assumed to be at least 1 page */
-	bs->used_md_pages = spdk_bit_array_create(1);
-	bs->used_blobids = spdk_bit_array_create(0);
+	spdk_thread_send_msg(blob->bs->md_thread, _spdk_blob_claim_cluster_msg, ctx);
+}
 
-	spdk_io_device_register(bs, _spdk_bs_channel_create, _spdk_bs_channel_destroy,
-				sizeof(struct spdk_bs_channel));
-	rc = spdk_bs_register_md_thread(bs);
-	if (rc == -1) {
-		spdk_io_device_unregister(bs, NULL);
-		spdk_bit_array_free(&bs->used_blobids);
-		spdk_bit_array_free(&bs->used_md_pages);
-		spdk_bit_array_free(&bs->used_clusters);
-		free(bs);
-		return NULL;
-	}
+/* END thin provisioning cluster allocation */
 
-	return bs;
+static void
+_spdk_blob_zero_iov(struct iovec *iov, int iovcnt, uint64_t length)
+{
+	size_t len;
+	int i;
+
+	for (i = 0; i < iovcnt && length > 0; i++) {
+		len = spdk_min(iov[i].iov_len, length);
+		memset(iov[i].iov_base, 0, len);
+		length -= len;
+	}
 }
 
-/* START spdk_bs_load, spdk_bs_load_ctx will used for both load and unload. */
+static void
+_spdk_blob_request_submit_op(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
+			     void *payload, uint64_t offset, uint64_t length,
+			     spdk_blob_op_complete cb_fn, void *cb_arg, enum spdk_blob_op_type op_type)
+{
+	struct spdk_blob_data		*blob = __blob_to_data(_blob);
+	spdk_bs_batch_t			*batch;
+	struct spdk_bs_cpl		cpl;
+	uint64_t			lba;
+	uint32_t			lba_count;
+	uint8_t				*buf;
+	uint64_t			io_unit;
+	uint64_t			cluster_index;
+	struct spdk_bs_user_op		*op;
+	struct spdk_bs_channel		*ch = spdk_io_channel_get_ctx(_channel);
+	bool				resubmit = ch->resubmitting_io;
 
-struct spdk_bs_load_ctx {
-	struct spdk_blob_store		*bs;
-	struct spdk_bs_super_block	*super;
+	assert(blob != NULL);
 
-	struct spdk_bs_md_mask		*mask;
-	bool				in_page_chain;
-	uint32_t			page_index;
-	uint32_t			cur_page;
-	struct spdk_blob_md_page	*page;
-	bool				is_load;
-};
+	/* Only this I/O is being resubmitted, not any I/O its completion submits */
+	ch->resubmitting_io = false;
 
-static void
-_spdk_bs_load_ctx_fail(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx, int bserrno)
-{
-	assert(bserrno != 0);
+	if (blob->data_ro && op_type != SPDK_BLOB_READ) {
+		cb_fn(cb_arg, -EPERM);
+		return;
+	}
+
+	if (offset + length > blob->active.num_clusters * _spdk_bs_io_units_per_cluster(blob)) {
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
 
-	spdk_dma_free(ctx->super);
 	/*
-	 * Only free the blobstore when a load fails.  If an unload fails (for some reason)
-	 *  we want to keep the blobstore in case the caller wants to try again.
+	 * Writes allocate every cluster they touch.  Zeroing a range of a clone
+	 *  must also allocate the clusters that would otherwise read from a snapshot.
 	 */
-	if (ctx->is_load) {
-		_spdk_bs_free(ctx->bs);
+	if ((op_type == SPDK_BLOB_WRITE &&
+	     _spdk_blob_find_unallocated_cluster(blob, offset, length, false, &cluster_index)) ||
+	    (op_type == SPDK_BLOB_WRITE_ZEROES &&
+	     _spdk_blob_find_unallocated_cluster(blob, offset, length, true, &cluster_index))) {
+		op = _spdk_bs_user_op_alloc(_blob, _channel, op_type, payload, NULL, 0,
+					    offset, length, cb_fn, cb_arg);
+		if (!op) {
+			cb_fn(cb_arg, -ENOMEM);
+			return;
+		}
+		_spdk_bs_allocate_cluster(op, cluster_index);
+		return;
 	}
-	free(ctx);
-	spdk_bs_sequence_finish(seq, bserrno);
-}
 
-static void
-_spdk_bs_set_mask(struct spdk_bit_array *array, struct spdk_bs_md_mask *mask)
-{
-	uint32_t i = 0;
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = cb_fn;
+	cpl.u.blob_basic.cb_arg = cb_arg;
 
-	while (true) {
-		i = spdk_bit_array_find_first_set(array, i);
-		if (i >= mask->length) {
-			break;
+	batch = spdk_bs_batch_open(_channel, &cpl);
+	if (!batch) {
+		_spdk_bs_queue_io(_blob, _channel, op_type, payload, NULL, 0, offset, length,
+				  cb_fn, cb_arg, resubmit);
+		return;
+	}
+
+	io_unit = offset;
+	buf = payload;
+	while (length > 0) {
+		/* io_units are LBAs of the backing device */
+		lba_count = spdk_min(length, _spdk_bs_num_io_units_to_cluster_boundary(blob, io_unit));
+
+		if (op_type == SPDK_BLOB_READ && !_spdk_bs_io_unit_is_allocated(blob, io_unit)) {
+			/*
+			 * Unallocated clusters of a clone read from its snapshot.  Anything
+			 *  else unallocated reads back as zeroes.
+			 */
+			if (_spdk_bs_blob_io_unit_to_backing_lba(blob, io_unit, &lba)) {
+				spdk_bs_batch_read(batch, buf, lba, lba_count);
+			} else {
+				memset(buf, 0, _spdk_bs_lba_to_byte(blob->bs, lba_count));
+			}
+		} else if (!_spdk_bs_io_unit_is_allocated(blob, io_unit)) {
+			/* There is nothing to unmap or zero in an unallocated cluster */
+			assert(op_type != SPDK_BLOB_WRITE);
+		} else {
+			lba = _spdk_bs_blob_io_unit_to_lba(blob, io_unit);
+
+			switch (op_type) {
+			case SPDK_BLOB_READ:
+				spdk_bs_batch_read(batch, buf, lba, lba_count);
+				break;
+			case SPDK_BLOB_WRITE:
+				spdk_bs_batch_write(batch, buf, lba, lba_count);
+				break;
+			case SPDK_BLOB_UNMAP:
+				spdk_bs_batch_unmap(batch, lba, lba_count);
+				break;
+			case SPDK_BLOB_WRITE_ZEROES:
+				spdk_bs_batch_write_zeroes(batch, lba, lba_count);
+				break;
+			default:
+				assert(false);
+				break;
+			}
+		}
+
+		length -= lba_count;
+		io_unit += lba_count;
+		if (op_type == SPDK_BLOB_WRITE || op_type == SPDK_BLOB_READ) {
+			buf += _spdk_bs_lba_to_byte(blob->bs, lba_count);
 		}
-		mask->mask[i / 8] |= 1U << (i % 8);
-		i++;
 	}
+
+	spdk_bs_batch_close(batch);
 }
 
 static void
-_spdk_bs_write_super(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
-		     struct spdk_bs_super_block *super, spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+_spdk_rw_iov_done(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	/* Update the values in the super block */
-	super->super_blob = bs->super_blob;
-	memcpy(&super->bstype, &bs->bstype, sizeof(bs->bstype));
-	super->crc = _spdk_blob_md_page_calc_crc(super);
-	spdk_bs_sequence_write(seq, super, _spdk_bs_page_to_lba(bs, 0),
-			       _spdk_bs_byte_to_lba(bs, sizeof(*super)),
-			       cb_fn, cb_arg);
+	spdk_bs_sequence_finish(seq, bserrno);
 }
 
+/*
+ * Split a vectored I/O that spans cluster boundaries into one child I/O per cluster,
+ *  since the clusters are not necessarily contiguous on disk, and submit all of them
+ *  at once in a batch.
+ */
 static void
-_spdk_bs_write_used_clusters(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
+_spdk_rw_iov_split(spdk_bs_sequence_t *seq, struct spdk_blob_data *blob,
+		   struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length, bool read)
 {
-	struct spdk_bs_load_ctx	*ctx = arg;
-	uint64_t	mask_size, lba, lba_count;
-
-	/* Write out the used clusters mask */
-	mask_size = ctx->super->used_cluster_mask_len * SPDK_BS_PAGE_SIZE;
-	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
-	if (!ctx->mask) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+	struct spdk_bs_request_set *set = (struct spdk_bs_request_set *)seq;
+	spdk_bs_batch_t	*batch;
+	struct iovec	*child_iov;
+	int		child_iovcnt, max_iovcnt;
+	size_t		iovoff = 0;
+	uint64_t	byte_count, iov_len, lba;
+	uint32_t	lba_count;
+
+	/* Each cluster boundary splits at most one of the original iovs in two. */
+	max_iovcnt = iovcnt + _spdk_bs_io_unit_to_cluster_index(blob, offset + length - 1) -
+		     _spdk_bs_io_unit_to_cluster_index(blob, offset);
+	if (spdk_likely(max_iovcnt <= SPDK_BS_REQUEST_SET_IOV_COUNT)) {
+		child_iov = set->iov;
+	} else {
+		if (set->iov_mem_count < max_iovcnt) {
+			/* Kept with the request set, so only a larger split allocates again */
+			free(set->iov_mem);
+			set->iov_mem = calloc(max_iovcnt, sizeof(struct iovec));
+			if (set->iov_mem == NULL) {
+				set->iov_mem_count = 0;
+				spdk_bs_sequence_finish(seq, -ENOMEM);
+				return;
+			}
+			set->iov_mem_count = max_iovcnt;
+		}
+		child_iov = set->iov_mem;
 	}
 
-	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_CLUSTERS;
-	ctx->mask->length = ctx->bs->total_clusters;
-	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_clusters));
-
-	_spdk_bs_set_mask(ctx->bs->used_clusters, ctx->mask);
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_len);
-	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
-}
+	batch = spdk_bs_sequence_to_batch(seq, _spdk_rw_iov_done, NULL);
 
-static void
-_spdk_bs_write_used_md(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
-{
-	struct spdk_bs_load_ctx	*ctx = arg;
-	uint64_t	mask_size, lba, lba_count;
+	while (length > 0) {
+		/* io_units are LBAs of the backing device */
+		lba_count = spdk_min(length, _spdk_bs_num_io_units_to_cluster_boundary(blob, offset));
+
+		/* Build the iov array for this cluster from where the previous one left off. */
+		byte_count = _spdk_bs_lba_to_byte(blob->bs, lba_count);
+		child_iovcnt = 0;
+		while (byte_count > 0) {
+			iov_len = spdk_min(byte_count, iov->iov_len - iovoff);
+			if (iov_len > 0) {
+				child_iov[child_iovcnt].iov_base = iov->iov_base + iovoff;
+				child_iov[child_iovcnt].iov_len = iov_len;
+				child_iovcnt++;
+			}
+			byte_count -= iov_len;
+			iovoff += iov_len;
+			if (iovoff == iov->iov_len) {
+				iov++;
+				iovoff = 0;
+			}
+		}
+		assert(child_iovcnt <= max_iovcnt);
+
+		/* Writes allocate every cluster they touch before they are split */
+		assert(read || _spdk_bs_io_unit_is_allocated(blob, offset));
+		if (!_spdk_bs_blob_io_unit_to_backing_lba(blob, offset, &lba)) {
+			assert(read);
+			_spdk_blob_zero_iov(child_iov, child_iovcnt, _spdk_bs_lba_to_byte(blob->bs, lba_count));
+		} else if (read) {
+			spdk_bs_batch_readv(batch, child_iov, child_iovcnt, lba, lba_count);
+		} else {
+			spdk_bs_batch_writev(batch, child_iov, child_iovcnt, lba, lba_count);
+		}
 
-	mask_size = ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE;
-	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
-	if (!ctx->mask) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+		child_iov += child_iovcnt;
+		max_iovcnt -= child_iovcnt;
+		offset += lba_count;
+		length -= lba_count;
 	}
 
-	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_PAGES;
-	ctx->mask->length = ctx->super->md_len;
-	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_md_pages));
-
-	_spdk_bs_set_mask(ctx->bs->used_md_pages, ctx->mask);
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_len);
-	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
+	spdk_bs_batch_close(batch);
 }
 
 static void
-_spdk_bs_write_used_blobids(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
+_spdk_blob_request_submit_rw_iov(struct spdk_blob *_blob, struct spdk_io_channel *_channel,
+				 struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
+				 spdk_blob_op_complete cb_fn, void *cb_arg, bool read)
 {
-	struct spdk_bs_load_ctx	*ctx = arg;
-	uint64_t	mask_size, lba, lba_count;
+	struct spdk_blob_data		*blob = __blob_to_data(_blob);
+	spdk_bs_sequence_t		*seq;
+	struct spdk_bs_cpl		cpl;
+	uint64_t			cluster_index;
+	struct spdk_bs_user_op		*op;
+	struct spdk_bs_channel		*ch = spdk_io_channel_get_ctx(_channel);
+	bool				resubmit = ch->resubmitting_io;
 
-	if (ctx->super->used_blobid_mask_len == 0) {
-		/*
-		 * This is a pre-v3 on-disk format where the blobid mask does not get
-		 *  written to disk.
-		 */
-		cb_fn(seq, arg, 0);
+	assert(blob != NULL);
+
+	/* Only this I/O is being resubmitted, not any I/O its completion submits */
+	ch->resubmitting_io = false;
+
+	if (!read && blob->data_ro) {
+		cb_fn(cb_arg, -EPERM);
 		return;
 	}
 
-	mask_size = ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE;
-	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
-	if (!ctx->mask) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+	if (length == 0) {
+		cb_fn(cb_arg, 0);
 		return;
 	}
 
-	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_BLOBIDS;
-	ctx->mask->length = ctx->super->md_len;
-	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_blobids));
-
-	_spdk_bs_set_mask(ctx->bs->used_blobids, ctx->mask);
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_len);
-	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
-}
-
-static void
-_spdk_bs_load_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
-{
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t i, j;
-	int rc;
-
-	/* The type must be correct */
-	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_BLOBIDS);
+	if (offset + length > blob->active.num_clusters * _spdk_bs_io_units_per_cluster(blob)) {
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
 
-	/* The length of the mask (in bits) must not be greater than
-	 * the length of the buffer (converted to bits) */
-	assert(ctx->mask->length <= (ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE * 8));
+	if (!read && _spdk_blob_find_unallocated_cluster(blob, offset, length, false, &cluster_index)) {
+		op = _spdk_bs_user_op_alloc(_blob, _channel, SPDK_BLOB_WRITEV, NULL, iov, iovcnt,
+					    offset, length, cb_fn, cb_arg);
+		if (!op) {
+			cb_fn(cb_arg, -ENOMEM);
+			return;
+		}
+		_spdk_bs_allocate_cluster(op, cluster_index);
+		return;
+	}
 
-	/* The length of the mask must be exactly equal to the size
-	 * (in pages) of the metadata region */
-	assert(ctx->mask->length == ctx->super->md_len);
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = cb_fn;
+	cpl.u.blob_basic.cb_arg = cb_arg;
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->mask->length);
-	if (rc < 0) {
-		spdk_dma_free(ctx->mask);
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+	/*
+	 * I/O that do not span a cluster boundary are submitted directly with the caller's
+	 *  iov array.  I/O that do are split per cluster and submitted in parallel.
+	 */
+	seq = spdk_bs_sequence_start(_channel, &cpl);
+	if (!seq) {
+		_spdk_bs_queue_io(_blob, _channel, read ? SPDK_BLOB_READV : SPDK_BLOB_WRITEV, NULL,
+				  iov, iovcnt, offset, length, cb_fn, cb_arg, resubmit);
 		return;
 	}
 
-	for (i = 0; i < ctx->mask->length / 8; i++) {
-		uint8_t segment = ctx->mask->mask[i];
-		for (j = 0; segment; j++) {
-			if (segment & 1U) {
-				spdk_bit_array_set(ctx->bs->used_blobids, (i * 8) + j);
-			}
-			segment >>= 1U;
+	if (spdk_likely(length <= _spdk_bs_num_io_units_to_cluster_boundary(blob, offset))) {
+		uint64_t lba;
+		uint32_t lba_count = length;
+
+		assert(read || _spdk_bs_io_unit_is_allocated(blob, offset));
+		if (!_spdk_bs_blob_io_unit_to_backing_lba(blob, offset, &lba)) {
+			_spdk_blob_zero_iov(iov, iovcnt, _spdk_bs_lba_to_byte(blob->bs, length));
+			spdk_bs_sequence_finish(seq, 0);
+			return;
+		}
+
+		if (read) {
+			spdk_bs_sequence_readv(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_done, NULL);
+		} else {
+			spdk_bs_sequence_writev(seq, iov, iovcnt, lba, lba_count, _spdk_rw_iov_done, NULL);
 		}
+	} else {
+		_spdk_rw_iov_split(seq, blob, iov, iovcnt, offset, length, read);
 	}
+}
 
-	spdk_dma_free(ctx->super);
-	spdk_dma_free(ctx->mask);
-	free(ctx);
+static inline struct spdk_blob_hash_bucket *
+_spdk_bs_blob_hash_bucket(struct spdk_blob_store *bs, spdk_blob_id blobid)
+{
+	/* Blob ids are handed out from the lowest free metadata page, so the page index spreads well */
+	return &bs->blob_hash[_spdk_bs_blobid_to_page(blobid) & (SPDK_BLOB_HASH_BUCKETS - 1)];
+}
 
-	spdk_bs_sequence_finish(seq, bserrno);
+static void
+_spdk_bs_add_open_blob(struct spdk_blob_store *bs, struct spdk_blob_data *blob)
+{
+	TAILQ_INSERT_HEAD(&bs->blobs, blob, link);
+	TAILQ_INSERT_HEAD(_spdk_bs_blob_hash_bucket(bs, blob->id), blob, hash_link);
 }
 
 static void
-_spdk_bs_load_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_remove_open_blob(struct spdk_blob_store *bs, struct spdk_blob_data *blob)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint64_t		lba, lba_count, mask_size;
-	uint32_t		i, j;
-	int			rc;
+	TAILQ_REMOVE(&bs->blobs, blob, link);
+	TAILQ_REMOVE(_spdk_bs_blob_hash_bucket(bs, blob->id), blob, hash_link);
+}
 
-	/* The type must be correct */
-	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	/* The length of the mask (in bits) must not be greater than the length of the buffer (converted to bits) */
-	assert(ctx->mask->length <= (ctx->super->used_cluster_mask_len * sizeof(
-					     struct spdk_blob_md_page) * 8));
-	/* The length of the mask must be exactly equal to the total number of clusters */
-	assert(ctx->mask->length == ctx->bs->total_clusters);
+static struct spdk_blob_data *
+_spdk_blob_lookup(struct spdk_blob_store *bs, spdk_blob_id blobid)
+{
+	struct spdk_blob_data *blob;
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
-	if (rc < 0) {
-		spdk_dma_free(ctx->mask);
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+	TAILQ_FOREACH(blob, _spdk_bs_blob_hash_bucket(bs, blobid), hash_link) {
+		if (blob->id == blobid) {
+			return blob;
+		}
 	}
 
-	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
-	for (i = 0; i < ctx->mask->length / 8; i++) {
-		uint8_t segment = ctx->mask->mask[i];
-		for (j = 0; segment && (j < 8); j++) {
-			if (segment & 1U) {
-				spdk_bit_array_set(ctx->bs->used_clusters, (i * 8) + j);
-				assert(ctx->bs->num_free_clusters > 0);
-				ctx->bs->num_free_clusters--;
-			}
-			segment >>= 1U;
+	return NULL;
+}
+
+static int
+_spdk_bs_channel_create(void *io_device, void *ctx_buf)
+{
+	struct spdk_blob_store		*bs = io_device;
+	struct spdk_bs_channel		*channel = ctx_buf;
+	struct spdk_bs_dev		*dev;
+
+	dev = bs->dev;
+
+	TAILQ_INIT(&channel->reqs);
+	TAILQ_INIT(&channel->chunks);
+	TAILQ_INIT(&channel->need_cluster_alloc);
+	TAILQ_INIT(&channel->queued_io);
+	TAILQ_INIT(&channel->user_ops);
+	channel->num_reqs = 0;
+
+	/* More request sets and user ops are allocated later if these run out */
+	if (spdk_bs_channel_add_reqs(channel, bs->max_channel_ops) != 0 ||
+	    _spdk_bs_channel_add_user_ops(channel, SPDK_BS_USER_OP_CHUNK) != 0) {
+		spdk_bs_channel_free_chunks(channel);
+		return -1;
+	}
+
+	channel->bs = bs;
+	channel->dev = dev;
+	channel->dev_channel = dev->create_channel(dev);
+
+	if (!channel->dev_channel) {
+		SPDK_ERRLOG("Failed to create device channel.\n");
+		spdk_bs_channel_free_chunks(channel);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+_spdk_bs_channel_destroy(void *io_device, void *ctx_buf)
+{
+	struct spdk_bs_channel *channel = ctx_buf;
+
+	assert(TAILQ_EMPTY(&channel->queued_io));
+	spdk_bs_channel_free_chunks(channel);
+	channel->dev->destroy_channel(channel->dev, channel->dev_channel);
+}
+
+static void
+_spdk_bs_dev_destroy(void *io_device)
+{
+	struct spdk_blob_store *bs = io_device;
+	struct spdk_blob_data	*blob, *blob_tmp;
+
+	bs->dev->destroy(bs->dev);
+
+	TAILQ_FOREACH_SAFE(blob, &bs->blobs, link, blob_tmp) {
+		_spdk_bs_remove_open_blob(bs, blob);
+		_spdk_blob_free(blob);
+	}
+
+	spdk_bit_array_free(&bs->used_blobids);
+	spdk_bit_array_free(&bs->used_md_pages);
+	spdk_bit_array_free(&bs->used_clusters);
+	/*
+	 * If this function is called for any reason except a successful unload,
+	 * the unload_cpl type will be NONE and this will be a nop.
+	 */
+	spdk_bs_call_cpl(&bs->unload_cpl, bs->unload_err);
+
+	free(bs);
+}
+
+static void
+_spdk_bs_free(struct spdk_blob_store *bs)
+{
+	spdk_bs_unregister_md_thread(bs);
+	spdk_io_device_unregister(bs, _spdk_bs_dev_destroy);
+}
+
+void
+spdk_bs_opts_init(struct spdk_bs_opts *opts)
+{
+	opts->cluster_sz = SPDK_BLOB_OPTS_CLUSTER_SZ;
+	opts->num_md_pages = SPDK_BLOB_OPTS_NUM_MD_PAGES;
+	opts->max_md_ops = SPDK_BLOB_OPTS_MAX_MD_OPS;
+	opts->max_channel_ops = SPDK_BLOB_OPTS_MAX_CHANNEL_OPS;
+	memset(&opts->bstype, 0, sizeof(opts->bstype));
+}
+
+static int
+_spdk_bs_opts_verify(struct spdk_bs_opts *opts)
+{
+	if (opts->cluster_sz == 0 || opts->num_md_pages == 0 || opts->max_md_ops == 0 ||
+	    opts->max_channel_ops == 0) {
+		SPDK_ERRLOG("Blobstore options cannot be set to 0\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct spdk_blob_store *
+_spdk_bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts)
+{
+	struct spdk_blob_store	*bs;
+	uint64_t dev_size;
+	uint32_t i;
+	int rc;
+
+	dev_size = dev->blocklen * dev->blockcnt;
+	if (dev_size < opts->cluster_sz) {
+		/* Device size cannot be smaller than cluster size of blobstore */
+		SPDK_ERRLOG("Device size %" PRIu64 " is smaller than cluster size %d\n", dev_size,
+			    opts->cluster_sz);
+		return NULL;
+	}
+	if (opts->cluster_sz < SPDK_BS_PAGE_SIZE) {
+		/* Cluster size cannot be smaller than page size */
+		SPDK_ERRLOG("Cluster size %d is smaller than page size %d\n",
+			    opts->cluster_sz, SPDK_BS_PAGE_SIZE);
+		return NULL;
+	}
+	bs = calloc(1, sizeof(struct spdk_blob_store));
+	if (!bs) {
+		return NULL;
+	}
+
+	TAILQ_INIT(&bs->blobs);
+	TAILQ_INIT(&bs->md_commit_pending);
+	for (i = 0; i < SPDK_BLOB_HASH_BUCKETS; i++) {
+		TAILQ_INIT(&bs->blob_hash[i]);
+	}
+	bs->dev = dev;
+
+	/*
+	 * Do not use _spdk_bs_lba_to_cluster() here since blockcnt may not be an
+	 *  even multiple of the cluster size.
+	 */
+	bs->cluster_sz = opts->cluster_sz;
+	bs->total_clusters = dev->blockcnt / (bs->cluster_sz / dev->blocklen);
+	bs->pages_per_cluster = bs->cluster_sz / SPDK_BS_PAGE_SIZE;
+	bs->io_unit_size = dev->blocklen;
+	bs->num_free_clusters = bs->total_clusters;
+	bs->used_clusters = spdk_bit_array_create(bs->total_clusters);
+	if (bs->used_clusters == NULL) {
+		free(bs);
+		return NULL;
+	}
+
+	bs->max_channel_ops = opts->max_channel_ops;
+	bs->super_blob = SPDK_BLOBID_INVALID;
+	memcpy(&bs->bstype, &opts->bstype, sizeof(opts->bstype));
+
+	/* The metadata is assumed to be at least 1 page */
+	bs->used_md_pages = spdk_bit_array_create(1);
+	bs->used_blobids = spdk_bit_array_create(0);
+
+	spdk_io_device_register(bs, _spdk_bs_channel_create, _spdk_bs_channel_destroy,
+				sizeof(struct spdk_bs_channel));
+	rc = spdk_bs_register_md_thread(bs);
+	if (rc == -1) {
+		spdk_io_device_unregister(bs, NULL);
+		spdk_bit_array_free(&bs->used_blobids);
+		spdk_bit_array_free(&bs->used_md_pages);
+		spdk_bit_array_free(&bs->used_clusters);
+		free(bs);
+		return NULL;
+	}
+
+	return bs;
+}
+
+/* START spdk_bs_load, spdk_bs_load_ctx will used for both load and unload. */
+
+struct spdk_bs_load_ctx {
+	struct spdk_blob_store		*bs;
+	struct spdk_bs_super_block	*super;
+
+	struct spdk_bs_md_mask		*mask;
+	bool				is_load;
+
+	/* Metadata replay, used to recover after a dirty shutdown */
+	struct spdk_blob_md_page	*window[2];
+	uint32_t			window_idx;
+	uint32_t			window_start;
+	bool				window_parsing;
+	bool				window_ready;
+	int				window_bserrno;
+	int				replay_bserrno;
+	struct spdk_bit_array		*chain_pages; /* Chain pages not replayed yet */
+	uint32_t			cur_page;
+	struct spdk_blob_md_page	*page;
+
+	/* Masks the replay fills in; the blobstore's own, or fresh ones for fsck */
+	struct spdk_bit_array		*used_md_pages;
+	struct spdk_bit_array		*used_blobids;
+	struct spdk_bit_array		*used_clusters;
+	struct spdk_bs_fsck_report	*report;
+};
+
+static void
+_spdk_bs_load_ctx_fail(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx, int bserrno)
+{
+	assert(bserrno != 0);
+
+	spdk_dma_free(ctx->super);
+	/*
+	 * Only free the blobstore when a load fails.  If an unload fails (for some reason)
+	 *  we want to keep the blobstore in case the caller wants to try again.
+	 */
+	if (ctx->is_load) {
+		_spdk_bs_free(ctx->bs);
+	}
+	free(ctx);
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
+static void
+_spdk_bs_set_mask(struct spdk_bit_array *array, struct spdk_bs_md_mask *mask)
+{
+	uint32_t i = 0;
+
+	while (true) {
+		i = spdk_bit_array_find_first_set(array, i);
+		if (i >= mask->length) {
+			break;
 		}
+		mask->mask[i / 8] |= 1U << (i % 8);
+		i++;
 	}
+}
 
-	spdk_dma_free(ctx->mask);
+static void
+_spdk_bs_write_super(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+		     struct spdk_bs_super_block *super, spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+{
+	/* Update the values in the super block */
+	super->super_blob = bs->super_blob;
+	memcpy(&super->bstype, &bs->bstype, sizeof(bs->bstype));
+	super->crc = _spdk_blob_md_page_calc_crc(super);
+	spdk_bs_sequence_write(seq, super, _spdk_bs_page_to_lba(bs, 0),
+			       _spdk_bs_byte_to_lba(bs, sizeof(*super)),
+			       cb_fn, cb_arg);
+}
 
-	/* Read the used blobids mask */
-	mask_size = ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE;
+static void
+_spdk_bs_write_used_clusters(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
+{
+	struct spdk_bs_load_ctx	*ctx = arg;
+	uint64_t	mask_size, lba, lba_count;
+
+	/* Write out the used clusters mask */
+	mask_size = ctx->super->used_cluster_mask_len * SPDK_BS_PAGE_SIZE;
 	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
 	if (!ctx->mask) {
 		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
 		return;
 	}
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_len);
-	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
-			      _spdk_bs_load_used_blobids_cpl, ctx);
+
+	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_CLUSTERS;
+	ctx->mask->length = ctx->bs->total_clusters;
+	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_clusters));
+
+	_spdk_bs_set_mask(ctx->bs->used_clusters, ctx->mask);
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_len);
+	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
+}
+
+static void
+_spdk_bs_write_used_md(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
+{
+	struct spdk_bs_load_ctx	*ctx = arg;
+	uint64_t	mask_size, lba, lba_count;
+
+	mask_size = ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE;
+	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
+	if (!ctx->mask) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_PAGES;
+	ctx->mask->length = ctx->super->md_len;
+	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_md_pages));
+
+	_spdk_bs_set_mask(ctx->bs->used_md_pages, ctx->mask);
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_len);
+	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
+}
+
+static void
+_spdk_bs_write_used_blobids(spdk_bs_sequence_t *seq, void *arg, spdk_bs_sequence_cpl cb_fn)
+{
+	struct spdk_bs_load_ctx	*ctx = arg;
+	uint64_t	mask_size, lba, lba_count;
+
+	if (ctx->super->used_blobid_mask_len == 0) {
+		/*
+		 * This is a pre-v3 on-disk format where the blobid mask does not get
+		 *  written to disk.
+		 */
+		cb_fn(seq, arg, 0);
+		return;
+	}
+
+	mask_size = ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE;
+	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
+	if (!ctx->mask) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->mask->type = SPDK_MD_MASK_TYPE_USED_BLOBIDS;
+	ctx->mask->length = ctx->super->md_len;
+	assert(ctx->mask->length == spdk_bit_array_capacity(ctx->bs->used_blobids));
+
+	_spdk_bs_set_mask(ctx->bs->used_blobids, ctx->mask);
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_len);
+	spdk_bs_sequence_write(seq, ctx->mask, lba, lba_count, cb_fn, arg);
+}
+
+static void
+_spdk_bs_load_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint32_t i, j;
+	int rc;
+
+	/* The type must be correct */
+	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_BLOBIDS);
+
+	/* The length of the mask (in bits) must not be greater than
+	 * the length of the buffer (converted to bits) */
+	assert(ctx->mask->length <= (ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE * 8));
+
+	/* The length of the mask must be exactly equal to the size
+	 * (in pages) of the metadata region */
+	assert(ctx->mask->length == ctx->super->md_len);
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->mask->length);
+	if (rc < 0) {
+		spdk_dma_free(ctx->mask);
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	for (i = 0; i < ctx->mask->length / 8; i++) {
+		uint8_t segment = ctx->mask->mask[i];
+		for (j = 0; segment; j++) {
+			if (segment & 1U) {
+				spdk_bit_array_set(ctx->bs->used_blobids, (i * 8) + j);
+			}
+			segment >>= 1U;
+		}
+	}
+
+	spdk_dma_free(ctx->super);
+	spdk_dma_free(ctx->mask);
+	free(ctx);
+
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
+static void
+_spdk_bs_load_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint64_t		lba, lba_count, mask_size;
+	uint32_t		i, j;
+	int			rc;
+
+	/* The type must be correct */
+	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	/* The length of the mask (in bits) must not be greater than the length of the buffer (converted to bits) */
+	assert(ctx->mask->length <= (ctx->super->used_cluster_mask_len * sizeof(
+					     struct spdk_blob_md_page) * 8));
+	/* The length of the mask must be exactly equal to the total number of clusters */
+	assert(ctx->mask->length == ctx->bs->total_clusters);
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
+	if (rc < 0) {
+		spdk_dma_free(ctx->mask);
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
+	for (i = 0; i < ctx->mask->length / 8; i++) {
+		uint8_t segment = ctx->mask->mask[i];
+		for (j = 0; segment && (j < 8); j++) {
+			if (segment & 1U) {
+				spdk_bit_array_set(ctx->bs->used_clusters, (i * 8) + j);
+				assert(ctx->bs->num_free_clusters > 0);
+				ctx->bs->num_free_clusters--;
+			}
+			segment >>= 1U;
+		}
+	}
+
+	spdk_dma_free(ctx->mask);
+
+	/* Read the used blobids mask */
+	mask_size = ctx->super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE;
+	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
+	if (!ctx->mask) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_blobid_mask_len);
+	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
+			      _spdk_bs_load_used_blobids_cpl, ctx);
+}
+
+static void
+_spdk_bs_load_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint64_t		lba, lba_count, mask_size;
+	uint32_t		i, j;
+	int			rc;
+
+	/* The type must be correct */
+	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_PAGES);
+	/* The length of the mask (in bits) must not be greater than the length of the buffer (converted to bits) */
+	assert(ctx->mask->length <= (ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE *
+				     8));
+	/* The length of the mask must be exactly equal to the size (in pages) of the metadata region */
+	assert(ctx->mask->length == ctx->super->md_len);
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->mask->length);
+	if (rc < 0) {
+		spdk_dma_free(ctx->mask);
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	for (i = 0; i < ctx->mask->length / 8; i++) {
+		uint8_t segment = ctx->mask->mask[i];
+		for (j = 0; segment && (j < 8); j++) {
+			if (segment & 1U) {
+				spdk_bit_array_set(ctx->bs->used_md_pages, (i * 8) + j);
+			}
+			segment >>= 1U;
+		}
+	}
+	spdk_dma_free(ctx->mask);
+
+	/* Read the used clusters mask */
+	mask_size = ctx->super->used_cluster_mask_len * SPDK_BS_PAGE_SIZE;
+	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
+	if (!ctx->mask) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_len);
+	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
+			      _spdk_bs_load_used_clusters_cpl, ctx);
+}
+
+static void
+_spdk_bs_load_write_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	uint64_t lba, lba_count, mask_size;
+
+	/* Read the used pages mask */
+	mask_size = ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE;
+	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
+	if (!ctx->mask) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_start);
+	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_len);
+	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
+			      _spdk_bs_load_used_pages_cpl, ctx);
+}
+
+static int
+_spdk_bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx,
+				   const struct spdk_blob_md_page *page)
+{
+	struct spdk_blob_store *bs = ctx->bs;
+	struct spdk_blob_md_descriptor *desc;
+	size_t	cur_desc = 0;
+	uint64_t cluster_idx;
+
+	desc = (struct spdk_blob_md_descriptor *)page->descriptors;
+	while (cur_desc < sizeof(page->descriptors)) {
+		if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_PADDING) {
+			if (desc->length == 0) {
+				/* If padding and length are 0, this terminates the page */
+				break;
+			}
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_EXTENT) {
+			struct spdk_blob_md_descriptor_extent	*desc_extent;
+			unsigned int				i, j;
+			unsigned int				cluster_count = 0;
+
+			desc_extent = (struct spdk_blob_md_descriptor_extent *)desc;
+
+			for (i = 0; i < desc_extent->length / sizeof(desc_extent->extents[0]); i++) {
+				for (j = 0; j < desc_extent->extents[i].length; j++) {
+					cluster_count++;
+					if (desc_extent->extents[i].cluster_idx == 0) {
+						/* Unallocated cluster of a thin provisioned blob */
+						continue;
+					}
+					cluster_idx = desc_extent->extents[i].cluster_idx + j;
+					if (cluster_idx >= bs->total_clusters) {
+						return -1;
+					}
+					if (ctx->report) {
+						if (spdk_bit_array_get(ctx->used_clusters, cluster_idx)) {
+							ctx->report->shared_clusters++;
+						} else {
+							spdk_bit_array_set(ctx->used_clusters, cluster_idx);
+							ctx->report->num_clusters++;
+						}
+						continue;
+					}
+					spdk_bit_array_set(ctx->used_clusters, cluster_idx);
+					if (bs->num_free_clusters == 0) {
+						return -1;
+					}
+					bs->num_free_clusters--;
+				}
+			}
+			if (cluster_count == 0) {
+				return -1;
+			}
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_XATTR) {
+			/* Skip this item */
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_FLAGS) {
+			/* Skip this item */
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_SNAPSHOT) {
+			/* Skip this item */
+		} else {
+			/* Error */
+			return -1;
+		}
+		/* Advance to the next descriptor */
+		cur_desc += sizeof(*desc) + desc->length;
+		if (cur_desc + sizeof(*desc) > sizeof(page->descriptors)) {
+			break;
+		}
+		desc = (struct spdk_blob_md_descriptor *)((uintptr_t)page->descriptors + cur_desc);
+	}
+	return 0;
+}
+
+static void
+_spdk_bs_load_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	spdk_dma_free(ctx->super);
+	spdk_bs_sequence_finish(seq, bserrno);
+	free(ctx);
+}
+
+static void
+_spdk_bs_load_write_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	ctx->mask = NULL;
+
+	_spdk_bs_write_used_clusters(seq, cb_arg, _spdk_bs_load_write_used_clusters_cpl);
+}
+
+static void
+_spdk_bs_load_write_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	ctx->mask = NULL;
+
+	_spdk_bs_write_used_blobids(seq, cb_arg, _spdk_bs_load_write_used_blobids_cpl);
+}
+
+static void
+_spdk_bs_load_write_used_md(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	_spdk_bs_write_used_md(seq, cb_arg, _spdk_bs_load_write_used_pages_cpl);
+}
+
+/*
+ * After a dirty shutdown the masks on disk can't be trusted, so they are rebuilt
+ *  from the metadata region itself.  The region is read a window at a time,
+ *  each window split into several reads issued together, and the next window
+ *  is read while the current one is parsed.  Root pages are recognized in
+ *  place.  The other pages of a blob are only valid when reached through the
+ *  chain from its root, so each valid page marks the page it points to in
+ *  chain_pages.  Chain pages found later in the scan are replayed in place;
+ *  any left over when the scan is done are read one by one.
+ */
+
+/* Pages per read of the metadata region, and reads per window */
+#define SPDK_BS_LOAD_MD_CHUNK_PAGES	64
+#define SPDK_BS_LOAD_MD_WINDOW_CHUNKS	4
+#define SPDK_BS_LOAD_MD_WINDOW_PAGES	(SPDK_BS_LOAD_MD_CHUNK_PAGES * SPDK_BS_LOAD_MD_WINDOW_CHUNKS)
+
+static void
+_spdk_bs_load_replay_free(struct spdk_bs_load_ctx *ctx)
+{
+	spdk_dma_free(ctx->window[0]);
+	spdk_dma_free(ctx->window[1]);
+	ctx->window[0] = NULL;
+	ctx->window[1] = NULL;
+	spdk_dma_free(ctx->page);
+	ctx->page = NULL;
+	spdk_bit_array_free(&ctx->chain_pages);
+	if (ctx->report) {
+		spdk_bit_array_free(&ctx->used_md_pages);
+		spdk_bit_array_free(&ctx->used_blobids);
+		spdk_bit_array_free(&ctx->used_clusters);
+	}
+}
+
+static void
+_spdk_bs_load_replay_fail(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx, int bserrno)
+{
+	_spdk_bs_load_replay_free(ctx);
+	_spdk_bs_load_ctx_fail(seq, ctx, bserrno);
+}
+
+/* Replay one metadata page. Returns 0 if it was not a valid page of a blob. */
+static int
+_spdk_bs_load_replay_md_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_page *page,
+			     uint32_t page_num)
+{
+	if (_spdk_blob_md_page_calc_crc(page) != page->crc) {
+		return 0;
+	}
+
+	if (page->sequence_num == 0) {
+		/* A root page sits where its blobid says */
+		if (_spdk_bs_page_to_blobid(page_num) != page->id) {
+			return 0;
+		}
+		spdk_bit_array_set(ctx->used_blobids, page_num);
+	} else if (!spdk_bit_array_get(ctx->chain_pages, page_num) ||
+		   !spdk_bit_array_get(ctx->used_blobids, _spdk_bs_blobid_to_page(page->id))) {
+		/* Not reached through the chain of a valid blob */
+		return 0;
+	}
+
+	spdk_bit_array_clear(ctx->chain_pages, page_num);
+	spdk_bit_array_set(ctx->used_md_pages, page_num);
+
+	if (ctx->report) {
+		ctx->report->num_md_pages++;
+		if (page->sequence_num == 0) {
+			ctx->report->num_blobs++;
+		}
+		if (_spdk_bs_load_replay_md_parse_page(ctx, page)) {
+			/* Count it and go on with the rest of the chain */
+			ctx->report->invalid_md_pages++;
+		}
+	} else if (_spdk_bs_load_replay_md_parse_page(ctx, page)) {
+		return -EILSEQ;
+	}
+
+	if (page->next != SPDK_INVALID_MD_PAGE && page->next < ctx->bs->md_len &&
+	    !spdk_bit_array_get(ctx->used_md_pages, page->next)) {
+		spdk_bit_array_set(ctx->chain_pages, page->next);
+	}
+
+	return 0;
+}
+
+/* Compare what the replay found against the blobstore's masks */
+static void
+_spdk_bs_fsck_compare(struct spdk_bs_load_ctx *ctx)
+{
+	struct spdk_blob_store		*bs = ctx->bs;
+	struct spdk_bs_fsck_report	*report = ctx->report;
+	uint64_t			i;
+	bool				found, marked;
+
+	for (i = 0; i < bs->md_len; i++) {
+		found = spdk_bit_array_get(ctx->used_md_pages, i);
+		marked = spdk_bit_array_get(bs->used_md_pages, i);
+		if (marked && !found) {
+			report->orphan_md_pages++;
+		} else if (found && !marked) {
+			report->unmarked_md_pages++;
+		}
+
+		found = spdk_bit_array_get(ctx->used_blobids, i);
+		marked = spdk_bit_array_get(bs->used_blobids, i);
+		if (marked && !found) {
+			report->orphan_blobids++;
+		} else if (found && !marked) {
+			report->unmarked_blobids++;
+		}
+	}
+
+	for (i = 0; i < bs->total_clusters; i++) {
+		found = spdk_bit_array_get(ctx->used_clusters, i);
+		marked = spdk_bit_array_get(bs->used_clusters, i);
+		if (marked && !found) {
+			report->leaked_clusters++;
+		} else if (found && !marked) {
+			report->unmarked_clusters++;
+		}
+	}
+}
+
+static void
+_spdk_bs_load_replay_done(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx)
+{
+	if (ctx->report) {
+		_spdk_bs_fsck_compare(ctx);
+		_spdk_bs_load_replay_free(ctx);
+		free(ctx);
+		spdk_bs_sequence_finish(seq, 0);
+		return;
+	}
+
+	_spdk_bs_load_replay_free(ctx);
+	_spdk_bs_load_write_used_md(seq, ctx, 0);
+}
+
+static void _spdk_bs_load_replay_chain_page(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx);
+
+static void
+_spdk_bs_load_replay_chain_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		_spdk_bs_load_replay_fail(seq, ctx, bserrno);
+		return;
+	}
+
+	if (_spdk_bs_load_replay_md_page(ctx, ctx->page, ctx->cur_page)) {
+		_spdk_bs_load_replay_fail(seq, ctx, -EILSEQ);
+		return;
+	}
+	/* An invalid page ends the chain */
+	spdk_bit_array_clear(ctx->chain_pages, ctx->cur_page);
+
+	_spdk_bs_load_replay_chain_page(seq, ctx);
+}
+
+/* Read the chain pages that the scan of the metadata region went past */
+static void
+_spdk_bs_load_replay_chain_page(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx)
+{
+	uint64_t lba;
+
+	ctx->cur_page = spdk_bit_array_find_first_set(ctx->chain_pages, 0);
+	if (ctx->cur_page >= ctx->bs->md_len) {
+		_spdk_bs_load_replay_done(seq, ctx);
+		return;
+	}
+
+	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->bs->md_start + ctx->cur_page);
+	spdk_bs_sequence_read(seq, ctx->page, lba,
+			      _spdk_bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE),
+			      _spdk_bs_load_replay_chain_page_cpl, ctx);
+}
+
+static uint32_t
+_spdk_bs_load_window_pages(struct spdk_bs_load_ctx *ctx, uint32_t start)
+{
+	return spdk_min(SPDK_BS_LOAD_MD_WINDOW_PAGES, ctx->bs->md_len - start);
+}
+
+static void _spdk_bs_load_replay_window_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno);
+
+static void
+_spdk_bs_load_read_window(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx,
+			  struct spdk_blob_md_page *buf, uint32_t start)
+{
+	spdk_bs_batch_t	*batch;
+	uint32_t	num_pages = _spdk_bs_load_window_pages(ctx, start);
+	uint32_t	i, count;
+
+	batch = spdk_bs_sequence_to_batch(seq, _spdk_bs_load_replay_window_cpl, ctx);
+	for (i = 0; i < num_pages; i += SPDK_BS_LOAD_MD_CHUNK_PAGES) {
+		count = spdk_min(SPDK_BS_LOAD_MD_CHUNK_PAGES, num_pages - i);
+		spdk_bs_batch_read(batch, &buf[i],
+				   _spdk_bs_page_to_lba(ctx->bs, ctx->bs->md_start + start + i),
+				   _spdk_bs_page_to_lba(ctx->bs, count));
+	}
+	spdk_bs_batch_close(batch);
+}
+
+static void
+_spdk_bs_load_replay_windows(spdk_bs_sequence_t *seq, struct spdk_bs_load_ctx *ctx, int bserrno)
+{
+	struct spdk_blob_md_page	*buf;
+	uint32_t			start, num_pages, next_start, i;
+
+	while (true) {
+		if (bserrno == 0) {
+			bserrno = ctx->replay_bserrno;
+		}
+		if (bserrno != 0) {
+			_spdk_bs_load_replay_fail(seq, ctx, bserrno);
+			return;
+		}
+
+		buf = ctx->window[ctx->window_idx];
+		start = ctx->window_start;
+		num_pages = _spdk_bs_load_window_pages(ctx, start);
+		next_start = start + num_pages;
+
+		/* Start reading the next window before parsing this one */
+		ctx->window_ready = false;
+		ctx->window_parsing = true;
+		if (next_start < ctx->bs->md_len) {
+			_spdk_bs_load_read_window(seq, ctx, ctx->window[!ctx->window_idx], next_start);
+		}
+
+		if (ctx->report) {
+			for (i = 0; i < num_pages; i++) {
+				if (spdk_bit_array_get(ctx->bs->used_md_pages, start + i) &&
+				    _spdk_blob_md_page_calc_crc(&buf[i]) != buf[i].crc) {
+					ctx->report->crc_md_pages++;
+				}
+			}
+		}
+
+		/* Root pages first, so chains that point back within the window are followed */
+		for (i = 0; i < num_pages && ctx->replay_bserrno == 0; i++) {
+			if (buf[i].sequence_num == 0) {
+				ctx->replay_bserrno = _spdk_bs_load_replay_md_page(ctx, &buf[i], start + i);
+			}
+		}
+		for (i = 0; i < num_pages && ctx->replay_bserrno == 0; i++) {
+			if (buf[i].sequence_num != 0) {
+				ctx->replay_bserrno = _spdk_bs_load_replay_md_page(ctx, &buf[i], start + i);
+			}
+		}
+		ctx->window_parsing = false;
+
+		if (next_start >= ctx->bs->md_len) {
+			break;
+		}
+
+		ctx->window_idx = !ctx->window_idx;
+		ctx->window_start = next_start;
+		if (!ctx->window_ready) {
+			/* The read completion picks up from here */
+			return;
+		}
+		bserrno = ctx->window_bserrno;
+	}
+
+	if (ctx->replay_bserrno != 0) {
+		_spdk_bs_load_replay_fail(seq, ctx, ctx->replay_bserrno);
+		return;
+	}
+
+	_spdk_bs_load_replay_chain_page(seq, ctx);
+}
+
+static void
+_spdk_bs_load_replay_window_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+
+	if (ctx->window_parsing) {
+		/* Still parsing the previous window */
+		ctx->window_ready = true;
+		ctx->window_bserrno = bserrno;
+		return;
+	}
+
+	_spdk_bs_load_replay_windows(seq, ctx, bserrno);
+}
+
+static void
+_spdk_bs_load_replay_md(spdk_bs_sequence_t *seq, void *cb_arg)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint32_t window_pages = spdk_min(SPDK_BS_LOAD_MD_WINDOW_PAGES, ctx->bs->md_len);
+
+	ctx->window[0] = spdk_dma_malloc(window_pages * SPDK_BS_PAGE_SIZE, SPDK_BS_PAGE_SIZE, NULL);
+	ctx->window[1] = spdk_dma_malloc(window_pages * SPDK_BS_PAGE_SIZE, SPDK_BS_PAGE_SIZE, NULL);
+	ctx->page = spdk_dma_zmalloc(SPDK_BS_PAGE_SIZE, SPDK_BS_PAGE_SIZE, NULL);
+	ctx->chain_pages = spdk_bit_array_create(ctx->bs->md_len);
+	if (!ctx->window[0] || !ctx->window[1] || !ctx->page || !ctx->chain_pages) {
+		_spdk_bs_load_replay_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->window_idx = 0;
+	ctx->window_start = 0;
+	ctx->replay_bserrno = 0;
+	_spdk_bs_load_read_window(seq, ctx, ctx->window[0], 0);
+}
+
+static void
+_spdk_bs_recover(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint64_t	num_md_clusters;
+	uint64_t	i;
+	int 		rc;
+
+	if (bserrno != 0) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -EIO);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->super->md_len);
+	if (rc < 0) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->super->md_len);
+	if (rc < 0) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
+	if (rc < 0) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
+	ctx->bs->free_cluster_hint = 0;
+
+	/* Claim all of the clusters used by the metadata */
+	num_md_clusters = divide_round_up(ctx->super->md_start + ctx->super->md_len,
+					  ctx->bs->pages_per_cluster);
+	for (i = 0; i < num_md_clusters; i++) {
+		_spdk_bs_claim_cluster(ctx->bs, i);
+	}
+
+	ctx->used_md_pages = ctx->bs->used_md_pages;
+	ctx->used_blobids = ctx->bs->used_blobids;
+	ctx->used_clusters = ctx->bs->used_clusters;
+	_spdk_bs_load_replay_md(seq, cb_arg);
+}
+
+static void
+_spdk_bs_load_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint32_t	crc;
+	static const char zeros[SPDK_BLOBSTORE_TYPE_LENGTH];
+
+	if (ctx->super->version > SPDK_BS_VERSION ||
+	    ctx->super->version < SPDK_BS_INITIAL_VERSION) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
+		return;
+	}
+
+	if (memcmp(ctx->super->signature, SPDK_BS_SUPER_BLOCK_SIG,
+		   sizeof(ctx->super->signature)) != 0) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
+		return;
+	}
+
+	crc = _spdk_blob_md_page_calc_crc(ctx->super);
+	if (crc != ctx->super->crc) {
+		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
+		return;
+	}
+
+	if (memcmp(&ctx->bs->bstype, &ctx->super->bstype, SPDK_BLOBSTORE_TYPE_LENGTH) == 0) {
+		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Bstype matched - loading blobstore\n");
+	} else if (memcmp(&ctx->bs->bstype, zeros, SPDK_BLOBSTORE_TYPE_LENGTH) == 0) {
+		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Bstype wildcard used - loading blobstore regardless bstype\n");
+	} else {
+		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Unexpected bstype\n");
+		SPDK_TRACEDUMP(SPDK_LOG_BLOB, "Expected:", ctx->bs->bstype.bstype, SPDK_BLOBSTORE_TYPE_LENGTH);
+		SPDK_TRACEDUMP(SPDK_LOG_BLOB, "Found:", ctx->super->bstype.bstype, SPDK_BLOBSTORE_TYPE_LENGTH);
+		_spdk_bs_load_ctx_fail(seq, ctx, -ENXIO);
+		return;
+	}
+
+	/* Parse the super block */
+	ctx->bs->cluster_sz = ctx->super->cluster_size;
+	ctx->bs->total_clusters = ctx->bs->dev->blockcnt / (ctx->bs->cluster_sz / ctx->bs->dev->blocklen);
+	ctx->bs->pages_per_cluster = ctx->bs->cluster_sz / SPDK_BS_PAGE_SIZE;
+	ctx->bs->md_start = ctx->super->md_start;
+	ctx->bs->md_len = ctx->super->md_len;
+	ctx->bs->total_data_clusters = ctx->bs->total_clusters - divide_round_up(
+					       ctx->bs->md_start + ctx->bs->md_len, ctx->bs->pages_per_cluster);
+	ctx->bs->super_blob = ctx->super->super_blob;
+	memcpy(&ctx->bs->bstype, &ctx->super->bstype, sizeof(ctx->super->bstype));
+
+	if (ctx->super->clean == 0) {
+		_spdk_bs_recover(seq, ctx, 0);
+	} else if (ctx->super->used_blobid_mask_len == 0) {
+		/*
+		 * Metadata is clean, but this is an old metadata format without
+		 *  a blobid mask.  Clear the clean bit and then build the masks
+		 *  using _spdk_bs_recover.
+		 */
+		ctx->super->clean = 0;
+		_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_recover, ctx);
+	} else {
+		ctx->super->clean = 0;
+		_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_load_write_super_cpl, ctx);
+	}
+}
+
+void
+spdk_bs_load(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
+	     spdk_bs_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob_store	*bs;
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_sequence_t	*seq;
+	struct spdk_bs_load_ctx *ctx;
+	struct spdk_bs_opts	opts = {};
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Loading blobstore from dev %p\n", dev);
+
+	if ((SPDK_BS_PAGE_SIZE % dev->blocklen) != 0) {
+		SPDK_ERRLOG("unsupported dev block length of %d\n",
+			    dev->blocklen);
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	if (o) {
+		opts = *o;
+	} else {
+		spdk_bs_opts_init(&opts);
+	}
+
+	if (opts.max_md_ops == 0 || opts.max_channel_ops == 0) {
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	bs = _spdk_bs_alloc(dev, &opts);
+	if (!bs) {
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->is_load = true;
+
+	/* Allocate memory for the super block */
+	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
+	if (!ctx->super) {
+		free(ctx);
+		_spdk_bs_free(bs);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BS_HANDLE;
+	cpl.u.bs_handle.cb_fn = cb_fn;
+	cpl.u.bs_handle.cb_arg = cb_arg;
+	cpl.u.bs_handle.bs = bs;
+
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!seq) {
+		spdk_dma_free(ctx->super);
+		free(ctx);
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	/* Read the super block */
+	spdk_bs_sequence_read(seq, ctx->super, _spdk_bs_page_to_lba(bs, 0),
+			      _spdk_bs_byte_to_lba(bs, sizeof(*ctx->super)),
+			      _spdk_bs_load_super_cpl, ctx);
+}
+
+/* END spdk_bs_load */
+
+/* START spdk_bs_fsck */
+
+static void
+_spdk_bs_fsck_ctx_free(struct spdk_bs_load_ctx *ctx)
+{
+	spdk_bit_array_free(&ctx->used_md_pages);
+	spdk_bit_array_free(&ctx->used_blobids);
+	spdk_bit_array_free(&ctx->used_clusters);
+	free(ctx);
+}
+
+void
+spdk_bs_fsck(struct spdk_blob_store *bs, struct spdk_bs_fsck_report *report,
+	     spdk_bs_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_sequence_t	*seq;
+	struct spdk_bs_load_ctx	*ctx;
+	uint64_t		num_md_clusters, i;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Checking blobstore metadata\n");
+
+	memset(report, 0, sizeof(*report));
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->report = report;
+
+	/* The replay marks what it finds in its own masks, compared to the blobstore's at the end */
+	ctx->used_md_pages = spdk_bit_array_create(bs->md_len);
+	ctx->used_blobids = spdk_bit_array_create(bs->md_len);
+	ctx->used_clusters = spdk_bit_array_create(bs->total_clusters);
+	if (!ctx->used_md_pages || !ctx->used_blobids || !ctx->used_clusters) {
+		_spdk_bs_fsck_ctx_free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	/* Blobs must not allocate the clusters holding the metadata */
+	num_md_clusters = divide_round_up(bs->md_start + bs->md_len, bs->pages_per_cluster);
+	for (i = 0; i < num_md_clusters; i++) {
+		spdk_bit_array_set(ctx->used_clusters, i);
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
+	cpl.u.bs_basic.cb_fn = cb_fn;
+	cpl.u.bs_basic.cb_arg = cb_arg;
+
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!seq) {
+		_spdk_bs_fsck_ctx_free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	_spdk_bs_load_replay_md(seq, ctx);
+}
+
+/* END spdk_bs_fsck */
+
+/* START spdk_bs_init */
+
+struct spdk_bs_init_ctx {
+	struct spdk_blob_store		*bs;
+	struct spdk_bs_super_block	*super;
+};
+
+static void
+_spdk_bs_init_persist_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_init_ctx *ctx = cb_arg;
+
+	spdk_dma_free(ctx->super);
+	free(ctx);
+
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
+static void
+_spdk_bs_init_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_init_ctx *ctx = cb_arg;
+
+	/* Write super block */
+	spdk_bs_sequence_write(seq, ctx->super, _spdk_bs_page_to_lba(ctx->bs, 0),
+			       _spdk_bs_byte_to_lba(ctx->bs, sizeof(*ctx->super)),
+			       _spdk_bs_init_persist_super_cpl, ctx);
+}
+
+void
+spdk_bs_init(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
+	     spdk_bs_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_init_ctx *ctx;
+	struct spdk_blob_store	*bs;
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_sequence_t	*seq;
+	spdk_bs_batch_t		*batch;
+	uint64_t		num_md_lba;
+	uint64_t		num_md_pages;
+	uint64_t		num_md_clusters;
+	uint32_t		i;
+	struct spdk_bs_opts	opts = {};
+	int			rc;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Initializing blobstore on dev %p\n", dev);
+
+	if ((SPDK_BS_PAGE_SIZE % dev->blocklen) != 0) {
+		SPDK_ERRLOG("unsupported dev block length of %d\n",
+			    dev->blocklen);
+		dev->destroy(dev);
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	if (o) {
+		opts = *o;
+	} else {
+		spdk_bs_opts_init(&opts);
+	}
+
+	if (_spdk_bs_opts_verify(&opts) != 0) {
+		dev->destroy(dev);
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	bs = _spdk_bs_alloc(dev, &opts);
+	if (!bs) {
+		dev->destroy(dev);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	if (opts.num_md_pages == SPDK_BLOB_OPTS_NUM_MD_PAGES) {
+		/* By default, allocate 1 page per cluster.
+		 * Technically, this over-allocates metadata
+		 * because more metadata will reduce the number
+		 * of usable clusters. This can be addressed with
+		 * more complex math in the future.
+		 */
+		bs->md_len = bs->total_clusters;
+	} else {
+		bs->md_len = opts.num_md_pages;
+	}
+
+	rc = spdk_bit_array_resize(&bs->used_md_pages, bs->md_len);
+	if (rc < 0) {
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&bs->used_blobids, bs->md_len);
+	if (rc < 0) {
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+
+	/* Allocate memory for the super block */
+	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
+	if (!ctx->super) {
+		free(ctx);
+		_spdk_bs_free(bs);
+		return;
+	}
+	memcpy(ctx->super->signature, SPDK_BS_SUPER_BLOCK_SIG,
+	       sizeof(ctx->super->signature));
+	ctx->super->version = SPDK_BS_VERSION;
+	ctx->super->length = sizeof(*ctx->super);
+	ctx->super->super_blob = bs->super_blob;
+	ctx->super->clean = 0;
+	ctx->super->cluster_size = bs->cluster_sz;
+	memcpy(&ctx->super->bstype, &bs->bstype, sizeof(bs->bstype));
+
+	/* Calculate how many pages the metadata consumes at the front
+	 * of the disk.
+	 */
+
+	/* The super block uses 1 page */
+	num_md_pages = 1;
+
+	/* The used_md_pages mask requires 1 bit per metadata page, rounded
+	 * up to the nearest page, plus a header.
+	 */
+	ctx->super->used_page_mask_start = num_md_pages;
+	ctx->super->used_page_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
+					 divide_round_up(bs->md_len, 8),
+					 SPDK_BS_PAGE_SIZE);
+	num_md_pages += ctx->super->used_page_mask_len;
+
+	/* The used_clusters mask requires 1 bit per cluster, rounded
+	 * up to the nearest page, plus a header.
+	 */
+	ctx->super->used_cluster_mask_start = num_md_pages;
+	ctx->super->used_cluster_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
+					    divide_round_up(bs->total_clusters, 8),
+					    SPDK_BS_PAGE_SIZE);
+	num_md_pages += ctx->super->used_cluster_mask_len;
+
+	/* The used_blobids mask requires 1 bit per metadata page, rounded
+	 * up to the nearest page, plus a header.
+	 */
+	ctx->super->used_blobid_mask_start = num_md_pages;
+	ctx->super->used_blobid_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
+					   divide_round_up(bs->md_len, 8),
+					   SPDK_BS_PAGE_SIZE);
+	num_md_pages += ctx->super->used_blobid_mask_len;
+
+	/* The metadata region size was chosen above */
+	ctx->super->md_start = bs->md_start = num_md_pages;
+	ctx->super->md_len = bs->md_len;
+	num_md_pages += bs->md_len;
+
+	num_md_lba = _spdk_bs_page_to_lba(bs, num_md_pages);
+
+	ctx->super->crc = _spdk_blob_md_page_calc_crc(ctx->super);
+
+	num_md_clusters = divide_round_up(num_md_pages, bs->pages_per_cluster);
+	if (num_md_clusters > bs->total_clusters) {
+		SPDK_ERRLOG("Blobstore metadata cannot use more clusters than is available, "
+			    "please decrease number of pages reserved for metadata "
+			    "or increase cluster size.\n");
+		spdk_dma_free(ctx->super);
+		free(ctx);
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+	/* Claim all of the clusters used by the metadata */
+	for (i = 0; i < num_md_clusters; i++) {
+		_spdk_bs_claim_cluster(bs, i);
+	}
+
+	bs->total_data_clusters = bs->num_free_clusters;
+
+	cpl.type = SPDK_BS_CPL_TYPE_BS_HANDLE;
+	cpl.u.bs_handle.cb_fn = cb_fn;
+	cpl.u.bs_handle.cb_arg = cb_arg;
+	cpl.u.bs_handle.bs = bs;
+
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!seq) {
+		spdk_dma_free(ctx->super);
+		free(ctx);
+		_spdk_bs_free(bs);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	batch = spdk_bs_sequence_to_batch(seq, _spdk_bs_init_trim_cpl, ctx);
+
+	/* Clear metadata space */
+	spdk_bs_batch_write_zeroes(batch, 0, num_md_lba);
+	/* Trim data clusters */
+	spdk_bs_batch_unmap(batch, num_md_lba, ctx->bs->dev->blockcnt - num_md_lba);
+
+	spdk_bs_batch_close(batch);
+}
+
+/* END spdk_bs_init */
+
+/* START spdk_bs_destroy */
+
+static void
+_spdk_bs_destroy_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_init_ctx *ctx = cb_arg;
+	struct spdk_blob_store *bs = ctx->bs;
+
+	/*
+	 * We need to defer calling spdk_bs_call_cpl() until after
+	 * dev destruction, so tuck these away for later use.
+	 */
+	bs->unload_err = bserrno;
+	memcpy(&bs->unload_cpl, &seq->cpl, sizeof(struct spdk_bs_cpl));
+	seq->cpl.type = SPDK_BS_CPL_TYPE_NONE;
+
+	spdk_bs_sequence_finish(seq, bserrno);
+
+	_spdk_bs_free(bs);
+	free(ctx);
+}
+
+void
+spdk_bs_destroy(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn,
+		void *cb_arg)
+{
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_sequence_t	*seq;
+	struct spdk_bs_init_ctx *ctx;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Destroying blobstore\n");
+
+	if (!TAILQ_EMPTY(&bs->blobs)) {
+		SPDK_ERRLOG("Blobstore still has open blobs\n");
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
+	cpl.u.bs_basic.cb_fn = cb_fn;
+	cpl.u.bs_basic.cb_arg = cb_arg;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!seq) {
+		free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	/* Write zeroes to the super block */
+	spdk_bs_sequence_write_zeroes(seq,
+				      _spdk_bs_page_to_lba(bs, 0),
+				      _spdk_bs_byte_to_lba(bs, sizeof(struct spdk_bs_super_block)),
+				      _spdk_bs_destroy_trim_cpl, ctx);
+}
+
+/* END spdk_bs_destroy */
+
+/* START spdk_bs_unload */
+
+static void
+_spdk_bs_unload_write_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->super);
+
+	/*
+	 * We need to defer calling spdk_bs_call_cpl() until after
+	 * dev destuction, so tuck these away for later use.
+	 */
+	ctx->bs->unload_err = bserrno;
+	memcpy(&ctx->bs->unload_cpl, &seq->cpl, sizeof(struct spdk_bs_cpl));
+	seq->cpl.type = SPDK_BS_CPL_TYPE_NONE;
+
+	spdk_bs_sequence_finish(seq, bserrno);
+
+	_spdk_bs_free(ctx->bs);
+	free(ctx);
+}
+
+static void
+_spdk_bs_unload_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	ctx->super->clean = 1;
+
+	_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_unload_write_super_cpl, ctx);
+}
+
+static void
+_spdk_bs_unload_write_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	ctx->mask = NULL;
+
+	_spdk_bs_write_used_clusters(seq, cb_arg, _spdk_bs_unload_write_used_clusters_cpl);
+}
+
+static void
+_spdk_bs_unload_write_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx	*ctx = cb_arg;
+
+	spdk_dma_free(ctx->mask);
+	ctx->mask = NULL;
+
+	_spdk_bs_write_used_blobids(seq, cb_arg, _spdk_bs_unload_write_used_blobids_cpl);
+}
+
+static void
+_spdk_bs_unload_read_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	_spdk_bs_write_used_md(seq, cb_arg, _spdk_bs_unload_write_used_pages_cpl);
+}
+
+void
+spdk_bs_unload(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_sequence_t	*seq;
+	struct spdk_bs_load_ctx *ctx;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Syncing blobstore\n");
+
+	if (!TAILQ_EMPTY(&bs->blobs)) {
+		SPDK_ERRLOG("Blobstore still has open blobs\n");
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->is_load = false;
+
+	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
+	if (!ctx->super) {
+		free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
+	cpl.u.bs_basic.cb_fn = cb_fn;
+	cpl.u.bs_basic.cb_arg = cb_arg;
+
+	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!seq) {
+		spdk_dma_free(ctx->super);
+		free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	/* Read super block */
+	spdk_bs_sequence_read(seq, ctx->super, _spdk_bs_page_to_lba(bs, 0),
+			      _spdk_bs_byte_to_lba(bs, sizeof(*ctx->super)),
+			      _spdk_bs_unload_read_super_cpl, ctx);
+}
+
+/* END spdk_bs_unload */
+
+void
+spdk_bs_set_super(struct spdk_blob_store *bs, spdk_blob_id blobid,
+		  spdk_bs_op_complete cb_fn, void *cb_arg)
+{
+	bs->super_blob = blobid;
+	cb_fn(cb_arg, 0);
+}
+
+void
+spdk_bs_get_super(struct spdk_blob_store *bs,
+		  spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+{
+	if (bs->super_blob == SPDK_BLOBID_INVALID) {
+		cb_fn(cb_arg, SPDK_BLOBID_INVALID, -ENOENT);
+	} else {
+		cb_fn(cb_arg, bs->super_blob, 0);
+	}
+}
+
+uint64_t
+spdk_bs_get_cluster_size(struct spdk_blob_store *bs)
+{
+	return bs->cluster_sz;
+}
+
+uint64_t
+spdk_bs_get_page_size(struct spdk_blob_store *bs)
+{
+	return SPDK_BS_PAGE_SIZE;
+}
+
+uint64_t
+spdk_bs_get_io_unit_size(struct spdk_blob_store *bs)
+{
+	return bs->io_unit_size;
 }
 
-static void
-_spdk_bs_load_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+uint64_t
+spdk_bs_free_cluster_count(struct spdk_blob_store *bs)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint64_t		lba, lba_count, mask_size;
-	uint32_t		i, j;
-	int			rc;
+	return bs->num_free_clusters;
+}
 
-	/* The type must be correct */
-	assert(ctx->mask->type == SPDK_MD_MASK_TYPE_USED_PAGES);
-	/* The length of the mask (in bits) must not be greater than the length of the buffer (converted to bits) */
-	assert(ctx->mask->length <= (ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE *
-				     8));
-	/* The length of the mask must be exactly equal to the size (in pages) of the metadata region */
-	assert(ctx->mask->length == ctx->super->md_len);
+uint64_t
+spdk_bs_total_data_cluster_count(struct spdk_blob_store *bs)
+{
+	return bs->total_data_clusters;
+}
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->mask->length);
-	if (rc < 0) {
-		spdk_dma_free(ctx->mask);
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+static int
+spdk_bs_register_md_thread(struct spdk_blob_store *bs)
+{
+	bs->md_channel = spdk_get_io_channel(bs);
+	if (!bs->md_channel) {
+		SPDK_ERRLOG("Failed to get IO channel.\n");
+		return -1;
 	}
+	bs->md_thread = spdk_get_thread();
 
-	for (i = 0; i < ctx->mask->length / 8; i++) {
-		uint8_t segment = ctx->mask->mask[i];
-		for (j = 0; segment && (j < 8); j++) {
-			if (segment & 1U) {
-				spdk_bit_array_set(ctx->bs->used_md_pages, (i * 8) + j);
-			}
-			segment >>= 1U;
-		}
-	}
-	spdk_dma_free(ctx->mask);
+	return 0;
+}
 
-	/* Read the used clusters mask */
-	mask_size = ctx->super->used_cluster_mask_len * SPDK_BS_PAGE_SIZE;
-	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
-	if (!ctx->mask) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
-	}
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_cluster_mask_len);
-	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
-			      _spdk_bs_load_used_clusters_cpl, ctx);
+static int
+spdk_bs_unregister_md_thread(struct spdk_blob_store *bs)
+{
+	spdk_put_io_channel(bs->md_channel);
+
+	return 0;
 }
 
-static void
-_spdk_bs_load_write_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+spdk_blob_id spdk_blob_get_id(struct spdk_blob *_blob)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
-	uint64_t lba, lba_count, mask_size;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	/* Read the used pages mask */
-	mask_size = ctx->super->used_page_mask_len * SPDK_BS_PAGE_SIZE;
-	ctx->mask = spdk_dma_zmalloc(mask_size, 0x1000, NULL);
-	if (!ctx->mask) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
-	}
+	assert(blob != NULL);
 
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_start);
-	lba_count = _spdk_bs_page_to_lba(ctx->bs, ctx->super->used_page_mask_len);
-	spdk_bs_sequence_read(seq, ctx->mask, lba, lba_count,
-			      _spdk_bs_load_used_pages_cpl, ctx);
+	return blob->id;
 }
 
-static int
-_spdk_bs_load_replay_md_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob_store *bs)
+uint64_t spdk_blob_get_num_pages(struct spdk_blob *_blob)
 {
-	struct spdk_blob_md_descriptor *desc;
-	size_t	cur_desc = 0;
-
-	desc = (struct spdk_blob_md_descriptor *)page->descriptors;
-	while (cur_desc < sizeof(page->descriptors)) {
-		if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_PADDING) {
-			if (desc->length == 0) {
-				/* If padding and length are 0, this terminates the page */
-				break;
-			}
-		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_EXTENT) {
-			struct spdk_blob_md_descriptor_extent	*desc_extent;
-			unsigned int				i, j;
-			unsigned int				cluster_count = 0;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-			desc_extent = (struct spdk_blob_md_descriptor_extent *)desc;
+	assert(blob != NULL);
 
-			for (i = 0; i < desc_extent->length / sizeof(desc_extent->extents[0]); i++) {
-				for (j = 0; j < desc_extent->extents[i].length; j++) {
-					spdk_bit_array_set(bs->used_clusters, desc_extent->extents[i].cluster_idx + j);
-					if (bs->num_free_clusters == 0) {
-						return -1;
-					}
-					bs->num_free_clusters--;
-					cluster_count++;
-				}
-			}
-			if (cluster_count == 0) {
-				return -1;
-			}
-		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_XATTR) {
-			/* Skip this item */
-		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_FLAGS) {
-			/* Skip this item */
-		} else {
-			/* Error */
-			return -1;
-		}
-		/* Advance to the next descriptor */
-		cur_desc += sizeof(*desc) + desc->length;
-		if (cur_desc + sizeof(*desc) > sizeof(page->descriptors)) {
-			break;
-		}
-		desc = (struct spdk_blob_md_descriptor *)((uintptr_t)page->descriptors + cur_desc);
-	}
-	return 0;
+	return _spdk_bs_cluster_to_page(blob->bs, blob->active.num_clusters);
 }
 
-static bool _spdk_bs_load_cur_md_page_valid(struct spdk_bs_load_ctx *ctx)
+uint64_t spdk_blob_get_num_io_units(struct spdk_blob *_blob)
 {
-	uint32_t crc;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	crc = _spdk_blob_md_page_calc_crc(ctx->page);
-	if (crc != ctx->page->crc) {
-		return false;
-	}
+	assert(blob != NULL);
 
-	if (_spdk_bs_page_to_blobid(ctx->cur_page) != ctx->page->id) {
-		return false;
-	}
-	return true;
+	return blob->active.num_clusters * _spdk_bs_io_units_per_cluster(blob);
 }
 
-static void
-_spdk_bs_load_replay_cur_md_page(spdk_bs_sequence_t *seq, void *cb_arg);
+uint64_t spdk_blob_get_num_clusters(struct spdk_blob *_blob)
+{
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-static void
-_spdk_bs_load_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+	assert(blob != NULL);
+
+	return blob->active.num_clusters;
+}
+
+uint64_t spdk_blob_get_num_allocated_clusters(struct spdk_blob *_blob)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
+	uint64_t i, count = 0;
 
-	spdk_dma_free(ctx->mask);
-	spdk_dma_free(ctx->super);
-	spdk_bs_sequence_finish(seq, bserrno);
-	free(ctx);
+	assert(blob != NULL);
+
+	for (i = 0; i < blob->active.num_clusters; i++) {
+		if (blob->active.clusters[i] != 0) {
+			count++;
+		}
+	}
+
+	return count;
 }
 
-static void
-_spdk_bs_load_write_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bool spdk_blob_is_thin_provisioned(struct spdk_blob *_blob)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	spdk_dma_free(ctx->mask);
-	ctx->mask = NULL;
+	assert(blob != NULL);
 
-	_spdk_bs_write_used_clusters(seq, cb_arg, _spdk_bs_load_write_used_clusters_cpl);
+	return (blob->invalid_flags & SPDK_BLOB_THIN_PROV) != 0;
 }
 
-static void
-_spdk_bs_load_write_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bool spdk_blob_is_snapshot(struct spdk_blob *_blob)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	spdk_dma_free(ctx->mask);
-	ctx->mask = NULL;
+	assert(blob != NULL);
 
-	_spdk_bs_write_used_blobids(seq, cb_arg, _spdk_bs_load_write_used_blobids_cpl);
+	return (blob->data_ro_flags & SPDK_BLOB_READ_ONLY) != 0;
 }
 
-static void
-_spdk_bs_load_write_used_md(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bool spdk_blob_is_clone(struct spdk_blob *_blob)
 {
-	_spdk_bs_write_used_md(seq, cb_arg, _spdk_bs_load_write_used_pages_cpl);
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
+
+	assert(blob != NULL);
+
+	return blob->parent_id != SPDK_BLOBID_INVALID;
 }
 
-static void
-_spdk_bs_load_replay_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+spdk_blob_id spdk_blob_get_parent_snapshot(struct spdk_blob *_blob)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t page_num;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	if (bserrno != 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, bserrno);
-		return;
-	}
+	assert(blob != NULL);
 
-	page_num = ctx->cur_page;
-	if (_spdk_bs_load_cur_md_page_valid(ctx) == true) {
-		if (ctx->page->sequence_num == 0 || ctx->in_page_chain == true) {
-			spdk_bit_array_set(ctx->bs->used_md_pages, page_num);
-			if (ctx->page->sequence_num == 0) {
-				spdk_bit_array_set(ctx->bs->used_blobids, page_num);
-			}
-			if (_spdk_bs_load_replay_md_parse_page(ctx->page, ctx->bs)) {
-				_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
-				return;
-			}
-			if (ctx->page->next != SPDK_INVALID_MD_PAGE) {
-				ctx->in_page_chain = true;
-				ctx->cur_page = ctx->page->next;
-				_spdk_bs_load_replay_cur_md_page(seq, cb_arg);
-				return;
-			}
-		}
-	}
+	return blob->parent_id;
+}
 
-	ctx->in_page_chain = false;
+uint64_t spdk_blob_get_num_clones(struct spdk_blob *_blob)
+{
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
 
-	do {
-		ctx->page_index++;
-	} while (spdk_bit_array_get(ctx->bs->used_md_pages, ctx->page_index) == true);
+	assert(blob != NULL);
 
-	if (ctx->page_index < ctx->super->md_len) {
-		ctx->cur_page = ctx->page_index;
-		_spdk_bs_load_replay_cur_md_page(seq, cb_arg);
-	} else {
-		spdk_dma_free(ctx->page);
-		_spdk_bs_load_write_used_md(seq, ctx, bserrno);
-	}
+	return blob->num_clones;
 }
 
+/* START spdk_bs_create_blob */
+
 static void
-_spdk_bs_load_replay_cur_md_page(spdk_bs_sequence_t *seq, void *cb_arg)
+_spdk_bs_create_blob_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint64_t lba;
+	struct spdk_blob_data *blob = cb_arg;
 
-	assert(ctx->cur_page < ctx->super->md_len);
-	lba = _spdk_bs_page_to_lba(ctx->bs, ctx->super->md_start + ctx->cur_page);
-	spdk_bs_sequence_read(seq, ctx->page, lba,
-			      _spdk_bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE),
-			      _spdk_bs_load_replay_md_cpl, ctx);
+	_spdk_blob_free(blob);
+
+	spdk_bs_sequence_finish(seq, bserrno);
 }
 
-static void
-_spdk_bs_load_replay_md(spdk_bs_sequence_t *seq, void *cb_arg)
+/* Claim a metadata page and blob id for a new, not yet persisted blob */
+static struct spdk_blob_data *
+_spdk_bs_create_blob_alloc(struct spdk_blob_store *bs)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
+	struct spdk_blob_data	*blob;
+	uint32_t		page_idx;
+	spdk_blob_id		id;
 
-	ctx->page_index = 0;
-	ctx->cur_page = 0;
-	ctx->page = spdk_dma_zmalloc(SPDK_BS_PAGE_SIZE,
-				     SPDK_BS_PAGE_SIZE,
-				     NULL);
-	if (!ctx->page) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+	page_idx = spdk_bit_array_find_first_clear(bs->used_md_pages, 0);
+	if (page_idx >= spdk_bit_array_capacity(bs->used_md_pages)) {
+		return NULL;
+	}
+
+	id = _spdk_bs_page_to_blobid(page_idx);
+
+	blob = _spdk_blob_alloc(bs, id);
+	if (!blob) {
+		return NULL;
 	}
-	_spdk_bs_load_replay_cur_md_page(seq, cb_arg);
+
+	spdk_bit_array_set(bs->used_blobids, page_idx);
+	spdk_bit_array_set(bs->used_md_pages, page_idx);
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Creating blob with id %lu at page %u\n", id, page_idx);
+
+	return blob;
 }
 
+/* Undo _spdk_bs_create_blob_alloc() for a blob that was never persisted */
 static void
-_spdk_bs_recover(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_create_blob_abort(struct spdk_blob_data *blob)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	int 		rc;
+	uint32_t page_idx = _spdk_bs_blobid_to_page(blob->id);
 
-	if (bserrno != 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -EIO);
-		return;
-	}
+	spdk_bit_array_clear(blob->bs->used_blobids, page_idx);
+	spdk_bit_array_clear(blob->bs->used_md_pages, page_idx);
+	_spdk_blob_free(blob);
+}
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->super->md_len);
-	if (rc < 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
-	}
+static int
+_spdk_blob_set_xattrs(struct spdk_blob_data *blob, const struct spdk_blob_xattr_opts *xattrs)
+{
+	const void	*value;
+	size_t		value_len;
+	size_t		i;
+	int		rc;
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->super->md_len);
-	if (rc < 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+	if (xattrs == NULL) {
+		return 0;
 	}
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
-	if (rc < 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENOMEM);
-		return;
+	for (i = 0; i < xattrs->count; i++) {
+		xattrs->get_value(xattrs->ctx, xattrs->names[i], &value, &value_len);
+		if (value == NULL || value_len > UINT16_MAX) {
+			return -EINVAL;
+		}
+
+		rc = spdk_blob_set_xattr(__data_to_blob(blob), xattrs->names[i], value, value_len);
+		if (rc < 0) {
+			return rc;
+		}
 	}
 
-	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
-	_spdk_bs_load_replay_md(seq, cb_arg);
+	return 0;
 }
 
+/* Write out a blob set up by _spdk_bs_create_blob_alloc() and free the in-memory copy */
 static void
-_spdk_bs_load_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_create_blob_persist(struct spdk_blob_data *blob,
+			     spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t	crc;
-	static const char zeros[SPDK_BLOBSTORE_TYPE_LENGTH];
+	struct spdk_bs_cpl 	cpl;
+	spdk_bs_sequence_t	*seq;
 
-	if (ctx->super->version > SPDK_BS_VERSION ||
-	    ctx->super->version < SPDK_BS_INITIAL_VERSION) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
+	cpl.type = SPDK_BS_CPL_TYPE_BLOBID;
+	cpl.u.blobid.cb_fn = cb_fn;
+	cpl.u.blobid.cb_arg = cb_arg;
+	cpl.u.blobid.blobid = blob->id;
+
+	seq = spdk_bs_sequence_start(blob->bs->md_channel, &cpl);
+	if (!seq) {
+		_spdk_blob_free(blob);
+		cb_fn(cb_arg, 0, -ENOMEM);
 		return;
 	}
 
-	if (memcmp(ctx->super->signature, SPDK_BS_SUPER_BLOCK_SIG,
-		   sizeof(ctx->super->signature)) != 0) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
+	_spdk_blob_persist(seq, blob, _spdk_bs_create_blob_cpl, blob);
+}
+
+void spdk_bs_create_blob_ext(struct spdk_blob_store *bs, const struct spdk_blob_opts *opts,
+			     spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob_data	*blob;
+	struct spdk_blob_opts	opts_default;
+
+	blob = _spdk_bs_create_blob_alloc(bs);
+	if (!blob) {
+		cb_fn(cb_arg, 0, -ENOMEM);
 		return;
 	}
 
-	crc = _spdk_blob_md_page_calc_crc(ctx->super);
-	if (crc != ctx->super->crc) {
-		_spdk_bs_load_ctx_fail(seq, ctx, -EILSEQ);
-		return;
+	if (!opts) {
+		spdk_blob_opts_init(&opts_default);
+		opts = &opts_default;
 	}
 
-	if (memcmp(&ctx->bs->bstype, &ctx->super->bstype, SPDK_BLOBSTORE_TYPE_LENGTH) == 0) {
-		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Bstype matched - loading blobstore\n");
-	} else if (memcmp(&ctx->bs->bstype, zeros, SPDK_BLOBSTORE_TYPE_LENGTH) == 0) {
-		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Bstype wildcard used - loading blobstore regardless bstype\n");
-	} else {
-		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Unexpected bstype\n");
-		SPDK_TRACEDUMP(SPDK_LOG_BLOB, "Expected:", ctx->bs->bstype.bstype, SPDK_BLOBSTORE_TYPE_LENGTH);
-		SPDK_TRACEDUMP(SPDK_LOG_BLOB, "Found:", ctx->super->bstype.bstype, SPDK_BLOBSTORE_TYPE_LENGTH);
-		_spdk_bs_load_ctx_fail(seq, ctx, -ENXIO);
-		return;
+	if (opts->thin_provision) {
+		blob->invalid_flags |= SPDK_BLOB_THIN_PROV;
 	}
 
-	/* Parse the super block */
-	ctx->bs->cluster_sz = ctx->super->cluster_size;
-	ctx->bs->total_clusters = ctx->bs->dev->blockcnt / (ctx->bs->cluster_sz / ctx->bs->dev->blocklen);
-	ctx->bs->pages_per_cluster = ctx->bs->cluster_sz / SPDK_BS_PAGE_SIZE;
-	ctx->bs->md_start = ctx->super->md_start;
-	ctx->bs->md_len = ctx->super->md_len;
-	ctx->bs->total_data_clusters = ctx->bs->total_clusters - divide_round_up(
-					       ctx->bs->md_start + ctx->bs->md_len, ctx->bs->pages_per_cluster);
-	ctx->bs->super_blob = ctx->super->super_blob;
-	memcpy(&ctx->bs->bstype, &ctx->super->bstype, sizeof(ctx->super->bstype));
+	spdk_blob_resize(__data_to_blob(blob), opts->num_clusters);
 
-	if (ctx->super->clean == 0) {
-		_spdk_bs_recover(seq, ctx, 0);
-	} else if (ctx->super->used_blobid_mask_len == 0) {
-		/*
-		 * Metadata is clean, but this is an old metadata format without
-		 *  a blobid mask.  Clear the clean bit and then build the masks
-		 *  using _spdk_bs_recover.
-		 */
-		ctx->super->clean = 0;
-		_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_recover, ctx);
-	} else {
-		ctx->super->clean = 0;
-		_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_load_write_super_cpl, ctx);
-	}
+	_spdk_bs_create_blob_persist(blob, cb_fn, cb_arg);
 }
 
-void
-spdk_bs_load(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
-	     spdk_bs_op_with_handle_complete cb_fn, void *cb_arg)
+void spdk_bs_create_blob(struct spdk_blob_store *bs,
+			 spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
 {
-	struct spdk_blob_store	*bs;
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t	*seq;
-	struct spdk_bs_load_ctx *ctx;
-	struct spdk_bs_opts	opts = {};
+	spdk_bs_create_blob_ext(bs, NULL, cb_fn, cb_arg);
+}
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Loading blobstore from dev %p\n", dev);
+/* END spdk_bs_create_blob */
 
-	if (o) {
-		opts = *o;
-	} else {
-		spdk_bs_opts_init(&opts);
-	}
+/* START spdk_blob_resize */
+int
+spdk_blob_resize(struct spdk_blob *_blob, uint64_t sz)
+{
+	struct spdk_blob_data	*blob = __blob_to_data(_blob);
+	int			rc;
 
-	if (opts.max_md_ops == 0 || opts.max_channel_ops == 0) {
-		cb_fn(cb_arg, NULL, -EINVAL);
-		return;
+	assert(blob != NULL);
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Resizing blob %lu to %lu clusters\n", blob->id, sz);
+
+	if (blob->md_ro) {
+		return -EPERM;
 	}
 
-	bs = _spdk_bs_alloc(dev, &opts);
-	if (!bs) {
-		cb_fn(cb_arg, NULL, -ENOMEM);
-		return;
+	if (sz == blob->active.num_clusters) {
+		return 0;
 	}
 
-	ctx = calloc(1, sizeof(*ctx));
-	if (!ctx) {
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
-		return;
+	rc = _spdk_resize_blob(blob, sz);
+	if (rc < 0) {
+		return rc;
 	}
 
-	ctx->bs = bs;
-	ctx->is_load = true;
+	return 0;
+}
 
-	/* Allocate memory for the super block */
-	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
-	if (!ctx->super) {
-		free(ctx);
-		_spdk_bs_free(bs);
-		return;
-	}
+/* END spdk_blob_resize */
 
-	cpl.type = SPDK_BS_CPL_TYPE_BS_HANDLE;
-	cpl.u.bs_handle.cb_fn = cb_fn;
-	cpl.u.bs_handle.cb_arg = cb_arg;
-	cpl.u.bs_handle.bs = bs;
 
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
-		spdk_dma_free(ctx->super);
-		free(ctx);
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+/*
+ * Drop a reference the blobstore took internally, e.g. the one a clone holds
+ *  on its snapshot.  While others still hold the blob open they own its
+ *  metadata, so only the last reference closes it.
+ */
+static void
+_spdk_blob_release_ref(struct spdk_blob_data *parent, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	assert(parent->open_ref > 0);
+
+	if (parent->open_ref > 1) {
+		parent->open_ref--;
+		cb_fn(cb_arg, 0);
 		return;
 	}
 
-	/* Read the super block */
-	spdk_bs_sequence_read(seq, ctx->super, _spdk_bs_page_to_lba(bs, 0),
-			      _spdk_bs_byte_to_lba(bs, sizeof(*ctx->super)),
-			      _spdk_bs_load_super_cpl, ctx);
+	spdk_blob_close(__data_to_blob(parent), cb_fn, cb_arg);
 }
 
-/* END spdk_bs_load */
-
-/* START spdk_bs_init */
+/* START spdk_bs_delete_blob */
 
-struct spdk_bs_init_ctx {
-	struct spdk_blob_store		*bs;
-	struct spdk_bs_super_block	*super;
+struct spdk_bs_delete_ctx {
+	spdk_bs_sequence_t	*seq;
+	struct spdk_blob_data	*blob;
+	int			bserrno;
 };
 
 static void
-_spdk_bs_init_persist_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_delete_close_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_init_ctx *ctx = cb_arg;
+	struct spdk_bs_delete_ctx *ctx = cb_arg;
+	spdk_bs_sequence_t *seq = ctx->seq;
 
-	spdk_dma_free(ctx->super);
-	free(ctx);
+	if (ctx->bserrno != 0) {
+		bserrno = ctx->bserrno;
+	}
 
+	free(ctx);
 	spdk_bs_sequence_finish(seq, bserrno);
 }
 
 static void
-_spdk_bs_init_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_delete_parent_sync_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_init_ctx *ctx = cb_arg;
+	struct spdk_bs_delete_ctx *ctx = cb_arg;
 
-	/* Write super block */
-	spdk_bs_sequence_write(seq, ctx->super, _spdk_bs_page_to_lba(ctx->bs, 0),
-			       _spdk_bs_byte_to_lba(ctx->bs, sizeof(*ctx->super)),
-			       _spdk_bs_init_persist_super_cpl, ctx);
+	if (bserrno != 0) {
+		/* The blob is gone either way; the snapshot keeps a stale clone count */
+		SPDK_ERRLOG("Failed to update snapshot %lu of deleted blob %lu\n",
+			    ctx->blob->parent_id, ctx->blob->id);
+	}
+
+	/*
+	 * This will immediately decrement the ref_count and call
+	 *  the completion routine since the metadata state is clean.
+	 *  By calling spdk_blob_close, we reduce the number of call
+	 *  points into code that touches the blob->open_ref count
+	 *  and the blobstore's blob list.
+	 */
+	spdk_blob_close(__data_to_blob(ctx->blob), _spdk_bs_delete_close_cpl, ctx);
 }
 
-void
-spdk_bs_init(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
-	     spdk_bs_op_with_handle_complete cb_fn, void *cb_arg)
+static void
+_spdk_bs_delete_persist_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_bs_init_ctx *ctx;
-	struct spdk_blob_store	*bs;
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t	*seq;
-	spdk_bs_batch_t		*batch;
-	uint64_t		num_md_lba;
-	uint64_t		num_md_pages;
-	uint64_t		num_md_clusters;
-	uint32_t		i;
-	struct spdk_bs_opts	opts = {};
-	int			rc;
+	struct spdk_bs_delete_ctx *ctx = cb_arg;
+	struct spdk_blob_data *blob = ctx->blob;
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Initializing blobstore on dev %p\n", dev);
+	if (bserrno != 0) {
+		/*
+		 * We already removed this blob from the blobstore tailq, so
+		 *  we need to free it here since this is the last reference
+		 *  to it.
+		 */
+		ctx->bserrno = bserrno;
+		if (blob->parent != NULL) {
+			struct spdk_blob_data *parent = blob->parent;
 
-	if ((SPDK_BS_PAGE_SIZE % dev->blocklen) != 0) {
-		SPDK_ERRLOG("unsupported dev block length of %d\n",
-			    dev->blocklen);
-		dev->destroy(dev);
-		cb_fn(cb_arg, NULL, -EINVAL);
+			_spdk_blob_free(blob);
+			_spdk_blob_release_ref(parent, _spdk_bs_delete_close_cpl, ctx);
+			return;
+		}
+		_spdk_blob_free(blob);
+		_spdk_bs_delete_close_cpl(ctx, bserrno);
 		return;
 	}
 
-	if (o) {
-		opts = *o;
-	} else {
-		spdk_bs_opts_init(&opts);
-	}
-
-	if (_spdk_bs_opts_verify(&opts) != 0) {
-		dev->destroy(dev);
-		cb_fn(cb_arg, NULL, -EINVAL);
+	if (blob->parent != NULL) {
+		/* The clone is gone from disk, so the snapshot may now drop it */
+		assert(blob->parent->num_clones > 0);
+		blob->parent->num_clones--;
+		blob->parent->state = SPDK_BLOB_STATE_DIRTY;
+		_spdk_blob_sync_md(blob->parent, _spdk_bs_delete_parent_sync_cpl, ctx);
 		return;
 	}
 
-	bs = _spdk_bs_alloc(dev, &opts);
-	if (!bs) {
-		dev->destroy(dev);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+	_spdk_bs_delete_parent_sync_cpl(ctx, 0);
+}
+
+static void
+_spdk_bs_delete_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
+{
+	struct spdk_bs_delete_ctx *ctx = cb_arg;
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
+	uint32_t page_num;
+
+	if (bserrno != 0) {
+		_spdk_bs_delete_close_cpl(ctx, bserrno);
 		return;
 	}
 
-	if (opts.num_md_pages == SPDK_BLOB_OPTS_NUM_MD_PAGES) {
-		/* By default, allocate 1 page per cluster.
-		 * Technically, this over-allocates metadata
-		 * because more metadata will reduce the number
-		 * of usable clusters. This can be addressed with
-		 * more complex math in the future.
-		 */
-		bs->md_len = bs->total_clusters;
-	} else {
-		bs->md_len = opts.num_md_pages;
-	}
+	ctx->blob = blob;
 
-	rc = spdk_bit_array_resize(&bs->used_md_pages, bs->md_len);
-	if (rc < 0) {
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+	if (blob->open_ref > 1) {
+		/*
+		 * Someone has this blob open (besides this delete context).
+		 *  Decrement the ref count directly and return -EBUSY.
+		 */
+		blob->open_ref--;
+		_spdk_bs_delete_close_cpl(ctx, -EBUSY);
 		return;
 	}
 
-	rc = spdk_bit_array_resize(&bs->used_blobids, bs->md_len);
-	if (rc < 0) {
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+	if (blob->num_clones > 0) {
+		/* Clones still read through this snapshot */
+		ctx->bserrno = -EBUSY;
+		spdk_blob_close(_blob, _spdk_bs_delete_close_cpl, ctx);
 		return;
 	}
 
+	/*
+	 * Remove the blob from the blob_store list now, to ensure it does not
+	 *  get returned after this point by _spdk_blob_lookup().
+	 */
+	_spdk_bs_remove_open_blob(blob->bs, blob);
+	page_num = _spdk_bs_blobid_to_page(blob->id);
+	spdk_bit_array_clear(blob->bs->used_blobids, page_num);
+	blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob->active.num_pages = 0;
+	_spdk_resize_blob(blob, 0);
+
+	_spdk_blob_persist(ctx->seq, blob, _spdk_bs_delete_persist_cpl, ctx);
+}
+
+void
+spdk_bs_delete_blob(struct spdk_blob_store *bs, spdk_blob_id blobid,
+		    spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_cpl		cpl;
+	struct spdk_bs_delete_ctx	*ctx;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Deleting blob %lu\n", blobid);
+
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx) {
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
 
-	ctx->bs = bs;
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = cb_fn;
+	cpl.u.blob_basic.cb_arg = cb_arg;
 
-	/* Allocate memory for the super block */
-	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
-	if (!ctx->super) {
+	ctx->seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
+	if (!ctx->seq) {
 		free(ctx);
-		_spdk_bs_free(bs);
+		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
-	memcpy(ctx->super->signature, SPDK_BS_SUPER_BLOCK_SIG,
-	       sizeof(ctx->super->signature));
-	ctx->super->version = SPDK_BS_VERSION;
-	ctx->super->length = sizeof(*ctx->super);
-	ctx->super->super_blob = bs->super_blob;
-	ctx->super->clean = 0;
-	ctx->super->cluster_size = bs->cluster_sz;
-	memcpy(&ctx->super->bstype, &bs->bstype, sizeof(bs->bstype));
 
-	/* Calculate how many pages the metadata consumes at the front
-	 * of the disk.
-	 */
+	spdk_bs_open_blob(bs, blobid, _spdk_bs_delete_open_cpl, ctx);
+}
 
-	/* The super block uses 1 page */
-	num_md_pages = 1;
+/* END spdk_bs_delete_blob */
 
-	/* The used_md_pages mask requires 1 bit per metadata page, rounded
-	 * up to the nearest page, plus a header.
-	 */
-	ctx->super->used_page_mask_start = num_md_pages;
-	ctx->super->used_page_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
-					 divide_round_up(bs->md_len, 8),
-					 SPDK_BS_PAGE_SIZE);
-	num_md_pages += ctx->super->used_page_mask_len;
+/* START spdk_bs_create_snapshot */
+
+struct spdk_bs_snapshot_ctx {
+	struct spdk_blob_store			*bs;
+	struct spdk_blob_xattr_opts		xattrs_copy;
+	const struct spdk_blob_xattr_opts	*xattrs;
+	struct spdk_blob_data			*original;
+	struct spdk_blob_data			*old_parent;
+	spdk_blob_id				snapshot_id;
+	spdk_blob_op_with_id_complete		cb_fn;
+	void					*cb_arg;
+	int					bserrno;
+};
 
-	/* The used_clusters mask requires 1 bit per cluster, rounded
-	 * up to the nearest page, plus a header.
-	 */
-	ctx->super->used_cluster_mask_start = num_md_pages;
-	ctx->super->used_cluster_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
-					    divide_round_up(bs->total_clusters, 8),
-					    SPDK_BS_PAGE_SIZE);
-	num_md_pages += ctx->super->used_cluster_mask_len;
+static void
+_spdk_bs_snapshot_finish(void *cb_arg, int bserrno)
+{
+	struct spdk_bs_snapshot_ctx *ctx = cb_arg;
 
-	/* The used_blobids mask requires 1 bit per metadata page, rounded
-	 * up to the nearest page, plus a header.
-	 */
-	ctx->super->used_blobid_mask_start = num_md_pages;
-	ctx->super->used_blobid_mask_len = divide_round_up(sizeof(struct spdk_bs_md_mask) +
-					   divide_round_up(bs->md_len, 8),
-					   SPDK_BS_PAGE_SIZE);
-	num_md_pages += ctx->super->used_blobid_mask_len;
+	if (ctx->bserrno != 0) {
+		bserrno = ctx->bserrno;
+	}
 
-	/* The metadata region size was chosen above */
-	ctx->super->md_start = bs->md_start = num_md_pages;
-	ctx->super->md_len = bs->md_len;
-	num_md_pages += bs->md_len;
+	ctx->cb_fn(ctx->cb_arg, bserrno == 0 ? ctx->snapshot_id : SPDK_BLOBID_INVALID, bserrno);
+	free(ctx);
+}
 
-	num_md_lba = _spdk_bs_page_to_lba(bs, num_md_pages);
+static void
+_spdk_bs_snapshot_cleanup(struct spdk_bs_snapshot_ctx *ctx, int bserrno)
+{
+	if (ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
 
-	ctx->super->crc = _spdk_blob_md_page_calc_crc(ctx->super);
+	_spdk_blob_release_ref(ctx->original, _spdk_bs_snapshot_finish, ctx);
+}
 
-	num_md_clusters = divide_round_up(num_md_pages, bs->pages_per_cluster);
-	if (num_md_clusters > bs->total_clusters) {
-		SPDK_ERRLOG("Blobstore metadata cannot use more clusters than is available, "
-			    "please decrease number of pages reserved for metadata "
-			    "or increase cluster size.\n");
-		spdk_dma_free(ctx->super);
-		free(ctx);
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
-		return;
-	}
-	/* Claim all of the clusters used by the metadata */
-	for (i = 0; i < num_md_clusters; i++) {
-		_spdk_bs_claim_cluster(bs, i);
-	}
+static void
+_spdk_bs_snapshot_release_old_parent_cpl(void *cb_arg, int bserrno)
+{
+	_spdk_bs_snapshot_cleanup(cb_arg, bserrno);
+}
 
-	bs->total_data_clusters = bs->num_free_clusters;
+static void
+_spdk_bs_snapshot_origblob_sync_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_bs_snapshot_ctx *ctx = cb_arg;
 
-	cpl.type = SPDK_BS_CPL_TYPE_BS_HANDLE;
-	cpl.u.bs_handle.cb_fn = cb_fn;
-	cpl.u.bs_handle.cb_arg = cb_arg;
-	cpl.u.bs_handle.bs = bs;
+	if (bserrno != 0) {
+		SPDK_ERRLOG("Failed to update blob %lu after snapshot %lu\n",
+			    ctx->original->id, ctx->snapshot_id);
+		ctx->bserrno = bserrno;
+	}
 
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
-		spdk_dma_free(ctx->super);
-		free(ctx);
-		_spdk_bs_free(bs);
-		cb_fn(cb_arg, NULL, -ENOMEM);
+	if (ctx->old_parent != NULL) {
+		/* The snapshot holds its own reference on the old parent now */
+		_spdk_blob_release_ref(ctx->old_parent, _spdk_bs_snapshot_release_old_parent_cpl, ctx);
 		return;
 	}
 
-	batch = spdk_bs_sequence_to_batch(seq, _spdk_bs_init_trim_cpl, ctx);
-
-	/* Clear metadata space */
-	spdk_bs_batch_write_zeroes(batch, 0, num_md_lba);
-	/* Trim data clusters */
-	spdk_bs_batch_unmap(batch, num_md_lba, ctx->bs->dev->blockcnt - num_md_lba);
-
-	spdk_bs_batch_close(batch);
+	_spdk_bs_snapshot_cleanup(ctx, 0);
 }
 
-/* END spdk_bs_init */
-
-/* START spdk_bs_destroy */
-
 static void
-_spdk_bs_destroy_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_snapshot_open_cpl(void *cb_arg, struct spdk_blob *_snapshot, int bserrno)
 {
-	struct spdk_bs_init_ctx *ctx = cb_arg;
-	struct spdk_blob_store *bs = ctx->bs;
+	struct spdk_bs_snapshot_ctx	*ctx = cb_arg;
+	struct spdk_blob_data		*original = ctx->original;
+
+	if (bserrno != 0) {
+		_spdk_bs_snapshot_cleanup(ctx, bserrno);
+		return;
+	}
 
 	/*
-	 * We need to defer calling spdk_bs_call_cpl() until after
-	 * dev destruction, so tuck these away for later use.
+	 * The snapshot owns the clusters now.  The original turns into an empty
+	 *  thin provisioned clone of it, and keeps the reference taken by the
+	 *  open above for as long as it is open itself.
 	 */
-	bs->unload_err = bserrno;
-	memcpy(&bs->unload_cpl, &seq->cpl, sizeof(struct spdk_bs_cpl));
-	seq->cpl.type = SPDK_BS_CPL_TYPE_NONE;
+	memset(original->active.clusters, 0, original->active.num_clusters * sizeof(uint64_t));
+	original->invalid_flags |= SPDK_BLOB_THIN_PROV;
+	ctx->old_parent = original->parent;
+	original->parent_id = ctx->snapshot_id;
+	original->parent = __blob_to_data(_snapshot);
+	original->state = SPDK_BLOB_STATE_DIRTY;
+
+	_spdk_blob_sync_md(original, _spdk_bs_snapshot_origblob_sync_cpl, ctx);
+}
 
-	spdk_bs_sequence_finish(seq, bserrno);
+static void
+_spdk_bs_snapshot_create_cpl(void *cb_arg, spdk_blob_id snapshot_id, int bserrno)
+{
+	struct spdk_bs_snapshot_ctx *ctx = cb_arg;
 
-	_spdk_bs_free(bs);
-	free(ctx);
+	if (bserrno != 0) {
+		_spdk_bs_snapshot_cleanup(ctx, bserrno);
+		return;
+	}
+
+	spdk_bs_open_blob(ctx->bs, ctx->snapshot_id, _spdk_bs_snapshot_open_cpl, ctx);
 }
 
-void
-spdk_bs_destroy(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn,
-		void *cb_arg)
+static void
+_spdk_bs_snapshot_origblob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 {
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t	*seq;
-	struct spdk_bs_init_ctx *ctx;
+	struct spdk_bs_snapshot_ctx	*ctx = cb_arg;
+	struct spdk_blob_data		*original;
+	struct spdk_blob_data		*snapshot;
+	int				rc;
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Destroying blobstore\n");
+	if (bserrno != 0) {
+		_spdk_bs_snapshot_finish(ctx, bserrno);
+		return;
+	}
 
-	if (!TAILQ_EMPTY(&bs->blobs)) {
-		SPDK_ERRLOG("Blobstore still has open blobs\n");
-		cb_fn(cb_arg, -EBUSY);
+	original = __blob_to_data(_blob);
+	ctx->original = original;
+
+	if (original->md_ro || original->data_ro) {
+		_spdk_bs_snapshot_cleanup(ctx, -EPERM);
 		return;
 	}
 
-	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
-	cpl.u.bs_basic.cb_fn = cb_fn;
-	cpl.u.bs_basic.cb_arg = cb_arg;
+	if (original->state == SPDK_BLOB_STATE_SYNCING) {
+		_spdk_bs_snapshot_cleanup(ctx, -EBUSY);
+		return;
+	}
+
+	snapshot = _spdk_bs_create_blob_alloc(ctx->bs);
+	if (!snapshot) {
+		_spdk_bs_snapshot_cleanup(ctx, -ENOMEM);
+		return;
+	}
+
+	rc = _spdk_blob_set_xattrs(snapshot, ctx->xattrs);
+	if (rc == 0 && original->active.num_clusters > 0) {
+		snapshot->active.clusters = calloc(original->active.num_clusters, sizeof(uint64_t));
+		if (!snapshot->active.clusters) {
+			rc = -ENOMEM;
+		}
+	}
+	if (rc != 0) {
+		_spdk_bs_create_blob_abort(snapshot);
+		_spdk_bs_snapshot_cleanup(ctx, rc);
+		return;
+	}
+
+	memcpy(snapshot->active.clusters, original->active.clusters,
+	       original->active.num_clusters * sizeof(uint64_t));
+	snapshot->active.num_clusters = original->active.num_clusters;
+	snapshot->active.cluster_array_size = original->active.num_clusters;
+	snapshot->data_ro_flags |= SPDK_BLOB_READ_ONLY;
+	snapshot->invalid_flags |= original->invalid_flags & SPDK_BLOB_THIN_PROV;
+	snapshot->parent_id = original->parent_id;
+	snapshot->num_clones = 1;
+	ctx->snapshot_id = snapshot->id;
+
+	/*
+	 * The snapshot is written out before the original gives up its
+	 *  clusters, so every cluster stays referenced by some blob on disk.
+	 */
+	_spdk_bs_create_blob_persist(snapshot, _spdk_bs_snapshot_create_cpl, ctx);
+}
+
+void spdk_bs_create_snapshot(struct spdk_blob_store *bs, spdk_blob_id blobid,
+			     const struct spdk_blob_xattr_opts *xattrs,
+			     spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_snapshot_ctx *ctx;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Creating snapshot of blob %lu\n", blobid);
 
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx) {
-		cb_fn(cb_arg, -ENOMEM);
+		cb_fn(cb_arg, SPDK_BLOBID_INVALID, -ENOMEM);
 		return;
 	}
 
 	ctx->bs = bs;
-
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
-		free(ctx);
-		cb_fn(cb_arg, -ENOMEM);
-		return;
+	if (xattrs) {
+		ctx->xattrs_copy = *xattrs;
+		ctx->xattrs = &ctx->xattrs_copy;
 	}
+	ctx->snapshot_id = SPDK_BLOBID_INVALID;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
 
-	/* Write zeroes to the super block */
-	spdk_bs_sequence_write_zeroes(seq,
-				      _spdk_bs_page_to_lba(bs, 0),
-				      _spdk_bs_byte_to_lba(bs, sizeof(struct spdk_bs_super_block)),
-				      _spdk_bs_destroy_trim_cpl, ctx);
+	spdk_bs_open_blob(bs, blobid, _spdk_bs_snapshot_origblob_open_cpl, ctx);
 }
 
-/* END spdk_bs_destroy */
+/* END spdk_bs_create_snapshot */
 
-/* START spdk_bs_unload */
+/* START spdk_bs_create_clone */
+
+struct spdk_bs_clone_ctx {
+	struct spdk_blob_store			*bs;
+	struct spdk_blob_xattr_opts		xattrs_copy;
+	const struct spdk_blob_xattr_opts	*xattrs;
+	struct spdk_blob_data			*snapshot;
+	struct spdk_blob_data			*clone;
+	spdk_blob_id				clone_id;
+	spdk_blob_op_with_id_complete		cb_fn;
+	void					*cb_arg;
+	int					bserrno;
+};
 
 static void
-_spdk_bs_unload_write_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_clone_finish(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_bs_clone_ctx *ctx = cb_arg;
 
-	spdk_dma_free(ctx->super);
+	if (ctx->bserrno != 0) {
+		bserrno = ctx->bserrno;
+	}
 
-	/*
-	 * We need to defer calling spdk_bs_call_cpl() until after
-	 * dev destuction, so tuck these away for later use.
-	 */
-	ctx->bs->unload_err = bserrno;
-	memcpy(&ctx->bs->unload_cpl, &seq->cpl, sizeof(struct spdk_bs_cpl));
-	seq->cpl.type = SPDK_BS_CPL_TYPE_NONE;
+	ctx->cb_fn(ctx->cb_arg, bserrno == 0 ? ctx->clone_id : SPDK_BLOBID_INVALID, bserrno);
+	free(ctx);
+}
 
-	spdk_bs_sequence_finish(seq, bserrno);
+static void
+_spdk_bs_clone_cleanup(struct spdk_bs_clone_ctx *ctx, int bserrno)
+{
+	if (ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
 
-	_spdk_bs_free(ctx->bs);
-	free(ctx);
+	_spdk_blob_release_ref(ctx->snapshot, _spdk_bs_clone_finish, ctx);
 }
 
 static void
-_spdk_bs_unload_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_clone_revert_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_bs_clone_ctx *ctx = cb_arg;
 
-	spdk_dma_free(ctx->mask);
-	ctx->super->clean = 1;
+	if (bserrno != 0) {
+		SPDK_ERRLOG("Failed to restore clone count of snapshot %lu\n", ctx->snapshot->id);
+	}
 
-	_spdk_bs_write_super(seq, ctx->bs, ctx->super, _spdk_bs_unload_write_super_cpl, ctx);
+	_spdk_bs_clone_cleanup(ctx, 0);
 }
 
 static void
-_spdk_bs_unload_write_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_clone_create_cpl(void *cb_arg, spdk_blob_id clone_id, int bserrno)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_bs_clone_ctx *ctx = cb_arg;
 
-	spdk_dma_free(ctx->mask);
-	ctx->mask = NULL;
+	if (bserrno != 0) {
+		ctx->bserrno = bserrno;
+		ctx->snapshot->num_clones--;
+		ctx->snapshot->state = SPDK_BLOB_STATE_DIRTY;
+		_spdk_blob_sync_md(ctx->snapshot, _spdk_bs_clone_revert_cpl, ctx);
+		return;
+	}
 
-	_spdk_bs_write_used_clusters(seq, cb_arg, _spdk_bs_unload_write_used_clusters_cpl);
+	_spdk_bs_clone_cleanup(ctx, 0);
 }
 
 static void
-_spdk_bs_unload_write_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_clone_snapshot_sync_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_load_ctx	*ctx = cb_arg;
+	struct spdk_bs_clone_ctx *ctx = cb_arg;
 
-	spdk_dma_free(ctx->mask);
-	ctx->mask = NULL;
+	if (bserrno != 0) {
+		ctx->snapshot->num_clones--;
+		_spdk_bs_create_blob_abort(ctx->clone);
+		_spdk_bs_clone_cleanup(ctx, bserrno);
+		return;
+	}
 
-	_spdk_bs_write_used_blobids(seq, cb_arg, _spdk_bs_unload_write_used_blobids_cpl);
+	_spdk_bs_create_blob_persist(ctx->clone, _spdk_bs_clone_create_cpl, ctx);
 }
 
 static void
-_spdk_bs_unload_read_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_clone_snapshot_open_cpl(void *cb_arg, struct spdk_blob *_snapshot, int bserrno)
 {
-	_spdk_bs_write_used_md(seq, cb_arg, _spdk_bs_unload_write_used_pages_cpl);
-}
-
-void
-spdk_bs_unload(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn, void *cb_arg)
-{
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t	*seq;
-	struct spdk_bs_load_ctx *ctx;
-
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Syncing blobstore\n");
+	struct spdk_bs_clone_ctx	*ctx = cb_arg;
+	struct spdk_blob_data		*snapshot;
+	struct spdk_blob_data		*clone;
+	int				rc;
 
-	if (!TAILQ_EMPTY(&bs->blobs)) {
-		SPDK_ERRLOG("Blobstore still has open blobs\n");
-		cb_fn(cb_arg, -EBUSY);
+	if (bserrno != 0) {
+		_spdk_bs_clone_finish(ctx, bserrno);
 		return;
 	}
 
-	ctx = calloc(1, sizeof(*ctx));
-	if (!ctx) {
-		cb_fn(cb_arg, -ENOMEM);
+	snapshot = __blob_to_data(_snapshot);
+	ctx->snapshot = snapshot;
+
+	if ((snapshot->data_ro_flags & SPDK_BLOB_READ_ONLY) == 0) {
+		/* Only snapshots are guaranteed not to change under a clone */
+		_spdk_bs_clone_cleanup(ctx, -EINVAL);
 		return;
 	}
 
-	ctx->bs = bs;
-	ctx->is_load = false;
-
-	ctx->super = spdk_dma_zmalloc(sizeof(*ctx->super), 0x1000, NULL);
-	if (!ctx->super) {
-		free(ctx);
-		cb_fn(cb_arg, -ENOMEM);
+	clone = _spdk_bs_create_blob_alloc(ctx->bs);
+	if (!clone) {
+		_spdk_bs_clone_cleanup(ctx, -ENOMEM);
 		return;
 	}
 
-	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
-	cpl.u.bs_basic.cb_fn = cb_fn;
-	cpl.u.bs_basic.cb_arg = cb_arg;
-
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
-		spdk_dma_free(ctx->super);
-		free(ctx);
-		cb_fn(cb_arg, -ENOMEM);
+	clone->invalid_flags |= SPDK_BLOB_THIN_PROV;
+	clone->parent_id = snapshot->id;
+	rc = _spdk_blob_set_xattrs(clone, ctx->xattrs);
+	if (rc == 0) {
+		rc = _spdk_resize_blob(clone, snapshot->active.num_clusters);
+	}
+	if (rc != 0) {
+		_spdk_bs_create_blob_abort(clone);
+		_spdk_bs_clone_cleanup(ctx, rc);
 		return;
 	}
 
-	/* Read super block */
-	spdk_bs_sequence_read(seq, ctx->super, _spdk_bs_page_to_lba(bs, 0),
-			      _spdk_bs_byte_to_lba(bs, sizeof(*ctx->super)),
-			      _spdk_bs_unload_read_super_cpl, ctx);
-}
-
-/* END spdk_bs_unload */
-
-void
-spdk_bs_set_super(struct spdk_blob_store *bs, spdk_blob_id blobid,
-		  spdk_bs_op_complete cb_fn, void *cb_arg)
-{
-	bs->super_blob = blobid;
-	cb_fn(cb_arg, 0);
-}
-
-void
-spdk_bs_get_super(struct spdk_blob_store *bs,
-		  spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
-{
-	if (bs->super_blob == SPDK_BLOBID_INVALID) {
-		cb_fn(cb_arg, SPDK_BLOBID_INVALID, -ENOENT);
-	} else {
-		cb_fn(cb_arg, bs->super_blob, 0);
-	}
-}
+	ctx->clone = clone;
+	ctx->clone_id = clone->id;
 
-uint64_t
-spdk_bs_get_cluster_size(struct spdk_blob_store *bs)
-{
-	return bs->cluster_sz;
+	/* Count the clone before it exists on disk, so the snapshot is never deleted under it */
+	snapshot->num_clones++;
+	snapshot->state = SPDK_BLOB_STATE_DIRTY;
+	_spdk_blob_sync_md(snapshot, _spdk_bs_clone_snapshot_sync_cpl, ctx);
 }
 
-uint64_t
-spdk_bs_get_page_size(struct spdk_blob_store *bs)
+void spdk_bs_create_clone(struct spdk_blob_store *bs, spdk_blob_id snapshot_id,
+			  const struct spdk_blob_xattr_opts *xattrs,
+			  spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
 {
-	return SPDK_BS_PAGE_SIZE;
-}
+	struct spdk_bs_clone_ctx *ctx;
 
-uint64_t
-spdk_bs_free_cluster_count(struct spdk_blob_store *bs)
-{
-	return bs->num_free_clusters;
-}
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Creating clone of snapshot %lu\n", snapshot_id);
 
-uint64_t
-spdk_bs_total_data_cluster_count(struct spdk_blob_store *bs)
-{
-	return bs->total_data_clusters;
-}
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, SPDK_BLOBID_INVALID, -ENOMEM);
+		return;
+	}
 
-static int
-spdk_bs_register_md_thread(struct spdk_blob_store *bs)
-{
-	bs->md_channel = spdk_get_io_channel(bs);
-	if (!bs->md_channel) {
-		SPDK_ERRLOG("Failed to get IO channel.\n");
-		return -1;
+	ctx->bs = bs;
+	if (xattrs) {
+		ctx->xattrs_copy = *xattrs;
+		ctx->xattrs = &ctx->xattrs_copy;
 	}
+	ctx->clone_id = SPDK_BLOBID_INVALID;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
 
-	return 0;
+	spdk_bs_open_blob(bs, snapshot_id, _spdk_bs_clone_snapshot_open_cpl, ctx);
 }
 
-static int
-spdk_bs_unregister_md_thread(struct spdk_blob_store *bs)
-{
-	spdk_put_io_channel(bs->md_channel);
+/* END spdk_bs_create_clone */
 
-	return 0;
-}
+/* START spdk_bs_inflate_blob */
 
-spdk_blob_id spdk_blob_get_id(struct spdk_blob *_blob)
+struct spdk_bs_inflate_ctx {
+	struct spdk_blob_data		*blob;
+	struct spdk_io_channel		*channel;
+	bool				decouple;
+	uint64_t			cluster;
+	struct spdk_blob_data		*old_parent;
+	struct spdk_blob_data		*new_parent;
+	spdk_blob_op_complete		cb_fn;
+	void				*cb_arg;
+	int				bserrno;
+};
+
+static void
+_spdk_bs_inflate_blob_done(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data *blob = __blob_to_data(_blob);
+	struct spdk_bs_inflate_ctx *ctx = cb_arg;
 
-	assert(blob != NULL);
+	if (ctx->bserrno != 0) {
+		bserrno = ctx->bserrno;
+	}
 
-	return blob->id;
+	ctx->cb_fn(ctx->cb_arg, bserrno);
+	free(ctx);
 }
 
-uint64_t spdk_blob_get_num_pages(struct spdk_blob *_blob)
+static void
+_spdk_bs_inflate_blob_finish(struct spdk_bs_inflate_ctx *ctx, int bserrno)
 {
-	struct spdk_blob_data *blob = __blob_to_data(_blob);
-
-	assert(blob != NULL);
+	if (ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
 
-	return _spdk_bs_cluster_to_page(blob->bs, blob->active.num_clusters);
+	_spdk_blob_release_ref(ctx->blob, _spdk_bs_inflate_blob_done, ctx);
 }
 
-uint64_t spdk_blob_get_num_clusters(struct spdk_blob *_blob)
+static void
+_spdk_bs_inflate_blob_release_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data *blob = __blob_to_data(_blob);
-
-	assert(blob != NULL);
-
-	return blob->active.num_clusters;
+	_spdk_bs_inflate_blob_finish(cb_arg, bserrno);
 }
 
-/* START spdk_bs_create_blob */
-
 static void
-_spdk_bs_create_blob_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_bs_inflate_old_parent_sync_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data *blob = cb_arg;
+	struct spdk_bs_inflate_ctx *ctx = cb_arg;
 
-	_spdk_blob_free(blob);
+	if (bserrno != 0) {
+		/* The blob no longer depends on it; the snapshot keeps a stale clone count */
+		SPDK_ERRLOG("Failed to update snapshot %lu\n", ctx->old_parent->id);
+	}
 
-	spdk_bs_sequence_finish(seq, bserrno);
+	_spdk_blob_release_ref(ctx->old_parent, _spdk_bs_inflate_blob_release_cpl, ctx);
 }
 
-void spdk_bs_create_blob_ext(struct spdk_blob_store *bs, const struct spdk_blob_opts *opts,
-			     spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+static void
+_spdk_bs_inflate_blob_sync_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data	*blob;
-	uint32_t		page_idx;
-	struct spdk_bs_cpl 	cpl;
-	struct spdk_blob_opts	opts_default;
-	spdk_bs_sequence_t	*seq;
-	spdk_blob_id		id;
+	struct spdk_bs_inflate_ctx *ctx = cb_arg;
 
-	page_idx = spdk_bit_array_find_first_clear(bs->used_md_pages, 0);
-	if (page_idx >= spdk_bit_array_capacity(bs->used_md_pages)) {
-		cb_fn(cb_arg, 0, -ENOMEM);
+	if (bserrno != 0) {
+		_spdk_bs_inflate_blob_finish(ctx, bserrno);
 		return;
 	}
-	spdk_bit_array_set(bs->used_blobids, page_idx);
-	spdk_bit_array_set(bs->used_md_pages, page_idx);
-
-	id = _spdk_bs_page_to_blobid(page_idx);
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Creating blob with id %lu at page %u\n", id, page_idx);
-
-	blob = _spdk_blob_alloc(bs, id);
-	if (!blob) {
-		cb_fn(cb_arg, 0, -ENOMEM);
+	if (ctx->old_parent == NULL) {
+		_spdk_bs_inflate_blob_finish(ctx, 0);
 		return;
 	}
 
-	if (!opts) {
-		spdk_blob_opts_init(&opts_default);
-		opts = &opts_default;
-	}
+	ctx->old_parent->num_clones--;
+	ctx->old_parent->state = SPDK_BLOB_STATE_DIRTY;
+	_spdk_blob_sync_md(ctx->old_parent, _spdk_bs_inflate_old_parent_sync_cpl, ctx);
+}
 
-	spdk_blob_resize(__data_to_blob(blob), opts->num_clusters);
-	cpl.type = SPDK_BS_CPL_TYPE_BLOBID;
-	cpl.u.blobid.cb_fn = cb_fn;
-	cpl.u.blobid.cb_arg = cb_arg;
-	cpl.u.blobid.blobid = blob->id;
+static void
+_spdk_bs_inflate_blob_update(struct spdk_bs_inflate_ctx *ctx)
+{
+	struct spdk_blob_data *blob = ctx->blob;
 
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
-		_spdk_blob_free(blob);
-		cb_fn(cb_arg, 0, -ENOMEM);
-		return;
+	blob->parent = ctx->new_parent;
+	blob->parent_id = ctx->new_parent ? ctx->new_parent->id : SPDK_BLOBID_INVALID;
+	if (!ctx->decouple) {
+		blob->invalid_flags &= ~SPDK_BLOB_THIN_PROV;
 	}
 
-	_spdk_blob_persist(seq, blob, _spdk_bs_create_blob_cpl, blob);
-}
+	if (blob->state == SPDK_BLOB_STATE_SYNCING) {
+		blob->dirty_during_sync = true;
+	} else {
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+	}
 
-void spdk_bs_create_blob(struct spdk_blob_store *bs,
-			 spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
-{
-	spdk_bs_create_blob_ext(bs, NULL, cb_fn, cb_arg);
+	_spdk_blob_sync_md(blob, _spdk_bs_inflate_blob_sync_cpl, ctx);
 }
 
-/* END spdk_bs_create_blob */
-
-/* START spdk_blob_resize */
-int
-spdk_blob_resize(struct spdk_blob *_blob, uint64_t sz)
+static void
+_spdk_bs_inflate_new_parent_sync_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_data	*blob = __blob_to_data(_blob);
-	int			rc;
+	struct spdk_bs_inflate_ctx *ctx = cb_arg;
 
-	assert(blob != NULL);
+	if (bserrno != 0) {
+		ctx->new_parent->num_clones--;
+		ctx->new_parent->open_ref--;
+		_spdk_bs_inflate_blob_finish(ctx, bserrno);
+		return;
+	}
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Resizing blob %lu to %lu clusters\n", blob->id, sz);
+	_spdk_bs_inflate_blob_update(ctx);
+}
 
-	if (blob->md_ro) {
-		return -EPERM;
-	}
+static bool
+_spdk_bs_inflate_cluster_needed(struct spdk_bs_inflate_ctx *ctx, uint64_t i)
+{
+	struct spdk_blob_data *blob = ctx->blob;
+	struct spdk_blob_data *parent = blob->parent;
 
-	if (sz == blob->active.num_clusters) {
-		return 0;
+	if (blob->active.clusters[i] != 0) {
+		return false;
 	}
 
-	rc = _spdk_resize_blob(blob, sz);
-	if (rc < 0) {
-		return rc;
+	if (!ctx->decouple) {
+		return true;
 	}
 
-	return 0;
+	/* Clusters further up the chain stay readable through the new parent */
+	return i < parent->active.num_clusters && parent->active.clusters[i] != 0;
 }
 
-/* END spdk_blob_resize */
-
-
-/* START spdk_bs_delete_blob */
-
 static void
-_spdk_bs_delete_close_cpl(void *cb_arg, int bserrno)
+_spdk_bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 {
-	spdk_bs_sequence_t *seq = cb_arg;
+	struct spdk_bs_inflate_ctx	*ctx = cb_arg;
+	struct spdk_blob_data		*blob = ctx->blob;
+	struct spdk_bs_user_op		*op;
 
-	spdk_bs_sequence_finish(seq, bserrno);
-}
+	if (bserrno != 0) {
+		_spdk_bs_inflate_blob_finish(ctx, bserrno);
+		return;
+	}
 
-static void
-_spdk_bs_delete_persist_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
-{
-	struct spdk_blob *_blob = cb_arg;
-	struct spdk_blob_data *blob = __blob_to_data(_blob);
+	while (ctx->cluster < blob->active.num_clusters &&
+	       !_spdk_bs_inflate_cluster_needed(ctx, ctx->cluster)) {
+		ctx->cluster++;
+	}
 
-	if (bserrno != 0) {
-		/*
-		 * We already removed this blob from the blobstore tailq, so
-		 *  we need to free it here since this is the last reference
-		 *  to it.
-		 */
-		_spdk_blob_free(blob);
-		_spdk_bs_delete_close_cpl(seq, bserrno);
+	if (ctx->cluster < blob->active.num_clusters) {
+		/* Allocate like a write would: copied from the snapshot, or zeroed */
+		op = _spdk_bs_user_op_alloc(__data_to_blob(blob), ctx->channel, SPDK_BLOB_ALLOCATE,
+					    NULL, NULL, 0, ctx->cluster * _spdk_bs_io_units_per_cluster(blob), 1,
+					    _spdk_bs_inflate_blob_touch_next, ctx);
+		if (!op) {
+			_spdk_bs_inflate_blob_finish(ctx, -ENOMEM);
+			return;
+		}
+		_spdk_bs_allocate_cluster(op, ctx->cluster);
 		return;
 	}
 
-	/*
-	 * This will immediately decrement the ref_count and call
-	 *  the completion routine since the metadata state is clean.
-	 *  By calling spdk_blob_close, we reduce the number of call
-	 *  points into code that touches the blob->open_ref count
-	 *  and the blobstore's blob list.
-	 */
-	spdk_blob_close(_blob, _spdk_bs_delete_close_cpl, seq);
+	/* Nothing is read from the old parent any more */
+	ctx->old_parent = blob->parent;
+	ctx->new_parent = ctx->decouple ? blob->parent->parent : NULL;
+
+	if (ctx->new_parent != NULL) {
+		/* Take the reference the blob holds on its new parent */
+		ctx->new_parent->open_ref++;
+		ctx->new_parent->num_clones++;
+		ctx->new_parent->state = SPDK_BLOB_STATE_DIRTY;
+		_spdk_blob_sync_md(ctx->new_parent, _spdk_bs_inflate_new_parent_sync_cpl, ctx);
+		return;
+	}
+
+	_spdk_bs_inflate_blob_update(ctx);
 }
 
 static void
-_spdk_bs_delete_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
+_spdk_bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 {
-	spdk_bs_sequence_t *seq = cb_arg;
-	struct spdk_blob_data *blob = __blob_to_data(_blob);
-	uint32_t page_num;
+	struct spdk_bs_inflate_ctx	*ctx = cb_arg;
+	struct spdk_blob_data		*blob;
 
 	if (bserrno != 0) {
-		spdk_bs_sequence_finish(seq, bserrno);
+		_spdk_bs_inflate_blob_done(ctx, bserrno);
 		return;
 	}
 
-	if (blob->open_ref > 1) {
-		/*
-		 * Someone has this blob open (besides this delete context).
-		 *  Decrement the ref count directly and return -EBUSY.
-		 */
-		blob->open_ref--;
-		spdk_bs_sequence_finish(seq, -EBUSY);
+	blob = __blob_to_data(_blob);
+	ctx->blob = blob;
+
+	if (blob->md_ro || blob->data_ro) {
+		_spdk_bs_inflate_blob_finish(ctx, -EPERM);
 		return;
 	}
 
-	/*
-	 * Remove the blob from the blob_store list now, to ensure it does not
-	 *  get returned after this point by _spdk_blob_lookup().
-	 */
-	TAILQ_REMOVE(&blob->bs->blobs, blob, link);
-	page_num = _spdk_bs_blobid_to_page(blob->id);
-	spdk_bit_array_clear(blob->bs->used_blobids, page_num);
-	blob->state = SPDK_BLOB_STATE_DIRTY;
-	blob->active.num_pages = 0;
-	_spdk_resize_blob(blob, 0);
+	if (ctx->decouple && blob->parent == NULL) {
+		_spdk_bs_inflate_blob_finish(ctx, -EINVAL);
+		return;
+	}
 
-	_spdk_blob_persist(seq, blob, _spdk_bs_delete_persist_cpl, _blob);
+	_spdk_bs_inflate_blob_touch_next(ctx, 0);
 }
 
-void
-spdk_bs_delete_blob(struct spdk_blob_store *bs, spdk_blob_id blobid,
-		    spdk_blob_op_complete cb_fn, void *cb_arg)
+static void
+_spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		      spdk_blob_id blobid, bool decouple, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t 	*seq;
-
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Deleting blob %lu\n", blobid);
-
-	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
-	cpl.u.blob_basic.cb_fn = cb_fn;
-	cpl.u.blob_basic.cb_arg = cb_arg;
+	struct spdk_bs_inflate_ctx *ctx;
 
-	seq = spdk_bs_sequence_start(bs->md_channel, &cpl);
-	if (!seq) {
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
 		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
 
-	spdk_bs_open_blob(bs, blobid, _spdk_bs_delete_open_cpl, seq);
+	ctx->channel = channel;
+	ctx->decouple = decouple;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	spdk_bs_open_blob(bs, blobid, _spdk_bs_inflate_blob_open_cpl, ctx);
 }
 
-/* END spdk_bs_delete_blob */
+void spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Inflating blob %lu\n", blobid);
+
+	_spdk_bs_inflate_blob(bs, channel, blobid, false, cb_fn, cb_arg);
+}
+
+void spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+				  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Decoupling blob %lu from its parent\n", blobid);
+
+	_spdk_bs_inflate_blob(bs, channel, blobid, true, cb_fn, cb_arg);
+}
+
+/* END spdk_bs_inflate_blob */
 
 /* START spdk_bs_open_blob */
 
+static void
+_spdk_bs_open_blob_finish(spdk_bs_sequence_t *seq, struct spdk_blob_data *blob)
+{
+	blob->open_ref++;
+
+	_spdk_bs_add_open_blob(blob->bs, blob);
+
+	spdk_bs_sequence_finish(seq, 0);
+}
+
+static void
+_spdk_bs_open_blob_parent_cpl(void *cb_arg, struct spdk_blob *parent, int bserrno)
+{
+	spdk_bs_sequence_t *seq = cb_arg;
+	struct spdk_blob_data *blob = __blob_to_data(seq->cpl.u.blob_handle.blob);
+
+	if (bserrno != 0) {
+		SPDK_ERRLOG("Failed to open snapshot %lu of blob %lu\n", blob->parent_id, blob->id);
+		_spdk_blob_free(blob);
+		seq->cpl.u.blob_handle.blob = NULL;
+		spdk_bs_sequence_finish(seq, bserrno);
+		return;
+	}
+
+	blob->parent = __blob_to_data(parent);
+	_spdk_bs_open_blob_finish(seq, blob);
+}
+
 static void
 _spdk_bs_open_blob_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
@@ -2900,11 +5015,13 @@ _spdk_bs_open_blob_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 		return;
 	}
 
-	blob->open_ref++;
-
-	TAILQ_INSERT_HEAD(&blob->bs->blobs, blob, link);
+	if (blob->parent_id != SPDK_BLOBID_INVALID) {
+		/* Unallocated clusters are read from the snapshot, so keep it open too */
+		spdk_bs_open_blob(blob->bs, blob->parent_id, _spdk_bs_open_blob_parent_cpl, seq);
+		return;
+	}
 
-	spdk_bs_sequence_finish(seq, bserrno);
+	_spdk_bs_open_blob_finish(seq, blob);
 }
 
 void spdk_bs_open_blob(struct spdk_blob_store *bs, spdk_blob_id blobid,
@@ -2956,36 +5073,126 @@ void spdk_bs_open_blob(struct spdk_blob_store *bs, spdk_blob_id blobid,
 
 /* START spdk_blob_sync_md */
 
+struct spdk_blob_sync_waiter {
+	spdk_blob_op_complete			cb_fn;
+	void					*cb_arg;
+
+	TAILQ_ENTRY(spdk_blob_sync_waiter)	link;
+};
+
+struct spdk_blob_sync_group {
+	TAILQ_HEAD(, spdk_blob_sync_waiter)	waiters;
+};
+
 static void
-_spdk_blob_sync_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+_spdk_blob_sync_group_cpl(void *cb_arg, int bserrno)
 {
-	spdk_bs_sequence_finish(seq, bserrno);
+	struct spdk_blob_sync_group	*group = cb_arg;
+	struct spdk_blob_sync_waiter	*waiter;
+
+	while (!TAILQ_EMPTY(&group->waiters)) {
+		waiter = TAILQ_FIRST(&group->waiters);
+		TAILQ_REMOVE(&group->waiters, waiter, link);
+		waiter->cb_fn(waiter->cb_arg, bserrno);
+		free(waiter);
+	}
+
+	free(group);
 }
 
-void
-spdk_blob_sync_md(struct spdk_blob *_blob, spdk_blob_op_complete cb_fn, void *cb_arg)
+static void _spdk_blob_sync_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno);
+
+/*
+ * Sync again on behalf of everyone who asked while the previous sync was in
+ *  flight.  One persist covers all of them.
+ */
+static void
+_spdk_blob_sync_waiters_resume(struct spdk_blob_data *blob)
 {
-	struct spdk_blob_data	*blob = __blob_to_data(_blob);
-	struct spdk_bs_cpl	cpl;
-	spdk_bs_sequence_t	*seq;
+	struct spdk_blob_sync_group	*group;
+	struct spdk_bs_cpl		cpl;
+	spdk_bs_sequence_t		*seq;
 
-	assert(blob != NULL);
+	if (TAILQ_EMPTY(&blob->sync_waiters) || blob->state == SPDK_BLOB_STATE_SYNCING) {
+		return;
+	}
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Syncing blob %lu\n", blob->id);
+	group = calloc(1, sizeof(*group));
+	if (!group) {
+		struct spdk_blob_sync_group tmp;
 
-	assert(blob->state != SPDK_BLOB_STATE_LOADING &&
-	       blob->state != SPDK_BLOB_STATE_SYNCING);
+		TAILQ_INIT(&tmp.waiters);
+		TAILQ_SWAP(&tmp.waiters, &blob->sync_waiters, spdk_blob_sync_waiter, link);
+		while (!TAILQ_EMPTY(&tmp.waiters)) {
+			struct spdk_blob_sync_waiter *waiter = TAILQ_FIRST(&tmp.waiters);
 
-	if (blob->md_ro) {
-		assert(blob->state == SPDK_BLOB_STATE_CLEAN);
+			TAILQ_REMOVE(&tmp.waiters, waiter, link);
+			waiter->cb_fn(waiter->cb_arg, -ENOMEM);
+			free(waiter);
+		}
+		return;
+	}
+
+	TAILQ_INIT(&group->waiters);
+	TAILQ_SWAP(&group->waiters, &blob->sync_waiters, spdk_blob_sync_waiter, link);
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = _spdk_blob_sync_group_cpl;
+	cpl.u.blob_basic.cb_arg = group;
+
+	seq = spdk_bs_sequence_start(blob->bs->md_channel, &cpl);
+	if (!seq) {
+		_spdk_blob_sync_group_cpl(group, -ENOMEM);
 		return;
 	}
 
+	_spdk_blob_persist(seq, blob, _spdk_blob_sync_md_cpl, blob);
+}
+
+static void
+_spdk_blob_sync_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_blob_data *blob = cb_arg;
+
+	/* The completion below may close the blob, so start the next sync first */
+	_spdk_blob_sync_waiters_resume(blob);
+
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
+/* Also used for blobstore-owned changes to metadata that is read-only to the user */
+static void
+_spdk_blob_sync_md(struct spdk_blob_data *blob, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_bs_cpl		cpl;
+	spdk_bs_sequence_t		*seq;
+	struct spdk_blob_sync_waiter	*waiter;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Syncing blob %lu\n", blob->id);
+
+	assert(blob->state != SPDK_BLOB_STATE_LOADING);
+
 	if (blob->state == SPDK_BLOB_STATE_CLEAN) {
 		cb_fn(cb_arg, 0);
 		return;
 	}
 
+	if (blob->state == SPDK_BLOB_STATE_SYNCING) {
+		/*
+		 * The sync in flight may have serialized the metadata before the
+		 *  changes this caller wants persisted.  Sync again when it is done.
+		 */
+		waiter = calloc(1, sizeof(*waiter));
+		if (!waiter) {
+			cb_fn(cb_arg, -ENOMEM);
+			return;
+		}
+		waiter->cb_fn = cb_fn;
+		waiter->cb_arg = cb_arg;
+		TAILQ_INSERT_TAIL(&blob->sync_waiters, waiter, link);
+		return;
+	}
+
 	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
 	cpl.u.blob_basic.cb_fn = cb_fn;
 	cpl.u.blob_basic.cb_arg = cb_arg;
@@ -2999,14 +5206,129 @@ spdk_blob_sync_md(struct spdk_blob *_blob, spdk_blob_op_complete cb_fn, void *cb
 	_spdk_blob_persist(seq, blob, _spdk_blob_sync_md_cpl, blob);
 }
 
+void
+spdk_blob_sync_md(struct spdk_blob *_blob, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob_data *blob = __blob_to_data(_blob);
+
+	assert(blob != NULL);
+
+	if (blob->md_ro) {
+		/* Nothing the user could have changed */
+		cb_fn(cb_arg, 0);
+		return;
+	}
+
+	_spdk_blob_sync_md(blob, cb_fn, cb_arg);
+}
+
 /* END spdk_blob_sync_md */
 
+/* START spdk_bs_io_flush_blob */
+
+struct spdk_blob_flush_ctx {
+	struct spdk_blob_data	*blob;
+	struct spdk_thread	*thread;
+	spdk_bs_sequence_t	*seq;
+	int			rc;
+};
+
+static void
+_spdk_blob_flush_dev_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_blob_flush_ctx *ctx = cb_arg;
+
+	free(ctx);
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
+static void
+_spdk_blob_flush_md_done(void *arg)
+{
+	struct spdk_blob_flush_ctx *ctx = arg;
+
+	if (ctx->rc != 0) {
+		spdk_bs_sequence_finish(ctx->seq, ctx->rc);
+		free(ctx);
+		return;
+	}
+
+	spdk_bs_sequence_flush(ctx->seq, _spdk_blob_flush_dev_cpl, ctx);
+}
+
+static void
+_spdk_blob_flush_md_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_blob_flush_ctx *ctx = cb_arg;
+
+	ctx->rc = bserrno;
+	spdk_thread_send_msg(ctx->thread, _spdk_blob_flush_md_done, ctx);
+}
+
+static void
+_spdk_blob_flush_md_msg(void *arg)
+{
+	struct spdk_blob_flush_ctx *ctx = arg;
+
+	if (ctx->blob->md_ro) {
+		_spdk_blob_flush_md_cpl(ctx, 0);
+		return;
+	}
+
+	spdk_blob_sync_md(__data_to_blob(ctx->blob), _spdk_blob_flush_md_cpl, ctx);
+}
+
+void
+spdk_bs_io_flush_blob(struct spdk_blob *_blob, struct spdk_io_channel *channel,
+		      spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob_data		*blob = __blob_to_data(_blob);
+	struct spdk_blob_flush_ctx	*ctx;
+	struct spdk_bs_cpl		cpl;
+
+	assert(blob != NULL);
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = cb_fn;
+	cpl.u.blob_basic.cb_arg = cb_arg;
+
+	ctx->seq = spdk_bs_sequence_start(channel, &cpl);
+	if (!ctx->seq) {
+		free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->blob = blob;
+	ctx->thread = spdk_get_thread();
+
+	/* Clusters allocated by completed writes are persisted on the metadata thread */
+	spdk_thread_send_msg(blob->bs->md_thread, _spdk_blob_flush_md_msg, ctx);
+}
+
+/* END spdk_bs_io_flush_blob */
+
 /* START spdk_blob_close */
 
+static void
+_spdk_blob_close_parent_cpl(void *cb_arg, int bserrno)
+{
+	spdk_bs_sequence_t *seq = cb_arg;
+
+	spdk_bs_sequence_finish(seq, bserrno);
+}
+
 static void
 _spdk_blob_close_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
 	struct spdk_blob_data *blob = cb_arg;
+	struct spdk_blob_data *parent;
 
 	if (bserrno == 0) {
 		blob->open_ref--;
@@ -3018,9 +5340,14 @@ _spdk_blob_close_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 			 *  remove them again.
 			 */
 			if (blob->active.num_pages > 0) {
-				TAILQ_REMOVE(&blob->bs->blobs, blob, link);
+				_spdk_bs_remove_open_blob(blob->bs, blob);
 			}
+			parent = blob->parent;
 			_spdk_blob_free(blob);
+			if (parent != NULL) {
+				_spdk_blob_release_ref(parent, _spdk_blob_close_parent_cpl, seq);
+				return;
+			}
 		}
 	}
 
@@ -3081,6 +5408,12 @@ void spdk_bs_free_io_channel(struct spdk_io_channel *channel)
 void spdk_bs_io_unmap_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 			   uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_UNMAP, NULL, NULL, 0, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_op(blob, channel, NULL, offset, length, cb_fn, cb_arg,
 				     SPDK_BLOB_UNMAP);
 }
@@ -3088,6 +5421,12 @@ void spdk_bs_io_unmap_blob(struct spdk_blob *blob, struct spdk_io_channel *chann
 void spdk_bs_io_write_zeroes_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 				  uint64_t offset, uint64_t length, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_WRITE_ZEROES, NULL, NULL, 0, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_op(blob, channel, NULL, offset, length, cb_fn, cb_arg,
 				     SPDK_BLOB_WRITE_ZEROES);
 }
@@ -3096,6 +5435,12 @@ void spdk_bs_io_write_blob(struct spdk_blob *blob, struct spdk_io_channel *chann
 			   void *payload, uint64_t offset, uint64_t length,
 			   spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_WRITE, payload, NULL, 0, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_op(blob, channel, payload, offset, length, cb_fn, cb_arg,
 				     SPDK_BLOB_WRITE);
 }
@@ -3104,6 +5449,12 @@ void spdk_bs_io_read_blob(struct spdk_blob *blob, struct spdk_io_channel *channe
 			  void *payload, uint64_t offset, uint64_t length,
 			  spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_READ, payload, NULL, 0, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_op(blob, channel, payload, offset, length, cb_fn, cb_arg,
 				     SPDK_BLOB_READ);
 }
@@ -3112,6 +5463,12 @@ void spdk_bs_io_writev_blob(struct spdk_blob *blob, struct spdk_io_channel *chan
 			    struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
 			    spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_WRITEV, NULL, iov, iovcnt, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_rw_iov(blob, channel, iov, iovcnt, offset, length, cb_fn, cb_arg, false);
 }
 
@@ -3119,6 +5476,12 @@ void spdk_bs_io_readv_blob(struct spdk_blob *blob, struct spdk_io_channel *chann
 			   struct iovec *iov, int iovcnt, uint64_t offset, uint64_t length,
 			   spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (_spdk_bs_channel_io_queued(channel)) {
+		_spdk_bs_queue_io(blob, channel, SPDK_BLOB_READV, NULL, iov, iovcnt, offset, length,
+				  cb_fn, cb_arg, false);
+		return;
+	}
+
 	_spdk_blob_request_submit_rw_iov(blob, channel, iov, iovcnt, offset, length, cb_fn, cb_arg, true);
 }
 
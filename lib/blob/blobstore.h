@@ -50,6 +50,9 @@
 #define SPDK_BLOB_OPTS_NUM_MD_PAGES UINT32_MAX
 #define SPDK_BLOB_OPTS_MAX_MD_OPS 32
 #define SPDK_BLOB_OPTS_MAX_CHANNEL_OPS 512
+
+/* Number of buckets in the blobstore's hash of open blobs. Must be a power of 2. */
+#define SPDK_BLOB_HASH_BUCKETS 1024
 #define SPDK_BLOB_BLOBID_HIGH_BIT (1ULL << 32)
 
 struct spdk_xattr {
@@ -117,6 +120,24 @@ struct spdk_blob_data {
 
 	enum spdk_blob_state		state;
 
+	/* A cluster of a thin provisioned blob was allocated while the
+	 * metadata was being synchronized, so the blob must stay dirty
+	 * once that sync completes.
+	 */
+	bool		dirty_during_sync;
+
+	/* spdk_blob_sync_md() calls made while the blob was syncing */
+	TAILQ_HEAD(, spdk_blob_sync_waiter) sync_waiters;
+
+	/* Snapshot that backs the unallocated clusters of a clone, or
+	 * SPDK_BLOBID_INVALID. The parent is kept open while the blob is.
+	 */
+	spdk_blob_id			parent_id;
+	struct spdk_blob_data		*parent;
+
+	/* Number of blobs, opened or not, whose parent is this snapshot */
+	uint64_t			num_clones;
+
 	/* Two copies of the mutable data. One is a version
 	 * that matches the last known data on disk (clean).
 	 * The other (active) is the current data. Syncing
@@ -125,6 +146,13 @@ struct spdk_blob_data {
 	struct spdk_blob_mut_data	clean;
 	struct spdk_blob_mut_data	active;
 
+	/* Metadata pages written by a sync whose root page write failed.
+	 * The root page on disk may point at them, so they stay claimed
+	 * until the next sync of the blob succeeds.
+	 */
+	uint32_t	*failed_pages;
+	uint32_t	num_failed_pages;
+
 	bool		invalid;
 	bool		data_ro;
 	bool		md_ro;
@@ -139,8 +167,11 @@ struct spdk_blob_data {
 	TAILQ_HEAD(, spdk_xattr) xattrs;
 
 	TAILQ_ENTRY(spdk_blob_data) link;
+	TAILQ_ENTRY(spdk_blob_data) hash_link;
 };
 
+TAILQ_HEAD(spdk_blob_hash_bucket, spdk_blob_data);
+
 #define __blob_to_data(x)	((struct spdk_blob_data *)(x))
 #define __data_to_blob(x)	((struct spdk_blob *)(x))
 
@@ -149,6 +180,7 @@ struct spdk_blob_store {
 	uint32_t			md_len; /* Count, in pages */
 
 	struct spdk_io_channel		*md_channel;
+	struct spdk_thread		*md_thread;
 	uint32_t			max_channel_ops;
 
 	struct spdk_bs_dev		*dev;
@@ -161,7 +193,9 @@ struct spdk_blob_store {
 	uint64_t			total_clusters;
 	uint64_t			total_data_clusters;
 	uint64_t			num_free_clusters;
+	uint32_t			free_cluster_hint; /* No cluster below this one is free */
 	uint32_t			pages_per_cluster;
+	uint32_t			io_unit_size;
 
 	spdk_blob_id			super_blob;
 	struct spdk_bs_type 		bstype;
@@ -170,16 +204,44 @@ struct spdk_blob_store {
 	int				unload_err;
 
 	TAILQ_HEAD(, spdk_blob_data) 	blobs;
+
+	/* Open blobs, hashed by the page index of their blob id */
+	struct spdk_blob_hash_bucket	blob_hash[SPDK_BLOB_HASH_BUCKETS];
+
+	/* Metadata group commit */
+	TAILQ_HEAD(, spdk_blob_persist_ctx) md_commit_pending;
+	bool				md_commit_active; /* A commit is in flight */
+	uint64_t			md_commit_blobs; /* Count of blobs committed */
+	uint64_t			md_commit_pages; /* Count of md pages written */
+	uint64_t			md_commit_ios; /* Count of md write I/Os issued */
+};
+
+/* Header of a block of request sets or user ops allocated for a channel */
+struct spdk_bs_channel_chunk {
+	TAILQ_ENTRY(spdk_bs_channel_chunk) link;
 };
 
 struct spdk_bs_channel {
-	struct spdk_bs_request_set	*req_mem;
 	TAILQ_HEAD(, spdk_bs_request_set) reqs;
+	uint32_t			num_reqs; /* Free and in use */
+	TAILQ_HEAD(, spdk_bs_channel_chunk) chunks;
 
 	struct spdk_blob_store		*bs;
 
 	struct spdk_bs_dev		*dev;
 	struct spdk_io_channel		*dev_channel;
+
+	/* User I/O waiting for a cluster of a thin provisioned blob to be allocated */
+	TAILQ_HEAD(, spdk_bs_user_op)	need_cluster_alloc;
+
+	/* User I/O waiting for a request set */
+	TAILQ_HEAD(, spdk_bs_user_op)	queued_io;
+
+	/* Set while spdk_bs_channel_resume_io() resubmits the first I/O of queued_io */
+	bool				resubmitting_io;
+
+	/* Free user ops, to hold I/O that has to wait */
+	TAILQ_HEAD(, spdk_bs_user_op)	user_ops;
 };
 
 /** operation type */
@@ -188,6 +250,10 @@ enum spdk_blob_op_type {
 	SPDK_BLOB_READ,
 	SPDK_BLOB_UNMAP,
 	SPDK_BLOB_WRITE_ZEROES,
+	SPDK_BLOB_WRITEV,
+	SPDK_BLOB_READV,
+	/* Allocate the clusters of the range without writing to them */
+	SPDK_BLOB_ALLOCATE,
 };
 
 /* On-Disk Data Structures
@@ -213,6 +279,7 @@ struct spdk_bs_md_mask {
 #define SPDK_MD_DESCRIPTOR_TYPE_EXTENT 1
 #define SPDK_MD_DESCRIPTOR_TYPE_XATTR 2
 #define SPDK_MD_DESCRIPTOR_TYPE_FLAGS 3
+#define SPDK_MD_DESCRIPTOR_TYPE_SNAPSHOT 4
 
 struct spdk_blob_md_descriptor_xattr {
 	uint8_t		type;
@@ -235,12 +302,25 @@ struct spdk_blob_md_descriptor_extent {
 	} extents[0];
 };
 
+struct spdk_blob_md_descriptor_snapshot {
+	uint8_t		type;
+	uint32_t	length;
+
+	/* Snapshot backing the unallocated clusters, or SPDK_BLOBID_INVALID */
+	spdk_blob_id	parent_id;
+
+	/* Number of blobs whose parent_id is this blob */
+	uint64_t	num_clones;
+};
+
 /*
  * As new flags are defined, these values will be updated to reflect the
  *  mask of all flag values understood by this application.
  */
-#define SPDK_BLOB_INVALID_FLAGS_MASK	0
-#define SPDK_BLOB_DATA_RO_FLAGS_MASK	0
+#define SPDK_BLOB_THIN_PROV		(1ULL << 0)
+#define SPDK_BLOB_INVALID_FLAGS_MASK	SPDK_BLOB_THIN_PROV
+#define SPDK_BLOB_READ_ONLY		(1ULL << 0)
+#define SPDK_BLOB_DATA_RO_FLAGS_MASK	SPDK_BLOB_READ_ONLY
 #define SPDK_BLOB_MD_RO_FLAGS_MASK	0
 
 struct spdk_blob_md_descriptor_flags {
@@ -325,8 +405,11 @@ SPDK_STATIC_ASSERT(sizeof(struct spdk_bs_super_block) == 0x1000, "Invalid super
  * The blobstore works with several different units:
  * - Byte: Self explanatory
  * - LBA: The logical blocks on the backing storage device.
- * - Page: The read/write units of blobs and metadata. This is
- *         an offset into a blob in units of 4KiB.
+ * - Page: The units of metadata and of cluster allocation. This is
+ *         an offset in units of 4KiB.
+ * - io_unit: The read/write units of blobs. This is an offset into a
+ *            blob in units of the backing device's block size, so an
+ *            io_unit within a cluster maps 1:1 to an LBA.
  * - Cluster Index: The disk is broken into a sequential list of
  *		    clusters. This is the offset from the beginning.
  *
@@ -415,36 +498,81 @@ _spdk_bs_page_to_blobid(uint32_t page_idx)
 	return SPDK_BLOB_BLOBID_HIGH_BIT | page_idx;
 }
 
-/* Given a page offset into a blob, look up the LBA for the
- * start of that page.
+static inline uint64_t
+_spdk_bs_io_units_per_cluster(struct spdk_blob_data *blob)
+{
+	return blob->bs->cluster_sz / blob->bs->io_unit_size;
+}
+
+/* Given an io_unit offset into a blob, look up the LBA for the
+ * start of that io_unit.
+ */
+static inline uint64_t
+_spdk_bs_blob_io_unit_to_lba(struct spdk_blob_data *blob, uint64_t io_unit)
+{
+	uint64_t	io_units_per_cluster;
+
+	io_units_per_cluster = _spdk_bs_io_units_per_cluster(blob);
+
+	assert(io_unit < blob->active.num_clusters * io_units_per_cluster);
+
+	return blob->active.clusters[io_unit / io_units_per_cluster] + io_unit % io_units_per_cluster;
+}
+
+/* Given an io_unit offset into a blob, look up the number of io_units until
+ * the next cluster boundary.
  */
 static inline uint64_t
-_spdk_bs_blob_page_to_lba(struct spdk_blob_data *blob, uint32_t page)
+_spdk_bs_num_io_units_to_cluster_boundary(struct spdk_blob_data *blob, uint64_t io_unit)
 {
-	uint64_t	lba;
-	uint32_t	pages_per_cluster;
+	uint64_t	io_units_per_cluster;
 
-	pages_per_cluster = blob->bs->pages_per_cluster;
+	io_units_per_cluster = _spdk_bs_io_units_per_cluster(blob);
 
-	assert(page < blob->active.num_clusters * pages_per_cluster);
+	return io_units_per_cluster - (io_unit % io_units_per_cluster);
+}
 
-	lba = blob->active.clusters[page / pages_per_cluster];
-	lba += _spdk_bs_page_to_lba(blob->bs, page % pages_per_cluster);
+/* Given an io_unit offset into a blob, look up the index of the cluster
+ * containing that io_unit in the blob's cluster map.
+ */
+static inline uint64_t
+_spdk_bs_io_unit_to_cluster_index(struct spdk_blob_data *blob, uint64_t io_unit)
+{
+	return io_unit / _spdk_bs_io_units_per_cluster(blob);
+}
 
-	return lba;
+/* Given an io_unit offset into a blob, return whether the cluster containing
+ * that io_unit is backed by the blobstore. Only clusters of thin provisioned
+ * blobs can be unallocated; LBA 0 always belongs to the metadata region so
+ * it is used to mark an unallocated cluster.
+ */
+static inline bool
+_spdk_bs_io_unit_is_allocated(struct spdk_blob_data *blob, uint64_t io_unit)
+{
+	assert(io_unit < blob->active.num_clusters * _spdk_bs_io_units_per_cluster(blob));
+
+	return blob->active.clusters[_spdk_bs_io_unit_to_cluster_index(blob, io_unit)] != 0;
 }
 
-/* Given a page offset into a blob, look up the number of pages until the
- * next cluster boundary.
+/* Given an io_unit offset into a blob, look up the LBA of the data that io_unit
+ * reads. An unallocated cluster of a clone reads from the nearest snapshot in
+ * its chain that has the cluster allocated. Returns false if no blob in the
+ * chain has it, in which case the io_unit reads as zeroes.
  */
-static inline uint32_t
-_spdk_bs_num_pages_to_cluster_boundary(struct spdk_blob_data *blob, uint32_t page)
+static inline bool
+_spdk_bs_blob_io_unit_to_backing_lba(struct spdk_blob_data *blob, uint64_t io_unit, uint64_t *lba)
 {
-	uint32_t	pages_per_cluster;
+	uint64_t	cluster_index = _spdk_bs_io_unit_to_cluster_index(blob, io_unit);
 
-	pages_per_cluster = blob->bs->pages_per_cluster;
+	while (blob != NULL && cluster_index < blob->active.num_clusters) {
+		if (blob->active.clusters[cluster_index] != 0) {
+			*lba = _spdk_bs_blob_io_unit_to_lba(blob, io_unit);
+			return true;
+		}
+		blob = blob->parent;
+	}
 
-	return pages_per_cluster - (page % pages_per_cluster);
+	return false;
 }
 
 #endif
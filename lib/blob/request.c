@@ -38,6 +38,7 @@
 
 #include "spdk/io_channel.h"
 #include "spdk/queue.h"
+#include "spdk/likely.h"
 
 #include "spdk_internal/log.h"
 
@@ -79,15 +80,79 @@ spdk_bs_call_cpl(struct spdk_bs_cpl *cpl, int bserrno)
 	}
 }
 
+int
+spdk_bs_channel_add_reqs(struct spdk_bs_channel *channel, uint32_t count)
+{
+	struct spdk_bs_channel_chunk	*chunk;
+	struct spdk_bs_request_set	*sets;
+	uint32_t			i;
+
+	chunk = calloc(1, sizeof(*chunk) + count * sizeof(*sets));
+	if (!chunk) {
+		return -ENOMEM;
+	}
+	TAILQ_INSERT_TAIL(&channel->chunks, chunk, link);
+
+	sets = (struct spdk_bs_request_set *)(chunk + 1);
+	for (i = 0; i < count; i++) {
+		TAILQ_INSERT_TAIL(&channel->reqs, &sets[i], link);
+	}
+	channel->num_reqs += count;
+
+	return 0;
+}
+
+void
+spdk_bs_channel_free_chunks(struct spdk_bs_channel *channel)
+{
+	struct spdk_bs_request_set	*set;
+	struct spdk_bs_channel_chunk	*chunk;
+
+	TAILQ_FOREACH(set, &channel->reqs, link) {
+		free(set->iov_mem);
+	}
+	TAILQ_INIT(&channel->reqs);
+	channel->num_reqs = 0;
+
+	while ((chunk = TAILQ_FIRST(&channel->chunks)) != NULL) {
+		TAILQ_REMOVE(&channel->chunks, chunk, link);
+		free(chunk);
+	}
+}
+
+static struct spdk_bs_request_set *
+spdk_bs_request_set_get(struct spdk_bs_channel *channel)
+{
+	struct spdk_bs_request_set *set;
+
+	set = TAILQ_FIRST(&channel->reqs);
+	if (spdk_unlikely(set == NULL)) {
+		/* Double the pool rather than fail the request */
+		if (spdk_bs_channel_add_reqs(channel, channel->num_reqs) != 0) {
+			return NULL;
+		}
+		set = TAILQ_FIRST(&channel->reqs);
+	}
+	TAILQ_REMOVE(&channel->reqs, set, link);
+
+	return set;
+}
+
 static void
 spdk_bs_request_set_complete(struct spdk_bs_request_set *set)
 {
+	struct spdk_bs_channel *channel = set->channel;
 	struct spdk_bs_cpl cpl = set->cpl;
 	int bserrno = set->bserrno;
 
-	TAILQ_INSERT_TAIL(&set->channel->reqs, set, link);
+	/* Reuse the most recently used request sets first, while they are still in cache */
+	TAILQ_INSERT_HEAD(&channel->reqs, set, link);
 
 	spdk_bs_call_cpl(&cpl, bserrno);
+
+	if (spdk_unlikely(!TAILQ_EMPTY(&channel->queued_io))) {
+		spdk_bs_channel_resume_io(channel);
+	}
 }
 
 static void
@@ -108,11 +173,10 @@ spdk_bs_sequence_start(struct spdk_io_channel *_channel,
 
 	channel = spdk_io_channel_get_ctx(_channel);
 
-	set = TAILQ_FIRST(&channel->reqs);
+	set = spdk_bs_request_set_get(channel);
 	if (!set) {
 		return NULL;
 	}
-	TAILQ_REMOVE(&channel->reqs, set, link);
 
 	set->cpl = *cpl;
 	set->bserrno = 0;
@@ -266,7 +330,7 @@ spdk_bs_batch_completion(struct spdk_io_channel *_channel,
 	if (set->u.batch.outstanding_ops == 0 && set->u.batch.batch_closed) {
 		if (set->u.batch.cb_fn) {
 			set->cb_args.cb_fn = spdk_bs_sequence_completion;
-			set->u.batch.cb_fn((spdk_bs_sequence_t *)set, set->u.batch.cb_arg, bserrno);
+			set->u.batch.cb_fn((spdk_bs_sequence_t *)set, set->u.batch.cb_arg, set->bserrno);
 		} else {
 			spdk_bs_request_set_complete(set);
 		}
@@ -282,11 +346,10 @@ spdk_bs_batch_open(struct spdk_io_channel *_channel,
 
 	channel = spdk_io_channel_get_ctx(_channel);
 
-	set = TAILQ_FIRST(&channel->reqs);
+	set = spdk_bs_request_set_get(channel);
 	if (!set) {
 		return NULL;
 	}
-	TAILQ_REMOVE(&channel->reqs, set, link);
 
 	set->cpl = *cpl;
 	set->bserrno = 0;
@@ -332,6 +395,34 @@ spdk_bs_batch_write(spdk_bs_batch_t *batch, void *payload,
 			    &set->cb_args);
 }
 
+void
+spdk_bs_batch_readv(spdk_bs_batch_t *batch, struct iovec *iov, int iovcnt,
+		    uint64_t lba, uint32_t lba_count)
+{
+	struct spdk_bs_request_set	*set = (struct spdk_bs_request_set *)batch;
+	struct spdk_bs_channel		*channel = set->channel;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB_RW, "Reading %u blocks from LBA %lu\n", lba_count, lba);
+
+	set->u.batch.outstanding_ops++;
+	channel->dev->readv(channel->dev, channel->dev_channel, iov, iovcnt, lba, lba_count,
+			    &set->cb_args);
+}
+
+void
+spdk_bs_batch_writev(spdk_bs_batch_t *batch, struct iovec *iov, int iovcnt,
+		     uint64_t lba, uint32_t lba_count)
+{
+	struct spdk_bs_request_set	*set = (struct spdk_bs_request_set *)batch;
+	struct spdk_bs_channel		*channel = set->channel;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB_RW, "Writing %u blocks to LBA %lu\n", lba_count, lba);
+
+	set->u.batch.outstanding_ops++;
+	channel->dev->writev(channel->dev, channel->dev_channel, iov, iovcnt, lba, lba_count,
+			     &set->cb_args);
+}
+
 void
 spdk_bs_batch_flush(spdk_bs_batch_t *batch)
 {
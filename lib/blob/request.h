@@ -100,6 +100,13 @@ struct spdk_bs_cpl {
 typedef void (*spdk_bs_sequence_cpl)(spdk_bs_sequence_t *sequence,
 				     void *cb_arg, int bserrno);
 
+/*
+ * Number of iovs each request set carries for splitting a vectored blob I/O into
+ *  per-cluster child I/O.  Larger splits allocate an iov array that stays with
+ *  the request set for reuse.
+ */
+#define SPDK_BS_REQUEST_SET_IOV_COUNT	16
+
 /* A generic request set. Can be a sequence or a batch. */
 struct spdk_bs_request_set {
 	struct spdk_bs_cpl      cpl;
@@ -124,11 +131,24 @@ struct spdk_bs_request_set {
 		} batch;
 	} u;
 
+	struct iovec			iov[SPDK_BS_REQUEST_SET_IOV_COUNT];
+	struct iovec			*iov_mem;
+	int				iov_mem_count;
+
 	TAILQ_ENTRY(spdk_bs_request_set) link;
 };
 
 void spdk_bs_call_cpl(struct spdk_bs_cpl *cpl, int bserrno);
 
+/* Add count request sets to the channel's pool */
+int spdk_bs_channel_add_reqs(struct spdk_bs_channel *channel, uint32_t count);
+
+/* Free the request sets and everything else allocated in chunks for the channel */
+void spdk_bs_channel_free_chunks(struct spdk_bs_channel *channel);
+
+/* Implemented in blobstore.c. Resubmits I/O that waited for a request set. */
+void spdk_bs_channel_resume_io(struct spdk_bs_channel *channel);
+
 spdk_bs_sequence_t *spdk_bs_sequence_start(struct spdk_io_channel *channel,
 		struct spdk_bs_cpl *cpl);
 
@@ -170,6 +190,12 @@ void spdk_bs_batch_read(spdk_bs_batch_t *batch, void *payload,
 void spdk_bs_batch_write(spdk_bs_batch_t *batch, void *payload,
 			 uint64_t lba, uint32_t lba_count);
 
+void spdk_bs_batch_readv(spdk_bs_batch_t *batch, struct iovec *iov, int iovcnt,
+			 uint64_t lba, uint32_t lba_count);
+
+void spdk_bs_batch_writev(spdk_bs_batch_t *batch, struct iovec *iov, int iovcnt,
+			  uint64_t lba, uint32_t lba_count);
+
 void spdk_bs_batch_flush(spdk_bs_batch_t *batch);
 
 void spdk_bs_batch_unmap(spdk_bs_batch_t *batch,
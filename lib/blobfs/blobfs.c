@@ -52,12 +52,51 @@
 
 #define BLOBFS_CACHE_SIZE (4ULL * 1024 * 1024 * 1024)
 
+#define CACHE_SHARD_COUNT	16
+
+/*
+ * Cache buffers are spread across shards by file and offset, each with its own lock and
+ *  one CLOCK list per file priority.  Buffers of low priority files are evicted first.
+ */
+struct cache_shard {
+	pthread_spinlock_t		lock;
+	TAILQ_HEAD(, cache_buffer)	buffers[SPDK_FILE_PRIORITY_HIGH + 1];
+	uint64_t			num_buffers[SPDK_FILE_PRIORITY_HIGH + 1];
+	uint64_t			hits;
+	uint64_t			misses;
+	uint64_t			evictions;
+	uint64_t			readahead_buffers;
+	uint64_t			readahead_hits;
+} __attribute__((aligned(64)));
+
+#define CACHE_MAX_POOLS		64
+#define CACHE_MAX_CPUS		1024
+
+/*
+ * Cache memory comes from one pool per NUMA socket of the SPDK cores, and buffers are
+ *  taken from the pools of the socket the caller runs on first.  Growing the cache adds
+ *  another set of pools.  Pools are only freed with the cache.
+ */
+struct cache_pool {
+	struct spdk_mempool	*mempool;
+	int32_t			socket_id;
+};
+
 static uint64_t g_fs_cache_size = BLOBFS_CACHE_SIZE;
-static struct spdk_mempool *g_cache_pool;
-static TAILQ_HEAD(, spdk_file) g_caches;
+static struct cache_pool g_cache_pools[CACHE_MAX_POOLS];
+static uint32_t g_cache_pool_count;
+static uint64_t g_cache_pool_buffers;
+/* Number of buffers the cache may hold, at most g_cache_pool_buffers */
+static uint64_t g_cache_max_buffers;
+/* Socket of each SPDK core, SPDK_ENV_SOCKET_ID_ANY for cores not in use */
+static int32_t g_cache_core_sockets[CACHE_MAX_CPUS];
+/* NUMA node of each OS CPU, for threads that do not run on an SPDK core */
+static int32_t g_cache_os_cpu_sockets[CACHE_MAX_CPUS];
+static struct cache_shard g_cache_shards[CACHE_SHARD_COUNT];
+/* Buffers filled by readahead that have not been read yet, across all files */
+static uint64_t g_readahead_buffers;
 static int g_fs_count = 0;
 static pthread_mutex_t g_cache_init_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_spinlock_t g_caches_lock;
 
 static void
 __sem_post(void *arg, int bserrno)
@@ -70,24 +109,91 @@ __sem_post(void *arg, int bserrno)
 void
 spdk_cache_buffer_free(struct cache_buffer *cache_buffer)
 {
-	spdk_mempool_put(g_cache_pool, cache_buffer->buf);
+	struct cache_shard *shard = cache_buffer->shard;
+
+	if (shard != NULL) {
+		pthread_spin_lock(&shard->lock);
+		TAILQ_REMOVE(&shard->buffers[cache_buffer->priority], cache_buffer, lru_tailq);
+		shard->num_buffers[cache_buffer->priority]--;
+		pthread_spin_unlock(&shard->lock);
+	}
+
+	if (cache_buffer->readahead) {
+		__atomic_fetch_sub(&g_readahead_buffers, 1, __ATOMIC_RELAXED);
+	}
+
+	/* Evicted buffers hand their memory straight to the new buffer */
+	if (cache_buffer->buf != NULL) {
+		spdk_mempool_put(cache_buffer->pool->mempool, cache_buffer->buf);
+	}
 	free(cache_buffer);
 }
 
 #define CACHE_READAHEAD_THRESHOLD	(128 * 1024)
+#define CACHE_READAHEAD_MIN		(2 * CACHE_BUFFER_SIZE)
+#define CACHE_READAHEAD_FILE_MAX	(4 * 1024 * 1024)
+
+static uint64_t g_readahead_file_max = CACHE_READAHEAD_FILE_MAX;
+/* 0 limits the buffers read ahead and not yet read to a quarter of the cache */
+static uint64_t g_readahead_total_max = 0;
+
+/* Largest number of bytes a blob grows by at once when it is appended to */
+#define FILE_PREALLOC_MAX_STEP		(64ULL * 1024 * 1024)
+
+/* Entry of a hashed index of file or directory names */
+struct fs_name_entry {
+	const char			*name;
+	size_t				len;
+	uint32_t			hash;
+	LIST_ENTRY(fs_name_entry)	link;
+};
+
+struct fs_name_index {
+	LIST_HEAD(, fs_name_entry)	*buckets;
+	uint32_t			num_buckets;
+	uint32_t			count;
+};
+
+#define FS_NAME_INDEX_MIN_BUCKETS	64
+
+/*
+ * Directory of files whose names share the path before their last '/'.  Directories
+ *  only exist while they hold files or other directories, so they are not persisted -
+ *  loading the filesystem rebuilds them from the file names.
+ */
+struct spdk_fs_dir {
+	char				*name;
+	struct fs_name_entry		name_entry;
+	struct spdk_fs_dir		*parent;
+	TAILQ_HEAD(, spdk_file)		files;
+	TAILQ_HEAD(, spdk_fs_dir)	subdirs;
+	TAILQ_ENTRY(spdk_fs_dir)	tailq;
+};
 
 struct spdk_file {
 	struct spdk_filesystem	*fs;
 	struct spdk_blob	*blob;
 	char			*name;
+	struct fs_name_entry	name_entry;
+	struct spdk_fs_dir	*dir;
+	TAILQ_ENTRY(spdk_file)	dir_tailq;
 	uint64_t		length;
 	bool                    is_deleted;
 	bool			open_for_writing;
 	uint64_t		length_flushed;
+	/* Length stored in the "length" xattr, and the one being stored by a pending md sync */
+	uint64_t		length_xattr;
+	uint64_t		length_syncing;
+	bool			sync_md_in_progress;
+	/* Error of a failed flush, reported to the sync requests waiting for it */
+	int			flush_error;
 	uint64_t		append_pos;
 	uint64_t		seq_byte_count;
 	uint64_t		next_seq_offset;
 	uint32_t		priority;
+	uint32_t		access_hint;
+	/* Opened with SPDK_BLOBFS_OPEN_DIRECT - bypass the cache until the last close */
+	bool			direct;
 	TAILQ_ENTRY(spdk_file)	tailq;
 	spdk_blob_id		blobid;
 	uint32_t		ref_count;
@@ -96,7 +202,6 @@ struct spdk_file {
 	struct cache_tree	*tree;
 	TAILQ_HEAD(open_requests_head, spdk_fs_request) open_requests;
 	TAILQ_HEAD(sync_requests_head, spdk_fs_request) sync_requests;
-	TAILQ_ENTRY(spdk_file)	cache_tailq;
 };
 
 struct spdk_deleted_file {
@@ -107,6 +212,9 @@ struct spdk_deleted_file {
 struct spdk_filesystem {
 	struct spdk_blob_store	*bs;
 	TAILQ_HEAD(, spdk_file)	files;
+	struct fs_name_index	file_index;
+	struct fs_name_index	dir_index;
+	struct spdk_fs_dir	*root;
 	struct spdk_bs_opts	bs_opts;
 	struct spdk_bs_dev	*bdev;
 	fs_send_request_fn	send_request;
@@ -126,6 +234,14 @@ struct spdk_filesystem {
 	struct {
 		uint32_t		max_ops;
 	} io_target;
+
+	/* Threads the data path requests of files are spread across, see spdk_fs_set_io_threads */
+	struct {
+		uint32_t		count;
+		fs_send_io_request_fn	send_request;
+		/* Sync target channel of each thread, got there on its first request */
+		struct spdk_io_channel	**channels;
+	} io_threads;
 };
 
 struct spdk_fs_cb_args {
@@ -151,13 +267,15 @@ struct spdk_fs_cb_args {
 		} truncate;
 		struct {
 			struct spdk_io_channel	*channel;
-			void		*user_buf;
+			struct iovec	*iovs;
+			int		iovcnt;
+			struct iovec	iov;
 			void		*pin_buf;
 			int		is_read;
 			off_t		offset;
 			size_t		length;
-			uint64_t	start_page;
-			uint64_t	num_pages;
+			uint64_t	start_io_unit;
+			uint64_t	num_io_units;
 			uint32_t	blocklen;
 		} rw;
 		struct {
@@ -176,10 +294,10 @@ struct spdk_fs_cb_args {
 		struct {
 			uint64_t			offset;
 			TAILQ_ENTRY(spdk_fs_request)	tailq;
-			bool				xattr_in_progress;
 		} sync;
 		struct {
 			uint32_t			num_clusters;
+			uint32_t			min_clusters;
 		} resize;
 		struct {
 			const char	*name;
@@ -195,32 +313,141 @@ struct spdk_fs_cb_args {
 		struct {
 			const char	*name;
 		} stat;
+		struct {
+			const char		*name;
+			spdk_fs_dir_entry_fn	fn;
+			void			*ctx;
+		} read_dir;
 	} op;
 };
 
 static void cache_free_buffers(struct spdk_file *file);
 
+static bool
+__cache_add_pool(uint64_t num_buffers, int32_t socket_id)
+{
+	struct cache_pool *pool = &g_cache_pools[g_cache_pool_count];
+	char name[32];
+
+	snprintf(name, sizeof(name), "spdk_fs_cache_%u", g_cache_pool_count);
+	pool->mempool = spdk_mempool_create(name, num_buffers, CACHE_BUFFER_SIZE,
+					    SPDK_MEMPOOL_DEFAULT_CACHE_SIZE, socket_id);
+	if (pool->mempool == NULL && socket_id != SPDK_ENV_SOCKET_ID_ANY) {
+		SPDK_NOTICELOG("no memory for %ju cache buffers on socket %d, using any socket\n",
+			       num_buffers, socket_id);
+		socket_id = SPDK_ENV_SOCKET_ID_ANY;
+		pool->mempool = spdk_mempool_create(name, num_buffers, CACHE_BUFFER_SIZE,
+						    SPDK_MEMPOOL_DEFAULT_CACHE_SIZE, socket_id);
+	}
+	if (pool->mempool == NULL) {
+		SPDK_ERRLOG("could not allocate %ju cache buffers\n", num_buffers);
+		return false;
+	}
+
+	pool->socket_id = socket_id;
+	/* Allocations walk the pools without a lock */
+	__atomic_store_n(&g_cache_pool_count, g_cache_pool_count + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * Add num_buffers to the cache memory, split evenly across the sockets of the SPDK cores.
+ *  Returns the number of buffers added.  Called with g_cache_init_lock held.
+ */
+static uint64_t
+__cache_add_pools(uint64_t num_buffers)
+{
+	int32_t sockets[CACHE_MAX_POOLS];
+	uint32_t core, num_sockets = 0, i;
+	uint64_t count, added = 0;
+	int32_t socket_id;
+
+	SPDK_ENV_FOREACH_CORE(core) {
+		socket_id = spdk_env_get_socket_id(core);
+		if (core < CACHE_MAX_CPUS) {
+			g_cache_core_sockets[core] = socket_id;
+		}
+		for (i = 0; i < num_sockets && sockets[i] != socket_id; i++) {
+		}
+		if (i == num_sockets && num_sockets < CACHE_MAX_POOLS) {
+			sockets[num_sockets++] = socket_id;
+		}
+	}
+	if (num_sockets == 0) {
+		sockets[num_sockets++] = SPDK_ENV_SOCKET_ID_ANY;
+	}
+
+	for (i = 0; i < num_sockets && g_cache_pool_count < CACHE_MAX_POOLS; i++) {
+		count = num_buffers / num_sockets + (i < num_buffers % num_sockets ? 1 : 0);
+		if (count > 0 && __cache_add_pool(count, sockets[i])) {
+			added += count;
+		}
+	}
+
+	return added;
+}
+
+static int32_t
+__cache_local_socket(void)
+{
+	uint32_t core;
+	int cpu;
+
+	core = spdk_env_get_current_core();
+	if (core != UINT32_MAX) {
+		return core < CACHE_MAX_CPUS ? g_cache_core_sockets[core] : SPDK_ENV_SOCKET_ID_ANY;
+	}
+
+	/* Threads of the sync API run outside of the SPDK cores */
+	cpu = sched_getcpu();
+	return (cpu >= 0 && cpu < CACHE_MAX_CPUS) ? g_cache_os_cpu_sockets[cpu] : SPDK_ENV_SOCKET_ID_ANY;
+}
+
 static void
 __initialize_cache(void)
 {
-	assert(g_cache_pool == NULL);
+	struct cache_shard *shard;
+	uint32_t i, priority;
+	long num_cpus;
+
+	assert(g_cache_pool_count == 0);
 
-	g_cache_pool = spdk_mempool_create("spdk_fs_cache",
-					   g_fs_cache_size / CACHE_BUFFER_SIZE,
-					   CACHE_BUFFER_SIZE,
-					   SPDK_MEMPOOL_DEFAULT_CACHE_SIZE,
-					   SPDK_ENV_SOCKET_ID_ANY);
-	TAILQ_INIT(&g_caches);
-	pthread_spin_init(&g_caches_lock, 0);
+	/*
+	 * SPDK core numbers need not match OS CPU numbers, so the sockets of the OS CPUs
+	 *  are looked up separately, once, instead of on every buffer allocation.
+	 */
+	num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	for (i = 0; i < CACHE_MAX_CPUS; i++) {
+		g_cache_core_sockets[i] = SPDK_ENV_SOCKET_ID_ANY;
+		g_cache_os_cpu_sockets[i] = (long)i < num_cpus ? spdk_env_get_socket_id_of_cpu(i) :
+					    SPDK_ENV_SOCKET_ID_ANY;
+	}
+	g_cache_pool_buffers = __cache_add_pools(g_fs_cache_size / CACHE_BUFFER_SIZE);
+	g_cache_max_buffers = g_cache_pool_buffers;
+
+	for (i = 0; i < CACHE_SHARD_COUNT; i++) {
+		shard = &g_cache_shards[i];
+		memset(shard, 0, sizeof(*shard));
+		pthread_spin_init(&shard->lock, 0);
+		for (priority = SPDK_FILE_PRIORITY_LOW; priority <= SPDK_FILE_PRIORITY_HIGH; priority++) {
+			TAILQ_INIT(&shard->buffers[priority]);
+		}
+	}
 }
 
 static void
 __free_cache(void)
 {
-	assert(g_cache_pool != NULL);
+	uint32_t i;
+
+	assert(g_cache_pool_count > 0);
 
-	spdk_mempool_free(g_cache_pool);
-	g_cache_pool = NULL;
+	for (i = 0; i < g_cache_pool_count; i++) {
+		spdk_mempool_free(g_cache_pools[i].mempool);
+		g_cache_pools[i].mempool = NULL;
+	}
+	g_cache_pool_count = 0;
+	g_cache_pool_buffers = 0;
 }
 
 static uint64_t
@@ -366,6 +593,82 @@ __send_request_direct(fs_request_fn fn, void *arg)
 	fn(arg);
 }
 
+static uint32_t
+__file_io_thread(struct spdk_file *file)
+{
+	/* All of a file's data path requests go to one thread, so they stay in order */
+	return file->blobid % file->fs->io_threads.count;
+}
+
+/*
+ * Send a data path request of a file to its I/O thread, or through send_request when
+ *  the filesystem has no I/O threads.
+ */
+static void
+__file_send_io_request(struct spdk_file *file, fs_send_request_fn send_request,
+		       fs_request_fn fn, void *arg)
+{
+	struct spdk_filesystem *fs = file->fs;
+
+	if (fs->io_threads.count == 0) {
+		send_request(fn, arg);
+		return;
+	}
+
+	fs->io_threads.send_request(__file_io_thread(file), fn, arg);
+}
+
+/* Must be called from the thread the data path requests of the file are sent to */
+static struct spdk_io_channel *
+__file_io_channel(struct spdk_file *file)
+{
+	struct spdk_filesystem	*fs = file->fs;
+	struct spdk_io_channel	**channel;
+	struct spdk_fs_channel	*fs_channel;
+
+	if (fs->io_threads.count == 0) {
+		return fs->sync_target.sync_io_channel;
+	}
+
+	channel = &fs->io_threads.channels[__file_io_thread(file)];
+	if (*channel != NULL) {
+		return *channel;
+	}
+
+	*channel = spdk_get_io_channel(&fs->sync_target);
+	if (*channel == NULL) {
+		return NULL;
+	}
+
+	/* The metadata thread may be one of the I/O threads and already have this set up */
+	fs_channel = spdk_io_channel_get_ctx(*channel);
+	if (fs_channel->bs_channel == NULL) {
+		fs_channel->bs_channel = spdk_bs_alloc_io_channel(fs->bs);
+		fs_channel->send_request = __send_request_direct;
+		if (fs_channel->bs_channel == NULL) {
+			spdk_put_io_channel(*channel);
+			*channel = NULL;
+		}
+	}
+
+	return *channel;
+}
+
+static struct spdk_io_channel *
+__file_io_bs_channel(struct spdk_file *file)
+{
+	struct spdk_io_channel *channel = __file_io_channel(file);
+	struct spdk_fs_channel *fs_channel;
+
+	if (channel == NULL) {
+		SPDK_ERRLOG("could not get an I/O channel for %s\n", file->name);
+		return NULL;
+	}
+
+	fs_channel = spdk_io_channel_get_ctx(channel);
+	return fs_channel->bs_channel;
+}
+
 static void
 common_fs_bs_init(struct spdk_filesystem *fs, struct spdk_blob_store *bs)
 {
@@ -518,6 +821,8 @@ file_alloc(struct spdk_filesystem *fs)
 }
 
 static void iter_delete_cb(void *ctx, int bserrno);
+static int fs_file_add_name(struct spdk_file *file);
+static void fs_free_names(struct spdk_filesystem *fs);
 
 static int
 _handle_deleted_files(struct spdk_fs_request *req)
@@ -608,9 +913,15 @@ iter_cb(void *ctx, struct spdk_blob *blob, int rc)
 		}
 
 		f->name = strdup(name);
+		if (f->name == NULL || fs_file_add_name(f) != 0) {
+			args->fn.fs_op_with_handle(args->arg, fs, -ENOMEM);
+			free_fs_request(req);
+			return;
+		}
 		f->blobid = spdk_blob_get_id(blob);
 		f->length = *length;
 		f->length_flushed = *length;
+		f->length_xattr = *length;
 		f->append_pos = *length;
 		SPDK_DEBUGLOG(SPDK_LOG_BLOBFS, "added file %s length=%ju\n", f->name, f->length);
 	} else {
@@ -721,6 +1032,8 @@ unload_cb(void *ctx, int bserrno)
 	args->fn.fs_op(args->arg, bserrno);
 	free(req);
 
+	fs_free_names(fs);
+	free(fs->io_threads.channels);
 	spdk_io_device_unregister(&fs->io_target, NULL);
 	spdk_io_device_unregister(&fs->sync_target, NULL);
 	spdk_io_device_unregister(&fs->md_target, NULL);
@@ -733,6 +1046,7 @@ spdk_fs_unload(struct spdk_filesystem *fs, spdk_fs_op_complete cb_fn, void *cb_a
 {
 	struct spdk_fs_request *req;
 	struct spdk_fs_cb_args *args;
+	uint32_t i;
 
 	/*
 	 * We must free the md_channel before unloading the blobstore, so just
@@ -749,25 +1063,330 @@ spdk_fs_unload(struct spdk_filesystem *fs, spdk_fs_op_complete cb_fn, void *cb_a
 	args->arg = cb_arg;
 	args->fs = fs;
 
+	for (i = 0; i < fs->io_threads.count; i++) {
+		if (fs->io_threads.channels[i] != NULL) {
+			/* Released on the I/O thread that got it */
+			spdk_fs_free_io_channel(fs->io_threads.channels[i]);
+		}
+	}
 	spdk_fs_free_io_channel(fs->md_target.md_io_channel);
 	spdk_fs_free_io_channel(fs->sync_target.sync_io_channel);
 	spdk_bs_unload(fs->bs, unload_cb, req);
 }
 
+/* START name index */
+
+static uint32_t
+fs_name_hash(const char *name, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void
+fs_name_index_grow(struct fs_name_index *index)
+{
+	LIST_HEAD(, fs_name_entry) *buckets;
+	struct fs_name_entry *entry;
+	uint32_t num_buckets, i;
+
+	num_buckets = spdk_max(index->num_buckets * 2, FS_NAME_INDEX_MIN_BUCKETS);
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	if (buckets == NULL) {
+		/* Keep using the current buckets, just with longer chains */
+		return;
+	}
+
+	for (i = 0; i < index->num_buckets; i++) {
+		while ((entry = LIST_FIRST(&index->buckets[i])) != NULL) {
+			LIST_REMOVE(entry, link);
+			LIST_INSERT_HEAD(&buckets[entry->hash & (num_buckets - 1)], entry, link);
+		}
+	}
+
+	free(index->buckets);
+	index->buckets = (void *)buckets;
+	index->num_buckets = num_buckets;
+}
+
+static int
+fs_name_index_insert(struct fs_name_index *index, struct fs_name_entry *entry,
+		     const char *name, size_t len)
+{
+	if (index->count >= index->num_buckets) {
+		fs_name_index_grow(index);
+		if (index->num_buckets == 0) {
+			return -ENOMEM;
+		}
+	}
+
+	entry->name = name;
+	entry->len = len;
+	entry->hash = fs_name_hash(name, len);
+	LIST_INSERT_HEAD(&index->buckets[entry->hash & (index->num_buckets - 1)], entry, link);
+	index->count++;
+
+	return 0;
+}
+
+static void
+fs_name_index_remove(struct fs_name_index *index, struct fs_name_entry *entry)
+{
+	LIST_REMOVE(entry, link);
+	index->count--;
+}
+
+static struct fs_name_entry *
+fs_name_index_find(struct fs_name_index *index, const char *name, size_t len)
+{
+	struct fs_name_entry *entry;
+	uint32_t hash;
+
+	if (index->num_buckets == 0) {
+		return NULL;
+	}
+
+	hash = fs_name_hash(name, len);
+	LIST_FOREACH(entry, &index->buckets[hash & (index->num_buckets - 1)], link) {
+		if (entry->hash == hash && entry->len == len && !memcmp(entry->name, name, len)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
 static struct spdk_file *
 fs_find_file(struct spdk_filesystem *fs, const char *name)
 {
+	struct fs_name_entry *entry;
+
+	entry = fs_name_index_find(&fs->file_index, name, strnlen(name, SPDK_FILE_NAME_MAX));
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	return SPDK_CONTAINEROF(entry, struct spdk_file, name_entry);
+}
+
+/* Length of the directory part of a path, the part before its last '/' */
+static size_t
+fs_dir_name_len(const char *name, size_t len)
+{
+	while (len > 0 && name[len - 1] != '/') {
+		len--;
+	}
+
+	return len > 0 ? len - 1 : 0;
+}
+
+static const char *
+fs_base_name(const char *name, size_t len)
+{
+	size_t dir_len = fs_dir_name_len(name, len);
+
+	return dir_len > 0 || name[0] == '/' ? &name[dir_len + 1] : name;
+}
+
+static struct spdk_fs_dir *
+fs_find_dir(struct spdk_filesystem *fs, const char *name, size_t len)
+{
+	struct fs_name_entry *entry;
+
+	if (len == 0) {
+		return fs->root;
+	}
+
+	entry = fs_name_index_find(&fs->dir_index, name, len);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	return SPDK_CONTAINEROF(entry, struct spdk_fs_dir, name_entry);
+}
+
+static struct spdk_fs_dir *
+fs_dir_alloc(const char *name, size_t len)
+{
+	struct spdk_fs_dir *dir;
+
+	dir = calloc(1, sizeof(*dir));
+	if (dir == NULL) {
+		return NULL;
+	}
+
+	dir->name = strndup(name, len);
+	if (dir->name == NULL) {
+		free(dir);
+		return NULL;
+	}
+
+	TAILQ_INIT(&dir->files);
+	TAILQ_INIT(&dir->subdirs);
+	return dir;
+}
+
+static void
+fs_dir_put(struct spdk_filesystem *fs, struct spdk_fs_dir *dir)
+{
+	struct spdk_fs_dir *parent;
+
+	/* Free directories once their last entry is gone, except for the root */
+	while (dir->parent != NULL && TAILQ_EMPTY(&dir->files) && TAILQ_EMPTY(&dir->subdirs)) {
+		parent = dir->parent;
+		TAILQ_REMOVE(&parent->subdirs, dir, tailq);
+		fs_name_index_remove(&fs->dir_index, &dir->name_entry);
+		free(dir->name);
+		free(dir);
+		dir = parent;
+	}
+}
+
+/* Get the directory with the given path, adding it and its parents if they do not exist */
+static struct spdk_fs_dir *
+fs_dir_get(struct spdk_filesystem *fs, const char *name, size_t len)
+{
+	struct spdk_fs_dir *dir, *parent;
+
+	if (fs->root == NULL) {
+		fs->root = fs_dir_alloc("", 0);
+		if (fs->root == NULL) {
+			return NULL;
+		}
+	}
+
+	dir = fs_find_dir(fs, name, len);
+	if (dir != NULL) {
+		return dir;
+	}
+
+	parent = fs_dir_get(fs, name, fs_dir_name_len(name, len));
+	if (parent == NULL) {
+		return NULL;
+	}
+
+	dir = fs_dir_alloc(name, len);
+	if (dir == NULL) {
+		fs_dir_put(fs, parent);
+		return NULL;
+	}
+
+	if (fs_name_index_insert(&fs->dir_index, &dir->name_entry, dir->name, len) != 0) {
+		free(dir->name);
+		free(dir);
+		fs_dir_put(fs, parent);
+		return NULL;
+	}
+
+	dir->parent = parent;
+	TAILQ_INSERT_TAIL(&parent->subdirs, dir, tailq);
+	return dir;
+}
+
+/* Add the name of a file to the index and to its directory */
+static int
+fs_file_add_name(struct spdk_file *file)
+{
+	struct spdk_filesystem *fs = file->fs;
+	size_t len;
+	int rc;
+
+	len = strlen(file->name);
+	file->dir = fs_dir_get(fs, file->name, fs_dir_name_len(file->name, len));
+	if (file->dir == NULL) {
+		return -ENOMEM;
+	}
+
+	rc = fs_name_index_insert(&fs->file_index, &file->name_entry, file->name, len);
+	if (rc != 0) {
+		fs_dir_put(fs, file->dir);
+		file->dir = NULL;
+		return rc;
+	}
+
+	TAILQ_INSERT_TAIL(&file->dir->files, file, dir_tailq);
+	return 0;
+}
+
+static void
+fs_file_remove_name(struct spdk_file *file)
+{
+	struct spdk_filesystem *fs = file->fs;
+
+	if (file->dir == NULL) {
+		return;
+	}
+
+	fs_name_index_remove(&fs->file_index, &file->name_entry);
+	TAILQ_REMOVE(&file->dir->files, file, dir_tailq);
+	fs_dir_put(fs, file->dir);
+	file->dir = NULL;
+}
+
+static void
+fs_free_names(struct spdk_filesystem *fs)
+{
+	struct fs_name_entry *entry;
+	struct spdk_fs_dir *dir;
+	uint32_t i;
+
+	/* Files are not freed on unload, only the directories and the buckets */
+	for (i = 0; i < fs->dir_index.num_buckets; i++) {
+		while ((entry = LIST_FIRST(&fs->dir_index.buckets[i])) != NULL) {
+			LIST_REMOVE(entry, link);
+			dir = SPDK_CONTAINEROF(entry, struct spdk_fs_dir, name_entry);
+			free(dir->name);
+			free(dir);
+		}
+	}
+	if (fs->root != NULL) {
+		free(fs->root->name);
+		free(fs->root);
+	}
+	free(fs->dir_index.buckets);
+	free(fs->file_index.buckets);
+}
+
+static int
+fs_read_dir(struct spdk_filesystem *fs, const char *name, spdk_fs_dir_entry_fn fn, void *ctx)
+{
+	struct spdk_fs_dir *dir, *subdir;
 	struct spdk_file *file;
+	size_t len;
+
+	len = strnlen(name, SPDK_FILE_NAME_MAX);
+	while (len > 0 && name[len - 1] == '/') {
+		len--;
+	}
 
-	TAILQ_FOREACH(file, &fs->files, tailq) {
-		if (!strncmp(name, file->name, SPDK_FILE_NAME_MAX)) {
-			return file;
+	dir = fs_find_dir(fs, name, len);
+	if (dir == NULL) {
+		return -ENOENT;
+	}
+
+	/* Entries are named by the part of their path after the last '/' */
+	TAILQ_FOREACH(subdir, &dir->subdirs, tailq) {
+		fn(ctx, fs_base_name(subdir->name, subdir->name_entry.len), true);
+	}
+	TAILQ_FOREACH(file, &dir->files, dir_tailq) {
+		if (!file->is_deleted) {
+			fn(ctx, fs_base_name(file->name, file->name_entry.len), false);
 		}
 	}
 
-	return NULL;
+	return 0;
 }
 
+/* END name index */
+
 void
 spdk_fs_file_stat_async(struct spdk_filesystem *fs, const char *name,
 			spdk_file_stat_op_complete cb_fn, void *cb_arg)
@@ -840,19 +1459,57 @@ spdk_fs_file_stat(struct spdk_filesystem *fs, struct spdk_io_channel *_channel,
 }
 
 static void
-fs_create_blob_close_cb(void *ctx, int bserrno)
+__fs_read_dir(void *arg)
 {
-	struct spdk_fs_request *req = ctx;
+	struct spdk_fs_request *req = arg;
 	struct spdk_fs_cb_args *args = &req->args;
 
-	args->fn.file_op(args->arg, bserrno);
-	free_fs_request(req);
+	args->rc = fs_read_dir(args->fs, args->op.read_dir.name, args->op.read_dir.fn,
+			       args->op.read_dir.ctx);
+	sem_post(args->sem);
 }
 
-static void
-fs_create_blob_open_cb(void *ctx, struct spdk_blob *blob, int bserrno)
+int
+spdk_fs_read_dir(struct spdk_filesystem *fs, struct spdk_io_channel *_channel,
+		 const char *name, spdk_fs_dir_entry_fn fn, void *ctx)
 {
-	struct spdk_fs_request *req = ctx;
+	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	struct spdk_fs_request *req;
+	int rc;
+
+	req = alloc_fs_request(channel);
+	if (req == NULL) {
+		return -ENOMEM;
+	}
+
+	req->args.fs = fs;
+	req->args.op.read_dir.name = name;
+	req->args.op.read_dir.fn = fn;
+	req->args.op.read_dir.ctx = ctx;
+	req->args.sem = &channel->sem;
+	channel->send_request(__fs_read_dir, req);
+	sem_wait(&channel->sem);
+
+	rc = req->args.rc;
+	free_fs_request(req);
+
+	return rc;
+}
+
+static void
+fs_create_blob_close_cb(void *ctx, int bserrno)
+{
+	struct spdk_fs_request *req = ctx;
+	struct spdk_fs_cb_args *args = &req->args;
+
+	args->fn.file_op(args->arg, bserrno);
+	free_fs_request(req);
+}
+
+static void
+fs_create_blob_open_cb(void *ctx, struct spdk_blob *blob, int bserrno)
+{
+	struct spdk_fs_request *req = ctx;
 	struct spdk_fs_cb_args *args = &req->args;
 	struct spdk_file *f = args->file;
 	uint64_t length = 0;
@@ -912,6 +1569,15 @@ spdk_fs_create_file_async(struct spdk_filesystem *fs, const char *name,
 	args->arg = cb_arg;
 
 	file->name = strdup(name);
+	if (file->name == NULL || fs_file_add_name(file) != 0) {
+		TAILQ_REMOVE(&fs->files, file, tailq);
+		free(file->name);
+		free(file->tree);
+		free(file);
+		free_fs_request(req);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
 	spdk_bs_create_blob(fs->bs, fs_create_blob_create_cb, args);
 }
 
@@ -998,6 +1664,9 @@ fs_open_blob_create_cb(void *ctx, int bserrno)
 	}
 
 	file->ref_count++;
+	if (args->op.open.flags & SPDK_BLOBFS_OPEN_DIRECT) {
+		file->direct = true;
+	}
 	TAILQ_INSERT_TAIL(&file->open_requests, req, args.op.open.tailq);
 	if (file->ref_count == 1) {
 		assert(file->blob == NULL);
@@ -1049,6 +1718,7 @@ spdk_fs_open_file_async(struct spdk_filesystem *fs, const char *name, uint32_t f
 	args->file = f;
 	args->fs = fs;
 	args->op.open.name = name;
+	args->op.open.flags = flags;
 
 	if (f == NULL) {
 		spdk_fs_create_file_async(fs, name, fs_open_blob_create_cb, req);
@@ -1138,6 +1808,7 @@ __spdk_fs_md_rename_file(struct spdk_fs_request *req)
 {
 	struct spdk_fs_cb_args *args = &req->args;
 	struct spdk_file *f;
+	char *old_name;
 
 	f = fs_find_file(args->fs, args->op.rename.old_name);
 	if (f == NULL) {
@@ -1146,8 +1817,26 @@ __spdk_fs_md_rename_file(struct spdk_fs_request *req)
 		return;
 	}
 
-	free(f->name);
+	old_name = f->name;
 	f->name = strdup(args->op.rename.new_name);
+	if (f->name == NULL) {
+		f->name = old_name;
+		args->fn.fs_op(args->arg, -ENOMEM);
+		free_fs_request(req);
+		return;
+	}
+
+	/* Move the file to the directory of its new name */
+	fs_file_remove_name(f);
+	if (fs_file_add_name(f) != 0) {
+		free(f->name);
+		f->name = old_name;
+		fs_file_add_name(f);
+		args->fn.fs_op(args->arg, -ENOMEM);
+		free_fs_request(req);
+		return;
+	}
+	free(old_name);
 	args->file = f;
 	spdk_bs_open_blob(args->fs->bs, f->blobid, fs_rename_blob_open_cb, req);
 }
@@ -1294,6 +1983,7 @@ spdk_fs_delete_file_async(struct spdk_filesystem *fs, const char *name,
 		return;
 	}
 
+	fs_file_remove_name(f);
 	TAILQ_REMOVE(&fs->files, f, tailq);
 
 	cache_free_buffers(f);
@@ -1435,6 +2125,7 @@ spdk_file_truncate_async(struct spdk_file *file, uint64_t length,
 	spdk_blob_set_xattr(file->blob, "length", &length, sizeof(length));
 
 	file->length = length;
+	file->length_xattr = length;
 	if (file->append_pos > file->length) {
 		file->append_pos = file->length;
 	}
@@ -1475,6 +2166,51 @@ spdk_file_truncate(struct spdk_file *file, struct spdk_io_channel *_channel,
 	free_fs_request(req);
 }
 
+static void
+__copy_iovs(struct iovec *iovs, int iovcnt, uint8_t *buf, size_t length, bool to_iovs)
+{
+	size_t copy;
+	int i;
+
+	for (i = 0; i < iovcnt && length > 0; i++) {
+		copy = spdk_min(iovs[i].iov_len, length);
+		if (to_iovs) {
+			memcpy(iovs[i].iov_base, buf, copy);
+		} else {
+			memcpy(buf, iovs[i].iov_base, copy);
+		}
+		buf += copy;
+		length -= copy;
+	}
+}
+
+/*
+ * Whether the blob I/O can use the caller's buffers directly - they must cover exactly
+ *  whole io units and be DMA-able memory.
+ */
+static bool
+__iovs_are_dma_aligned(struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
+		       uint32_t io_unit_size)
+{
+	uint64_t iovs_length = 0;
+	int i;
+
+	if (offset % io_unit_size != 0 || length % io_unit_size != 0) {
+		return false;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if ((uintptr_t)iovs[i].iov_base % io_unit_size != 0 ||
+		    iovs[i].iov_len % io_unit_size != 0 ||
+		    spdk_vtophys(iovs[i].iov_base) == SPDK_VTOPHYS_ERROR) {
+			return false;
+		}
+		iovs_length += iovs[i].iov_len;
+	}
+
+	return iovs_length == length;
+}
+
 static void
 __rw_done(void *ctx, int bserrno)
 {
@@ -1491,19 +2227,20 @@ __read_done(void *ctx, int bserrno)
 {
 	struct spdk_fs_request *req = ctx;
 	struct spdk_fs_cb_args *args = &req->args;
+	uint64_t io_unit_size = spdk_bs_get_io_unit_size(args->file->fs->bs);
 
 	if (args->op.rw.is_read) {
-		memcpy(args->op.rw.user_buf,
-		       args->op.rw.pin_buf + (args->op.rw.offset & 0xFFF),
-		       args->op.rw.length);
+		__copy_iovs(args->op.rw.iovs, args->op.rw.iovcnt,
+			    args->op.rw.pin_buf + (args->op.rw.offset % io_unit_size),
+			    args->op.rw.length, true);
 		__rw_done(req, 0);
 	} else {
-		memcpy(args->op.rw.pin_buf + (args->op.rw.offset & 0xFFF),
-		       args->op.rw.user_buf,
-		       args->op.rw.length);
+		__copy_iovs(args->op.rw.iovs, args->op.rw.iovcnt,
+			    args->op.rw.pin_buf + (args->op.rw.offset % io_unit_size),
+			    args->op.rw.length, false);
 		spdk_bs_io_write_blob(args->file->blob, args->op.rw.channel,
 				      args->op.rw.pin_buf,
-				      args->op.rw.start_page, args->op.rw.num_pages,
+				      args->op.rw.start_io_unit, args->op.rw.num_io_units,
 				      __rw_done, req);
 	}
 }
@@ -1514,34 +2251,50 @@ __do_blob_read(void *ctx, int fserrno)
 	struct spdk_fs_request *req = ctx;
 	struct spdk_fs_cb_args *args = &req->args;
 
+	if (args->op.rw.pin_buf == NULL) {
+		/* The caller's buffers are used directly, without a bounce buffer */
+		if (args->op.rw.is_read) {
+			spdk_bs_io_readv_blob(args->file->blob, args->op.rw.channel,
+					      args->op.rw.iovs, args->op.rw.iovcnt,
+					      args->op.rw.start_io_unit, args->op.rw.num_io_units,
+					      __rw_done, req);
+		} else {
+			spdk_bs_io_writev_blob(args->file->blob, args->op.rw.channel,
+					       args->op.rw.iovs, args->op.rw.iovcnt,
+					       args->op.rw.start_io_unit, args->op.rw.num_io_units,
+					       __rw_done, req);
+		}
+		return;
+	}
+
 	spdk_bs_io_read_blob(args->file->blob, args->op.rw.channel,
 			     args->op.rw.pin_buf,
-			     args->op.rw.start_page, args->op.rw.num_pages,
+			     args->op.rw.start_io_unit, args->op.rw.num_io_units,
 			     __read_done, req);
 }
 
 static void
-__get_page_parameters(struct spdk_file *file, uint64_t offset, uint64_t length,
-		      uint64_t *start_page, uint32_t *page_size, uint64_t *num_pages)
+__get_io_unit_parameters(struct spdk_file *file, uint64_t offset, uint64_t length,
+			 uint64_t *start_io_unit, uint32_t *io_unit_size, uint64_t *num_io_units)
 {
-	uint64_t end_page;
+	uint64_t end_io_unit;
 
-	*page_size = spdk_bs_get_page_size(file->fs->bs);
-	*start_page = offset / *page_size;
-	end_page = (offset + length - 1) / *page_size;
-	*num_pages = (end_page - *start_page + 1);
+	*io_unit_size = spdk_bs_get_io_unit_size(file->fs->bs);
+	*start_io_unit = offset / *io_unit_size;
+	end_io_unit = (offset + length - 1) / *io_unit_size;
+	*num_io_units = (end_io_unit - *start_io_unit + 1);
 }
 
 static void
 __readwrite(struct spdk_file *file, struct spdk_io_channel *_channel,
-	    void *payload, uint64_t offset, uint64_t length,
+	    struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
 	    spdk_file_op_complete cb_fn, void *cb_arg, int is_read)
 {
 	struct spdk_fs_request *req;
 	struct spdk_fs_cb_args *args;
 	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
-	uint64_t start_page, num_pages, pin_buf_length;
-	uint32_t page_size;
+	uint64_t start_io_unit, num_io_units, pin_buf_length;
+	uint32_t io_unit_size;
 
 	if (is_read && offset + length > file->length) {
 		cb_fn(cb_arg, -EINVAL);
@@ -1559,17 +2312,31 @@ __readwrite(struct spdk_file *file, struct spdk_io_channel *_channel,
 	args->arg = cb_arg;
 	args->file = file;
 	args->op.rw.channel = channel->bs_channel;
-	args->op.rw.user_buf = payload;
+	if (iovcnt == 1) {
+		/* Keep a copy, so a single iovec may live on the caller's stack */
+		args->op.rw.iov = iovs[0];
+		iovs = &args->op.rw.iov;
+	}
+	args->op.rw.iovs = iovs;
+	args->op.rw.iovcnt = iovcnt;
 	args->op.rw.is_read = is_read;
 	args->op.rw.offset = offset;
 	args->op.rw.length = length;
 
-	__get_page_parameters(file, offset, length, &start_page, &page_size, &num_pages);
-	pin_buf_length = num_pages * page_size;
-	args->op.rw.pin_buf = spdk_dma_malloc(pin_buf_length, 4096, NULL);
+	__get_io_unit_parameters(file, offset, length, &start_io_unit, &io_unit_size, &num_io_units);
+	if (!__iovs_are_dma_aligned(iovs, iovcnt, offset, length, io_unit_size)) {
+		/* Bounce through a buffer covering the whole io units */
+		pin_buf_length = num_io_units * io_unit_size;
+		args->op.rw.pin_buf = spdk_dma_malloc(pin_buf_length, 4096, NULL);
+		if (args->op.rw.pin_buf == NULL) {
+			free_fs_request(req);
+			cb_fn(cb_arg, -ENOMEM);
+			return;
+		}
+	}
 
-	args->op.rw.start_page = start_page;
-	args->op.rw.num_pages = num_pages;
+	args->op.rw.start_io_unit = start_io_unit;
+	args->op.rw.num_io_units = num_io_units;
 
 	if (!is_read && file->length < offset + length) {
 		spdk_file_truncate_async(file, offset + length, __do_blob_read, req);
@@ -1578,12 +2345,32 @@ __readwrite(struct spdk_file *file, struct spdk_io_channel *_channel,
 	}
 }
 
+void
+spdk_file_writev_async(struct spdk_file *file, struct spdk_io_channel *channel,
+		       struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
+		       spdk_file_op_complete cb_fn, void *cb_arg)
+{
+	__readwrite(file, channel, iovs, iovcnt, offset, length, cb_fn, cb_arg, 0);
+}
+
+void
+spdk_file_readv_async(struct spdk_file *file, struct spdk_io_channel *channel,
+		      struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
+		      spdk_file_op_complete cb_fn, void *cb_arg)
+{
+	SPDK_DEBUGLOG(SPDK_LOG_BLOBFS, "file=%s offset=%jx length=%jx\n",
+		      file->name, offset, length);
+	__readwrite(file, channel, iovs, iovcnt, offset, length, cb_fn, cb_arg, 1);
+}
+
 void
 spdk_file_write_async(struct spdk_file *file, struct spdk_io_channel *channel,
 		      void *payload, uint64_t offset, uint64_t length,
 		      spdk_file_op_complete cb_fn, void *cb_arg)
 {
-	__readwrite(file, channel, payload, offset, length, cb_fn, cb_arg, 0);
+	struct iovec iov = { .iov_base = payload, .iov_len = length };
+
+	__readwrite(file, channel, &iov, 1, offset, length, cb_fn, cb_arg, 0);
 }
 
 void
@@ -1591,9 +2378,11 @@ spdk_file_read_async(struct spdk_file *file, struct spdk_io_channel *channel,
 		     void *payload, uint64_t offset, uint64_t length,
 		     spdk_file_op_complete cb_fn, void *cb_arg)
 {
+	struct iovec iov = { .iov_base = payload, .iov_len = length };
+
 	SPDK_DEBUGLOG(SPDK_LOG_BLOBFS, "file=%s offset=%jx length=%jx\n",
 		      file->name, offset, length);
-	__readwrite(file, channel, payload, offset, length, cb_fn, cb_arg, 1);
+	__readwrite(file, channel, &iov, 1, offset, length, cb_fn, cb_arg, 1);
 }
 
 struct spdk_io_channel *
@@ -1625,91 +2414,249 @@ spdk_fs_alloc_io_channel_sync(struct spdk_filesystem *fs)
 	return io_channel;
 }
 
+int
+spdk_fs_set_io_threads(struct spdk_filesystem *fs, uint32_t num_threads,
+		       fs_send_io_request_fn send_io_request_fn)
+{
+	if (num_threads == 0 || send_io_request_fn == NULL) {
+		return -EINVAL;
+	}
+
+	if (fs->io_threads.count != 0) {
+		return -EBUSY;
+	}
+
+	fs->io_threads.channels = calloc(num_threads, sizeof(*fs->io_threads.channels));
+	if (fs->io_threads.channels == NULL) {
+		return -ENOMEM;
+	}
+
+	fs->io_threads.send_request = send_io_request_fn;
+	fs->io_threads.count = num_threads;
+
+	return 0;
+}
+
 void
 spdk_fs_free_io_channel(struct spdk_io_channel *channel)
 {
 	spdk_put_io_channel(channel);
 }
 
-void
-spdk_fs_set_cache_size(uint64_t size_in_mb)
+static uint32_t
+__cache_shard_index(struct spdk_file *file, uint64_t offset)
 {
-	g_fs_cache_size = size_in_mb * 1024 * 1024;
+	return (file->blobid + (offset >> g_fs_cache_buffer_shift)) % CACHE_SHARD_COUNT;
 }
 
-uint64_t
-spdk_fs_get_cache_size(void)
+static uint64_t
+__cache_buffers_in_use(void)
 {
-	return g_fs_cache_size / (1024 * 1024);
-}
+	struct cache_shard *shard;
+	uint64_t count = 0;
+	uint32_t i;
 
-static void __file_flush(void *_args);
+	for (i = 0; i < CACHE_SHARD_COUNT; i++) {
+		shard = &g_cache_shards[i];
+		count += __atomic_load_n(&shard->num_buffers[SPDK_FILE_PRIORITY_LOW], __ATOMIC_RELAXED);
+		count += __atomic_load_n(&shard->num_buffers[SPDK_FILE_PRIORITY_HIGH], __ATOMIC_RELAXED);
+	}
+
+	return count;
+}
 
 static void *
-alloc_cache_memory_buffer(struct spdk_file *context)
+__cache_shard_evict(struct cache_shard *shard, uint32_t priority, struct spdk_file *context,
+		    struct cache_pool **pool)
 {
+	struct cache_buffer *buf;
 	struct spdk_file *file;
-	void *buf;
+	uint64_t count;
+	void *data;
 
-	buf = spdk_mempool_get(g_cache_pool);
-	if (buf != NULL) {
-		return buf;
-	}
+	pthread_spin_lock(&shard->lock);
+	count = shard->num_buffers[priority];
+	while (count-- > 0) {
+		/* Advance the clock hand, moving the buffer behind it */
+		buf = TAILQ_FIRST(&shard->buffers[priority]);
+		TAILQ_REMOVE(&shard->buffers[priority], buf, lru_tailq);
+		TAILQ_INSERT_TAIL(&shard->buffers[priority], buf, lru_tailq);
 
-	pthread_spin_lock(&g_caches_lock);
-	TAILQ_FOREACH(file, &g_caches, cache_tailq) {
-		if (!file->open_for_writing &&
-		    file->priority == SPDK_FILE_PRIORITY_LOW &&
-		    file != context) {
-			break;
+		/*
+		 * The caller already holds the lock of the context file.  Other files are
+		 *  locked here in the reverse order of the rest of blobfs, so skip busy ones.
+		 */
+		file = buf->file;
+		if (file != context && pthread_spin_trylock(&file->lock) != 0) {
+			continue;
 		}
-	}
-	pthread_spin_unlock(&g_caches_lock);
-	if (file != NULL) {
-		cache_free_buffers(file);
-		buf = spdk_mempool_get(g_cache_pool);
-		if (buf != NULL) {
-			return buf;
+
+		if (buf->referenced) {
+			buf->referenced = false;
+		} else if (!buf->in_progress && buf->bytes_filled == buf->bytes_flushed &&
+			   buf != file->last && buf->pin_count == 0) {
+			TAILQ_REMOVE(&shard->buffers[priority], buf, lru_tailq);
+			shard->num_buffers[priority]--;
+			shard->evictions++;
+			pthread_spin_unlock(&shard->lock);
+
+			data = buf->buf;
+			*pool = buf->pool;
+			buf->buf = NULL;
+			buf->shard = NULL;
+			spdk_tree_remove_buffer(file->tree, buf);
+			if (file != context) {
+				pthread_spin_unlock(&file->lock);
+			}
+			return data;
 		}
-	}
 
-	pthread_spin_lock(&g_caches_lock);
-	TAILQ_FOREACH(file, &g_caches, cache_tailq) {
-		if (!file->open_for_writing && file != context) {
-			break;
+		if (file != context) {
+			pthread_spin_unlock(&file->lock);
 		}
 	}
-	pthread_spin_unlock(&g_caches_lock);
-	if (file != NULL) {
-		cache_free_buffers(file);
-		buf = spdk_mempool_get(g_cache_pool);
-		if (buf != NULL) {
-			return buf;
+	pthread_spin_unlock(&shard->lock);
+
+	return NULL;
+}
+
+/*
+ * Evict one clean buffer and return its memory, and in *pool the pool it belongs to.  Shards
+ *  are scanned starting from start_shard, low priority buffers across all shards before high
+ *  priority ones.  Each shard is swept twice, since the first sweep may only clear referenced bits.
+ */
+static void *
+cache_evict_buffer(struct spdk_file *context, uint32_t start_shard, struct cache_pool **pool)
+{
+	uint32_t i, priority;
+	void *buf;
+
+	for (priority = SPDK_FILE_PRIORITY_LOW; priority <= SPDK_FILE_PRIORITY_HIGH; priority++) {
+		for (i = 0; i < 2 * CACHE_SHARD_COUNT; i++) {
+			buf = __cache_shard_evict(&g_cache_shards[(start_shard + i) % CACHE_SHARD_COUNT],
+						  priority, context, pool);
+			if (buf != NULL) {
+				return buf;
+			}
 		}
 	}
 
-	pthread_spin_lock(&g_caches_lock);
-	TAILQ_FOREACH(file, &g_caches, cache_tailq) {
-		if (file != context) {
-			break;
+	return NULL;
+}
+
+void
+spdk_fs_set_cache_size(uint64_t size_in_mb)
+{
+	struct cache_pool *pool;
+	uint64_t max_buffers;
+	void *buf;
+
+	pthread_mutex_lock(&g_cache_init_lock);
+	g_fs_cache_size = size_in_mb * 1024 * 1024;
+	if (g_cache_pool_count > 0) {
+		max_buffers = g_fs_cache_size / CACHE_BUFFER_SIZE;
+		if (max_buffers > g_cache_pool_buffers) {
+			g_cache_pool_buffers += __cache_add_pools(max_buffers - g_cache_pool_buffers);
+		}
+		/* Memory that could not be added caps the size, and shrinking keeps the pools */
+		max_buffers = spdk_min(max_buffers, g_cache_pool_buffers);
+		g_fs_cache_size = max_buffers * CACHE_BUFFER_SIZE;
+		g_cache_max_buffers = max_buffers;
+		while (__cache_buffers_in_use() > max_buffers) {
+			buf = cache_evict_buffer(NULL, 0, &pool);
+			if (buf == NULL) {
+				break;
+			}
+			spdk_mempool_put(pool->mempool, buf);
 		}
 	}
-	pthread_spin_unlock(&g_caches_lock);
-	if (file != NULL) {
-		cache_free_buffers(file);
-		buf = spdk_mempool_get(g_cache_pool);
-		if (buf != NULL) {
-			return buf;
+	pthread_mutex_unlock(&g_cache_init_lock);
+}
+
+uint64_t
+spdk_fs_get_cache_size(void)
+{
+	return g_fs_cache_size / (1024 * 1024);
+}
+
+void
+spdk_fs_set_readahead_limits(uint64_t file_max, uint64_t total_max)
+{
+	g_readahead_file_max = file_max;
+	g_readahead_total_max = total_max;
+}
+
+void
+spdk_fs_get_cache_stats(struct spdk_fs_cache_stats *stats)
+{
+	struct cache_shard *shard;
+	uint32_t i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < CACHE_SHARD_COUNT; i++) {
+		shard = &g_cache_shards[i];
+		stats->hits += __atomic_load_n(&shard->hits, __ATOMIC_RELAXED);
+		stats->misses += __atomic_load_n(&shard->misses, __ATOMIC_RELAXED);
+		stats->evictions += __atomic_load_n(&shard->evictions, __ATOMIC_RELAXED);
+		stats->readahead_buffers += __atomic_load_n(&shard->readahead_buffers, __ATOMIC_RELAXED);
+		stats->readahead_hits += __atomic_load_n(&shard->readahead_hits, __ATOMIC_RELAXED);
+	}
+	stats->bytes_cached = __cache_buffers_in_use() * CACHE_BUFFER_SIZE;
+}
+
+static void __file_flush(void *_args);
+
+/* Take a buffer from the pools of the local socket first, then from any other pool */
+static void *
+__cache_pool_get(struct cache_pool **pool)
+{
+	uint32_t count, i, pass;
+	int32_t socket_id;
+	bool local;
+	void *buf;
+
+	socket_id = __cache_local_socket();
+	count = __atomic_load_n(&g_cache_pool_count, __ATOMIC_ACQUIRE);
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < count; i++) {
+			local = g_cache_pools[i].socket_id == socket_id;
+			if (local != (pass == 0)) {
+				continue;
+			}
+			buf = spdk_mempool_get(g_cache_pools[i].mempool);
+			if (buf != NULL) {
+				*pool = &g_cache_pools[i];
+				return buf;
+			}
 		}
 	}
 
 	return NULL;
 }
 
+static void *
+alloc_cache_memory_buffer(struct spdk_file *context, uint32_t shard_index,
+			  struct cache_pool **pool)
+{
+	void *buf = NULL;
+
+	if (__cache_buffers_in_use() < g_cache_max_buffers) {
+		buf = __cache_pool_get(pool);
+	}
+	if (buf == NULL) {
+		buf = cache_evict_buffer(context, shard_index, pool);
+	}
+
+	return buf;
+}
+
+/* Must be called with the lock of the file held */
 static struct cache_buffer *
 cache_insert_buffer(struct spdk_file *file, uint64_t offset)
 {
 	struct cache_buffer *buf;
+	struct cache_shard *shard;
+	uint32_t shard_index;
 	int count = 0;
 
 	buf = calloc(1, sizeof(*buf));
@@ -1718,14 +2665,14 @@ cache_insert_buffer(struct spdk_file *file, uint64_t offset)
 		return NULL;
 	}
 
-	buf->buf = alloc_cache_memory_buffer(file);
+	shard_index = __cache_shard_index(file, offset);
+	buf->buf = alloc_cache_memory_buffer(file, shard_index, &buf->pool);
 	while (buf->buf == NULL) {
 		/*
-		 * TODO: alloc_cache_memory_buffer() should eventually free
-		 *  some buffers.  Need a more sophisticated check here, instead
-		 *  of just bailing if 100 tries does not result in getting a
-		 *  free buffer.  This will involve using the sync channel's
-		 *  semaphore to block until a buffer becomes available.
+		 * TODO: alloc_cache_memory_buffer() can only evict clean buffers.  Need a
+		 *  more sophisticated check here, instead of just bailing if 100 tries does
+		 *  not result in getting a free buffer.  This will involve using the sync
+		 *  channel's semaphore to block until a buffer is flushed.
 		 */
 		if (count++ == 100) {
 			SPDK_ERRLOG("could not allocate cache buffer\n");
@@ -1733,18 +2680,22 @@ cache_insert_buffer(struct spdk_file *file, uint64_t offset)
 			free(buf);
 			return NULL;
 		}
-		buf->buf = alloc_cache_memory_buffer(file);
+		buf->buf = alloc_cache_memory_buffer(file, shard_index, &buf->pool);
 	}
 
 	buf->buf_size = CACHE_BUFFER_SIZE;
 	buf->offset = offset;
+	buf->file = file;
+	buf->priority = spdk_min(file->priority, SPDK_FILE_PRIORITY_HIGH);
 
-	pthread_spin_lock(&g_caches_lock);
-	if (file->tree->present_mask == 0) {
-		TAILQ_INSERT_TAIL(&g_caches, file, cache_tailq);
-	}
 	file->tree = spdk_tree_insert_buffer(file->tree, buf);
-	pthread_spin_unlock(&g_caches_lock);
+
+	shard = &g_cache_shards[shard_index];
+	pthread_spin_lock(&shard->lock);
+	TAILQ_INSERT_TAIL(&shard->buffers[buf->priority], buf, lru_tailq);
+	shard->num_buffers[buf->priority]++;
+	buf->shard = shard;
+	pthread_spin_unlock(&shard->lock);
 
 	return buf;
 }
@@ -1776,26 +2727,38 @@ __wake_caller(struct spdk_fs_cb_args *args)
 
 static void __check_sync_reqs(struct spdk_file *file);
 
+/*
+ * Complete the sync requests whose data is flushed and already covered by the length
+ *  in the "length" xattr.  Requests are queued in offset order.
+ */
 static void
 __file_cache_finish_sync(struct spdk_file *file)
 {
+	TAILQ_HEAD(, spdk_fs_request) done = TAILQ_HEAD_INITIALIZER(done);
 	struct spdk_fs_request *sync_req;
 	struct spdk_fs_cb_args *sync_args;
 
 	pthread_spin_lock(&file->lock);
-	sync_req = TAILQ_FIRST(&file->sync_requests);
-	sync_args = &sync_req->args;
-	assert(sync_args->op.sync.offset <= file->length_flushed);
-	BLOBFS_TRACE(file, "sync done offset=%jx\n", sync_args->op.sync.offset);
-	TAILQ_REMOVE(&file->sync_requests, sync_req, args.op.sync.tailq);
+	while ((sync_req = TAILQ_FIRST(&file->sync_requests)) != NULL) {
+		sync_args = &sync_req->args;
+		if (sync_args->op.sync.offset > file->length_flushed ||
+		    sync_args->op.sync.offset > file->length_xattr) {
+			break;
+		}
+		BLOBFS_TRACE(file, "sync done offset=%jx\n", sync_args->op.sync.offset);
+		TAILQ_REMOVE(&file->sync_requests, sync_req, args.op.sync.tailq);
+		TAILQ_INSERT_TAIL(&done, sync_req, args.op.sync.tailq);
+	}
 	pthread_spin_unlock(&file->lock);
 
-	sync_args->fn.file_op(sync_args->arg, 0);
-	__check_sync_reqs(file);
+	while ((sync_req = TAILQ_FIRST(&done)) != NULL) {
+		TAILQ_REMOVE(&done, sync_req, args.op.sync.tailq);
+		sync_req->args.fn.file_op(sync_req->args.arg, 0);
 
-	pthread_spin_lock(&file->lock);
-	free_fs_request(sync_req);
-	pthread_spin_unlock(&file->lock);
+		pthread_spin_lock(&file->lock);
+		free_fs_request(sync_req);
+		pthread_spin_unlock(&file->lock);
+	}
 }
 
 static void
@@ -1803,7 +2766,12 @@ __file_cache_finish_sync_bs_cb(void *ctx, int bserrno)
 {
 	struct spdk_file *file = ctx;
 
-	__file_cache_finish_sync(file);
+	pthread_spin_lock(&file->lock);
+	file->sync_md_in_progress = false;
+	file->length_xattr = file->length_syncing;
+	pthread_spin_unlock(&file->lock);
+
+	__check_sync_reqs(file);
 }
 
 static void
@@ -1820,24 +2788,48 @@ __free_args(struct spdk_fs_cb_args *args)
 	}
 }
 
+/*
+ * Group commit - requests that were flushed while an md sync was in progress share the
+ *  next one, which stores the length flushed so far.  Files whose stored length already
+ *  covers the flushed data, such as preallocated ones, skip the md sync.
+ */
 static void
 __check_sync_reqs(struct spdk_file *file)
 {
+	TAILQ_HEAD(, spdk_fs_request) failed = TAILQ_HEAD_INITIALIZER(failed);
 	struct spdk_fs_request *sync_req;
+	int rc;
+
+	__file_cache_finish_sync(file);
 
 	pthread_spin_lock(&file->lock);
 
-	TAILQ_FOREACH(sync_req, &file->sync_requests, args.op.sync.tailq) {
-		if (sync_req->args.op.sync.offset <= file->length_flushed) {
-			break;
+	if (file->flush_error != 0) {
+		/* The data of the remaining requests was not flushed.  A later sync flushes again. */
+		rc = file->flush_error;
+		file->flush_error = 0;
+		TAILQ_SWAP(&failed, &file->sync_requests, spdk_fs_request, args.op.sync.tailq);
+		pthread_spin_unlock(&file->lock);
+
+		while ((sync_req = TAILQ_FIRST(&failed)) != NULL) {
+			TAILQ_REMOVE(&failed, sync_req, args.op.sync.tailq);
+			sync_req->args.fn.file_op(sync_req->args.arg, rc);
+
+			pthread_spin_lock(&file->lock);
+			free_fs_request(sync_req);
+			pthread_spin_unlock(&file->lock);
 		}
+		return;
 	}
 
-	if (sync_req != NULL && !sync_req->args.op.sync.xattr_in_progress) {
+	sync_req = TAILQ_FIRST(&file->sync_requests);
+	if (sync_req != NULL && sync_req->args.op.sync.offset <= file->length_flushed &&
+	    !file->sync_md_in_progress) {
 		BLOBFS_TRACE(file, "set xattr length 0x%jx\n", file->length_flushed);
-		sync_req->args.op.sync.xattr_in_progress = true;
-		spdk_blob_set_xattr(file->blob, "length", &file->length_flushed,
-				    sizeof(file->length_flushed));
+		file->sync_md_in_progress = true;
+		file->length_syncing = file->length_flushed;
+		spdk_blob_set_xattr(file->blob, "length", &file->length_syncing,
+				    sizeof(file->length_syncing));
 
 		pthread_spin_unlock(&file->lock);
 		spdk_blob_sync_md(file->blob, __file_cache_finish_sync_bs_cb, file);
@@ -1846,6 +2838,39 @@ __check_sync_reqs(struct spdk_file *file)
 	}
 }
 
+static void
+__check_sync_reqs_msg(void *arg)
+{
+	__check_sync_reqs(arg);
+}
+
+static void
+__file_check_sync_reqs(struct spdk_file *file)
+{
+	if (spdk_get_thread() == spdk_io_channel_get_thread(file->fs->md_target.md_io_channel)) {
+		__check_sync_reqs(file);
+	} else {
+		/* The length xattr is only updated from the metadata thread */
+		file->fs->send_request(__check_sync_reqs_msg, file);
+	}
+}
+
+/* Fail the sync requests of the file that wait for data that could not be flushed */
+static void
+__file_flush_failed(struct spdk_fs_cb_args *args, int rc)
+{
+	struct spdk_file *file = args->file;
+
+	SPDK_ERRLOG("flush of %s failed: %d\n", file->name, rc);
+
+	pthread_spin_lock(&file->lock);
+	file->flush_error = rc;
+	pthread_spin_unlock(&file->lock);
+
+	__free_args(args);
+	__file_check_sync_reqs(file);
+}
+
 static void
 __file_flush_done(void *arg, int bserrno)
 {
@@ -1855,11 +2880,19 @@ __file_flush_done(void *arg, int bserrno)
 
 	BLOBFS_TRACE(file, "length=%jx\n", args->op.flush.length);
 
-	pthread_spin_lock(&file->lock);
-	next->in_progress = false;
-	next->bytes_flushed += args->op.flush.length;
-	file->length_flushed += args->op.flush.length;
-	if (file->length_flushed > file->length) {
+	if (bserrno != 0) {
+		pthread_spin_lock(&file->lock);
+		next->in_progress = false;
+		pthread_spin_unlock(&file->lock);
+		__file_flush_failed(args, bserrno);
+		return;
+	}
+
+	pthread_spin_lock(&file->lock);
+	next->in_progress = false;
+	next->bytes_flushed += args->op.flush.length;
+	file->length_flushed += args->op.flush.length;
+	if (file->length_flushed > file->length) {
 		file->length = file->length_flushed;
 	}
 	if (next->bytes_flushed == next->buf_size) {
@@ -1876,7 +2909,7 @@ __file_flush_done(void *arg, int bserrno)
 
 	pthread_spin_unlock(&file->lock);
 
-	__check_sync_reqs(file);
+	__file_check_sync_reqs(file);
 
 	__file_flush(args);
 }
@@ -1887,8 +2920,15 @@ __file_flush(void *_args)
 	struct spdk_fs_cb_args *args = _args;
 	struct spdk_file *file = args->file;
 	struct cache_buffer *next;
-	uint64_t offset, length, start_page, num_pages;
-	uint32_t page_size;
+	struct spdk_io_channel *bs_channel;
+	uint64_t offset, length, start_io_unit, num_io_units;
+	uint32_t io_unit_size;
+
+	bs_channel = __file_io_bs_channel(file);
+	if (bs_channel == NULL) {
+		__file_flush_failed(args, -ENOMEM);
+		return;
+	}
 
 	pthread_spin_lock(&file->lock);
 	next = spdk_tree_find_buffer(file->tree, file->length_flushed);
@@ -1913,15 +2953,15 @@ __file_flush(void *_args)
 	args->op.flush.length = length;
 	args->op.flush.cache_buffer = next;
 
-	__get_page_parameters(file, offset, length, &start_page, &page_size, &num_pages);
+	__get_io_unit_parameters(file, offset, length, &start_io_unit, &io_unit_size, &num_io_units);
 
 	next->in_progress = true;
-	BLOBFS_TRACE(file, "offset=%jx length=%jx page start=%jx num=%jx\n",
-		     offset, length, start_page, num_pages);
+	BLOBFS_TRACE(file, "offset=%jx length=%jx io_unit start=%jx num=%jx\n",
+		     offset, length, start_io_unit, num_io_units);
 	pthread_spin_unlock(&file->lock);
-	spdk_bs_io_write_blob(file->blob, file->fs->sync_target.sync_fs_channel->bs_channel,
-			      next->buf + (start_page * page_size) - next->offset,
-			      start_page, num_pages,
+	spdk_bs_io_write_blob(file->blob, bs_channel,
+			      next->buf + (start_io_unit * io_unit_size) - next->offset,
+			      start_io_unit, num_io_units,
 			      __file_flush_done, args);
 }
 
@@ -1930,20 +2970,77 @@ __file_extend_done(void *arg, int bserrno)
 {
 	struct spdk_fs_cb_args *args = arg;
 
+	args->rc = bserrno;
 	__wake_caller(args);
 }
 
+/*
+ * Grow the blob to num_clusters, or to min_clusters if the blobstore does not have that
+ *  many free clusters.  Blobs that are already large enough are left alone.
+ */
 static void
 __file_extend_blob(void *_args)
 {
 	struct spdk_fs_cb_args *args = _args;
 	struct spdk_file *file = args->file;
+	int rc;
 
-	spdk_blob_resize(file->blob, args->op.resize.num_clusters);
+	if (spdk_blob_get_num_clusters(file->blob) >= args->op.resize.min_clusters) {
+		__file_extend_done(args, 0);
+		return;
+	}
+
+	rc = spdk_blob_resize(file->blob, args->op.resize.num_clusters);
+	if (rc != 0 && args->op.resize.num_clusters > args->op.resize.min_clusters) {
+		rc = spdk_blob_resize(file->blob, args->op.resize.min_clusters);
+	}
+	if (rc != 0) {
+		__file_extend_done(args, rc);
+		return;
+	}
 
 	spdk_blob_sync_md(file->blob, __file_extend_done, args);
 }
 
+/*
+ * Clusters to grow a blob to when an append needs min_clusters.  Blobs grow geometrically, so
+ *  appending n bytes takes O(log n) md syncs, in steps of at most FILE_PREALLOC_MAX_STEP.  The
+ *  clusters past the end of the file are released when it is closed.
+ */
+static uint32_t
+__file_prealloc_clusters(struct spdk_file *file, uint32_t min_clusters)
+{
+	uint64_t num_clusters, step;
+
+	num_clusters = spdk_blob_get_num_clusters(file->blob);
+	step = spdk_max(num_clusters, 1);
+	step = spdk_min(step, __bytes_to_clusters(FILE_PREALLOC_MAX_STEP, file->fs->bs_opts.cluster_sz));
+
+	return spdk_max(min_clusters, num_clusters + step);
+}
+
+int
+spdk_file_allocate(struct spdk_file *file, struct spdk_io_channel *_channel, uint64_t length)
+{
+	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	struct spdk_fs_cb_args args = {};
+
+	BLOBFS_TRACE(file, "length=%jx\n", length);
+
+	if (length <= __file_get_blob_size(file)) {
+		return 0;
+	}
+
+	args.sem = &channel->sem;
+	args.file = file;
+	args.op.resize.num_clusters = __bytes_to_clusters(length, file->fs->bs_opts.cluster_sz);
+	args.op.resize.min_clusters = args.op.resize.num_clusters;
+	file->fs->send_request(__file_extend_blob, &args);
+	sem_wait(&channel->sem);
+
+	return args.rc;
+}
+
 static void
 __rw_from_file_done(void *arg, int bserrno)
 {
@@ -1958,20 +3055,31 @@ __rw_from_file(void *_args)
 {
 	struct spdk_fs_cb_args *args = _args;
 	struct spdk_file *file = args->file;
+	struct spdk_io_channel *channel;
+
+	channel = __file_io_channel(file);
+	if (channel == NULL) {
+		__rw_from_file_done(args, -ENOMEM);
+		return;
+	}
 
 	if (args->op.rw.is_read) {
-		spdk_file_read_async(file, file->fs->sync_target.sync_io_channel, args->op.rw.user_buf,
-				     args->op.rw.offset, args->op.rw.length,
-				     __rw_from_file_done, args);
-	} else {
-		spdk_file_write_async(file, file->fs->sync_target.sync_io_channel, args->op.rw.user_buf,
+		spdk_file_readv_async(file, channel, args->op.rw.iovs, args->op.rw.iovcnt,
 				      args->op.rw.offset, args->op.rw.length,
 				      __rw_from_file_done, args);
+	} else {
+		spdk_file_writev_async(file, channel, args->op.rw.iovs, args->op.rw.iovcnt,
+				       args->op.rw.offset, args->op.rw.length,
+				       __rw_from_file_done, args);
 	}
 }
 
+/*
+ * Read or write a file range through the blob, bypassing the cache.  iovs with more than one
+ *  entry must stay valid until sem is posted.
+ */
 static int
-__send_rw_from_file(struct spdk_file *file, sem_t *sem, void *payload,
+__send_rw_from_file(struct spdk_file *file, sem_t *sem, struct iovec *iovs, int iovcnt,
 		    uint64_t offset, uint64_t length, bool is_read)
 {
 	struct spdk_fs_cb_args *args;
@@ -1984,14 +3092,45 @@ __send_rw_from_file(struct spdk_file *file, sem_t *sem, void *payload,
 
 	args->file = file;
 	args->sem = sem;
-	args->op.rw.user_buf = payload;
+	if (iovcnt == 1) {
+		args->op.rw.iov = iovs[0];
+		iovs = &args->op.rw.iov;
+	}
+	args->op.rw.iovs = iovs;
+	args->op.rw.iovcnt = iovcnt;
 	args->op.rw.offset = offset;
 	args->op.rw.length = length;
 	args->op.rw.is_read = is_read;
-	file->fs->send_request(__rw_from_file, args);
+	__file_send_io_request(file, file->fs->send_request, __rw_from_file, args);
 	return 0;
 }
 
+/*
+ * Append to the file straight through the blob.  Called with the file lock held, which
+ *  is released before waiting for the write.
+ */
+static int
+__file_write_uncached(struct spdk_file *file, struct spdk_fs_channel *channel,
+		      struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length)
+{
+	struct cache_buffer *buf;
+	int rc;
+
+	file->append_pos += length;
+
+	/* A buffer cached by a read may hold the old end of the file, which the write extends */
+	buf = spdk_tree_find_buffer(file->tree, offset);
+	if (buf != NULL && !buf->in_progress && buf->bytes_filled == buf->bytes_flushed &&
+	    buf->pin_count == 0) {
+		spdk_tree_remove_buffer(file->tree, buf);
+	}
+	pthread_spin_unlock(&file->lock);
+
+	rc = __send_rw_from_file(file, &channel->sem, iovs, iovcnt, offset, length, false);
+	sem_wait(&channel->sem);
+	return rc;
+}
+
 int
 spdk_file_write(struct spdk_file *file, struct spdk_io_channel *_channel,
 		void *payload, uint64_t offset, uint64_t length)
@@ -2018,17 +3157,12 @@ spdk_file_write(struct spdk_file *file, struct spdk_io_channel *_channel,
 	file->open_for_writing = true;
 
 	if (file->last == NULL) {
-		if (file->append_pos % CACHE_BUFFER_SIZE == 0) {
+		if (file->append_pos % CACHE_BUFFER_SIZE == 0 && !file->direct) {
 			cache_append_buffer(file);
 		} else {
-			int rc;
+			struct iovec iov = { .iov_base = payload, .iov_len = length };
 
-			file->append_pos += length;
-			pthread_spin_unlock(&file->lock);
-			rc = __send_rw_from_file(file, &channel->sem, payload,
-						 offset, length, false);
-			sem_wait(&channel->sem);
-			return rc;
+			return __file_write_uncached(file, channel, &iov, 1, offset, length);
 		}
 	}
 
@@ -2039,12 +3173,18 @@ spdk_file_write(struct spdk_file *file, struct spdk_io_channel *_channel,
 
 		cluster_sz = file->fs->bs_opts.cluster_sz;
 		extend_args.sem = &channel->sem;
-		extend_args.op.resize.num_clusters = __bytes_to_clusters((offset + length), cluster_sz);
+		extend_args.op.resize.min_clusters = __bytes_to_clusters((offset + length), cluster_sz);
+		extend_args.op.resize.num_clusters = __file_prealloc_clusters(file,
+						     extend_args.op.resize.min_clusters);
 		extend_args.file = file;
 		BLOBFS_TRACE(file, "start resize to %u clusters\n", extend_args.op.resize.num_clusters);
 		pthread_spin_unlock(&file->lock);
 		file->fs->send_request(__file_extend_blob, &extend_args);
 		sem_wait(&channel->sem);
+		if (extend_args.rc != 0) {
+			return extend_args.rc;
+		}
+		pthread_spin_lock(&file->lock);
 	}
 
 	last = file->last;
@@ -2087,11 +3227,68 @@ spdk_file_write(struct spdk_file *file, struct spdk_io_channel *_channel,
 	}
 
 	args->file = file;
-	file->fs->send_request(__file_flush, args);
+	__file_send_io_request(file, file->fs->send_request, __file_flush, args);
 	pthread_spin_unlock(&file->lock);
 	return 0;
 }
 
+int
+spdk_file_writev(struct spdk_file *file, struct spdk_io_channel *_channel,
+		 struct iovec *iovs, int iovcnt, uint64_t offset)
+{
+	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	uint64_t length = 0;
+	int i, rc;
+
+	for (i = 0; i < iovcnt; i++) {
+		length += iovs[i].iov_len;
+	}
+
+	if (length == 0) {
+		return 0;
+	}
+
+	if (offset != file->append_pos) {
+		BLOBFS_TRACE(file, " error offset=%jx append_pos=%jx\n", offset, file->append_pos);
+		return -EINVAL;
+	}
+
+	pthread_spin_lock(&file->lock);
+	if (file->direct && file->last == NULL) {
+		file->open_for_writing = true;
+		return __file_write_uncached(file, channel, iovs, iovcnt, offset, length);
+	}
+	pthread_spin_unlock(&file->lock);
+
+	for (i = 0; i < iovcnt; i++) {
+		rc = spdk_file_write(file, _channel, iovs[i].iov_base, offset, iovs[i].iov_len);
+		if (rc != 0) {
+			return rc;
+		}
+		offset += iovs[i].iov_len;
+	}
+
+	return 0;
+}
+
+/* Give back the buffer of a readahead that did not fill it, so reads of it go to the blob */
+static void
+__readahead_failed(struct spdk_fs_cb_args *args, int rc)
+{
+	struct cache_buffer *cache_buffer = args->op.readahead.cache_buffer;
+	struct spdk_file *file = args->file;
+
+	SPDK_ERRLOG("readahead of %s at offset 0x%jx failed: %d\n", file->name,
+		    cache_buffer->offset, rc);
+
+	pthread_spin_lock(&file->lock);
+	cache_buffer->in_progress = false;
+	spdk_tree_remove_buffer(file->tree, cache_buffer);
+	pthread_spin_unlock(&file->lock);
+
+	__free_args(args);
+}
+
 static void
 __readahead_done(void *arg, int bserrno)
 {
@@ -2101,6 +3298,11 @@ __readahead_done(void *arg, int bserrno)
 
 	BLOBFS_TRACE(file, "offset=%jx\n", cache_buffer->offset);
 
+	if (bserrno != 0) {
+		__readahead_failed(args, bserrno);
+		return;
+	}
+
 	pthread_spin_lock(&file->lock);
 	cache_buffer->bytes_filled = args->op.readahead.length;
 	cache_buffer->bytes_flushed = args->op.readahead.length;
@@ -2115,20 +3317,27 @@ __readahead(void *_args)
 {
 	struct spdk_fs_cb_args *args = _args;
 	struct spdk_file *file = args->file;
-	uint64_t offset, length, start_page, num_pages;
-	uint32_t page_size;
+	struct spdk_io_channel *bs_channel;
+	uint64_t offset, length, start_io_unit, num_io_units;
+	uint32_t io_unit_size;
+
+	bs_channel = __file_io_bs_channel(file);
+	if (bs_channel == NULL) {
+		__readahead_failed(args, -ENOMEM);
+		return;
+	}
 
 	offset = args->op.readahead.offset;
 	length = args->op.readahead.length;
 	assert(length > 0);
 
-	__get_page_parameters(file, offset, length, &start_page, &page_size, &num_pages);
+	__get_io_unit_parameters(file, offset, length, &start_io_unit, &io_unit_size, &num_io_units);
 
-	BLOBFS_TRACE(file, "offset=%jx length=%jx page start=%jx num=%jx\n",
-		     offset, length, start_page, num_pages);
-	spdk_bs_io_read_blob(file->blob, file->fs->sync_target.sync_fs_channel->bs_channel,
+	BLOBFS_TRACE(file, "offset=%jx length=%jx io_unit start=%jx num=%jx\n",
+		     offset, length, start_io_unit, num_io_units);
+	spdk_bs_io_read_blob(file->blob, bs_channel,
 			     args->op.readahead.cache_buffer->buf,
-			     start_page, num_pages,
+			     start_io_unit, num_io_units,
 			     __readahead_done, args);
 }
 
@@ -2139,14 +3348,10 @@ __next_cache_buffer_offset(uint64_t offset)
 }
 
 static void
-check_readahead(struct spdk_file *file, uint64_t offset)
+__readahead_buffer(struct spdk_file *file, uint64_t offset)
 {
 	struct spdk_fs_cb_args *args;
-
-	offset = __next_cache_buffer_offset(offset);
-	if (spdk_tree_find_buffer(file->tree, offset) != NULL || file->length <= offset) {
-		return;
-	}
+	struct cache_buffer *buf;
 
 	args = calloc(1, sizeof(*args));
 	if (args == NULL) {
@@ -2155,28 +3360,121 @@ check_readahead(struct spdk_file *file, uint64_t offset)
 
 	BLOBFS_TRACE(file, "offset=%jx\n", offset);
 
+	buf = cache_insert_buffer(file, offset);
+	if (buf == NULL) {
+		free(args);
+		return;
+	}
+	buf->in_progress = true;
+	buf->readahead = true;
+	__atomic_fetch_add(&g_readahead_buffers, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&buf->shard->readahead_buffers, 1, __ATOMIC_RELAXED);
+
 	args->file = file;
 	args->op.readahead.offset = offset;
-	args->op.readahead.cache_buffer = cache_insert_buffer(file, offset);
-	args->op.readahead.cache_buffer->in_progress = true;
+	args->op.readahead.cache_buffer = buf;
 	if (file->length < (offset + CACHE_BUFFER_SIZE)) {
 		args->op.readahead.length = file->length & (CACHE_BUFFER_SIZE - 1);
 	} else {
 		args->op.readahead.length = CACHE_BUFFER_SIZE;
 	}
-	file->fs->send_request(__readahead, args);
+	__file_send_io_request(file, file->fs->send_request, __readahead, args);
+}
+
+/*
+ * Bytes to read ahead of the reader.  Without a hint, readahead starts once a file has
+ *  been read sequentially for CACHE_READAHEAD_THRESHOLD bytes, and the window then grows
+ *  with the length of the sequential run.  Any other read starts a new run.
+ */
+static uint64_t
+__readahead_window(struct spdk_file *file)
+{
+	switch (file->access_hint) {
+	case SPDK_FILE_ACCESS_RANDOM:
+		return 0;
+	case SPDK_FILE_ACCESS_SEQUENTIAL:
+		return g_readahead_file_max;
+	default:
+		if (file->seq_byte_count < CACHE_READAHEAD_THRESHOLD) {
+			return 0;
+		}
+		return spdk_min(spdk_max(file->seq_byte_count, CACHE_READAHEAD_MIN), g_readahead_file_max);
+	}
+}
+
+static uint64_t
+__readahead_max_buffers(void)
+{
+	if (g_readahead_total_max == 0) {
+		return g_cache_max_buffers / 4;
+	}
+	return g_readahead_total_max / CACHE_BUFFER_SIZE;
+}
+
+static void
+check_readahead(struct spdk_file *file, uint64_t offset, uint64_t length)
+{
+	uint64_t window, last, max_buffers;
+
+	window = __readahead_window(file);
+	if (window == 0) {
+		return;
+	}
+
+	max_buffers = __readahead_max_buffers();
+	last = offset + length - 1;
+	for (offset = __next_cache_buffer_offset(last);
+	     offset <= last + window && offset < file->length;
+	     offset += CACHE_BUFFER_SIZE) {
+		if (spdk_tree_find_buffer(file->tree, offset) != NULL) {
+			continue;
+		}
+		if (__atomic_load_n(&g_readahead_buffers, __ATOMIC_RELAXED) >= max_buffers) {
+			break;
+		}
+		__readahead_buffer(file, offset);
+	}
+}
+
+static void
+__cache_buffer_hit(struct cache_buffer *buf, struct cache_shard *shard)
+{
+	buf->referenced = true;
+	__atomic_fetch_add(&shard->hits, 1, __ATOMIC_RELAXED);
+	if (buf->readahead) {
+		buf->readahead = false;
+		__atomic_fetch_sub(&g_readahead_buffers, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&shard->readahead_hits, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void
+__file_track_read(struct spdk_file *file, uint64_t offset, uint64_t length)
+{
+	if (offset != file->next_seq_offset) {
+		file->seq_byte_count = 0;
+	}
+	file->seq_byte_count += length;
+	file->next_seq_offset = offset + length;
+	check_readahead(file, offset, length);
 }
 
 static int
 __file_read(struct spdk_file *file, void *payload, uint64_t offset, uint64_t length, sem_t *sem)
 {
+	struct cache_shard *shard;
 	struct cache_buffer *buf;
+	struct iovec iov;
 	int rc;
 
+	shard = &g_cache_shards[__cache_shard_index(file, offset)];
 	buf = spdk_tree_find_filled_buffer(file->tree, offset);
 	if (buf == NULL) {
+		__atomic_fetch_add(&shard->misses, 1, __ATOMIC_RELAXED);
 		pthread_spin_unlock(&file->lock);
-		rc = __send_rw_from_file(file, sem, payload, offset, length, true);
+		iov.iov_base = payload;
+		iov.iov_len = length;
+		rc = __send_rw_from_file(file, sem, &iov, 1, offset, length, true);
 		pthread_spin_lock(&file->lock);
 		return rc;
 	}
@@ -2186,27 +3484,23 @@ __file_read(struct spdk_file *file, void *payload, uint64_t offset, uint64_t len
 	}
 	BLOBFS_TRACE(file, "read %p offset=%ju length=%ju\n", payload, offset, length);
 	memcpy(payload, &buf->buf[offset - buf->offset], length);
-	if ((offset + length) % CACHE_BUFFER_SIZE == 0) {
-		pthread_spin_lock(&g_caches_lock);
-		spdk_tree_remove_buffer(file->tree, buf);
-		if (file->tree->present_mask == 0) {
-			TAILQ_REMOVE(&g_caches, file, cache_tailq);
-		}
-		pthread_spin_unlock(&g_caches_lock);
-	}
+	__cache_buffer_hit(buf, shard);
 
 	sem_post(sem);
 	return 0;
 }
 
-int64_t
-spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
-	       void *payload, uint64_t offset, uint64_t length)
+/*
+ * Read a file opened with SPDK_BLOBFS_OPEN_DIRECT straight from the blob, with one request
+ *  for the whole range that uses the caller's buffers when they are aligned.  Returns -EAGAIN
+ *  if part of the range is only in dirty cache buffers, so it must be read through the cache.
+ *  Otherwise sem is posted once the read is done, and *sub_reads counts that.
+ */
+static int64_t
+__file_submit_read_direct(struct spdk_file *file, sem_t *sem, struct iovec *iovs, int iovcnt,
+			  uint64_t offset, uint64_t length, uint32_t *sub_reads)
 {
-	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
-	uint64_t final_offset, final_length;
-	uint32_t sub_reads = 0;
-	int rc = 0;
+	int rc;
 
 	pthread_spin_lock(&file->lock);
 
@@ -2223,16 +3517,59 @@ spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
 		length = file->append_pos - offset;
 	}
 
-	if (offset != file->next_seq_offset) {
-		file->seq_byte_count = 0;
+	if (file->last != NULL && offset + length > file->length_flushed) {
+		pthread_spin_unlock(&file->lock);
+		return -EAGAIN;
 	}
-	file->seq_byte_count += length;
-	file->next_seq_offset = offset + length;
-	if (file->seq_byte_count >= CACHE_READAHEAD_THRESHOLD) {
-		check_readahead(file, offset);
-		check_readahead(file, offset + CACHE_BUFFER_SIZE);
+	pthread_spin_unlock(&file->lock);
+
+	rc = __send_rw_from_file(file, sem, iovs, iovcnt, offset, length, true);
+	(*sub_reads)++;
+
+	return rc == 0 ? (int64_t)length : rc;
+}
+
+static int64_t
+__file_read_direct(struct spdk_file *file, struct spdk_fs_channel *channel,
+		   struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length)
+{
+	uint32_t sub_reads = 0;
+	int64_t rc;
+
+	rc = __file_submit_read_direct(file, &channel->sem, iovs, iovcnt, offset, length, &sub_reads);
+	while (sub_reads-- > 0) {
+		sem_wait(&channel->sem);
 	}
 
+	return rc;
+}
+
+/*
+ * Start reading a range through the cache, with the file lock held.  Each cache buffer
+ *  of the range is copied, or read from the blob on a miss, and posts sem once done.
+ *  *sub_reads counts those posts.
+ */
+static int64_t
+__file_submit_read_cached(struct spdk_file *file, sem_t *sem, void *payload,
+			  uint64_t offset, uint64_t length, uint32_t *sub_reads)
+{
+	uint64_t final_offset, final_length;
+	int rc = 0;
+
+	BLOBFS_TRACE_RW(file, "offset=%ju length=%ju\n", offset, length);
+
+	file->open_for_writing = false;
+
+	if (length == 0 || offset >= file->append_pos) {
+		return 0;
+	}
+
+	if (offset + length > file->append_pos) {
+		length = file->append_pos - offset;
+	}
+
+	__file_track_read(file, offset, length);
+
 	final_length = 0;
 	final_offset = offset + length;
 	while (offset < final_offset) {
@@ -2240,7 +3577,9 @@ spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
 		if (length > (final_offset - offset)) {
 			length = final_offset - offset;
 		}
-		rc = __file_read(file, payload, offset, length, &channel->sem);
+		rc = __file_read(file, payload, offset, length, sem);
+		/* sem is posted even if the read could not be sent */
+		(*sub_reads)++;
 		if (rc == 0) {
 			final_length += length;
 		} else {
@@ -2248,12 +3587,8 @@ spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
 		}
 		payload += length;
 		offset += length;
-		sub_reads++;
-	}
-	pthread_spin_unlock(&file->lock);
-	while (sub_reads-- > 0) {
-		sem_wait(&channel->sem);
 	}
+
 	if (rc == 0) {
 		return final_length;
 	} else {
@@ -2261,6 +3596,184 @@ spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
 	}
 }
 
+static int64_t
+__file_read_cached(struct spdk_file *file, struct spdk_fs_channel *channel,
+		   void *payload, uint64_t offset, uint64_t length)
+{
+	uint32_t sub_reads = 0;
+	int64_t rc;
+
+	pthread_spin_lock(&file->lock);
+	rc = __file_submit_read_cached(file, &channel->sem, payload, offset, length, &sub_reads);
+	pthread_spin_unlock(&file->lock);
+	while (sub_reads-- > 0) {
+		sem_wait(&channel->sem);
+	}
+
+	return rc;
+}
+
+int64_t
+spdk_file_readv(struct spdk_file *file, struct spdk_io_channel *_channel,
+		struct iovec *iovs, int iovcnt, uint64_t offset)
+{
+	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	uint64_t length = 0;
+	int64_t rc, total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		length += iovs[i].iov_len;
+	}
+
+	if (file->direct) {
+		rc = __file_read_direct(file, channel, iovs, iovcnt, offset, length);
+		if (rc != -EAGAIN) {
+			return rc;
+		}
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		rc = __file_read_cached(file, channel, iovs[i].iov_base, offset, iovs[i].iov_len);
+		if (rc < 0) {
+			return total > 0 ? total : rc;
+		}
+		total += rc;
+		offset += rc;
+		if ((uint64_t)rc < iovs[i].iov_len) {
+			/* End of the file */
+			break;
+		}
+	}
+
+	return total;
+}
+
+int64_t
+spdk_file_read(struct spdk_file *file, struct spdk_io_channel *_channel,
+	       void *payload, uint64_t offset, uint64_t length)
+{
+	struct iovec iov = { .iov_base = payload, .iov_len = length };
+
+	return spdk_file_readv(file, _channel, &iov, 1, offset);
+}
+
+int
+spdk_file_read_batch(struct spdk_file *file, struct spdk_io_channel *_channel,
+		     struct spdk_file_read_req *reqs, uint32_t count)
+{
+	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	struct spdk_file_read_req *req;
+	struct iovec iov;
+	uint32_t i, sub_reads = 0;
+	int rc = 0;
+
+	for (i = 0; i < count; i++) {
+		req = &reqs[i];
+		req->result = -EAGAIN;
+		if (file->direct) {
+			iov.iov_base = req->payload;
+			iov.iov_len = req->length;
+			req->result = __file_submit_read_direct(file, &channel->sem, &iov, 1,
+								req->offset, req->length, &sub_reads);
+		}
+		if (req->result == -EAGAIN) {
+			pthread_spin_lock(&file->lock);
+			req->result = __file_submit_read_cached(file, &channel->sem, req->payload,
+								req->offset, req->length, &sub_reads);
+			pthread_spin_unlock(&file->lock);
+		}
+	}
+
+	while (sub_reads-- > 0) {
+		sem_wait(&channel->sem);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (reqs[i].result < 0 && rc == 0) {
+			rc = reqs[i].result;
+		}
+	}
+
+	return rc;
+}
+
+void
+spdk_file_prefetch(struct spdk_file *file, uint64_t offset, uint64_t length)
+{
+	uint64_t end, max_buffers;
+
+	pthread_spin_lock(&file->lock);
+
+	BLOBFS_TRACE_RW(file, "offset=%ju length=%ju\n", offset, length);
+
+	if (file->direct || length == 0 || offset >= file->length) {
+		pthread_spin_unlock(&file->lock);
+		return;
+	}
+
+	end = spdk_min(offset + length, file->length);
+	max_buffers = __readahead_max_buffers();
+	for (offset &= ~(CACHE_TREE_LEVEL_MASK(0)); offset < end; offset += CACHE_BUFFER_SIZE) {
+		if (spdk_tree_find_buffer(file->tree, offset) != NULL) {
+			continue;
+		}
+		if (__atomic_load_n(&g_readahead_buffers, __ATOMIC_RELAXED) >= max_buffers) {
+			break;
+		}
+		__readahead_buffer(file, offset);
+	}
+
+	pthread_spin_unlock(&file->lock);
+}
+
+int64_t
+spdk_file_pin_buffer(struct spdk_file *file, uint64_t offset, uint64_t length, const void **data)
+{
+	struct cache_shard *shard;
+	struct cache_buffer *buf;
+
+	pthread_spin_lock(&file->lock);
+
+	BLOBFS_TRACE_RW(file, "offset=%ju length=%ju\n", offset, length);
+
+	if (length == 0 || offset >= file->append_pos) {
+		pthread_spin_unlock(&file->lock);
+		*data = NULL;
+		return 0;
+	}
+
+	buf = spdk_tree_find_filled_buffer(file->tree, offset);
+	if (buf == NULL || offset >= buf->offset + buf->bytes_filled) {
+		pthread_spin_unlock(&file->lock);
+		return -ENODATA;
+	}
+
+	length = spdk_min(length, buf->offset + buf->bytes_filled - offset);
+	buf->pin_count++;
+	shard = &g_cache_shards[__cache_shard_index(file, offset)];
+	__cache_buffer_hit(buf, shard);
+	__file_track_read(file, offset, length);
+	*data = &buf->buf[offset - buf->offset];
+
+	pthread_spin_unlock(&file->lock);
+	return length;
+}
+
+void
+spdk_file_unpin_buffer(struct spdk_file *file, uint64_t offset)
+{
+	struct cache_buffer *buf;
+
+	pthread_spin_lock(&file->lock);
+	buf = spdk_tree_find_buffer(file->tree, offset);
+	assert(buf != NULL && buf->pin_count > 0);
+	if (buf != NULL && buf->pin_count > 0) {
+		buf->pin_count--;
+	}
+	pthread_spin_unlock(&file->lock);
+}
+
 static void
 _file_sync(struct spdk_file *file, struct spdk_fs_channel *channel,
 	   spdk_file_op_complete cb_fn, void *cb_arg)
@@ -2292,23 +3805,33 @@ _file_sync(struct spdk_file *file, struct spdk_fs_channel *channel,
 	sync_args->fn.file_op = cb_fn;
 	sync_args->arg = cb_arg;
 	sync_args->op.sync.offset = file->append_pos;
-	sync_args->op.sync.xattr_in_progress = false;
 	TAILQ_INSERT_TAIL(&file->sync_requests, sync_req, args.op.sync.tailq);
 	pthread_spin_unlock(&file->lock);
 
 	flush_args->file = file;
-	channel->send_request(__file_flush, flush_args);
+	__file_send_io_request(file, channel->send_request, __file_flush, flush_args);
+}
+
+static void
+__file_sync_done(void *arg, int fserrno)
+{
+	struct spdk_fs_cb_args *args = arg;
+
+	args->rc = fserrno;
+	sem_post(args->sem);
 }
 
 int
 spdk_file_sync(struct spdk_file *file, struct spdk_io_channel *_channel)
 {
 	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
+	struct spdk_fs_cb_args args = {};
 
-	_file_sync(file, channel, __sem_post, &channel->sem);
+	args.sem = &channel->sem;
+	_file_sync(file, channel, __file_sync_done, &args);
 	sem_wait(&channel->sem);
 
-	return 0;
+	return args.rc;
 }
 
 void
@@ -2328,6 +3851,38 @@ spdk_file_set_priority(struct spdk_file *file, uint32_t priority)
 
 }
 
+void
+spdk_file_set_access_hint(struct spdk_file *file, uint32_t hint)
+{
+	BLOBFS_TRACE(file, "hint=%u\n", hint);
+	file->access_hint = hint;
+}
+
+void
+spdk_file_invalidate_cache(struct spdk_file *file, uint64_t offset, uint64_t length)
+{
+	struct cache_buffer *buf;
+	uint64_t buf_offset;
+	bool to_end;
+
+	BLOBFS_TRACE(file, "offset=%jx length=%jx\n", offset, length);
+
+	pthread_spin_lock(&file->lock);
+	to_end = length == 0 || offset + length >= file->append_pos;
+	buf_offset = (offset + CACHE_BUFFER_SIZE - 1) & ~(CACHE_TREE_LEVEL_MASK(0));
+	for (; buf_offset < file->append_pos; buf_offset += CACHE_BUFFER_SIZE) {
+		if (!to_end && buf_offset + CACHE_BUFFER_SIZE > offset + length) {
+			break;
+		}
+		buf = spdk_tree_find_buffer(file->tree, buf_offset);
+		if (buf != NULL && !buf->in_progress && buf->bytes_filled == buf->bytes_flushed &&
+		    buf != file->last && buf->pin_count == 0) {
+			spdk_tree_remove_buffer(file->tree, buf);
+		}
+	}
+	pthread_spin_unlock(&file->lock);
+}
+
 /*
  * Close routines
  */
@@ -2343,7 +3898,8 @@ __file_close_async_done(void *ctx, int bserrno)
 		spdk_fs_delete_file_async(file->fs, file->name, blob_delete_cb, ctx);
 		return;
 	}
-	args->fn.file_op(args->arg, bserrno);
+	/* The file is closed either way; report the first error seen on the way */
+	args->fn.file_op(args->arg, args->rc != 0 ? args->rc : bserrno);
 	free_fs_request(req);
 }
 
@@ -2351,6 +3907,8 @@ static void
 __file_close_async(struct spdk_file *file, struct spdk_fs_request *req)
 {
 	struct spdk_blob *blob;
+	uint64_t num_clusters;
+	int rc;
 
 	pthread_spin_lock(&file->lock);
 	if (file->ref_count == 0) {
@@ -2366,10 +3924,20 @@ __file_close_async(struct spdk_file *file, struct spdk_fs_request *req)
 		return;
 	}
 
+	file->direct = false;
 	pthread_spin_unlock(&file->lock);
 
 	blob = file->blob;
 	file->blob = NULL;
+	num_clusters = __bytes_to_clusters(file->length, file->fs->bs_opts.cluster_sz);
+	if (!file->is_deleted && num_clusters < spdk_blob_get_num_clusters(blob)) {
+		/* Release the clusters preallocated past the end of the file, closing persists it */
+		rc = spdk_blob_resize(blob, num_clusters);
+		if (rc != 0) {
+			SPDK_ERRLOG("could not trim %s to %ju clusters: %d\n", file->name, num_clusters, rc);
+			req->args.rc = rc;
+		}
+	}
 	spdk_blob_close(blob, __file_close_async_done, req);
 }
 
@@ -2427,13 +3995,15 @@ spdk_file_close(struct spdk_file *file, struct spdk_io_channel *_channel)
 	struct spdk_fs_channel *channel = spdk_io_channel_get_ctx(_channel);
 	struct spdk_fs_request *req;
 	struct spdk_fs_cb_args *args;
+	int sync_rc;
 
 	req = alloc_fs_request(channel);
 	assert(req != NULL);
 
 	args = &req->args;
 
-	spdk_file_sync(file, _channel);
+	/* Close the file even if its data could not be synced, but report the error */
+	sync_rc = spdk_file_sync(file, _channel);
 	BLOBFS_TRACE(file, "name=%s\n", file->name);
 	args->file = file;
 	args->sem = &channel->sem;
@@ -2442,7 +4012,7 @@ spdk_file_close(struct spdk_file *file, struct spdk_io_channel *_channel)
 	channel->send_request(__file_close, req);
 	sem_wait(&channel->sem);
 
-	return args->rc;
+	return args->rc != 0 ? args->rc : sync_rc;
 }
 
 static void
@@ -2450,21 +4020,12 @@ cache_free_buffers(struct spdk_file *file)
 {
 	BLOBFS_TRACE(file, "free=%s\n", file->name);
 	pthread_spin_lock(&file->lock);
-	pthread_spin_lock(&g_caches_lock);
 	if (file->tree->present_mask == 0) {
-		pthread_spin_unlock(&g_caches_lock);
 		pthread_spin_unlock(&file->lock);
 		return;
 	}
 	spdk_tree_free_buffers(file->tree);
-
-	TAILQ_REMOVE(&g_caches, file, cache_tailq);
-	/* If not freed, put it in the end of the queue */
-	if (file->tree->present_mask != 0) {
-		TAILQ_INSERT_TAIL(&g_caches, file, cache_tailq);
-	}
 	file->last = NULL;
-	pthread_spin_unlock(&g_caches_lock);
 	pthread_spin_unlock(&file->lock);
 }
 
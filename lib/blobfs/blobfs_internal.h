@@ -56,6 +56,12 @@ void spdk_file_write_async(struct spdk_file *file, struct spdk_io_channel *chann
 void spdk_file_read_async(struct spdk_file *file, struct spdk_io_channel *channel,
 			  void *payload, uint64_t offset, uint64_t length,
 			  spdk_file_op_complete cb_fn, void *cb_arg);
+void spdk_file_writev_async(struct spdk_file *file, struct spdk_io_channel *channel,
+			    struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
+			    spdk_file_op_complete cb_fn, void *cb_arg);
+void spdk_file_readv_async(struct spdk_file *file, struct spdk_io_channel *channel,
+			   struct iovec *iovs, int iovcnt, uint64_t offset, uint64_t length,
+			   spdk_file_op_complete cb_fn, void *cb_arg);
 
 /* Sync all dirty cache buffers to the backing block device.  For async
  *  usage models, completion of the sync indicates only that data written
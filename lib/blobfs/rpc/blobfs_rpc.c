@@ -0,0 +1,121 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/blobfs.h"
+#include "spdk/rpc.h"
+#include "spdk/util.h"
+
+#include "spdk_internal/log.h"
+
+struct rpc_blobfs_cache_size {
+	uint64_t size_in_mb;
+};
+
+static const struct spdk_json_object_decoder rpc_blobfs_cache_size_decoders[] = {
+	{"size_in_mb", offsetof(struct rpc_blobfs_cache_size, size_in_mb), spdk_json_decode_uint64},
+};
+
+static void
+spdk_rpc_set_blobfs_cache_size(struct spdk_jsonrpc_request *request,
+			       const struct spdk_json_val *params)
+{
+	struct rpc_blobfs_cache_size req = {};
+	struct spdk_json_write_ctx *w;
+
+	if (spdk_json_decode_object(params, rpc_blobfs_cache_size_decoders,
+				    SPDK_COUNTOF(rpc_blobfs_cache_size_decoders), &req)) {
+		SPDK_DEBUGLOG(SPDK_LOG_BLOBFS, "spdk_json_decode_object failed\n");
+		goto invalid;
+	}
+
+	if (req.size_in_mb == 0) {
+		SPDK_DEBUGLOG(SPDK_LOG_BLOBFS, "cache size must not be 0\n");
+		goto invalid;
+	}
+
+	spdk_fs_set_cache_size(req.size_in_mb);
+
+	w = spdk_jsonrpc_begin_result(request);
+	if (w == NULL) {
+		return;
+	}
+
+	spdk_json_write_uint64(w, spdk_fs_get_cache_size());
+	spdk_jsonrpc_end_result(request, w);
+	return;
+
+invalid:
+	spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+}
+SPDK_RPC_REGISTER("set_blobfs_cache_size", spdk_rpc_set_blobfs_cache_size)
+
+static void
+spdk_rpc_get_blobfs_cache_stats(struct spdk_jsonrpc_request *request,
+				const struct spdk_json_val *params)
+{
+	struct spdk_fs_cache_stats stats;
+	struct spdk_json_write_ctx *w;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "get_blobfs_cache_stats requires no parameters");
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	if (w == NULL) {
+		return;
+	}
+
+	spdk_fs_get_cache_stats(&stats);
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_name(w, "cache_size_in_mb");
+	spdk_json_write_uint64(w, spdk_fs_get_cache_size());
+	spdk_json_write_name(w, "bytes_cached");
+	spdk_json_write_uint64(w, stats.bytes_cached);
+	spdk_json_write_name(w, "hits");
+	spdk_json_write_uint64(w, stats.hits);
+	spdk_json_write_name(w, "misses");
+	spdk_json_write_uint64(w, stats.misses);
+	spdk_json_write_name(w, "evictions");
+	spdk_json_write_uint64(w, stats.evictions);
+	spdk_json_write_name(w, "readahead_buffers");
+	spdk_json_write_uint64(w, stats.readahead_buffers);
+	spdk_json_write_name(w, "readahead_hits");
+	spdk_json_write_uint64(w, stats.readahead_hits);
+	spdk_json_write_object_end(w);
+
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("get_blobfs_cache_stats", spdk_rpc_get_blobfs_cache_stats)
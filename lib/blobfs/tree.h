@@ -34,6 +34,12 @@
 #ifndef SPDK_TREE_H_
 #define SPDK_TREE_H_
 
+#include "spdk/queue.h"
+
+struct spdk_file;
+struct cache_shard;
+struct cache_pool;
+
 struct cache_buffer {
 	uint8_t			*buf;
 	uint64_t		offset;
@@ -41,6 +47,19 @@ struct cache_buffer {
 	uint32_t		bytes_filled;
 	uint32_t		bytes_flushed;
 	bool			in_progress;
+	/* Set on each cache hit, cleared as the eviction clock passes over the buffer */
+	bool			referenced;
+	/* Filled by readahead and not read since */
+	bool			readahead;
+	/* Lent out by spdk_file_pin_buffer() - pinned buffers are never evicted */
+	uint32_t		pin_count;
+	uint8_t			priority;
+	struct spdk_file	*file;
+	/* Pool the memory of the buffer is returned to */
+	struct cache_pool	*pool;
+	/* Eviction shard the buffer is linked into, NULL once it has been evicted */
+	struct cache_shard	*shard;
+	TAILQ_ENTRY(cache_buffer)	lru_tailq;
 };
 
 extern uint32_t g_fs_cache_buffer_shift;
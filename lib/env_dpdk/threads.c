@@ -90,6 +90,33 @@ spdk_env_get_socket_id(uint32_t core)
 	return rte_lcore_to_socket_id(core);
 }
 
+int
+spdk_env_get_socket_id_of_cpu(uint32_t cpu)
+{
+	char path[64];
+	struct dirent *entry;
+	DIR *dir;
+	int socket_id = SPDK_ENV_SOCKET_ID_ANY;
+
+	/* DPDK only knows the sockets of its lcores, so ask sysfs about the OS CPU */
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+	dir = opendir(path);
+	if (dir == NULL) {
+		return SPDK_ENV_SOCKET_ID_ANY;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4])) {
+			socket_id = atoi(&entry->d_name[4]);
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	return socket_id;
+}
+
 int
 spdk_env_thread_launch_pinned(uint32_t core, thread_start_fn fn, void *arg)
 {
@@ -0,0 +1,389 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#include "spdk/likely.h"
+#include "spdk/queue.h"
+#include "spdk/util.h"
+
+#include <sys/syscall.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+/*
+ * DMA memory comes from arenas of ordinary pages rather than hugepages.  Each
+ *  arena is a memfd (falling back to anonymous memory) mapped at a 2MB-aligned
+ *  address and marked for transparent hugepages, so the kernel backs it with 2MB
+ *  pages whenever it can.  Arenas are registered with the memory maps like DPDK
+ *  memory segments, and spdk_dma_malloc() carves buffers out of them with a
+ *  first-fit free list.
+ */
+#define SPDK_DMA_ARENA_SIZE	(32ULL * 1024 * 1024)
+#define SPDK_DMA_MIN_ALIGN	SPDK_ENV_CACHE_LINE_SIZE
+#define SPDK_DMA_HDR_MAGIC	0x53504b444d41ULL
+
+struct spdk_dma_arena {
+	void				*addr;
+	size_t				len;
+	int				fd;
+	TAILQ_ENTRY(spdk_dma_arena)	tailq;
+};
+
+struct spdk_dma_extent {
+	uintptr_t			addr;
+	size_t				len;
+	TAILQ_ENTRY(spdk_dma_extent)	tailq;
+};
+
+/* Stored immediately before every buffer returned by spdk_dma_malloc(). */
+struct spdk_dma_hdr {
+	uint64_t	magic;
+	uintptr_t	block;
+	size_t		block_len;
+	size_t		size;
+};
+
+static TAILQ_HEAD(, spdk_dma_arena) g_dma_arenas = TAILQ_HEAD_INITIALIZER(g_dma_arenas);
+/* Free space in all arenas, sorted by address. */
+static TAILQ_HEAD(, spdk_dma_extent) g_dma_free = TAILQ_HEAD_INITIALIZER(g_dma_free);
+static pthread_mutex_t g_dma_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+_spdk_dma_memfd_create(void)
+{
+#ifdef SYS_memfd_create
+	return syscall(SYS_memfd_create, "spdk_dma", MFD_CLOEXEC);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void *
+_spdk_dma_arena_map(size_t len, int *fd)
+{
+	uint8_t *reserved, *addr;
+	size_t reserved_len = len + VALUE_2MB;
+	size_t off;
+	int flags = MAP_SHARED | MAP_FIXED;
+
+	*fd = _spdk_dma_memfd_create();
+	if (*fd >= 0 && ftruncate(*fd, len) != 0) {
+		close(*fd);
+		*fd = -1;
+	}
+
+	if (*fd < 0) {
+		flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+	}
+
+	/* Reserve enough address space to place the arena on a 2MB boundary. */
+	reserved = mmap(NULL, reserved_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved == MAP_FAILED) {
+		goto err;
+	}
+
+	addr = (uint8_t *)(((uintptr_t)reserved + MASK_2MB) & ~MASK_2MB);
+	if (addr > reserved) {
+		munmap(reserved, addr - reserved);
+	}
+	if (addr + len < reserved + reserved_len) {
+		munmap(addr + len, reserved + reserved_len - (addr + len));
+	}
+
+	if (mmap(addr, len, PROT_READ | PROT_WRITE, flags, *fd, 0) == MAP_FAILED) {
+		munmap(addr, len);
+		goto err;
+	}
+
+#ifdef MADV_HUGEPAGE
+	/* Best effort - shmem THP may be disabled, which only costs TLB misses. */
+	madvise(addr, len, MADV_HUGEPAGE);
+#endif
+
+	/* Fault everything in now, like hugepage memory, so I/O never waits on a page fault. */
+	for (off = 0; off < len; off += (MASK_4KB + 1)) {
+		((volatile uint8_t *)addr)[off] = 0;
+	}
+
+	return addr;
+
+err:
+	if (*fd >= 0) {
+		close(*fd);
+		*fd = -1;
+	}
+	return NULL;
+}
+
+/* Return a free extent to the sorted free list, merging it with its neighbours. */
+static int
+_spdk_dma_free_extent(uintptr_t addr, size_t len)
+{
+	struct spdk_dma_extent *ext, *prev = NULL, *next;
+
+	TAILQ_FOREACH(next, &g_dma_free, tailq) {
+		if (next->addr > addr) {
+			break;
+		}
+		prev = next;
+	}
+
+	if (prev && prev->addr + prev->len == addr) {
+		prev->len += len;
+		if (next && addr + len == next->addr) {
+			prev->len += next->len;
+			TAILQ_REMOVE(&g_dma_free, next, tailq);
+			free(next);
+		}
+		return 0;
+	}
+
+	if (next && addr + len == next->addr) {
+		next->addr = addr;
+		next->len += len;
+		return 0;
+	}
+
+	ext = calloc(1, sizeof(*ext));
+	if (ext == NULL) {
+		return -ENOMEM;
+	}
+
+	ext->addr = addr;
+	ext->len = len;
+	if (next) {
+		TAILQ_INSERT_BEFORE(next, ext, tailq);
+	} else {
+		TAILQ_INSERT_TAIL(&g_dma_free, ext, tailq);
+	}
+
+	return 0;
+}
+
+static int
+_spdk_dma_arena_add(size_t len)
+{
+	struct spdk_dma_arena *arena;
+
+	len = (len + MASK_2MB) & ~MASK_2MB;
+
+	arena = calloc(1, sizeof(*arena));
+	if (arena == NULL) {
+		return -ENOMEM;
+	}
+
+	arena->len = len;
+	arena->addr = _spdk_dma_arena_map(len, &arena->fd);
+	if (arena->addr == NULL) {
+		fprintf(stderr, "Failed to map %zu bytes of DMA memory: %s\n", len, strerror(errno));
+		free(arena);
+		return -ENOMEM;
+	}
+
+	if (spdk_mem_register(arena->addr, len) != 0 ||
+	    _spdk_dma_free_extent((uintptr_t)arena->addr, len) != 0) {
+		munmap(arena->addr, len);
+		if (arena->fd >= 0) {
+			close(arena->fd);
+		}
+		free(arena);
+		return -ENOMEM;
+	}
+
+	TAILQ_INSERT_TAIL(&g_dma_arenas, arena, tailq);
+
+	return 0;
+}
+
+static void *
+_spdk_dma_alloc_locked(size_t size, size_t align)
+{
+	struct spdk_dma_extent *ext;
+	struct spdk_dma_hdr *hdr;
+	uintptr_t buf, end;
+
+	TAILQ_FOREACH(ext, &g_dma_free, tailq) {
+		buf = (ext->addr + sizeof(*hdr) + align - 1) & ~(align - 1);
+		end = (buf + size + SPDK_DMA_MIN_ALIGN - 1) & ~(uintptr_t)(SPDK_DMA_MIN_ALIGN - 1);
+		if (end > ext->addr + ext->len) {
+			continue;
+		}
+
+		hdr = (struct spdk_dma_hdr *)buf - 1;
+		hdr->magic = SPDK_DMA_HDR_MAGIC;
+		hdr->block = ext->addr;
+		hdr->block_len = end - ext->addr;
+		hdr->size = size;
+
+		ext->len -= hdr->block_len;
+		ext->addr = end;
+		if (ext->len == 0) {
+			TAILQ_REMOVE(&g_dma_free, ext, tailq);
+			free(ext);
+		}
+
+		return (void *)buf;
+	}
+
+	return NULL;
+}
+
+static struct spdk_dma_hdr *
+_spdk_dma_get_hdr(void *buf)
+{
+	struct spdk_dma_hdr *hdr = (struct spdk_dma_hdr *)buf - 1;
+
+	if (spdk_unlikely(hdr->magic != SPDK_DMA_HDR_MAGIC)) {
+		fprintf(stderr, "%s: %p was not allocated with spdk_dma_malloc()\n", __func__, buf);
+		abort();
+	}
+
+	return hdr;
+}
+
+void *
+spdk_dma_malloc_socket(size_t size, size_t align, uint64_t *phys_addr, int socket_id)
+{
+	void *buf;
+
+	if (size == 0 || (align & (align - 1)) != 0) {
+		return NULL;
+	}
+
+	if (align < SPDK_DMA_MIN_ALIGN) {
+		align = SPDK_DMA_MIN_ALIGN;
+	}
+
+	pthread_mutex_lock(&g_dma_mutex);
+	buf = _spdk_dma_alloc_locked(size, align);
+	if (buf == NULL) {
+		if (_spdk_dma_arena_add(spdk_max(size + align + sizeof(struct spdk_dma_hdr),
+						  SPDK_DMA_ARENA_SIZE)) == 0) {
+			buf = _spdk_dma_alloc_locked(size, align);
+		}
+	}
+	pthread_mutex_unlock(&g_dma_mutex);
+
+	if (buf && phys_addr) {
+		*phys_addr = spdk_vtophys(buf);
+	}
+
+	return buf;
+}
+
+void *
+spdk_dma_zmalloc_socket(size_t size, size_t align, uint64_t *phys_addr, int socket_id)
+{
+	void *buf = spdk_dma_malloc_socket(size, align, phys_addr, socket_id);
+
+	if (buf) {
+		memset(buf, 0, size);
+	}
+
+	return buf;
+}
+
+void *
+spdk_dma_malloc(size_t size, size_t align, uint64_t *phys_addr)
+{
+	return spdk_dma_malloc_socket(size, align, phys_addr, SPDK_ENV_SOCKET_ID_ANY);
+}
+
+void *
+spdk_dma_zmalloc(size_t size, size_t align, uint64_t *phys_addr)
+{
+	return spdk_dma_zmalloc_socket(size, align, phys_addr, SPDK_ENV_SOCKET_ID_ANY);
+}
+
+void *
+spdk_dma_realloc(void *buf, size_t size, size_t align, uint64_t *phys_addr)
+{
+	void *new_buf;
+
+	if (buf == NULL) {
+		return spdk_dma_malloc(size, align, phys_addr);
+	}
+
+	new_buf = spdk_dma_malloc(size, align, phys_addr);
+	if (new_buf == NULL) {
+		return NULL;
+	}
+
+	memcpy(new_buf, buf, spdk_min(size, _spdk_dma_get_hdr(buf)->size));
+	spdk_dma_free(buf);
+
+	return new_buf;
+}
+
+void
+spdk_dma_free(void *buf)
+{
+	struct spdk_dma_hdr *hdr;
+
+	if (buf == NULL) {
+		return;
+	}
+
+	hdr = _spdk_dma_get_hdr(buf);
+	hdr->magic = 0;
+
+	pthread_mutex_lock(&g_dma_mutex);
+	if (_spdk_dma_free_extent(hdr->block, hdr->block_len) != 0) {
+		/* Leak the block rather than corrupt the free list. */
+		fprintf(stderr, "%s: failed to track %zu free bytes\n", __func__, hdr->block_len);
+	}
+	pthread_mutex_unlock(&g_dma_mutex);
+}
+
+int
+spdk_env_dma_init(size_t initial_size)
+{
+	int rc = 0;
+
+	if (initial_size == 0) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_dma_mutex);
+	rc = _spdk_dma_arena_add(initial_size);
+	pthread_mutex_unlock(&g_dma_mutex);
+
+	return rc;
+}
@@ -0,0 +1,261 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#include "spdk/queue.h"
+
+#define SPDK_MEMZONE_NAME_LEN	32
+
+struct spdk_memzone {
+	char				name[SPDK_MEMZONE_NAME_LEN];
+	void				*addr;
+	size_t				len;
+	int				socket_id;
+	TAILQ_ENTRY(spdk_memzone)	tailq;
+};
+
+static TAILQ_HEAD(, spdk_memzone) g_memzones = TAILQ_HEAD_INITIALIZER(g_memzones);
+static pthread_mutex_t g_memzones_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t g_ticks_hz;
+
+static struct spdk_memzone *
+_spdk_memzone_lookup(const char *name)
+{
+	struct spdk_memzone *mz;
+
+	TAILQ_FOREACH(mz, &g_memzones, tailq) {
+		if (strcmp(mz->name, name) == 0) {
+			return mz;
+		}
+	}
+
+	return NULL;
+}
+
+void *
+spdk_memzone_reserve(const char *name, size_t len, int socket_id, unsigned flags)
+{
+	struct spdk_memzone *mz;
+
+	if (name == NULL || strlen(name) >= SPDK_MEMZONE_NAME_LEN) {
+		return NULL;
+	}
+
+	mz = calloc(1, sizeof(*mz));
+	if (mz == NULL) {
+		return NULL;
+	}
+
+	snprintf(mz->name, sizeof(mz->name), "%s", name);
+	mz->len = len;
+	mz->socket_id = socket_id;
+	mz->addr = spdk_dma_zmalloc_socket(len, SPDK_ENV_CACHE_LINE_SIZE, NULL, socket_id);
+	if (mz->addr == NULL) {
+		free(mz);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&g_memzones_mutex);
+	if (_spdk_memzone_lookup(name) != NULL) {
+		pthread_mutex_unlock(&g_memzones_mutex);
+		spdk_dma_free(mz->addr);
+		free(mz);
+		return NULL;
+	}
+	TAILQ_INSERT_TAIL(&g_memzones, mz, tailq);
+	pthread_mutex_unlock(&g_memzones_mutex);
+
+	return mz->addr;
+}
+
+void *
+spdk_memzone_lookup(const char *name)
+{
+	struct spdk_memzone *mz;
+	void *addr = NULL;
+
+	pthread_mutex_lock(&g_memzones_mutex);
+	mz = _spdk_memzone_lookup(name);
+	if (mz != NULL) {
+		addr = mz->addr;
+	}
+	pthread_mutex_unlock(&g_memzones_mutex);
+
+	return addr;
+}
+
+int
+spdk_memzone_free(const char *name)
+{
+	struct spdk_memzone *mz;
+
+	pthread_mutex_lock(&g_memzones_mutex);
+	mz = _spdk_memzone_lookup(name);
+	if (mz != NULL) {
+		TAILQ_REMOVE(&g_memzones, mz, tailq);
+	}
+	pthread_mutex_unlock(&g_memzones_mutex);
+
+	if (mz == NULL) {
+		return -1;
+	}
+
+	spdk_dma_free(mz->addr);
+	free(mz);
+
+	return 0;
+}
+
+void
+spdk_memzone_dump(FILE *f)
+{
+	struct spdk_memzone *mz;
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&g_memzones_mutex);
+	TAILQ_FOREACH(mz, &g_memzones, tailq) {
+		fprintf(f, "Zone %u: name:<%s>, addr:%p, len:0x%zx, socket_id:%d\n",
+			i++, mz->name, mz->addr, mz->len, mz->socket_id);
+	}
+	pthread_mutex_unlock(&g_memzones_mutex);
+}
+
+bool
+spdk_process_is_primary(void)
+{
+	/* Multi-process mode needs shared hugepage memory, so every process is primary. */
+	return true;
+}
+
+static uint64_t
+_spdk_get_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t
+spdk_get_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return _spdk_get_monotonic_ns();
+#endif
+}
+
+void
+spdk_env_ticks_init(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	struct timespec delay = { .tv_sec = 0, .tv_nsec = 10 * 1000 * 1000 };
+	uint64_t start_ns, start_tsc, ns, tsc;
+
+	/* Measure the TSC rate against the monotonic clock. */
+	start_ns = _spdk_get_monotonic_ns();
+	start_tsc = spdk_get_ticks();
+	nanosleep(&delay, NULL);
+	ns = _spdk_get_monotonic_ns() - start_ns;
+	tsc = spdk_get_ticks() - start_tsc;
+
+	g_ticks_hz = tsc * 1000000000ULL / ns;
+#else
+	g_ticks_hz = 1000000000ULL;
+#endif
+}
+
+uint64_t
+spdk_get_ticks_hz(void)
+{
+	if (g_ticks_hz == 0) {
+		spdk_env_ticks_init();
+	}
+
+	return g_ticks_hz;
+}
+
+void
+spdk_delay_us(unsigned int us)
+{
+	uint64_t end = spdk_get_ticks() + us * spdk_get_ticks_hz() / 1000000ULL;
+
+	while (spdk_get_ticks() < end) {
+		;
+	}
+}
+
+void
+spdk_unaffinitize_thread(void)
+{
+	cpu_set_t new_cpuset;
+	long num_cores, i;
+
+	CPU_ZERO(&new_cpuset);
+
+	num_cores = sysconf(_SC_NPROCESSORS_CONF);
+
+	/* Create a mask containing all CPUs */
+	for (i = 0; i < num_cores; i++) {
+		CPU_SET(i, &new_cpuset);
+	}
+
+	pthread_setaffinity_np(pthread_self(), sizeof(new_cpuset), &new_cpuset);
+}
+
+void *
+spdk_call_unaffinitized(void *cb(void *arg), void *arg)
+{
+	cpu_set_t orig_cpuset;
+	void *ret;
+
+	if (cb == NULL) {
+		return NULL;
+	}
+
+	pthread_getaffinity_np(pthread_self(), sizeof(orig_cpuset), &orig_cpuset);
+
+	spdk_unaffinitize_thread();
+
+	ret = cb(arg);
+
+	pthread_setaffinity_np(pthread_self(), sizeof(orig_cpuset), &orig_cpuset);
+
+	return ret;
+}
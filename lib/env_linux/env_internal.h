@@ -0,0 +1,102 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SPDK_ENV_LINUX_INTERNAL_H
+#define SPDK_ENV_LINUX_INTERNAL_H
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+
+/* x86-64 userspace virtual addresses use only the low 47 bits [0..46],
+ * which is enough to cover 128 TB.
+ */
+#define SHIFT_128TB	47 /* (1 << 47) == 128 TB */
+#define MASK_128TB	((1ULL << SHIFT_128TB) - 1)
+
+#define SHIFT_1GB	30 /* (1 << 30) == 1 GB */
+#define MASK_1GB	((1ULL << SHIFT_1GB) - 1)
+
+#define SHIFT_2MB	21 /* (1 << 21) == 2MB */
+#define MASK_2MB	((1ULL << SHIFT_2MB) - 1)
+#define VALUE_2MB	(1 << SHIFT_2MB)
+
+#define SHIFT_4KB	12 /* (1 << 12) == 4KB */
+#define MASK_4KB	((1ULL << SHIFT_4KB) - 1)
+
+#define SPDK_ENV_MAX_CORES	128
+
+#define SPDK_ENV_CACHE_LINE_SIZE	64
+
+/*
+ * There is no PCI access without DPDK, so devices are never handed out.  The
+ *  structure only exists so the spdk_pci_device accessors have something to
+ *  dereference.
+ */
+struct spdk_pci_device {
+	struct spdk_pci_addr	addr;
+	struct spdk_pci_id	id;
+	int			socket_id;
+};
+
+/* threads.c */
+int spdk_env_threads_init(const char *core_mask, int master_core);
+bool spdk_env_core_is_enabled(uint32_t core);
+void spdk_env_set_current_core(uint32_t core);
+
+/* env.c */
+void spdk_env_ticks_init(void);
+
+/*
+ * ring.c - the public spdk_ring functions are built on these, which also back the
+ *  mempool and so have to allow several consumers.  With bulk set, either all count
+ *  objects are moved or none are.
+ */
+struct spdk_ring *spdk_env_ring_alloc(size_t count);
+size_t spdk_env_ring_enqueue(struct spdk_ring *ring, void *const *objs, size_t count,
+			     bool single, bool bulk);
+size_t spdk_env_ring_dequeue(struct spdk_ring *ring, void **objs, size_t count,
+			     bool single, bool bulk);
+size_t spdk_env_ring_count(const struct spdk_ring *ring);
+
+/* dma.c */
+int spdk_env_dma_init(size_t initial_size);
+
+/* memory.c */
+void spdk_mem_map_init(void);
+
+/* vtophys.c */
+void spdk_vtophys_init(void);
+
+#endif
@@ -0,0 +1,88 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#define SPDK_ENV_LINUX_DEFAULT_NAME		"spdk"
+#define SPDK_ENV_LINUX_DEFAULT_SHM_ID		-1
+#define SPDK_ENV_LINUX_DEFAULT_MEM_SIZE		-1
+#define SPDK_ENV_LINUX_DEFAULT_MASTER_CORE	-1
+#define SPDK_ENV_LINUX_DEFAULT_MEM_CHANNEL	-1
+#define SPDK_ENV_LINUX_DEFAULT_CORE_MASK	"0x1"
+
+void
+spdk_env_opts_init(struct spdk_env_opts *opts)
+{
+	if (!opts) {
+		return;
+	}
+
+	memset(opts, 0, sizeof(*opts));
+
+	opts->name = SPDK_ENV_LINUX_DEFAULT_NAME;
+	opts->core_mask = SPDK_ENV_LINUX_DEFAULT_CORE_MASK;
+	opts->shm_id = SPDK_ENV_LINUX_DEFAULT_SHM_ID;
+	opts->mem_size = SPDK_ENV_LINUX_DEFAULT_MEM_SIZE;
+	opts->master_core = SPDK_ENV_LINUX_DEFAULT_MASTER_CORE;
+	opts->mem_channel = SPDK_ENV_LINUX_DEFAULT_MEM_CHANNEL;
+}
+
+void spdk_env_init(const struct spdk_env_opts *opts)
+{
+	size_t mem_size = 0;
+
+	printf("Starting %s initialization without DPDK (core mask %s)...\n",
+	       opts->name, opts->core_mask);
+
+	if (spdk_env_threads_init(opts->core_mask, opts->master_core) != 0) {
+		fprintf(stderr, "Invalid arguments to initialize the environment\n");
+		exit(-1);
+	}
+
+	spdk_env_ticks_init();
+	spdk_mem_map_init();
+	spdk_vtophys_init();
+
+	/* With -s, map the requested memory up front.  Otherwise it is mapped on demand. */
+	if (opts->mem_size > 0) {
+		mem_size = (size_t)opts->mem_size * 1024 * 1024;
+	}
+
+	if (spdk_env_dma_init(mem_size) != 0) {
+		fprintf(stderr, "Failed to allocate %zu bytes of DMA memory\n", mem_size);
+		exit(-1);
+	}
+}
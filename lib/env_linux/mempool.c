@@ -0,0 +1,290 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#include "spdk/likely.h"
+#include "spdk/queue.h"
+#include "spdk/util.h"
+
+#define SPDK_MEMPOOL_NAME_LEN		32
+#define SPDK_MEMPOOL_CACHE_MAX_SIZE	512
+
+/*
+ * Each core owns a small stack of free elements so that get/put from a reactor
+ *  normally never touches the shared ring.  Only the thread pinned to that core
+ *  uses the cache; threads that are not running on an SPDK core go straight to
+ *  the ring.
+ */
+struct spdk_mempool_cache {
+	uint32_t	len;
+	void		*objs[];
+} __attribute__((aligned(SPDK_ENV_CACHE_LINE_SIZE)));
+
+struct spdk_mempool {
+	char				name[SPDK_MEMPOOL_NAME_LEN];
+	size_t				count;
+	size_t				ele_size;
+	uint32_t			cache_size;
+	uint32_t			cache_flush_thresh;
+	void				*ele_mem;
+	struct spdk_ring		*ring;
+	struct spdk_mempool_cache	*caches[SPDK_ENV_MAX_CORES];
+	TAILQ_ENTRY(spdk_mempool)	tailq;
+};
+
+static TAILQ_HEAD(, spdk_mempool) g_mempools = TAILQ_HEAD_INITIALIZER(g_mempools);
+static pthread_mutex_t g_mempools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct spdk_mempool *
+_spdk_mempool_lookup(const char *name)
+{
+	struct spdk_mempool *mp;
+
+	TAILQ_FOREACH(mp, &g_mempools, tailq) {
+		if (strcmp(mp->name, name) == 0) {
+			return mp;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+_spdk_mempool_destroy(struct spdk_mempool *mp)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPDK_ENV_MAX_CORES; i++) {
+		free(mp->caches[i]);
+	}
+
+	if (mp->ring) {
+		spdk_ring_free(mp->ring);
+	}
+
+	spdk_dma_free(mp->ele_mem);
+	free(mp);
+}
+
+struct spdk_mempool *
+spdk_mempool_create_ctor(const char *name, size_t count,
+			 size_t ele_size, size_t cache_size, int socket_id,
+			 spdk_mempool_obj_cb_t *obj_init, void *obj_init_arg)
+{
+	struct spdk_mempool *mp;
+	size_t tmp, i;
+	uint32_t core;
+	uint8_t *ele;
+
+	if (name == NULL || count == 0 || ele_size == 0 ||
+	    strlen(name) >= SPDK_MEMPOOL_NAME_LEN) {
+		return NULL;
+	}
+
+	/* No more than half of all elements can be in cache */
+	tmp = (count / 2) / spdk_max(spdk_env_get_core_count(), 1U);
+	if (cache_size > tmp) {
+		cache_size = tmp;
+	}
+
+	if (cache_size > SPDK_MEMPOOL_CACHE_MAX_SIZE) {
+		cache_size = SPDK_MEMPOOL_CACHE_MAX_SIZE;
+	}
+
+	mp = calloc(1, sizeof(*mp));
+	if (mp == NULL) {
+		return NULL;
+	}
+
+	snprintf(mp->name, sizeof(mp->name), "%s", name);
+	mp->count = count;
+	mp->ele_size = (ele_size + SPDK_ENV_CACHE_LINE_SIZE - 1) & ~(SPDK_ENV_CACHE_LINE_SIZE - 1);
+	mp->cache_size = cache_size;
+	mp->cache_flush_thresh = cache_size + cache_size / 2;
+
+	mp->ring = spdk_env_ring_alloc(count);
+	mp->ele_mem = spdk_dma_malloc(mp->ele_size * count, 0x1000, NULL);
+	if (mp->ring == NULL || mp->ele_mem == NULL) {
+		_spdk_mempool_destroy(mp);
+		return NULL;
+	}
+
+	if (cache_size > 0) {
+		SPDK_ENV_FOREACH_CORE(core) {
+			if (posix_memalign((void **)&mp->caches[core], SPDK_ENV_CACHE_LINE_SIZE,
+					   sizeof(struct spdk_mempool_cache) +
+					   (mp->cache_flush_thresh + 1) * sizeof(void *))) {
+				mp->caches[core] = NULL;
+				_spdk_mempool_destroy(mp);
+				return NULL;
+			}
+			mp->caches[core]->len = 0;
+		}
+	}
+
+	ele = mp->ele_mem;
+	for (i = 0; i < count; i++) {
+		if (obj_init) {
+			obj_init(mp, obj_init_arg, ele, i);
+		}
+		spdk_env_ring_enqueue(mp->ring, (void **)&ele, 1, true, true);
+		ele += mp->ele_size;
+	}
+
+	pthread_mutex_lock(&g_mempools_mutex);
+	if (_spdk_mempool_lookup(name) != NULL) {
+		pthread_mutex_unlock(&g_mempools_mutex);
+		_spdk_mempool_destroy(mp);
+		return NULL;
+	}
+	TAILQ_INSERT_TAIL(&g_mempools, mp, tailq);
+	pthread_mutex_unlock(&g_mempools_mutex);
+
+	return mp;
+}
+
+struct spdk_mempool *
+spdk_mempool_create(const char *name, size_t count,
+		    size_t ele_size, size_t cache_size, int socket_id)
+{
+	return spdk_mempool_create_ctor(name, count, ele_size, cache_size, socket_id,
+					NULL, NULL);
+}
+
+char *
+spdk_mempool_get_name(struct spdk_mempool *mp)
+{
+	return mp->name;
+}
+
+void
+spdk_mempool_free(struct spdk_mempool *mp)
+{
+	if (mp == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_mempools_mutex);
+	TAILQ_REMOVE(&g_mempools, mp, tailq);
+	pthread_mutex_unlock(&g_mempools_mutex);
+
+	_spdk_mempool_destroy(mp);
+}
+
+static inline struct spdk_mempool_cache *
+_spdk_mempool_get_cache(struct spdk_mempool *mp)
+{
+	uint32_t core = spdk_env_get_current_core();
+
+	if (spdk_unlikely(core >= SPDK_ENV_MAX_CORES)) {
+		return NULL;
+	}
+
+	return mp->caches[core];
+}
+
+void *
+spdk_mempool_get(struct spdk_mempool *mp)
+{
+	struct spdk_mempool_cache *cache;
+	void *ele = NULL;
+
+	cache = _spdk_mempool_get_cache(mp);
+	if (spdk_unlikely(cache == NULL)) {
+		spdk_env_ring_dequeue(mp->ring, &ele, 1, false, true);
+		return ele;
+	}
+
+	if (cache->len == 0) {
+		cache->len = spdk_env_ring_dequeue(mp->ring, cache->objs, mp->cache_size, false, false);
+		if (cache->len == 0) {
+			return NULL;
+		}
+	}
+
+	return cache->objs[--cache->len];
+}
+
+void
+spdk_mempool_put(struct spdk_mempool *mp, void *ele)
+{
+	spdk_mempool_put_bulk(mp, &ele, 1);
+}
+
+void
+spdk_mempool_put_bulk(struct spdk_mempool *mp, void *const *ele_arr, size_t count)
+{
+	struct spdk_mempool_cache *cache;
+	size_t n;
+
+	cache = _spdk_mempool_get_cache(mp);
+	if (spdk_unlikely(cache == NULL)) {
+		spdk_env_ring_enqueue(mp->ring, ele_arr, count, false, true);
+		return;
+	}
+
+	while (count > 0) {
+		n = spdk_min(count, mp->cache_flush_thresh + 1 - cache->len);
+		memcpy(&cache->objs[cache->len], ele_arr, n * sizeof(void *));
+		cache->len += n;
+		ele_arr += n;
+		count -= n;
+
+		if (cache->len > mp->cache_flush_thresh) {
+			/* Keep cache_size elements for the next gets and return the rest. */
+			spdk_env_ring_enqueue(mp->ring, &cache->objs[mp->cache_size],
+					      cache->len - mp->cache_size, false, true);
+			cache->len = mp->cache_size;
+		}
+	}
+}
+
+size_t
+spdk_mempool_count(const struct spdk_mempool *pool)
+{
+	size_t count;
+	uint32_t i;
+
+	count = spdk_env_ring_count(pool->ring);
+	for (i = 0; i < SPDK_ENV_MAX_CORES; i++) {
+		if (pool->caches[i]) {
+			count += pool->caches[i]->len;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,224 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#include "spdk/likely.h"
+
+/*
+ * Lock-free bounded ring, modelled on the DPDK ring.  Producers and consumers each
+ *  have a head and a tail.  A producer reserves slots by moving the producer head
+ *  (with a compare-and-swap when there may be several producers), fills them in, and
+ *  then publishes them by moving the producer tail once every earlier producer has
+ *  published.  Consumers do the same on the other side.
+ */
+struct spdk_ring_headtail {
+	volatile uint32_t	head;
+	volatile uint32_t	tail;
+} __attribute__((aligned(SPDK_ENV_CACHE_LINE_SIZE)));
+
+struct spdk_ring {
+	uint32_t			size;
+	uint32_t			mask;
+
+	struct spdk_ring_headtail	prod;
+	struct spdk_ring_headtail	cons;
+
+	void				*objs[] __attribute__((aligned(SPDK_ENV_CACHE_LINE_SIZE)));
+};
+
+static inline void
+_spdk_ring_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+struct spdk_ring *
+spdk_env_ring_alloc(size_t count)
+{
+	struct spdk_ring *ring;
+	size_t size = 1;
+
+	if (count == 0 || count > (1U << 31)) {
+		return NULL;
+	}
+
+	while (size < count) {
+		size <<= 1;
+	}
+
+	if (posix_memalign((void **)&ring, SPDK_ENV_CACHE_LINE_SIZE,
+			   sizeof(*ring) + size * sizeof(void *))) {
+		return NULL;
+	}
+
+	memset(ring, 0, sizeof(*ring));
+	ring->size = size;
+	ring->mask = size - 1;
+
+	return ring;
+}
+
+size_t
+spdk_env_ring_enqueue(struct spdk_ring *ring, void *const *objs, size_t count,
+		      bool single, bool bulk)
+{
+	uint32_t head, next, cons_tail, free_entries, n, i;
+
+	head = __atomic_load_n(&ring->prod.head, __ATOMIC_RELAXED);
+	do {
+		cons_tail = __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE);
+		free_entries = ring->size + cons_tail - head;
+
+		n = count;
+		if (spdk_unlikely(n > free_entries)) {
+			if (bulk || free_entries == 0) {
+				return 0;
+			}
+			n = free_entries;
+		}
+
+		next = head + n;
+		if (single) {
+			ring->prod.head = next;
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&ring->prod.head, &head, next, true,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	for (i = 0; i < n; i++) {
+		ring->objs[(head + i) & ring->mask] = objs[i];
+	}
+
+	/* Publish in reservation order, after any producer that reserved before us. */
+	while (spdk_unlikely(__atomic_load_n(&ring->prod.tail, __ATOMIC_RELAXED) != head)) {
+		_spdk_ring_pause();
+	}
+	__atomic_store_n(&ring->prod.tail, next, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+size_t
+spdk_env_ring_dequeue(struct spdk_ring *ring, void **objs, size_t count,
+		      bool single, bool bulk)
+{
+	uint32_t head, next, prod_tail, entries, n, i;
+
+	head = __atomic_load_n(&ring->cons.head, __ATOMIC_RELAXED);
+	do {
+		prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+		entries = prod_tail - head;
+
+		n = count;
+		if (spdk_unlikely(n > entries)) {
+			if (bulk || entries == 0) {
+				return 0;
+			}
+			n = entries;
+		}
+
+		next = head + n;
+		if (single) {
+			ring->cons.head = next;
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&ring->cons.head, &head, next, true,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	for (i = 0; i < n; i++) {
+		objs[i] = ring->objs[(head + i) & ring->mask];
+	}
+
+	while (spdk_unlikely(__atomic_load_n(&ring->cons.tail, __ATOMIC_RELAXED) != head)) {
+		_spdk_ring_pause();
+	}
+	__atomic_store_n(&ring->cons.tail, next, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+size_t
+spdk_env_ring_count(const struct spdk_ring *ring)
+{
+	uint32_t prod_tail, cons_tail;
+
+	cons_tail = __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE);
+	prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+
+	return prod_tail - cons_tail;
+}
+
+struct spdk_ring *
+spdk_ring_create(enum spdk_ring_type type, size_t count, int socket_id)
+{
+	switch (type) {
+	case SPDK_RING_TYPE_SP_SC:
+	case SPDK_RING_TYPE_MP_SC:
+		break;
+	default:
+		return NULL;
+	}
+
+	return spdk_env_ring_alloc(count);
+}
+
+void
+spdk_ring_free(struct spdk_ring *ring)
+{
+	free(ring);
+}
+
+size_t
+spdk_ring_count(struct spdk_ring *ring)
+{
+	return spdk_env_ring_count(ring);
+}
+
+size_t
+spdk_ring_enqueue(struct spdk_ring *ring, void **objs, size_t count)
+{
+	/* Like the DPDK environment, enqueue is all-or-nothing and always multi-producer safe. */
+	return spdk_env_ring_enqueue(ring, objs, count, false, true);
+}
+
+size_t
+spdk_ring_dequeue(struct spdk_ring *ring, void **objs, size_t count)
+{
+	return spdk_env_ring_dequeue(ring, objs, count, true, false);
+}
@@ -0,0 +1,317 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+struct spdk_env_thread {
+	uint32_t		core;
+	thread_start_fn		fn;
+	void			*arg;
+};
+
+static uint64_t g_core_mask[SPDK_ENV_MAX_CORES / 64];
+static uint32_t g_core_count;
+static uint32_t g_master_core;
+static int32_t g_socket_ids[SPDK_ENV_MAX_CORES];
+static pthread_t g_threads[SPDK_ENV_MAX_CORES];
+static bool g_thread_launched[SPDK_ENV_MAX_CORES];
+
+static __thread uint32_t g_current_core = SPDK_ENV_LCORE_ID_ANY;
+
+bool
+spdk_env_core_is_enabled(uint32_t core)
+{
+	if (core >= SPDK_ENV_MAX_CORES) {
+		return false;
+	}
+
+	return (g_core_mask[core / 64] & (1ULL << (core % 64))) != 0;
+}
+
+void
+spdk_env_set_current_core(uint32_t core)
+{
+	g_current_core = core;
+}
+
+static int
+_spdk_env_parse_core_mask(const char *core_mask)
+{
+	const char *p;
+	uint32_t bit = 0;
+	int val;
+
+	if (core_mask == NULL) {
+		return -EINVAL;
+	}
+
+	if (core_mask[0] == '0' && (core_mask[1] == 'x' || core_mask[1] == 'X')) {
+		core_mask += 2;
+	}
+
+	if (*core_mask == '\0') {
+		return -EINVAL;
+	}
+
+	memset(g_core_mask, 0, sizeof(g_core_mask));
+
+	/* Walk the hex digits from least to most significant. */
+	for (p = core_mask + strlen(core_mask) - 1; p >= core_mask; p--, bit += 4) {
+		if (!isxdigit(*p)) {
+			return -EINVAL;
+		}
+
+		val = isdigit(*p) ? *p - '0' : tolower(*p) - 'a' + 10;
+		if (val == 0) {
+			continue;
+		}
+
+		if (bit >= SPDK_ENV_MAX_CORES) {
+			return -EINVAL;
+		}
+
+		g_core_mask[bit / 64] |= (uint64_t)val << (bit % 64);
+	}
+
+	return 0;
+}
+
+int
+spdk_env_get_socket_id_of_cpu(uint32_t cpu)
+{
+	char path[64];
+	struct dirent *entry;
+	DIR *dir;
+	int socket_id = SPDK_ENV_SOCKET_ID_ANY;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+	dir = opendir(path);
+	if (dir == NULL) {
+		return SPDK_ENV_SOCKET_ID_ANY;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4])) {
+			socket_id = atoi(&entry->d_name[4]);
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	return socket_id;
+}
+
+static void
+_spdk_env_pin_current_thread(uint32_t core)
+{
+	cpu_set_t cpuset;
+	int rc;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(core, &cpuset);
+
+	rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+	if (rc != 0) {
+		/* Containers often restrict the usable CPUs.  Run unpinned rather than fail. */
+		fprintf(stderr, "Could not pin thread to core %u: %s\n", core, strerror(rc));
+	}
+}
+
+int
+spdk_env_threads_init(const char *core_mask, int master_core)
+{
+	long num_cpus;
+	uint32_t core;
+	int socket_id;
+
+	if (_spdk_env_parse_core_mask(core_mask) != 0) {
+		fprintf(stderr, "Invalid core mask '%s'\n", core_mask ? core_mask : "");
+		return -EINVAL;
+	}
+
+	num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	g_core_count = 0;
+	for (core = 0; core < SPDK_ENV_MAX_CORES; core++) {
+		if (!spdk_env_core_is_enabled(core)) {
+			continue;
+		}
+
+		if (core >= num_cpus) {
+			fprintf(stderr, "Core %u in mask '%s' does not exist\n", core, core_mask);
+			return -EINVAL;
+		}
+
+		/* Machines without NUMA have no node entries; everything is on socket 0 */
+		socket_id = spdk_env_get_socket_id_of_cpu(core);
+		g_socket_ids[core] = socket_id == SPDK_ENV_SOCKET_ID_ANY ? 0 : socket_id;
+		g_core_count++;
+	}
+
+	if (g_core_count == 0) {
+		fprintf(stderr, "Core mask '%s' does not select any cores\n", core_mask);
+		return -EINVAL;
+	}
+
+	if (master_core < 0) {
+		g_master_core = spdk_env_get_first_core();
+	} else if (spdk_env_core_is_enabled(master_core)) {
+		g_master_core = master_core;
+	} else {
+		fprintf(stderr, "Master core %d is not in core mask '%s'\n", master_core, core_mask);
+		return -EINVAL;
+	}
+
+	_spdk_env_pin_current_thread(g_master_core);
+	spdk_env_set_current_core(g_master_core);
+
+	return 0;
+}
+
+uint32_t
+spdk_env_get_core_count(void)
+{
+	return g_core_count;
+}
+
+uint32_t
+spdk_env_get_current_core(void)
+{
+	return g_current_core;
+}
+
+uint32_t
+spdk_env_get_first_core(void)
+{
+	return spdk_env_get_next_core(UINT32_MAX);
+}
+
+uint32_t
+spdk_env_get_last_core(void)
+{
+	uint32_t i;
+	uint32_t last_core = UINT32_MAX;
+
+	SPDK_ENV_FOREACH_CORE(i) {
+		last_core = i;
+	}
+
+	assert(last_core != UINT32_MAX);
+
+	return last_core;
+}
+
+uint32_t
+spdk_env_get_next_core(uint32_t prev_core)
+{
+	uint32_t core;
+
+	for (core = prev_core + 1; core < SPDK_ENV_MAX_CORES; core++) {
+		if (spdk_env_core_is_enabled(core)) {
+			return core;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+uint32_t
+spdk_env_get_socket_id(uint32_t core)
+{
+	if (!spdk_env_core_is_enabled(core)) {
+		return SPDK_ENV_SOCKET_ID_ANY;
+	}
+
+	return g_socket_ids[core];
+}
+
+static void *
+_spdk_env_thread_start(void *arg)
+{
+	struct spdk_env_thread *thread = arg;
+	thread_start_fn fn = thread->fn;
+	void *fn_arg = thread->arg;
+
+	_spdk_env_pin_current_thread(thread->core);
+	spdk_env_set_current_core(thread->core);
+	free(thread);
+
+	return (void *)(intptr_t)fn(fn_arg);
+}
+
+int
+spdk_env_thread_launch_pinned(uint32_t core, thread_start_fn fn, void *arg)
+{
+	struct spdk_env_thread *thread;
+	int rc;
+
+	if (!spdk_env_core_is_enabled(core) || core == g_master_core || g_thread_launched[core]) {
+		return -EINVAL;
+	}
+
+	thread = calloc(1, sizeof(*thread));
+	if (thread == NULL) {
+		return -ENOMEM;
+	}
+
+	thread->core = core;
+	thread->fn = fn;
+	thread->arg = arg;
+
+	rc = pthread_create(&g_threads[core], NULL, _spdk_env_thread_start, thread);
+	if (rc != 0) {
+		free(thread);
+		return -rc;
+	}
+
+	g_thread_launched[core] = true;
+
+	return 0;
+}
+
+void
+spdk_env_thread_wait_all(void)
+{
+	uint32_t core;
+
+	for (core = 0; core < SPDK_ENV_MAX_CORES; core++) {
+		if (g_thread_launched[core]) {
+			pthread_join(g_threads[core], NULL);
+			g_thread_launched[core] = false;
+		}
+	}
+}
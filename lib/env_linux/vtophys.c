@@ -0,0 +1,86 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "env_internal.h"
+
+#include "spdk/assert.h"
+
+/*
+ * Without an IOMMU or pagemap access there is no physical address to hand out, so
+ *  registered memory translates to its own virtual address.  Anything that was never
+ *  registered still fails the lookup, which keeps callers honest about passing DMA
+ *  memory even though no device will ever read it.
+ */
+static struct spdk_mem_map *g_vtophys_map;
+
+static int
+spdk_vtophys_notify(void *cb_ctx, struct spdk_mem_map *map,
+		    enum spdk_mem_map_notify_action action,
+		    void *vaddr, size_t len)
+{
+	switch (action) {
+	case SPDK_MEM_MAP_NOTIFY_REGISTER:
+		return spdk_mem_map_set_translation(map, (uint64_t)vaddr, len, (uint64_t)vaddr);
+	case SPDK_MEM_MAP_NOTIFY_UNREGISTER:
+		return spdk_mem_map_clear_translation(map, (uint64_t)vaddr, len);
+	}
+
+	return -EINVAL;
+}
+
+void
+spdk_vtophys_init(void)
+{
+	g_vtophys_map = spdk_mem_map_alloc(SPDK_VTOPHYS_ERROR, spdk_vtophys_notify, NULL);
+	if (g_vtophys_map == NULL) {
+		fprintf(stderr, "vtophys map allocation failed\n");
+		abort();
+	}
+}
+
+uint64_t
+spdk_vtophys(void *buf)
+{
+	uint64_t vaddr_2mb;
+
+	vaddr_2mb = spdk_mem_map_translate(g_vtophys_map, (uint64_t)buf);
+
+	/*
+	 * SPDK_VTOPHYS_ERROR has all bits set, so or-ing in the offset leaves it unchanged.
+	 */
+	SPDK_STATIC_ASSERT(SPDK_VTOPHYS_ERROR == UINT64_C(-1), "SPDK_VTOPHYS_ERROR should be all 1s");
+	return vaddr_2mb | ((uint64_t)buf & MASK_2MB);
+}
@@ -354,6 +354,10 @@ spdk_app_start(struct spdk_app_opts *opts, spdk_event_fn start_fn,
 		opts->no_pci = spdk_conf_section_get_boolval(sp, "NoPci", false);
 	}
 
+	if (!opts->interrupt_mode && sp) {
+		opts->interrupt_mode = spdk_conf_section_get_boolval(sp, "InterruptMode", false);
+	}
+
 	spdk_env_opts_init(&env_opts);
 
 	env_opts.name = opts->name;
@@ -373,7 +377,7 @@ spdk_app_start(struct spdk_app_opts *opts, spdk_event_fn start_fn,
 	 *  reactor_mask will be 0x1 which will enable core 0 to run one
 	 *  reactor.
 	 */
-	if (spdk_reactors_init(opts->max_delay_us)) {
+	if (spdk_reactors_init(opts->max_delay_us, opts->interrupt_mode)) {
 		SPDK_ERRLOG("Invalid reactor mask.\n");
 		spdk_conf_free(g_spdk_app.config);
 		exit(EXIT_FAILURE);
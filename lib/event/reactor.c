@@ -39,13 +39,31 @@
 #include "spdk/log.h"
 #include "spdk/io_channel.h"
 #include "spdk/env.h"
+#include "spdk/util.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 #define SPDK_MAX_SOCKET		64
 
 #define SPDK_REACTOR_SPIN_TIME_USEC	1000
+#define SPDK_REACTOR_LOAD_WINDOW_USEC	100000
+#define SPDK_REACTOR_INTERRUPT_MAX_LOAD	10
 #define SPDK_TIMER_POLL_ITERATIONS	5
 #define SPDK_EVENT_BATCH_SIZE		8
 #define SPDK_SEC_TO_USEC		1000000ULL
+#define SPDK_REACTOR_MAX_INTERRUPTS	8
+#define SPDK_THREAD_MSG_POOL_SIZE	65535
+#define SPDK_REACTOR_THREAD_NO_MOVE	UINT32_MAX
+
+#define SPDK_REACTOR_SCHED_PERIOD_USEC		1000000
+#define SPDK_REACTOR_SCHED_DECISIONS		16
+/* The balanced scheduler moves work off a reactor once it is at least this busy... */
+#define SPDK_REACTOR_SCHED_BUSY_PCT		70
+/* ...and at least this much busier than the least loaded reactor. */
+#define SPDK_REACTOR_SCHED_IMBALANCE_PCT	20
 
 enum spdk_poller_state {
 	/* The poller is registered with a reactor but not currently executing its fn. */
@@ -58,9 +76,11 @@ enum spdk_poller_state {
 	SPDK_POLLER_STATE_UNREGISTERED,
 };
 
+struct spdk_reactor_thread;
+
 struct spdk_poller {
 	TAILQ_ENTRY(spdk_poller)	tailq;
-	uint32_t			lcore;
+	struct spdk_reactor_thread	*thread;
 
 	/* Current state of the poller; should only be accessed from the poller's thread. */
 	enum spdk_poller_state		state;
@@ -69,6 +89,66 @@ struct spdk_poller {
 	uint64_t			next_run_tick;
 	spdk_poller_fn			fn;
 	void				*arg;
+
+	/* Number of fds registered with spdk_poller_add_interrupt_fd(). */
+	uint32_t			num_interrupt_fds;
+};
+
+struct spdk_reactor_thread_msg {
+	spdk_thread_fn				fn;
+	void					*ctx;
+	STAILQ_ENTRY(spdk_reactor_thread_msg)	link;
+};
+
+/*
+ * A thread scheduled by a reactor.  Every reactor runs a default thread, which
+ *  receives its messages through the reactor's event ring, plus any number of
+ *  lightweight threads created with spdk_reactor_create_thread().  Pollers,
+ *  messages and I/O channels belong to a thread, so a lightweight thread can be
+ *  moved to another reactor without tearing any of them down.
+ */
+struct spdk_reactor_thread {
+	struct spdk_thread				*thread;
+
+	/* Reactor running this thread, or the one it is being moved to. */
+	struct spdk_reactor *volatile			reactor;
+
+	/*
+	 * Contains pollers actively running on this thread.  Pollers
+	 *  are run round-robin. The reactor takes one poller from the head
+	 *  of the ring, executes it, then puts it back at the tail of
+	 *  the ring.
+	 */
+	TAILQ_HEAD(, spdk_poller)			active_pollers;
+
+	/**
+	 * Contains pollers running on this thread with a periodic timer.
+	 */
+	TAILQ_HEAD(timer_pollers_head, spdk_poller)	timer_pollers;
+
+	/* Number of untimed pollers with no interrupt fd. */
+	uint32_t					num_polled_pollers;
+
+	/* epoll instance holding this thread's interrupt fds, or -1 if it has none. */
+	int						epfd;
+
+	/*
+	 * Pending messages of a lightweight thread.  Unused by the default thread.
+	 *  msgs is only accessed with msg_lock held.  num_msgs is changed with it held
+	 *  too, and read atomically without it to check for messages cheaply.
+	 */
+	pthread_spinlock_t				msg_lock;
+	STAILQ_HEAD(, spdk_reactor_thread_msg)		msgs;
+	uint32_t					num_msgs;
+
+	/* Ticks spent doing work since the thread was created or last moved. */
+	uint64_t					busy_tsc;
+
+	/* Requested from a message on the thread; acted upon once it yields. */
+	uint32_t					move_lcore;
+	bool						exiting;
+
+	TAILQ_ENTRY(spdk_reactor_thread)		link;
 };
 
 enum spdk_reactor_state {
@@ -92,18 +172,14 @@ struct spdk_reactor {
 	/* The last known rusage values */
 	struct rusage 					rusage;
 
-	/*
-	 * Contains pollers actively running on this reactor.  Pollers
-	 *  are run round-robin. The reactor takes one poller from the head
-	 *  of the ring, executes it, then puts it back at the tail of
-	 *  the ring.
-	 */
-	TAILQ_HEAD(, spdk_poller)			active_pollers;
+	/* Runs events and any pollers registered outside of a lightweight thread. */
+	struct spdk_reactor_thread			*default_thread;
 
-	/**
-	 * Contains pollers running on this reactor with a periodic timer.
-	 */
-	TAILQ_HEAD(timer_pollers_head, spdk_poller)	timer_pollers;
+	/* Thread whose messages or pollers the reactor is running right now. */
+	struct spdk_reactor_thread			*current_thread;
+
+	/* Every thread scheduled by this reactor, including the default thread. */
+	TAILQ_HEAD(, spdk_reactor_thread)		threads;
 
 	struct spdk_ring				*events;
 
@@ -111,19 +187,93 @@ struct spdk_reactor {
 	struct spdk_mempool				*event_mempool;
 
 	uint64_t					max_delay_us;
+
+	/*
+	 * In interrupt mode, the epoll instance an idle reactor blocks on.  It holds
+	 *  doorbell_fd and every poller interrupt fd.  -1 when interrupt mode is off.
+	 */
+	int						epfd;
+
+	/* eventfd written by spdk_event_call() to wake a reactor blocked in epfd. */
+	int						doorbell_fd;
+
+	/* Set by the reactor while it is blocked, or about to block, in epfd. */
+	volatile bool					in_interrupt;
+
+	/*
+	 * Number of untimed pollers with no interrupt fd, across all of the reactor's
+	 *  threads.  The reactor may only block when this is 0, since nothing would
+	 *  wake it up to call them.
+	 */
+	uint32_t					num_polled_pollers;
+
+	/*
+	 * Ticks spent doing work and ticks spent spinning or sleeping without
+	 *  finding any.  Only updated by the reactor's own thread.
+	 */
+	uint64_t					busy_tsc;
+	uint64_t					idle_tsc;
+
+	/*
+	 * Busy percentage over the last SPDK_REACTOR_LOAD_WINDOW_USEC, and the tick
+	 *  count and busy_tsc at the start of the current window.  Interrupt mode only
+	 *  blocks while recent_load is below SPDK_REACTOR_INTERRUPT_MAX_LOAD.  Only
+	 *  updated by the reactor's own thread.
+	 */
+	uint32_t					recent_load;
+	uint64_t					load_window_tsc;
+	uint64_t					load_window_busy_tsc;
+
+	/*
+	 * Snapshot of busy_tsc and idle_tsc at the last scheduler pass, and the
+	 *  resulting load percentage.  Only updated by the scheduler.
+	 */
+	uint64_t					sched_busy_tsc;
+	uint64_t					sched_idle_tsc;
+	uint32_t					load;
 } __attribute__((aligned(64)));
 
+struct spdk_reactor_migrate_handler {
+	spdk_reactor_migrate_fn				fn;
+	void						*ctx;
+	/*
+	 * Calls in progress.  An unregistered handler stays on the list, marked
+	 *  removed, until the last of them returns.
+	 */
+	uint32_t					refs;
+	bool						removed;
+	TAILQ_ENTRY(spdk_reactor_migrate_handler)	tailq;
+};
+
 static struct spdk_reactor *g_reactors;
 
 static enum spdk_reactor_state	g_reactor_state = SPDK_REACTOR_STATE_INVALID;
 
 static bool g_context_switch_monitor_enabled = true;
 
+static bool g_interrupt_mode;
+
+static struct spdk_mempool *g_thread_msg_mempool;
+
 static void spdk_reactor_construct(struct spdk_reactor *w, uint32_t lcore,
 				   uint64_t max_delay_us);
 
 static struct spdk_mempool *g_spdk_event_mempool[SPDK_MAX_SOCKET];
 
+static TAILQ_HEAD(, spdk_reactor_scheduler) g_schedulers = TAILQ_HEAD_INITIALIZER(g_schedulers);
+static struct spdk_reactor_scheduler *g_scheduler;
+static uint64_t g_scheduler_period_us = SPDK_REACTOR_SCHED_PERIOD_USEC;
+static uint32_t g_scheduler_lcore;
+static struct spdk_poller *g_scheduler_poller;
+static struct spdk_reactor_load *g_reactor_loads;
+
+static struct spdk_reactor_sched_decision g_sched_decisions[SPDK_REACTOR_SCHED_DECISIONS];
+static uint32_t g_sched_decision_count;
+
+static TAILQ_HEAD(, spdk_reactor_migrate_handler) g_migrate_handlers =
+	TAILQ_HEAD_INITIALIZER(g_migrate_handlers);
+static pthread_mutex_t g_migrate_handlers_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static struct spdk_reactor *
 spdk_reactor_get(uint32_t lcore)
 {
@@ -152,6 +302,23 @@ spdk_event_allocate(uint32_t lcore, spdk_event_fn fn, void *arg1, void *arg2)
 	return event;
 }
 
+static void
+_spdk_reactor_wake(struct spdk_reactor *reactor)
+{
+	uint64_t val = 1;
+
+	/*
+	 * Pairs with the barrier in _spdk_reactor_interrupt_wait(): either the reactor
+	 *  sees the event in its ring before blocking, or we see in_interrupt set.
+	 */
+	__sync_synchronize();
+	if (reactor->in_interrupt) {
+		if (write(reactor->doorbell_fd, &val, sizeof(val)) != sizeof(val) && errno != EAGAIN) {
+			SPDK_ERRLOG("Failed to wake reactor %u\n", reactor->lcore);
+		}
+	}
+}
+
 void
 spdk_event_call(struct spdk_event *event)
 {
@@ -165,6 +332,10 @@ spdk_event_call(struct spdk_event *event)
 	if (rc != 1) {
 		assert(false);
 	}
+
+	if (reactor->epfd >= 0) {
+		_spdk_reactor_wake(reactor);
+	}
 }
 
 static inline uint32_t
@@ -211,17 +382,86 @@ static void
 _spdk_reactor_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
 {
 	struct spdk_event *event;
-	struct spdk_reactor *reactor;
+	struct spdk_reactor_thread *rthread;
 
-	reactor = thread_ctx;
+	rthread = thread_ctx;
 
-	event = spdk_event_allocate(reactor->lcore, _spdk_reactor_msg_passed, fn, ctx);
+	event = spdk_event_allocate(rthread->reactor->lcore, _spdk_reactor_msg_passed, fn, ctx);
 
 	spdk_event_call(event);
 }
 
 static void
-_spdk_poller_insert_timer(struct spdk_reactor *reactor, struct spdk_poller *poller, uint64_t now)
+_spdk_reactor_thread_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
+{
+	struct spdk_reactor_thread *rthread = thread_ctx;
+	struct spdk_reactor_thread_msg *msg;
+	struct spdk_reactor *reactor;
+
+	msg = spdk_mempool_get(g_thread_msg_mempool);
+	if (msg == NULL) {
+		SPDK_ERRLOG("Thread message pool exhausted\n");
+		assert(false);
+		return;
+	}
+
+	msg->fn = fn;
+	msg->ctx = ctx;
+
+	pthread_spin_lock(&rthread->msg_lock);
+	STAILQ_INSERT_TAIL(&rthread->msgs, msg, link);
+	__atomic_add_fetch(&rthread->num_msgs, 1, __ATOMIC_RELEASE);
+	pthread_spin_unlock(&rthread->msg_lock);
+
+	/*
+	 * If the thread is being moved, this may wake the reactor it is leaving.  The
+	 *  reactor it is moving to gets woken up by the event that attaches it.
+	 */
+	reactor = rthread->reactor;
+	if (reactor->epfd >= 0) {
+		_spdk_reactor_wake(reactor);
+	}
+}
+
+static inline bool
+_spdk_reactor_thread_has_msgs(struct spdk_reactor_thread *rthread)
+{
+	return __atomic_load_n(&rthread->num_msgs, __ATOMIC_ACQUIRE) != 0;
+}
+
+static uint32_t
+_spdk_reactor_thread_run_msgs(struct spdk_reactor_thread *rthread)
+{
+	struct spdk_reactor_thread_msg *msgs[SPDK_EVENT_BATCH_SIZE];
+	uint32_t count, i;
+
+	if (!_spdk_reactor_thread_has_msgs(rthread)) {
+		return 0;
+	}
+
+	pthread_spin_lock(&rthread->msg_lock);
+	for (count = 0; count < SPDK_EVENT_BATCH_SIZE; count++) {
+		msgs[count] = STAILQ_FIRST(&rthread->msgs);
+		if (msgs[count] == NULL) {
+			break;
+		}
+		STAILQ_REMOVE_HEAD(&rthread->msgs, link);
+	}
+	__atomic_sub_fetch(&rthread->num_msgs, count, __ATOMIC_RELEASE);
+	pthread_spin_unlock(&rthread->msg_lock);
+
+	for (i = 0; i < count; i++) {
+		msgs[i]->fn(msgs[i]->ctx);
+	}
+
+	spdk_mempool_put_bulk(g_thread_msg_mempool, (void **)msgs, count);
+
+	return count;
+}
+
+static void
+_spdk_poller_insert_timer(struct spdk_reactor_thread *rthread, struct spdk_poller *poller,
+			  uint64_t now)
 {
 	struct spdk_poller *iter;
 	uint64_t next_run_tick;
@@ -230,31 +470,31 @@ _spdk_poller_insert_timer(struct spdk_reactor *reactor, struct spdk_poller *poll
 	poller->next_run_tick = next_run_tick;
 
 	/*
-	 * Insert poller in the reactor's timer_pollers list in sorted order by next scheduled
+	 * Insert poller in the thread's timer_pollers list in sorted order by next scheduled
 	 * run time.
 	 */
-	TAILQ_FOREACH_REVERSE(iter, &reactor->timer_pollers, timer_pollers_head, tailq) {
+	TAILQ_FOREACH_REVERSE(iter, &rthread->timer_pollers, timer_pollers_head, tailq) {
 		if (iter->next_run_tick <= next_run_tick) {
-			TAILQ_INSERT_AFTER(&reactor->timer_pollers, iter, poller, tailq);
+			TAILQ_INSERT_AFTER(&rthread->timer_pollers, iter, poller, tailq);
 			return;
 		}
 	}
 
 	/* No earlier pollers were found, so this poller must be the new head */
-	TAILQ_INSERT_HEAD(&reactor->timer_pollers, poller, tailq);
+	TAILQ_INSERT_HEAD(&rthread->timer_pollers, poller, tailq);
 }
 
 static struct spdk_poller *
 _spdk_reactor_start_poller(void *thread_ctx,
-			   spdk_thread_fn fn,
+			   spdk_poller_fn fn,
 			   void *arg,
 			   uint64_t period_microseconds)
 {
 	struct spdk_poller *poller;
-	struct spdk_reactor *reactor;
+	struct spdk_reactor_thread *rthread;
 	uint64_t quotient, remainder, ticks;
 
-	reactor = thread_ctx;
+	rthread = thread_ctx;
 
 	poller = calloc(1, sizeof(*poller));
 	if (poller == NULL) {
@@ -262,7 +502,7 @@ _spdk_reactor_start_poller(void *thread_ctx,
 		return NULL;
 	}
 
-	poller->lcore = reactor->lcore;
+	poller->thread = rthread;
 	poller->state = SPDK_POLLER_STATE_WAITING;
 	poller->fn = fn;
 	poller->arg = arg;
@@ -278,49 +518,522 @@ _spdk_reactor_start_poller(void *thread_ctx,
 	}
 
 	if (poller->period_ticks) {
-		_spdk_poller_insert_timer(reactor, poller, spdk_get_ticks());
+		_spdk_poller_insert_timer(rthread, poller, spdk_get_ticks());
+	} else {
+		TAILQ_INSERT_TAIL(&rthread->active_pollers, poller, tailq);
+		rthread->num_polled_pollers++;
+		rthread->reactor->num_polled_pollers++;
+	}
+
+	return poller;
+}
+
+static void
+_spdk_reactor_free_poller(struct spdk_poller *poller)
+{
+	struct spdk_reactor_thread *rthread = poller->thread;
+
+	if (poller->period_ticks == 0 && poller->num_interrupt_fds == 0) {
+		assert(rthread->num_polled_pollers > 0);
+		rthread->num_polled_pollers--;
+		rthread->reactor->num_polled_pollers--;
+	}
+
+	free(poller);
+}
+
+static void
+_spdk_reactor_stop_poller(struct spdk_poller *poller, void *thread_ctx)
+{
+	struct spdk_reactor_thread *rthread;
+
+	rthread = poller->thread;
+
+	assert(rthread == thread_ctx);
+
+	if (poller->state == SPDK_POLLER_STATE_RUNNING) {
+		/*
+		 * We are being called from the poller_fn, so set the state to unregistered
+		 * and let the reactor loop free the poller.
+		 */
+		poller->state = SPDK_POLLER_STATE_UNREGISTERED;
 	} else {
-		TAILQ_INSERT_TAIL(&reactor->active_pollers, poller, tailq);
+		/* Poller is not running currently, so just free it. */
+		if (poller->period_ticks) {
+			TAILQ_REMOVE(&rthread->timer_pollers, poller, tailq);
+		} else {
+			TAILQ_REMOVE(&rthread->active_pollers, poller, tailq);
+		}
+
+		_spdk_reactor_free_poller(poller);
+	}
+}
+
+static int
+_spdk_reactor_interrupt_fd(struct spdk_poller *poller, int fd, bool enable, void *thread_ctx)
+{
+#ifdef __linux__
+	struct spdk_reactor_thread *rthread = poller->thread;
+	struct spdk_reactor *reactor = rthread->reactor;
+	struct epoll_event event = {};
+
+	assert(rthread == thread_ctx);
+
+	if (reactor->epfd < 0) {
+		return -ENOTSUP;
+	}
+
+	if (enable) {
+		/*
+		 * Each thread keeps its fds in its own epoll instance, nested in the
+		 *  reactor's, so that they follow the thread when it is moved.
+		 */
+		if (rthread->epfd < 0) {
+			rthread->epfd = epoll_create1(EPOLL_CLOEXEC);
+			if (rthread->epfd < 0) {
+				return -errno;
+			}
+			event.events = EPOLLIN;
+			event.data.ptr = rthread;
+			if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, rthread->epfd, &event) != 0) {
+				close(rthread->epfd);
+				rthread->epfd = -1;
+				return -errno;
+			}
+		}
+
+		event.events = EPOLLIN;
+		event.data.ptr = poller;
+		if (epoll_ctl(rthread->epfd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			return -errno;
+		}
+		if (poller->num_interrupt_fds++ == 0 && poller->period_ticks == 0) {
+			rthread->num_polled_pollers--;
+			reactor->num_polled_pollers--;
+		}
+	} else {
+		if (poller->num_interrupt_fds == 0 || rthread->epfd < 0) {
+			return -EINVAL;
+		}
+		/* The event argument is ignored, but old kernels require it to be non-NULL. */
+		if (epoll_ctl(rthread->epfd, EPOLL_CTL_DEL, fd, &event) != 0) {
+			return -errno;
+		}
+		if (--poller->num_interrupt_fds == 0 && poller->period_ticks == 0) {
+			rthread->num_polled_pollers++;
+			reactor->num_polled_pollers++;
+		}
+	}
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*
+ * Find the earliest deadline among the timer pollers of every thread on the reactor.
+ *  If skip_interrupt_pollers is set, ignore timer pollers that can be woken by an fd.
+ */
+static bool
+_spdk_reactor_next_timer(struct spdk_reactor *reactor, bool skip_interrupt_pollers,
+			 uint64_t *next_run_tick)
+{
+	struct spdk_reactor_thread *rthread;
+	struct spdk_poller *poller;
+	bool found = false;
+
+	TAILQ_FOREACH(rthread, &reactor->threads, link) {
+		TAILQ_FOREACH(poller, &rthread->timer_pollers, tailq) {
+			if (skip_interrupt_pollers && poller->num_interrupt_fds > 0) {
+				continue;
+			}
+			if (!found || poller->next_run_tick < *next_run_tick) {
+				*next_run_tick = poller->next_run_tick;
+				found = true;
+			}
+			break;
+		}
+	}
+
+	return found;
+}
+
+static bool
+_spdk_reactor_has_msgs(struct spdk_reactor *reactor)
+{
+	struct spdk_reactor_thread *rthread;
+
+	if (spdk_ring_count(reactor->events) != 0) {
+		return true;
+	}
+
+	TAILQ_FOREACH(rthread, &reactor->threads, link) {
+		if (_spdk_reactor_thread_has_msgs(rthread)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Block until an interrupt fd fires, an event or message arrives or the next timer
+ *  poller without an interrupt fd is due.
+ */
+static void
+_spdk_reactor_interrupt_wait(struct spdk_reactor *reactor, uint64_t now)
+{
+#ifdef __linux__
+	struct epoll_event events[SPDK_REACTOR_MAX_INTERRUPTS];
+	uint64_t next_run_tick = 0, val;
+	int timeout_ms = -1;
+
+	if (_spdk_reactor_next_timer(reactor, true, &next_run_tick)) {
+		if (next_run_tick <= now) {
+			return;
+		}
+		/* Round up so that the timer has expired by the time we wake. */
+		timeout_ms = spdk_min(((next_run_tick - now) * 1000 + spdk_get_ticks_hz() - 1) /
+				      spdk_get_ticks_hz(), INT_MAX);
+	}
+
+	reactor->in_interrupt = true;
+	__sync_synchronize();
+	if (!_spdk_reactor_has_msgs(reactor) && g_reactor_state == SPDK_REACTOR_STATE_RUNNING) {
+		epoll_wait(reactor->epfd, events, SPDK_REACTOR_MAX_INTERRUPTS, timeout_ms);
+	}
+	reactor->in_interrupt = false;
+
+	/* Drain the doorbell; it is non-blocking, so this is harmless if nobody rang. */
+	if (read(reactor->doorbell_fd, &val, sizeof(val)) < 0 && errno != EAGAIN) {
+		SPDK_ERRLOG("Failed to read reactor %u doorbell\n", reactor->lcore);
+	}
+#endif
+}
+
+static int
+_spdk_reactor_interrupt_init(struct spdk_reactor *reactor)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reactor->epfd < 0) {
+		SPDK_ERRLOG("epoll_create1() failed for reactor %u\n", reactor->lcore);
+		return -1;
+	}
+
+	reactor->doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (reactor->doorbell_fd < 0) {
+		SPDK_ERRLOG("eventfd() failed for reactor %u\n", reactor->lcore);
+		close(reactor->epfd);
+		reactor->epfd = -1;
+		return -1;
+	}
+
+	event.events = EPOLLIN;
+	if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->doorbell_fd, &event) != 0) {
+		SPDK_ERRLOG("Failed to add doorbell for reactor %u\n", reactor->lcore);
+		close(reactor->doorbell_fd);
+		close(reactor->epfd);
+		reactor->doorbell_fd = -1;
+		reactor->epfd = -1;
+		return -1;
+	}
+
+	return 0;
+#else
+	SPDK_ERRLOG("Interrupt mode is not supported on this platform\n");
+	return -1;
+#endif
+}
+
+static void
+_spdk_reactor_interrupt_fini(struct spdk_reactor *reactor)
+{
+	if (reactor->doorbell_fd >= 0) {
+		close(reactor->doorbell_fd);
+		reactor->doorbell_fd = -1;
+	}
+	if (reactor->epfd >= 0) {
+		close(reactor->epfd);
+		reactor->epfd = -1;
+	}
+}
+
+static bool
+_spdk_reactor_valid_lcore(uint32_t lcore)
+{
+	if (g_reactors == NULL || lcore > spdk_env_get_last_core()) {
+		return false;
+	}
+
+	return spdk_reactor_get(lcore)->events != NULL;
+}
+
+static struct spdk_reactor_thread *
+_spdk_reactor_thread_alloc(struct spdk_reactor *reactor)
+{
+	struct spdk_reactor_thread *rthread;
+
+	rthread = calloc(1, sizeof(*rthread));
+	if (rthread == NULL) {
+		SPDK_ERRLOG("Could not allocate reactor thread\n");
+		return NULL;
+	}
+
+	rthread->reactor = reactor;
+	TAILQ_INIT(&rthread->active_pollers);
+	TAILQ_INIT(&rthread->timer_pollers);
+	rthread->epfd = -1;
+	pthread_spin_init(&rthread->msg_lock, PTHREAD_PROCESS_PRIVATE);
+	STAILQ_INIT(&rthread->msgs);
+	rthread->move_lcore = SPDK_REACTOR_THREAD_NO_MOVE;
+
+	return rthread;
+}
+
+static void
+_spdk_reactor_thread_free(struct spdk_reactor_thread *rthread)
+{
+	struct spdk_poller *poller, *tmp;
+	struct spdk_reactor_thread_msg *msg;
+
+	if (!TAILQ_EMPTY(&rthread->active_pollers) || !TAILQ_EMPTY(&rthread->timer_pollers)) {
+		SPDK_ERRLOG("Reactor thread freed with pollers still registered\n");
+	}
+
+	/* The thread is detached, so its pollers no longer count towards any reactor. */
+	TAILQ_FOREACH_SAFE(poller, &rthread->active_pollers, tailq, tmp) {
+		TAILQ_REMOVE(&rthread->active_pollers, poller, tailq);
+		free(poller);
+	}
+	TAILQ_FOREACH_SAFE(poller, &rthread->timer_pollers, tailq, tmp) {
+		TAILQ_REMOVE(&rthread->timer_pollers, poller, tailq);
+		free(poller);
+	}
+
+	pthread_spin_lock(&rthread->msg_lock);
+	while ((msg = STAILQ_FIRST(&rthread->msgs)) != NULL) {
+		STAILQ_REMOVE_HEAD(&rthread->msgs, link);
+		spdk_mempool_put(g_thread_msg_mempool, msg);
+	}
+	rthread->num_msgs = 0;
+	pthread_spin_unlock(&rthread->msg_lock);
+
+	if (rthread->epfd >= 0) {
+		close(rthread->epfd);
+	}
+	pthread_spin_destroy(&rthread->msg_lock);
+	free(rthread);
+}
+
+static void
+_spdk_reactor_thread_attach(struct spdk_reactor *reactor, struct spdk_reactor_thread *rthread)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+#endif
+
+	assert(rthread->reactor == reactor);
+
+	TAILQ_INSERT_TAIL(&reactor->threads, rthread, link);
+	reactor->num_polled_pollers += rthread->num_polled_pollers;
+
+#ifdef __linux__
+	if (rthread->epfd >= 0 && reactor->epfd >= 0) {
+		event.events = EPOLLIN;
+		event.data.ptr = rthread;
+		if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, rthread->epfd, &event) != 0) {
+			SPDK_ERRLOG("Failed to add thread interrupt fds to reactor %u\n", reactor->lcore);
+		}
+	}
+#endif
+}
+
+static void
+_spdk_reactor_thread_detach(struct spdk_reactor *reactor, struct spdk_reactor_thread *rthread)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+
+	if (rthread->epfd >= 0 && reactor->epfd >= 0) {
+		epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, rthread->epfd, &event);
+	}
+#endif
+
+	assert(reactor->num_polled_pollers >= rthread->num_polled_pollers);
+	reactor->num_polled_pollers -= rthread->num_polled_pollers;
+	TAILQ_REMOVE(&reactor->threads, rthread, link);
+	if (reactor->current_thread == rthread) {
+		reactor->current_thread = NULL;
+	}
+}
+
+static void
+_spdk_reactor_thread_attach_event(void *arg1, void *arg2)
+{
+	struct spdk_reactor_thread *rthread = arg1;
+
+	_spdk_reactor_thread_attach(spdk_reactor_get(spdk_env_get_current_core()), rthread);
+}
+
+static void
+_spdk_reactor_thread_move(struct spdk_reactor *reactor, struct spdk_reactor_thread *rthread,
+			  uint32_t lcore)
+{
+	rthread->move_lcore = SPDK_REACTOR_THREAD_NO_MOVE;
+	if (lcore == reactor->lcore) {
+		return;
+	}
+
+	SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "Moving thread %s from core %u to core %u\n",
+		      spdk_thread_get_name(rthread->thread), reactor->lcore, lcore);
+
+	_spdk_reactor_thread_detach(reactor, rthread);
+	rthread->busy_tsc = 0;
+
+	/*
+	 * Messages sent from here on are queued on the thread and wake the new reactor;
+	 *  the attach event wakes it for any that were queued before.
+	 */
+	rthread->reactor = spdk_reactor_get(lcore);
+	spdk_event_call(spdk_event_allocate(lcore, _spdk_reactor_thread_attach_event, rthread, NULL));
+}
+
+/*
+ * Act on a move or exit that the thread requested while it was running.  Exits
+ *  wait until the messages already sent to the thread have been processed.
+ */
+static void
+_spdk_reactor_thread_yield(struct spdk_reactor *reactor, struct spdk_reactor_thread *rthread)
+{
+	if (rthread->exiting) {
+		if (_spdk_reactor_thread_has_msgs(rthread)) {
+			return;
+		}
+		_spdk_reactor_thread_detach(reactor, rthread);
+		spdk_thread_destroy(rthread->thread);
+		_spdk_reactor_thread_free(rthread);
+	} else if (rthread->move_lcore != SPDK_REACTOR_THREAD_NO_MOVE) {
+		_spdk_reactor_thread_move(reactor, rthread, rthread->move_lcore);
+	}
+}
+
+struct spdk_thread *
+spdk_reactor_create_thread(const char *name, uint32_t lcore)
+{
+	struct spdk_reactor_thread *rthread;
+	struct spdk_thread *prev;
+
+	if (!_spdk_reactor_valid_lcore(lcore)) {
+		SPDK_ERRLOG("No reactor on core %u\n", lcore);
+		return NULL;
+	}
+
+	rthread = _spdk_reactor_thread_alloc(spdk_reactor_get(lcore));
+	if (rthread == NULL) {
+		return NULL;
+	}
+
+	rthread->thread = spdk_thread_create(_spdk_reactor_thread_send_msg,
+					     _spdk_reactor_start_poller,
+					     _spdk_reactor_stop_poller,
+					     rthread, name);
+	if (rthread->thread == NULL) {
+		_spdk_reactor_thread_free(rthread);
+		return NULL;
+	}
+
+	if (g_interrupt_mode) {
+		prev = spdk_set_thread(rthread->thread);
+		spdk_thread_set_interrupt_fd_fn(_spdk_reactor_interrupt_fd);
+		spdk_set_thread(prev);
+	}
+
+	spdk_event_call(spdk_event_allocate(lcore, _spdk_reactor_thread_attach_event, rthread, NULL));
+
+	return rthread->thread;
+}
+
+void
+spdk_reactor_exit_thread(void)
+{
+	struct spdk_reactor *reactor = spdk_reactor_get(spdk_env_get_current_core());
+	struct spdk_reactor_thread *rthread = reactor->current_thread;
+
+	if (rthread == NULL || rthread == reactor->default_thread) {
+		SPDK_ERRLOG("Only a lightweight thread can exit\n");
+		return;
 	}
 
-	return poller;
+	rthread->exiting = true;
 }
 
 static void
-_spdk_reactor_stop_poller(struct spdk_poller *poller, void *thread_ctx)
+_spdk_reactor_thread_move_msg(void *ctx)
 {
-	struct spdk_reactor *reactor;
+	struct spdk_reactor *reactor = spdk_reactor_get(spdk_env_get_current_core());
+	struct spdk_reactor_thread *rthread = reactor->current_thread;
 
-	reactor = thread_ctx;
+	if (rthread == NULL || rthread == reactor->default_thread) {
+		SPDK_ERRLOG("A reactor's default thread cannot be moved\n");
+		return;
+	}
 
-	assert(poller->lcore == spdk_env_get_current_core());
+	rthread->move_lcore = (uint32_t)(uintptr_t)ctx;
+}
 
-	if (poller->state == SPDK_POLLER_STATE_RUNNING) {
-		/*
-		 * We are being called from the poller_fn, so set the state to unregistered
-		 * and let the reactor loop free the poller.
-		 */
-		poller->state = SPDK_POLLER_STATE_UNREGISTERED;
-	} else {
-		/* Poller is not running currently, so just free it. */
-		if (poller->period_ticks) {
-			TAILQ_REMOVE(&reactor->timer_pollers, poller, tailq);
-		} else {
-			TAILQ_REMOVE(&reactor->active_pollers, poller, tailq);
+int
+spdk_reactor_move_thread(struct spdk_thread *thread, uint32_t lcore)
+{
+	if (!_spdk_reactor_valid_lcore(lcore)) {
+		return -EINVAL;
+	}
+
+	spdk_thread_send_msg(thread, _spdk_reactor_thread_move_msg, (void *)(uintptr_t)lcore);
+
+	return 0;
+}
+
+/*
+ * Migrate handler for the reactor scheduler.  Moves the lightweight thread that
+ *  has done the most work on this reactor since it arrived.
+ */
+static int
+_spdk_reactor_migrate_thread(uint32_t dst_lcore, void *ctx)
+{
+	struct spdk_reactor *reactor = spdk_reactor_get(spdk_env_get_current_core());
+	struct spdk_reactor_thread *rthread, *busiest = NULL;
+
+	TAILQ_FOREACH(rthread, &reactor->threads, link) {
+		if (rthread == reactor->default_thread || rthread->exiting ||
+		    rthread->move_lcore != SPDK_REACTOR_THREAD_NO_MOVE) {
+			continue;
 		}
+		if (busiest == NULL || rthread->busy_tsc > busiest->busy_tsc) {
+			busiest = rthread;
+		}
+	}
 
-		free(poller);
+	if (busiest == NULL) {
+		return -ENOENT;
 	}
+
+	_spdk_reactor_thread_move(reactor, busiest, dst_lcore);
+
+	return 0;
 }
 
-static void
+static int
 get_rusage(void *arg)
 {
 	struct spdk_reactor	*reactor = arg;
 	struct rusage		rusage;
 
 	if (getrusage(RUSAGE_THREAD, &rusage) != 0) {
-		return;
+		return -1;
 	}
 
 	if (rusage.ru_nvcsw != reactor->rusage.ru_nvcsw || rusage.ru_nivcsw != reactor->rusage.ru_nivcsw) {
@@ -330,6 +1043,8 @@ get_rusage(void *arg)
 			     rusage.ru_nivcsw - reactor->rusage.ru_nivcsw);
 	}
 	reactor->rusage = rusage;
+
+	return 0;
 }
 
 static void
@@ -380,6 +1095,360 @@ spdk_reactor_context_switch_monitor_enabled(void)
 	return g_context_switch_monitor_enabled;
 }
 
+int
+spdk_reactor_get_stats(uint32_t lcore, struct spdk_reactor_stats *stats)
+{
+	struct spdk_reactor *reactor;
+
+	if (g_reactors == NULL || lcore > spdk_env_get_last_core()) {
+		return -EINVAL;
+	}
+
+	reactor = spdk_reactor_get(lcore);
+	if (reactor->events == NULL) {
+		return -EINVAL;
+	}
+
+	stats->busy_tsc = reactor->busy_tsc;
+	stats->idle_tsc = reactor->idle_tsc;
+	stats->load = reactor->load;
+
+	return 0;
+}
+
+int
+spdk_reactor_register_migrate_handler(spdk_reactor_migrate_fn fn, void *ctx)
+{
+	struct spdk_reactor_migrate_handler *handler;
+
+	handler = calloc(1, sizeof(*handler));
+	if (handler == NULL) {
+		SPDK_ERRLOG("Could not allocate migrate handler\n");
+		return -ENOMEM;
+	}
+
+	handler->fn = fn;
+	handler->ctx = ctx;
+
+	pthread_mutex_lock(&g_migrate_handlers_mutex);
+	TAILQ_INSERT_TAIL(&g_migrate_handlers, handler, tailq);
+	pthread_mutex_unlock(&g_migrate_handlers_mutex);
+
+	return 0;
+}
+
+void
+spdk_reactor_unregister_migrate_handler(spdk_reactor_migrate_fn fn, void *ctx)
+{
+	struct spdk_reactor_migrate_handler *handler;
+
+	pthread_mutex_lock(&g_migrate_handlers_mutex);
+	TAILQ_FOREACH(handler, &g_migrate_handlers, tailq) {
+		if (handler->fn == fn && handler->ctx == ctx && !handler->removed) {
+			handler->removed = true;
+			if (handler->refs == 0) {
+				TAILQ_REMOVE(&g_migrate_handlers, handler, tailq);
+				free(handler);
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_migrate_handlers_mutex);
+}
+
+void
+spdk_reactor_scheduler_register(struct spdk_reactor_scheduler *scheduler)
+{
+	TAILQ_INSERT_TAIL(&g_schedulers, scheduler, tailq);
+}
+
+static struct spdk_reactor_scheduler *
+_spdk_reactor_scheduler_find(const char *name)
+{
+	struct spdk_reactor_scheduler *scheduler;
+
+	TAILQ_FOREACH(scheduler, &g_schedulers, tailq) {
+		if (strcmp(scheduler->name, name) == 0) {
+			return scheduler;
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t
+_spdk_reactor_load_pct(const struct spdk_reactor_load *load)
+{
+	uint64_t total_tsc = load->busy_tsc + load->idle_tsc;
+
+	if (total_tsc == 0) {
+		return 0;
+	}
+
+	return load->busy_tsc * 100 / total_tsc;
+}
+
+/*
+ * Runs on the busy reactor.  Offer the move to each migrate handler in turn until
+ *  one of them hands off some of its work.  The handlers are called without the
+ *  mutex held, so they may register or unregister handlers themselves.
+ */
+static void
+_spdk_reactor_migrate(void *arg1, void *arg2)
+{
+	struct spdk_reactor_sched_decision *decision = arg1;
+	uint32_t dst_lcore = (uint32_t)(uintptr_t)arg2;
+	struct spdk_reactor_migrate_handler *handler, *next;
+	enum spdk_reactor_sched_result result = SPDK_REACTOR_SCHED_NO_WORK;
+	int rc;
+
+	pthread_mutex_lock(&g_migrate_handlers_mutex);
+	handler = TAILQ_FIRST(&g_migrate_handlers);
+	while (handler != NULL) {
+		if (handler->removed) {
+			handler = TAILQ_NEXT(handler, tailq);
+			continue;
+		}
+
+		handler->refs++;
+		pthread_mutex_unlock(&g_migrate_handlers_mutex);
+
+		rc = handler->fn(dst_lcore, handler->ctx);
+
+		pthread_mutex_lock(&g_migrate_handlers_mutex);
+		next = TAILQ_NEXT(handler, tailq);
+		if (--handler->refs == 0 && handler->removed) {
+			TAILQ_REMOVE(&g_migrate_handlers, handler, tailq);
+			free(handler);
+		}
+
+		if (rc == 0) {
+			result = SPDK_REACTOR_SCHED_MIGRATED;
+			break;
+		}
+		handler = next;
+	}
+	pthread_mutex_unlock(&g_migrate_handlers_mutex);
+
+	SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "Moving work from core %u to core %u: %s\n",
+		      spdk_env_get_current_core(), dst_lcore,
+		      result == SPDK_REACTOR_SCHED_MIGRATED ? "migrated" : "nothing to move");
+	decision->result = result;
+}
+
+static int
+_spdk_reactor_scheduler_poll(void *arg)
+{
+	struct spdk_reactor *reactor;
+	struct spdk_reactor_load *load;
+	struct spdk_reactor_sched_decision *decision;
+	uint64_t busy_tsc, idle_tsc;
+	uint32_t i, count, src_lcore, dst_lcore;
+
+	count = 0;
+	SPDK_ENV_FOREACH_CORE(i) {
+		reactor = spdk_reactor_get(i);
+		busy_tsc = reactor->busy_tsc;
+		idle_tsc = reactor->idle_tsc;
+
+		load = &g_reactor_loads[count++];
+		load->lcore = i;
+		load->busy_tsc = busy_tsc - reactor->sched_busy_tsc;
+		load->idle_tsc = idle_tsc - reactor->sched_idle_tsc;
+
+		reactor->sched_busy_tsc = busy_tsc;
+		reactor->sched_idle_tsc = idle_tsc;
+		reactor->load = _spdk_reactor_load_pct(load);
+	}
+
+	if (g_scheduler->balance == NULL ||
+	    !g_scheduler->balance(g_reactor_loads, count, &src_lcore, &dst_lcore) ||
+	    src_lcore == dst_lcore) {
+		return 0;
+	}
+
+	decision = &g_sched_decisions[g_sched_decision_count % SPDK_REACTOR_SCHED_DECISIONS];
+	decision->tsc = spdk_get_ticks();
+	decision->src_lcore = src_lcore;
+	decision->dst_lcore = dst_lcore;
+	decision->result = SPDK_REACTOR_SCHED_PENDING;
+	g_sched_decision_count++;
+
+	SPDK_INFOLOG(SPDK_LOG_REACTOR, "Scheduler %s: core %u is %u%% busy, core %u is %u%% busy\n",
+		     g_scheduler->name, src_lcore, spdk_reactor_get(src_lcore)->load,
+		     dst_lcore, spdk_reactor_get(dst_lcore)->load);
+
+	spdk_event_call(spdk_event_allocate(src_lcore, _spdk_reactor_migrate, decision,
+					    (void *)(uintptr_t)dst_lcore));
+
+	return 1;
+}
+
+static void
+_spdk_reactor_scheduler_start(void *arg1, void *arg2)
+{
+	spdk_poller_unregister(&g_scheduler_poller);
+	g_scheduler_poller = spdk_poller_register(_spdk_reactor_scheduler_poll, NULL,
+			     g_scheduler_period_us);
+}
+
+int
+spdk_reactor_set_scheduler(const char *name, uint64_t period_us)
+{
+	struct spdk_reactor_scheduler *scheduler;
+
+	scheduler = _spdk_reactor_scheduler_find(name);
+	if (scheduler == NULL) {
+		return -ENOENT;
+	}
+
+	if (period_us == 0) {
+		period_us = SPDK_REACTOR_SCHED_PERIOD_USEC;
+	}
+
+	g_scheduler = scheduler;
+	if (period_us != g_scheduler_period_us) {
+		g_scheduler_period_us = period_us;
+		if (g_reactor_state == SPDK_REACTOR_STATE_RUNNING) {
+			/* Re-register the poller with the new period on the scheduler's core. */
+			spdk_event_call(spdk_event_allocate(g_scheduler_lcore,
+							    _spdk_reactor_scheduler_start, NULL, NULL));
+		}
+	}
+
+	SPDK_NOTICELOG("Reactor scheduler set to %s, period %" PRIu64 " us\n",
+		       scheduler->name, period_us);
+
+	return 0;
+}
+
+const char *
+spdk_reactor_get_scheduler(uint64_t *period_us)
+{
+	if (period_us != NULL) {
+		*period_us = g_scheduler_period_us;
+	}
+
+	return g_scheduler ? g_scheduler->name : NULL;
+}
+
+uint32_t
+spdk_reactor_get_sched_decisions(struct spdk_reactor_sched_decision *decisions,
+				 uint32_t max_decisions)
+{
+	uint32_t i, count;
+
+	count = spdk_min(g_sched_decision_count, SPDK_REACTOR_SCHED_DECISIONS);
+	count = spdk_min(count, max_decisions);
+
+	for (i = 0; i < count; i++) {
+		decisions[i] = g_sched_decisions[(g_sched_decision_count - 1 - i) %
+						 SPDK_REACTOR_SCHED_DECISIONS];
+	}
+
+	return count;
+}
+
+/*
+ * Move work from the busiest reactor to the least loaded one when the busiest is
+ *  nearly saturated and the difference between the two is large enough that moving
+ *  a unit of work is likely to help rather than just bounce it back next period.
+ */
+static bool
+_spdk_reactor_sched_balanced(const struct spdk_reactor_load *loads, uint32_t count,
+			     uint32_t *src_lcore, uint32_t *dst_lcore)
+{
+	uint32_t i, pct, max_pct, min_pct;
+
+	if (count < 2) {
+		return false;
+	}
+
+	max_pct = 0;
+	min_pct = UINT32_MAX;
+	for (i = 0; i < count; i++) {
+		pct = _spdk_reactor_load_pct(&loads[i]);
+		if (pct >= max_pct) {
+			max_pct = pct;
+			*src_lcore = loads[i].lcore;
+		}
+		if (pct < min_pct) {
+			min_pct = pct;
+			*dst_lcore = loads[i].lcore;
+		}
+	}
+
+	return max_pct >= SPDK_REACTOR_SCHED_BUSY_PCT &&
+	       max_pct - min_pct >= SPDK_REACTOR_SCHED_IMBALANCE_PCT;
+}
+
+SPDK_REACTOR_SCHEDULER_REGISTER(static, NULL)
+SPDK_REACTOR_SCHEDULER_REGISTER(balanced, _spdk_reactor_sched_balanced)
+
+/*
+ * Run one round of a thread: a batch of its messages, its next active poller and,
+ *  if run_timers is set, its first timer poller if that has expired.
+ */
+static bool
+_spdk_reactor_thread_poll(struct spdk_reactor *reactor, struct spdk_reactor_thread *rthread,
+			  bool run_timers, bool *busy)
+{
+	struct spdk_poller	*poller;
+	bool			took_action = false;
+	uint64_t		now;
+	int			rc;
+
+	reactor->current_thread = rthread;
+	spdk_set_thread(rthread->thread);
+
+	if (_spdk_reactor_thread_run_msgs(rthread) > 0) {
+		took_action = true;
+		*busy = true;
+	}
+
+	poller = TAILQ_FIRST(&rthread->active_pollers);
+	if (poller) {
+		TAILQ_REMOVE(&rthread->active_pollers, poller, tailq);
+		poller->state = SPDK_POLLER_STATE_RUNNING;
+		rc = poller->fn(poller->arg);
+		if (rc > 0) {
+			*busy = true;
+		}
+		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
+			_spdk_reactor_free_poller(poller);
+		} else {
+			poller->state = SPDK_POLLER_STATE_WAITING;
+			TAILQ_INSERT_TAIL(&rthread->active_pollers, poller, tailq);
+		}
+		took_action = true;
+	}
+
+	if (run_timers) {
+		poller = TAILQ_FIRST(&rthread->timer_pollers);
+		if (poller) {
+			now = spdk_get_ticks();
+
+			if (now >= poller->next_run_tick) {
+				TAILQ_REMOVE(&rthread->timer_pollers, poller, tailq);
+				poller->state = SPDK_POLLER_STATE_RUNNING;
+				rc = poller->fn(poller->arg);
+				if (rc > 0) {
+					*busy = true;
+				}
+				if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
+					_spdk_reactor_free_poller(poller);
+				} else {
+					poller->state = SPDK_POLLER_STATE_WAITING;
+					_spdk_poller_insert_timer(rthread, poller, now);
+				}
+				took_action = true;
+			}
+		}
+	}
+
+	return took_action;
+}
+
 /**
  *
  * \brief This is the main function of the reactor thread.
@@ -388,93 +1457,117 @@ spdk_reactor_context_switch_monitor_enabled(void)
  *
  * while (1)
  *	if (events to run)
- *		dequeue and run a batch of events
+ *		dequeue and run a batch of events on the default thread
  *
- *	if (active pollers)
- *		run the first poller in the list and move it to the back
+ *	for (each thread, starting with the default thread)
+ *		run a batch of the thread's messages
  *
- *	if (first timer poller has expired)
- *		run the first timer poller and reinsert it in the timer list
+ *		if (active pollers)
+ *			run the first poller in the list and move it to the back
+ *
+ *		if (first timer poller has expired)
+ *			run the first timer poller and reinsert it in the timer list
+ *
+ *		if (thread asked to move or exit)
+ *			hand it to the target reactor, or free it
+ *
+ *	if (any events, messages or pollers did work)
+ *		account the iteration as busy time, otherwise as idle time
  *
  *	if (idle for at least SPDK_REACTOR_SPIN_TIME_USEC)
- *		sleep until next timer poller is scheduled to expire
+ *		if (interrupt mode and every untimed poller has an interrupt fd)
+ *			if (busy less than SPDK_REACTOR_INTERRUPT_MAX_LOAD percent of the
+ *			    last SPDK_REACTOR_LOAD_WINDOW_USEC)
+ *				block until an fd fires, an event arrives or a timer expires
+ *		else
+ *			sleep until next timer poller is scheduled to expire
  * \endcode
  *
  */
 static int
 _spdk_reactor_run(void *arg)
 {
-	struct spdk_reactor	*reactor = arg;
-	struct spdk_poller	*poller;
-	uint32_t		event_count;
-	uint64_t		idle_started, now;
-	uint64_t		spin_cycles, sleep_cycles;
-	uint32_t		sleep_us;
-	uint32_t 		timer_poll_count;
-	char			thread_name[32];
+	struct spdk_reactor		*reactor = arg;
+	struct spdk_reactor_thread	*rthread, *tmp;
+	uint32_t			event_count;
+	uint64_t			idle_started, now, last_tsc, thread_tsc;
+	uint64_t			spin_cycles, sleep_cycles, load_window_cycles, next_run_tick;
+	uint32_t			sleep_us;
+	uint32_t 			timer_poll_count;
+	bool				run_timers;
+	char				thread_name[32];
 
 	snprintf(thread_name, sizeof(thread_name), "reactor_%u", reactor->lcore);
-	if (spdk_allocate_thread(_spdk_reactor_send_msg,
-				 _spdk_reactor_start_poller,
-				 _spdk_reactor_stop_poller,
-				 reactor, thread_name) == NULL) {
+	reactor->default_thread->thread = spdk_allocate_thread(_spdk_reactor_send_msg,
+					  _spdk_reactor_start_poller,
+					  _spdk_reactor_stop_poller,
+					  reactor->default_thread, thread_name);
+	if (reactor->default_thread->thread == NULL) {
 		return -1;
 	}
+	if (reactor->epfd >= 0) {
+		spdk_thread_set_interrupt_fd_fn(_spdk_reactor_interrupt_fd);
+	}
+	reactor->current_thread = reactor->default_thread;
+	spdk_set_thread(reactor->default_thread->thread);
 	SPDK_NOTICELOG("Reactor started on core %u on socket %u\n", reactor->lcore,
 		       reactor->socket_id);
 
 	spin_cycles = SPDK_REACTOR_SPIN_TIME_USEC * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
 	sleep_cycles = reactor->max_delay_us * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	load_window_cycles = SPDK_REACTOR_LOAD_WINDOW_USEC * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
 	idle_started = 0;
+	next_run_tick = 0;
 	timer_poll_count = 0;
 	if (g_context_switch_monitor_enabled) {
 		_spdk_reactor_context_switch_monitor_start(reactor, NULL);
 	}
+	if (reactor->lcore == g_scheduler_lcore) {
+		_spdk_reactor_scheduler_start(NULL, NULL);
+	}
+	last_tsc = spdk_get_ticks();
+	reactor->load_window_tsc = last_tsc;
+	reactor->load_window_busy_tsc = reactor->busy_tsc;
 	while (1) {
 		bool took_action = false;
+		bool busy = false;
 
+		/* Events always run on the default thread. */
+		reactor->current_thread = reactor->default_thread;
+		spdk_set_thread(reactor->default_thread->thread);
 		event_count = _spdk_event_queue_run_batch(reactor);
 		if (event_count > 0) {
 			took_action = true;
+			busy = true;
 		}
 
-		poller = TAILQ_FIRST(&reactor->active_pollers);
-		if (poller) {
-			TAILQ_REMOVE(&reactor->active_pollers, poller, tailq);
-			poller->state = SPDK_POLLER_STATE_RUNNING;
-			poller->fn(poller->arg);
-			if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-				free(poller);
-			} else {
-				poller->state = SPDK_POLLER_STATE_WAITING;
-				TAILQ_INSERT_TAIL(&reactor->active_pollers, poller, tailq);
-			}
-			took_action = true;
-		}
-
-		if (timer_poll_count >= SPDK_TIMER_POLL_ITERATIONS) {
-			poller = TAILQ_FIRST(&reactor->timer_pollers);
-			if (poller) {
-				now = spdk_get_ticks();
-
-				if (now >= poller->next_run_tick) {
-					TAILQ_REMOVE(&reactor->timer_pollers, poller, tailq);
-					poller->state = SPDK_POLLER_STATE_RUNNING;
-					poller->fn(poller->arg);
-					if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-						free(poller);
-					} else {
-						poller->state = SPDK_POLLER_STATE_WAITING;
-						_spdk_poller_insert_timer(reactor, poller, now);
-					}
-					took_action = true;
-				}
-			}
+		run_timers = timer_poll_count >= SPDK_TIMER_POLL_ITERATIONS;
+		if (run_timers) {
 			timer_poll_count = 0;
 		} else {
 			timer_poll_count++;
 		}
 
+		TAILQ_FOREACH_SAFE(rthread, &reactor->threads, link, tmp) {
+			bool thread_busy = false;
+
+			if (rthread == reactor->default_thread) {
+				took_action |= _spdk_reactor_thread_poll(reactor, rthread, run_timers, &busy);
+				continue;
+			}
+
+			thread_tsc = spdk_get_ticks();
+			took_action |= _spdk_reactor_thread_poll(reactor, rthread, run_timers, &thread_busy);
+			if (thread_busy) {
+				rthread->busy_tsc += spdk_get_ticks() - thread_tsc;
+				busy = true;
+			}
+			_spdk_reactor_thread_yield(reactor, rthread);
+		}
+
+		reactor->current_thread = reactor->default_thread;
+		spdk_set_thread(reactor->default_thread->thread);
+
 		if (took_action) {
 			/* We were busy this loop iteration. Reset the idle timer. */
 			idle_started = 0;
@@ -484,20 +1577,36 @@ _spdk_reactor_run(void *arg)
 		}
 
 		/* Determine if the thread can sleep */
-		if (sleep_cycles && idle_started) {
+		if (reactor->epfd >= 0 && reactor->num_polled_pollers == 0 && idle_started) {
+			now = spdk_get_ticks();
+			/*
+			 * A reactor that was busy during the last load window is likely to get
+			 *  more work soon, so it keeps polling until the window shows it mostly idle.
+			 */
+			if (now >= (idle_started + spin_cycles) &&
+			    reactor->recent_load < SPDK_REACTOR_INTERRUPT_MAX_LOAD) {
+				/*
+				 * Every untimed poller is waiting on an fd, so block until
+				 *  there is something to do.
+				 */
+				_spdk_reactor_interrupt_wait(reactor, now);
+
+				/* After waking up, always poll for timers */
+				timer_poll_count = SPDK_TIMER_POLL_ITERATIONS;
+			}
+		} else if (sleep_cycles && idle_started) {
 			now = spdk_get_ticks();
 			if (now >= (idle_started + spin_cycles)) {
 				sleep_us = reactor->max_delay_us;
 
-				poller = TAILQ_FIRST(&reactor->timer_pollers);
-				if (poller) {
+				if (_spdk_reactor_next_timer(reactor, false, &next_run_tick)) {
 					/* There are timers registered, so don't sleep beyond
 					 * when the next timer should fire */
-					if (poller->next_run_tick < (now + sleep_cycles)) {
-						if (poller->next_run_tick <= now) {
+					if (next_run_tick < (now + sleep_cycles)) {
+						if (next_run_tick <= now) {
 							sleep_us = 0;
 						} else {
-							sleep_us = ((poller->next_run_tick - now) *
+							sleep_us = ((next_run_tick - now) *
 								    SPDK_SEC_TO_USEC) / spdk_get_ticks_hz();
 						}
 					}
@@ -512,13 +1621,46 @@ _spdk_reactor_run(void *arg)
 			}
 		}
 
+		now = spdk_get_ticks();
+		if (busy) {
+			reactor->busy_tsc += now - last_tsc;
+		} else {
+			reactor->idle_tsc += now - last_tsc;
+		}
+		last_tsc = now;
+
+		if (now - reactor->load_window_tsc >= load_window_cycles) {
+			reactor->recent_load = (reactor->busy_tsc - reactor->load_window_busy_tsc) * 100 /
+					       (now - reactor->load_window_tsc);
+			reactor->load_window_tsc = now;
+			reactor->load_window_busy_tsc = reactor->busy_tsc;
+		}
+
 		if (g_reactor_state != SPDK_REACTOR_STATE_RUNNING) {
 			break;
 		}
 	}
 
+	if (reactor->lcore == g_scheduler_lcore) {
+		spdk_poller_unregister(&g_scheduler_poller);
+	}
 	_spdk_reactor_context_switch_monitor_stop(reactor, NULL);
+
+	/* Lightweight threads should have exited by now; reclaim any that did not. */
+	TAILQ_FOREACH_SAFE(rthread, &reactor->threads, link, tmp) {
+		if (rthread == reactor->default_thread) {
+			continue;
+		}
+		SPDK_ERRLOG("Thread %s still running on core %u at shutdown\n",
+			    spdk_thread_get_name(rthread->thread), reactor->lcore);
+		_spdk_reactor_thread_detach(reactor, rthread);
+		spdk_thread_destroy(rthread->thread);
+		_spdk_reactor_thread_free(rthread);
+	}
+
+	spdk_set_thread(NULL);
 	spdk_free_thread();
+	reactor->default_thread->thread = NULL;
 	return 0;
 }
 
@@ -529,9 +1671,18 @@ spdk_reactor_construct(struct spdk_reactor *reactor, uint32_t lcore, uint64_t ma
 	reactor->socket_id = spdk_env_get_socket_id(lcore);
 	assert(reactor->socket_id < SPDK_MAX_SOCKET);
 	reactor->max_delay_us = max_delay_us;
+	reactor->epfd = -1;
+	reactor->doorbell_fd = -1;
 
-	TAILQ_INIT(&reactor->active_pollers);
-	TAILQ_INIT(&reactor->timer_pollers);
+	TAILQ_INIT(&reactor->threads);
+	reactor->default_thread = _spdk_reactor_thread_alloc(reactor);
+	assert(reactor->default_thread != NULL);
+	TAILQ_INSERT_TAIL(&reactor->threads, reactor->default_thread, link);
+	reactor->current_thread = reactor->default_thread;
+
+	if (g_interrupt_mode && _spdk_reactor_interrupt_init(reactor) != 0) {
+		SPDK_NOTICELOG("Reactor %u will always poll\n", lcore);
+	}
 
 	reactor->events = spdk_ring_create(SPDK_RING_TYPE_MP_SC, 65536, reactor->socket_id);
 	if (!reactor->events) {
@@ -651,11 +1802,22 @@ spdk_reactors_start(void)
 void
 spdk_reactors_stop(void *arg1, void *arg2)
 {
+	uint32_t i;
+	struct spdk_reactor *reactor;
+
 	g_reactor_state = SPDK_REACTOR_STATE_EXITING;
+
+	/* Reactors blocked in interrupt mode will not notice the state change on their own. */
+	SPDK_ENV_FOREACH_CORE(i) {
+		reactor = spdk_reactor_get(i);
+		if (reactor->epfd >= 0) {
+			_spdk_reactor_wake(reactor);
+		}
+	}
 }
 
 int
-spdk_reactors_init(unsigned int max_delay_us)
+spdk_reactors_init(unsigned int max_delay_us, bool interrupt_mode)
 {
 	int rc;
 	uint32_t i, j, last_core;
@@ -733,11 +1895,46 @@ spdk_reactors_init(unsigned int max_delay_us)
 
 	memset(g_reactors, 0, (last_core + 1) * sizeof(struct spdk_reactor));
 
+	snprintf(mempool_name, sizeof(mempool_name), "thread_msg_%d", getpid());
+	g_thread_msg_mempool = spdk_mempool_create(mempool_name,
+			       SPDK_THREAD_MSG_POOL_SIZE,
+			       sizeof(struct spdk_reactor_thread_msg),
+			       SPDK_MEMPOOL_DEFAULT_CACHE_SIZE,
+			       SPDK_ENV_SOCKET_ID_ANY);
+
+	g_reactor_loads = calloc(spdk_env_get_core_count(), sizeof(*g_reactor_loads));
+	if (g_reactor_loads == NULL || g_thread_msg_mempool == NULL) {
+		SPDK_ERRLOG("Could not allocate reactor load array or thread message pool\n");
+		free(g_reactor_loads);
+		g_reactor_loads = NULL;
+		if (g_thread_msg_mempool != NULL) {
+			spdk_mempool_free(g_thread_msg_mempool);
+			g_thread_msg_mempool = NULL;
+		}
+		free(g_reactors);
+		g_reactors = NULL;
+		for (i = 0; i < SPDK_MAX_SOCKET; i++) {
+			if (g_spdk_event_mempool[i] != NULL) {
+				spdk_mempool_free(g_spdk_event_mempool[i]);
+			}
+		}
+		return -1;
+	}
+
+	if (g_scheduler == NULL) {
+		g_scheduler = _spdk_reactor_scheduler_find("static");
+		assert(g_scheduler != NULL);
+	}
+	g_scheduler_lcore = spdk_env_get_current_core();
+	g_interrupt_mode = interrupt_mode;
+
 	SPDK_ENV_FOREACH_CORE(i) {
 		reactor = spdk_reactor_get(i);
 		spdk_reactor_construct(reactor, i, max_delay_us);
 	}
 
+	spdk_reactor_register_migrate_handler(_spdk_reactor_migrate_thread, NULL);
+
 	g_reactor_state = SPDK_REACTOR_STATE_INITIALIZED;
 
 	return 0;
@@ -754,6 +1951,19 @@ spdk_reactors_fini(void)
 		if (reactor->events != NULL) {
 			spdk_ring_free(reactor->events);
 		}
+		if (reactor->default_thread != NULL) {
+			TAILQ_REMOVE(&reactor->threads, reactor->default_thread, link);
+			_spdk_reactor_thread_free(reactor->default_thread);
+			reactor->default_thread = NULL;
+		}
+		_spdk_reactor_interrupt_fini(reactor);
+	}
+
+	spdk_reactor_unregister_migrate_handler(_spdk_reactor_migrate_thread, NULL);
+
+	if (g_thread_msg_mempool != NULL) {
+		spdk_mempool_free(g_thread_msg_mempool);
+		g_thread_msg_mempool = NULL;
 	}
 
 	for (i = 0; i < SPDK_MAX_SOCKET; i++) {
@@ -762,7 +1972,10 @@ spdk_reactors_fini(void)
 		}
 	}
 
+	free(g_reactor_loads);
+	g_reactor_loads = NULL;
 	free(g_reactors);
+	g_reactors = NULL;
 }
 
 SPDK_LOG_REGISTER_COMPONENT("reactor", SPDK_LOG_REACTOR)
@@ -33,6 +33,7 @@
 
 #include "spdk/stdinc.h"
 
+#include "spdk/env.h"
 #include "spdk/event.h"
 #include "spdk/rpc.h"
 #include "spdk/util.h"
@@ -153,3 +154,138 @@ spdk_rpc_context_switch_monitor(struct spdk_jsonrpc_request *request,
 }
 
 SPDK_RPC_REGISTER("context_switch_monitor", spdk_rpc_context_switch_monitor)
+
+static const char *
+spdk_rpc_sched_result_str(enum spdk_reactor_sched_result result)
+{
+	switch (result) {
+	case SPDK_REACTOR_SCHED_PENDING:
+		return "pending";
+	case SPDK_REACTOR_SCHED_MIGRATED:
+		return "migrated";
+	case SPDK_REACTOR_SCHED_NO_WORK:
+		return "no_work";
+	}
+
+	return "unknown";
+}
+
+static void
+spdk_rpc_get_reactor_scheduler(struct spdk_jsonrpc_request *request,
+			       const struct spdk_json_val *params)
+{
+	struct spdk_reactor_sched_decision decisions[16];
+	struct spdk_reactor_stats stats;
+	struct spdk_json_write_ctx *w;
+	const char *name;
+	uint64_t period_us;
+	uint32_t lcore, i, count;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "get_reactor_scheduler requires no parameters");
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	if (w == NULL) {
+		return;
+	}
+
+	name = spdk_reactor_get_scheduler(&period_us);
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_name(w, "name");
+	spdk_json_write_string(w, name);
+
+	spdk_json_write_name(w, "period_us");
+	spdk_json_write_uint64(w, period_us);
+
+	spdk_json_write_name(w, "tsc_rate");
+	spdk_json_write_uint64(w, spdk_get_ticks_hz());
+
+	spdk_json_write_name(w, "reactors");
+	spdk_json_write_array_begin(w);
+	SPDK_ENV_FOREACH_CORE(lcore) {
+		if (spdk_reactor_get_stats(lcore, &stats) != 0) {
+			continue;
+		}
+		spdk_json_write_object_begin(w);
+		spdk_json_write_name(w, "lcore");
+		spdk_json_write_uint32(w, lcore);
+		spdk_json_write_name(w, "busy_tsc");
+		spdk_json_write_uint64(w, stats.busy_tsc);
+		spdk_json_write_name(w, "idle_tsc");
+		spdk_json_write_uint64(w, stats.idle_tsc);
+		spdk_json_write_name(w, "load");
+		spdk_json_write_uint32(w, stats.load);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	count = spdk_reactor_get_sched_decisions(decisions, SPDK_COUNTOF(decisions));
+	spdk_json_write_name(w, "decisions");
+	spdk_json_write_array_begin(w);
+	for (i = 0; i < count; i++) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_name(w, "tsc");
+		spdk_json_write_uint64(w, decisions[i].tsc);
+		spdk_json_write_name(w, "src_lcore");
+		spdk_json_write_uint32(w, decisions[i].src_lcore);
+		spdk_json_write_name(w, "dst_lcore");
+		spdk_json_write_uint32(w, decisions[i].dst_lcore);
+		spdk_json_write_name(w, "result");
+		spdk_json_write_string(w, spdk_rpc_sched_result_str(decisions[i].result));
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("get_reactor_scheduler", spdk_rpc_get_reactor_scheduler)
+
+struct rpc_set_reactor_scheduler {
+	char *name;
+	uint64_t period_us;
+};
+
+static const struct spdk_json_object_decoder rpc_set_reactor_scheduler_decoders[] = {
+	{"name", offsetof(struct rpc_set_reactor_scheduler, name), spdk_json_decode_string},
+	{"period_us", offsetof(struct rpc_set_reactor_scheduler, period_us), spdk_json_decode_uint64, true},
+};
+
+static void
+spdk_rpc_set_reactor_scheduler(struct spdk_jsonrpc_request *request,
+			       const struct spdk_json_val *params)
+{
+	struct rpc_set_reactor_scheduler req = {};
+	struct spdk_json_write_ctx *w;
+
+	if (params == NULL || spdk_json_decode_object(params, rpc_set_reactor_scheduler_decoders,
+			SPDK_COUNTOF(rpc_set_reactor_scheduler_decoders),
+			&req)) {
+		SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "spdk_json_decode_object failed\n");
+		goto invalid;
+	}
+
+	if (spdk_reactor_set_scheduler(req.name, req.period_us) != 0) {
+		goto invalid;
+	}
+
+	free(req.name);
+
+	w = spdk_jsonrpc_begin_result(request);
+	if (w == NULL) {
+		return;
+	}
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+	return;
+
+invalid:
+	spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+	free(req.name);
+}
+SPDK_RPC_REGISTER("set_reactor_scheduler", spdk_rpc_set_reactor_scheduler)
@@ -44,6 +44,10 @@ static TAILQ_HEAD(subsystem_depend, spdk_subsystem_depend) g_depends =
 	TAILQ_HEAD_INITIALIZER(g_depends);
 static struct spdk_subsystem *g_next_subsystem;
 static bool g_subsystems_initialized = false;
+static bool g_init_failed = false;
+static bool g_init_scanning = false;
+static bool g_init_rescan = false;
+static uint64_t g_init_start_tsc;
 static struct spdk_event *g_app_start_event;
 static struct spdk_event *g_app_stop_event;
 static uint32_t g_fini_core;
@@ -115,32 +119,123 @@ subsystem_sort(void)
 	}
 }
 
-void
-spdk_subsystem_init_next(int rc)
+static bool
+spdk_subsystem_deps_initialized(struct spdk_subsystem *subsystem)
 {
-	if (rc) {
-		SPDK_ERRLOG("Init subsystem %s failed\n", g_next_subsystem->name);
-		spdk_app_stop(rc);
+	struct spdk_subsystem_depend *dep;
+	struct spdk_subsystem *depends_on;
+
+	TAILQ_FOREACH(dep, &g_depends, tailq) {
+		if (strcmp(subsystem->name, dep->name) != 0) {
+			continue;
+		}
+		depends_on = spdk_subsystem_find(&g_subsystems, dep->depends_on);
+		if (depends_on == NULL || !depends_on->init_done) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+spdk_subsystem_init_log_times(void)
+{
+	struct spdk_subsystem *subsystem;
+	char buf[256];
+	int len = 0;
+
+	buf[0] = '\0';
+	TAILQ_FOREACH(subsystem, &g_subsystems, tailq) {
+		if (len >= (int)sizeof(buf)) {
+			break;
+		}
+		len += snprintf(buf + len, sizeof(buf) - len, " %s=%" PRIu64 "ms",
+				subsystem->name, subsystem->init_tsc * 1000 / spdk_get_ticks_hz());
+	}
+
+	SPDK_NOTICELOG("Subsystems initialized in %" PRIu64 " ms:%s\n",
+		       (spdk_get_ticks() - g_init_start_tsc) * 1000 / spdk_get_ticks_hz(), buf);
+}
+
+/*
+ * Start every subsystem whose dependencies have finished initializing.  Subsystems that
+ *  complete from within their init function make more subsystems ready, so keep scanning
+ *  until nothing changes.  Subsystems that complete later call back in here through
+ *  spdk_subsystem_init_done().
+ */
+static void
+spdk_subsystem_init_start_ready(void)
+{
+	struct spdk_subsystem *subsystem;
+	bool all_done;
+
+	if (g_init_scanning) {
+		g_init_rescan = true;
 		return;
 	}
 
-	if (!g_next_subsystem) {
-		g_next_subsystem = TAILQ_FIRST(&g_subsystems);
-	} else {
-		g_next_subsystem = TAILQ_NEXT(g_next_subsystem, tailq);
+	g_init_scanning = true;
+	do {
+		g_init_rescan = false;
+		TAILQ_FOREACH(subsystem, &g_subsystems, tailq) {
+			if (g_init_failed) {
+				break;
+			}
+			if (subsystem->init_started || !spdk_subsystem_deps_initialized(subsystem)) {
+				continue;
+			}
+
+			subsystem->init_started = true;
+			subsystem->init_start_tsc = spdk_get_ticks();
+			if (subsystem->init) {
+				subsystem->init();
+			} else {
+				spdk_subsystem_init_done(subsystem, 0);
+			}
+		}
+	} while (g_init_rescan && !g_init_failed);
+	g_init_scanning = false;
+
+	if (g_init_failed || g_subsystems_initialized) {
+		return;
 	}
 
-	if (!g_next_subsystem) {
+	all_done = true;
+	TAILQ_FOREACH(subsystem, &g_subsystems, tailq) {
+		if (!subsystem->init_done) {
+			all_done = false;
+			break;
+		}
+	}
+
+	if (all_done) {
 		g_subsystems_initialized = true;
+		spdk_subsystem_init_log_times();
 		spdk_event_call(g_app_start_event);
+	}
+}
+
+void
+spdk_subsystem_init_done(struct spdk_subsystem *subsystem, int rc)
+{
+	assert(subsystem->init_started && !subsystem->init_done);
+
+	if (g_init_failed) {
 		return;
 	}
 
-	if (g_next_subsystem->init) {
-		g_next_subsystem->init();
-	} else {
-		spdk_subsystem_init_next(0);
+	if (rc) {
+		SPDK_ERRLOG("Init subsystem %s failed\n", subsystem->name);
+		g_init_failed = true;
+		spdk_app_stop(rc);
+		return;
 	}
+
+	subsystem->init_done = true;
+	subsystem->init_tsc = spdk_get_ticks() - subsystem->init_start_tsc;
+
+	spdk_subsystem_init_start_ready();
 }
 
 static void
@@ -165,7 +260,8 @@ spdk_subsystem_verify(void *arg1, void *arg2)
 
 	subsystem_sort();
 
-	spdk_subsystem_init_next(0);
+	g_init_start_tsc = spdk_get_ticks();
+	spdk_subsystem_init_start_ready();
 }
 
 void
@@ -185,22 +281,17 @@ _spdk_subsystem_fini_next(void *arg1, void *arg2)
 	assert(g_fini_core == spdk_env_get_current_core());
 
 	if (!g_next_subsystem) {
-		/* If the initialized flag is false, then we've failed to initialize
-		 * the very first subsystem and no de-init is needed
-		 */
-		if (g_subsystems_initialized) {
-			g_next_subsystem = TAILQ_LAST(&g_subsystems, spdk_subsystem_list);
-		}
+		g_next_subsystem = TAILQ_LAST(&g_subsystems, spdk_subsystem_list);
 	} else {
-		/* We rewind the g_next_subsystem unconditionally - even when some subsystem failed
-		 * to initialize. It is assumed that subsystem which failed to initialize does not
-		 * need to be deinitialized.
-		 */
 		g_next_subsystem = TAILQ_PREV(g_next_subsystem, spdk_subsystem_list, tailq);
 	}
 
+	/*
+	 * Walk the subsystems in reverse dependency order.  It is assumed that a subsystem
+	 *  which failed to initialize, or never got to, does not need to be deinitialized.
+	 */
 	while (g_next_subsystem) {
-		if (g_next_subsystem->fini) {
+		if (g_next_subsystem->init_done && g_next_subsystem->fini) {
 			g_next_subsystem->fini();
 			return;
 		}
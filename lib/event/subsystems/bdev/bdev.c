@@ -40,16 +40,18 @@
 #include "spdk_internal/event.h"
 #include "spdk/env.h"
 
+SPDK_DECLARE_SUBSYSTEM(bdev)
+
 static void
 spdk_bdev_initialize_complete(void *cb_arg, int rc)
 {
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(cb_arg, rc);
 }
 
 static void
 spdk_bdev_subsystem_initialize(void)
 {
-	spdk_bdev_initialize(spdk_bdev_initialize_complete, NULL);
+	spdk_bdev_initialize(spdk_bdev_initialize_complete, SPDK_GET_SUBSYSTEM(bdev));
 }
 
 static void
@@ -38,6 +38,8 @@
 #include "spdk_internal/event.h"
 #include "spdk/env.h"
 
+SPDK_DECLARE_SUBSYSTEM(copy)
+
 static void
 spdk_copy_engine_subsystem_initialize(void)
 {
@@ -45,7 +47,7 @@ spdk_copy_engine_subsystem_initialize(void)
 
 	rc = spdk_copy_engine_initialize();
 
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(SPDK_GET_SUBSYSTEM(copy), rc);
 }
 
 static void
@@ -37,6 +37,8 @@
 
 #include "spdk_internal/event.h"
 
+SPDK_DECLARE_SUBSYSTEM(nbd)
+
 static void
 spdk_nbd_subsystem_init(void)
 {
@@ -44,7 +46,7 @@ spdk_nbd_subsystem_init(void)
 
 	rc = spdk_nbd_init();
 
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(SPDK_GET_SUBSYSTEM(nbd), rc);
 }
 
 static void
@@ -37,6 +37,9 @@
 
 #include "spdk_internal/event.h"
 
+SPDK_DECLARE_SUBSYSTEM(interface)
+SPDK_DECLARE_SUBSYSTEM(net_framework)
+
 static void
 spdk_interface_subsystem_init(void)
 {
@@ -44,7 +47,7 @@ spdk_interface_subsystem_init(void)
 
 	rc = spdk_interface_init();
 
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(SPDK_GET_SUBSYSTEM(interface), rc);
 }
 
 static void
@@ -64,7 +67,7 @@ spdk_net_subsystem_start(void)
 
 	rc = spdk_net_framework_start();
 
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(SPDK_GET_SUBSYSTEM(net_framework), rc);
 }
 
 static void
@@ -37,6 +37,8 @@
 
 #include "spdk_internal/event.h"
 
+SPDK_DECLARE_SUBSYSTEM(vhost)
+
 static void
 spdk_vhost_subsystem_init(void)
 {
@@ -44,7 +46,7 @@ spdk_vhost_subsystem_init(void)
 
 	rc = spdk_vhost_init();
 
-	spdk_subsystem_init_next(rc);
+	spdk_subsystem_init_done(SPDK_GET_SUBSYSTEM(vhost), rc);
 }
 
 static void
@@ -45,15 +45,16 @@
 
 #define ACCEPT_TIMEOUT_US 1000 /* 1ms */
 
-static void
+static int
 spdk_iscsi_portal_accept(void *arg)
 {
 	struct spdk_iscsi_portal	*portal = arg;
 	int				rc, sock;
 	char				buf[64];
+	int				count = 0;
 
 	if (portal->sock < 0) {
-		return;
+		return -1;
 	}
 
 	while (1) {
@@ -66,6 +67,7 @@ spdk_iscsi_portal_accept(void *arg)
 				SPDK_ERRLOG("spdk_iscsi_connection_construct() failed\n");
 				break;
 			}
+			count++;
 		} else {
 			if (errno != EAGAIN && errno != EWOULDBLOCK) {
 				spdk_strerror_r(errno, buf, sizeof(buf));
@@ -74,16 +76,22 @@ spdk_iscsi_portal_accept(void *arg)
 			break;
 		}
 	}
+
+	return count;
 }
 
 void
 spdk_iscsi_acceptor_start(struct spdk_iscsi_portal *p)
 {
 	p->acceptor_poller = spdk_poller_register(spdk_iscsi_portal_accept, p, ACCEPT_TIMEOUT_US);
+
+	/* Failure just means the reactor keeps waking up for the acceptor timer. */
+	spdk_poller_add_interrupt_fd(p->acceptor_poller, p->sock);
 }
 
 void
 spdk_iscsi_acceptor_stop(struct spdk_iscsi_portal *p)
 {
+	spdk_poller_remove_interrupt_fd(p->acceptor_poller, p->sock);
 	spdk_poller_unregister(&p->acceptor_poller);
 }
@@ -66,6 +66,7 @@ static int64_t g_conn_idle_interval_in_tsc = -1;
 
 #define DEFAULT_CONNECTIONS_PER_LCORE	4
 #define SPDK_MAX_POLLERS_PER_CORE	4096
+#define IDLE_CONN_TIMER_US		1000000
 static int g_connections_per_lcore = DEFAULT_CONNECTIONS_PER_LCORE;
 static uint32_t *g_num_connections;
 
@@ -82,13 +83,15 @@ static void __add_idle_conn(void *arg1, void *arg2);
 /** Global variables used for managing idle connections. */
 static int g_poll_fd = 0;
 static struct spdk_poller *g_idle_conn_poller;
+static struct spdk_poller *g_idle_conn_timer;
 static STAILQ_HEAD(idle_list, spdk_iscsi_conn) g_idle_conn_list_head;
 
-void spdk_iscsi_conn_login_do_work(void *arg);
-void spdk_iscsi_conn_full_feature_do_work(void *arg);
-void spdk_iscsi_conn_idle_do_work(void *arg);
+int spdk_iscsi_conn_login_do_work(void *arg);
+int spdk_iscsi_conn_full_feature_do_work(void *arg);
+int spdk_iscsi_conn_idle_do_work(void *arg);
 
 static void spdk_iscsi_conn_full_feature_migrate(void *arg1, void *arg2);
+static int spdk_iscsi_conn_rebalance(uint32_t dst_lcore, void *ctx);
 static struct spdk_event *spdk_iscsi_conn_get_migrate_event(struct spdk_iscsi_conn *conn,
 		int *lcore);
 static void spdk_iscsi_conn_stop_poller(struct spdk_iscsi_conn *conn, spdk_event_fn fn_after_stop,
@@ -345,6 +348,21 @@ check_idle_conns(void)
 
 #endif
 
+static void
+fini_idle_conns(void)
+{
+	spdk_poller_unregister(&g_idle_conn_timer);
+	if (g_idle_conn_poller != NULL) {
+		spdk_poller_remove_interrupt_fd(g_idle_conn_poller, g_poll_fd);
+		spdk_poller_unregister(&g_idle_conn_poller);
+	}
+
+	if (g_poll_fd > 0) {
+		close(g_poll_fd);
+		g_poll_fd = 0;
+	}
+}
+
 int spdk_initialize_iscsi_conns(void)
 {
 	size_t conns_size;
@@ -401,6 +419,20 @@ int spdk_initialize_iscsi_conns(void)
 	}
 
 	g_idle_conn_poller = spdk_poller_register(spdk_iscsi_conn_idle_do_work, NULL, 0);
+	if (spdk_poller_add_interrupt_fd(g_idle_conn_poller, g_poll_fd) == 0) {
+		/*
+		 * The reactor may now block until an idle connection's socket is
+		 *  readable, so also walk the idle list periodically to keep sending
+		 *  NOP-Ins on time.
+		 */
+		g_idle_conn_timer = spdk_poller_register(spdk_iscsi_conn_idle_do_work, NULL,
+				    IDLE_CONN_TIMER_US);
+	}
+
+	if (spdk_reactor_register_migrate_handler(spdk_iscsi_conn_rebalance, NULL) != 0) {
+		SPDK_ERRLOG("could not register iSCSI connection migrate handler\n");
+		return -1;
+	}
 
 	return 0;
 }
@@ -695,7 +727,7 @@ _spdk_iscsi_conn_free(void *arg1, void *arg2)
 	pthread_mutex_unlock(&g_conns_mutex);
 }
 
-static void
+static int
 _spdk_iscsi_conn_check_shutdown(void *arg)
 {
 	struct spdk_iscsi_conn *conn = arg;
@@ -703,12 +735,14 @@ _spdk_iscsi_conn_check_shutdown(void *arg)
 
 	rc = spdk_iscsi_conn_free_tasks(conn);
 	if (rc < 0) {
-		return;
+		return 0;
 	}
 
 	spdk_poller_unregister(&conn->shutdown_timer);
 
 	spdk_iscsi_conn_stop_poller(conn, _spdk_iscsi_conn_free, spdk_env_get_current_core());
+
+	return 1;
 }
 
 void spdk_iscsi_conn_destruct(struct spdk_iscsi_conn *conn)
@@ -769,21 +803,27 @@ spdk_iscsi_conns_cleanup(void)
 static void
 spdk_iscsi_conn_check_shutdown_cb(void *arg1, void *arg2)
 {
+	/* Idle connections are on the list until they exit, so stop watching only now */
+	fini_idle_conns();
 	spdk_iscsi_conns_cleanup();
 	spdk_iscsi_fini_done();
 }
 
-static void
+static int
 spdk_iscsi_conn_check_shutdown(void *arg)
 {
 	struct spdk_event *event;
 
-	if (spdk_iscsi_get_active_conns() == 0) {
-		spdk_poller_unregister(&g_shutdown_timer);
-		event = spdk_event_allocate(spdk_env_get_current_core(), spdk_iscsi_conn_check_shutdown_cb, NULL,
-					    NULL);
-		spdk_event_call(event);
+	if (spdk_iscsi_get_active_conns() != 0) {
+		return 0;
 	}
+
+	spdk_poller_unregister(&g_shutdown_timer);
+	event = spdk_event_allocate(spdk_env_get_current_core(), spdk_iscsi_conn_check_shutdown_cb, NULL,
+				    NULL);
+	spdk_event_call(event);
+
+	return 1;
 }
 
 static struct spdk_event *
@@ -857,6 +897,8 @@ void spdk_shutdown_iscsi_conns(void)
 	struct spdk_iscsi_conn	*conn, *tmp;
 	int				i;
 
+	spdk_reactor_unregister_migrate_handler(spdk_iscsi_conn_rebalance, NULL);
+
 	/* cleanup - move conns from list back into ring
 	   where they will get cleaned up
 	 */
@@ -1453,7 +1495,111 @@ spdk_iscsi_conn_full_feature_migrate(void *arg1, void *arg2)
 					    0);
 }
 
-void
+/* Run on the new lcore of a connection moved by spdk_iscsi_conn_rebalance() */
+static void
+spdk_iscsi_conn_rebalance_migrate(void *arg1, void *arg2)
+{
+	struct spdk_iscsi_conn *conn = arg1;
+
+	__sync_fetch_and_add(&g_num_connections[spdk_env_get_current_core()], 1);
+	spdk_iscsi_conn_full_feature_migrate(conn, NULL);
+}
+
+/* True if the connection has no tasks, data-in or R2T transfers, or PDUs in flight */
+static bool
+spdk_iscsi_conn_is_quiesced(struct spdk_iscsi_conn *conn)
+{
+	return conn->pending_task_cnt == 0 && conn->data_in_cnt == 0 &&
+	       TAILQ_EMPTY(&conn->write_pdu_list) &&
+	       TAILQ_EMPTY(&conn->queued_datain_tasks) &&
+	       TAILQ_EMPTY(&conn->queued_r2t_tasks) &&
+	       TAILQ_EMPTY(&conn->active_r2t_tasks);
+}
+
+static bool
+spdk_iscsi_conn_can_rebalance(struct spdk_iscsi_conn *conn, uint32_t lcore)
+{
+	return conn->is_valid && !conn->is_idle && conn->poller != NULL &&
+	       conn->full_feature && conn->sess != NULL &&
+	       conn->sess->session_type == SESSION_TYPE_NORMAL &&
+	       conn->state == ISCSI_CONN_STATE_RUNNING &&
+	       conn->lcore == lcore && spdk_iscsi_conn_is_quiesced(conn);
+}
+
+/**
+ * \brief Called by the reactor scheduler on a busy reactor to move one target
+ *  node, and every active connection to it, onto dst_lcore.
+ *
+ * Connections to the same target node always run on the same lcore, so a
+ *  target node is only moved when none of its connections on this lcore have
+ *  outstanding work.
+ */
+static int
+spdk_iscsi_conn_rebalance(uint32_t dst_lcore, void *ctx)
+{
+	struct spdk_iscsi_conn		*conn;
+	struct spdk_iscsi_tgt_node	*target = NULL;
+	uint32_t			lcore = spdk_env_get_current_core();
+	uint32_t			num_conns = 0;
+	int				i;
+
+	pthread_mutex_lock(&g_conns_mutex);
+
+	for (i = 0; i < MAX_ISCSI_CONNECTIONS; i++) {
+		conn = &g_conns_array[i];
+		if (spdk_iscsi_conn_can_rebalance(conn, lcore) &&
+		    (conn->portal->cpumask & (1ULL << dst_lcore))) {
+			target = conn->sess->target;
+			break;
+		}
+	}
+
+	if (target == NULL) {
+		pthread_mutex_unlock(&g_conns_mutex);
+		return -ENOENT;
+	}
+
+	for (i = 0; i < MAX_ISCSI_CONNECTIONS; i++) {
+		conn = &g_conns_array[i];
+		if (!conn->is_valid || conn->is_idle || !conn->full_feature ||
+		    conn->sess == NULL || conn->sess->target != target || conn->lcore != lcore) {
+			continue;
+		}
+		if (!spdk_iscsi_conn_can_rebalance(conn, lcore) ||
+		    !(conn->portal->cpumask & (1ULL << dst_lcore))) {
+			pthread_mutex_unlock(&g_conns_mutex);
+			return -EBUSY;
+		}
+		num_conns++;
+	}
+
+	/*
+	 * spdk_iscsi_conn_stop_poller() drops each moved connection from num_active_conns.
+	 *  Count them twice until then, so the count never reaches zero and a new
+	 *  connection to the target cannot pick another lcore while they move.
+	 */
+	pthread_mutex_lock(&target->mutex);
+	target->num_active_conns += num_conns;
+	target->lcore = dst_lcore;
+	pthread_mutex_unlock(&target->mutex);
+
+	for (i = 0; i < MAX_ISCSI_CONNECTIONS; i++) {
+		conn = &g_conns_array[i];
+		if (!spdk_iscsi_conn_can_rebalance(conn, lcore) || conn->sess->target != target) {
+			continue;
+		}
+
+		SPDK_DEBUGLOG(SPDK_LOG_ISCSI, "moving conn %d (target %s) from lcore %u to %u\n",
+			      conn->id, target->name, lcore, dst_lcore);
+		spdk_iscsi_conn_stop_poller(conn, spdk_iscsi_conn_rebalance_migrate, dst_lcore);
+	}
+
+	pthread_mutex_unlock(&g_conns_mutex);
+
+	return 0;
+}
+
+int
 spdk_iscsi_conn_login_do_work(void *arg)
 {
 	struct spdk_iscsi_conn	*conn = arg;
@@ -1464,7 +1610,7 @@ spdk_iscsi_conn_login_do_work(void *arg)
 	/* General connection processing */
 	rc = spdk_iscsi_conn_execute(conn);
 	if (rc < 0) {
-		return;
+		return -1;
 	}
 
 	/* Check if this connection transitioned to full feature phase. If it
@@ -1478,9 +1624,11 @@ spdk_iscsi_conn_login_do_work(void *arg)
 		spdk_poller_unregister(&conn->poller);
 		spdk_event_call(event);
 	}
+
+	return rc;
 }
 
-void
+int
 spdk_iscsi_conn_full_feature_do_work(void *arg)
 {
 	struct spdk_iscsi_conn	*conn = arg;
@@ -1488,7 +1636,7 @@ spdk_iscsi_conn_full_feature_do_work(void *arg)
 
 	rc = spdk_iscsi_conn_execute(conn);
 	if (rc < 0) {
-		return;
+		return -1;
 	} else if (rc > 0) {
 		conn->last_activity_tsc = spdk_get_ticks();
 	}
@@ -1497,6 +1645,8 @@ spdk_iscsi_conn_full_feature_do_work(void *arg)
 	   and it was idle longer than the configured timeout, migrate this
 	   session to the first core. */
 	spdk_iscsi_conn_handle_idle(conn);
+
+	return rc;
 }
 
 /**
@@ -1515,10 +1665,11 @@ spdk_iscsi_conn_full_feature_do_work(void *arg)
  * to process required timer based actions that must be maintained
  * even though the connection is considered 'idle'.
  */
-void spdk_iscsi_conn_idle_do_work(void *arg)
+int spdk_iscsi_conn_idle_do_work(void *arg)
 {
 	uint64_t	tsc;
 	struct spdk_iscsi_conn *tconn;
+	int		count = 0;
 
 	check_idle_conns();
 
@@ -1551,8 +1702,11 @@ void spdk_iscsi_conn_idle_do_work(void *arg)
 			__sync_fetch_and_add(&g_num_connections[lcore], 1);
 			SPDK_DEBUGLOG(SPDK_LOG_ISCSI, "add conn id = %d, cid = %d poller = %p to lcore = %d active\n",
 				      tconn->id, tconn->cid, &tconn->poller, lcore);
+			count++;
 		}
 	} /* for each conn in idle list */
+
+	return count;
 }
 
 static void
@@ -1624,12 +1778,14 @@ spdk_iscsi_conn_allocate_reactor(uint64_t cpumask)
 	return selected_core;
 }
 
-static void
+static int
 logout_timeout(void *arg)
 {
 	struct spdk_iscsi_conn *conn = arg;
 
 	spdk_iscsi_conn_destruct(conn);
+
+	return 1;
 }
 
 void
@@ -167,7 +167,7 @@ spdk_jsonrpc_server_accept(struct spdk_jsonrpc_server *server)
 
 		server->num_conns++;
 
-		return 0;
+		return 1;
 	}
 
 	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
@@ -258,7 +258,7 @@ spdk_jsonrpc_server_conn_recv(struct spdk_jsonrpc_server_conn *conn)
 		conn->recv_len -= rc;
 	}
 
-	return 0;
+	return 1;
 }
 
 void
@@ -275,29 +275,30 @@ spdk_jsonrpc_server_conn_send(struct spdk_jsonrpc_server_conn *conn)
 	struct spdk_jsonrpc_request *request;
 	ssize_t rc;
 	char buf[64];
+	int sent = 0;
 
 more:
 	if (conn->outstanding_requests == 0) {
-		return 0;
+		return sent;
 	}
 
 	if (conn->send_request == NULL) {
 		if (spdk_ring_dequeue(conn->send_queue, (void **)&conn->send_request, 1) != 1) {
-			return 0;
+			return sent;
 		}
 	}
 
 	request = conn->send_request;
 	if (request == NULL) {
 		/* Nothing to send right now */
-		return 0;
+		return sent;
 	}
 
 	rc = send(conn->sockfd, request->send_buf + request->send_offset,
 		  request->send_len, 0);
 	if (rc < 0) {
 		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-			return 0;
+			return sent;
 		}
 
 		spdk_strerror_r(errno, buf, sizeof(buf));
@@ -315,16 +316,17 @@ more:
 		 */
 		conn->send_request = NULL;
 		spdk_jsonrpc_free_request(request);
+		sent++;
 		goto more;
 	}
 
-	return 0;
+	return sent;
 }
 
 int
 spdk_jsonrpc_server_poll(struct spdk_jsonrpc_server *server)
 {
-	int rc, i;
+	int rc, i, count = 0;
 	struct spdk_jsonrpc_server_conn *conn;
 
 	for (i = 0; i < server->num_conns; i++) {
@@ -358,7 +360,10 @@ spdk_jsonrpc_server_poll(struct spdk_jsonrpc_server *server)
 
 	/* Check listen socket */
 	if (server->num_conns < SPDK_JSONRPC_MAX_CONNS) {
-		spdk_jsonrpc_server_accept(server);
+		rc = spdk_jsonrpc_server_accept(server);
+		if (rc > 0) {
+			count += rc;
+		}
 	}
 
 	for (i = 0; i < server->num_conns; i++) {
@@ -369,17 +374,19 @@ spdk_jsonrpc_server_poll(struct spdk_jsonrpc_server *server)
 		}
 
 		rc = spdk_jsonrpc_server_conn_send(conn);
-		if (rc != 0) {
+		if (rc < 0) {
 			spdk_jsonrpc_server_conn_close(conn);
 			continue;
 		}
+		count += rc;
 
 		rc = spdk_jsonrpc_server_conn_recv(conn);
-		if (rc != 0) {
+		if (rc < 0) {
 			spdk_jsonrpc_server_conn_close(conn);
 			continue;
 		}
+		count += rc;
 	}
 
-	return 0;
+	return count;
 }
@@ -34,6 +34,7 @@
 #include "spdk_internal/lvolstore.h"
 #include "spdk_internal/log.h"
 #include "spdk/string.h"
+#include "spdk/util.h"
 #include "spdk/io_channel.h"
 #include "spdk/blob_bdev.h"
 
@@ -190,6 +191,7 @@ _spdk_load_next_lvol(void *cb_arg, struct spdk_blob *blob, int lvolerrno)
 	lvol->blob_id = blob_id;
 	lvol->lvol_store = lvs;
 	lvol->num_clusters = spdk_blob_get_num_clusters(blob);
+	lvol->thin_provision = spdk_blob_is_thin_provisioned(blob);
 	lvol->close_only = false;
 	uuid_unparse(lvol->lvol_store->uuid, uuid);
 	lvol->old_name = spdk_sprintf_alloc("%s_%"PRIu64, uuid, (uint64_t)blob_id);
@@ -789,9 +791,9 @@ _spdk_lvol_delete_blob_cb(void *cb_arg, int lvolerrno)
 	struct spdk_lvol *lvol = req->lvol;
 
 	if (lvolerrno < 0) {
+		/* The blob is still there, e.g. a snapshot that has clones, so keep the lvol */
 		SPDK_ERRLOG("Could not delete blob on lvol\n");
-		free(lvol->old_name);
-		free(lvol);
+		lvol->action_in_progress = false;
 		goto end;
 	}
 
@@ -924,19 +926,10 @@ _spdk_lvol_create_cb(void *cb_arg, spdk_blob_id blobid, int lvolerrno)
 	spdk_bs_open_blob(bs, blobid, _spdk_lvol_create_open_cb, req);
 }
 
-int
-spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, uint64_t sz,
-		 spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+static int
+_spdk_lvs_verify_lvol_name(struct spdk_lvol_store *lvs, const char *name)
 {
-	struct spdk_lvol_with_handle_req *req;
-	struct spdk_blob_store *bs;
-	struct spdk_lvol *lvol, *tmp;
-	uint64_t num_clusters, free_clusters;
-
-	if (lvs == NULL) {
-		SPDK_ERRLOG("lvol store does not exist\n");
-		return -ENODEV;
-	}
+	struct spdk_lvol *tmp;
 
 	if (name == NULL || strnlen(name, SPDK_LVS_NAME_MAX) == 0) {
 		SPDK_ERRLOG("No name specified.\n");
@@ -955,11 +948,35 @@ spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, uint64_t sz,
 		}
 	}
 
+	return 0;
+}
+
+int
+spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, uint64_t sz,
+		 bool thin_provision, spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	struct spdk_blob_store *bs;
+	struct spdk_lvol *lvol;
+	struct spdk_blob_opts opts;
+	uint64_t num_clusters, free_clusters;
+	int rc;
+
+	if (lvs == NULL) {
+		SPDK_ERRLOG("lvol store does not exist\n");
+		return -ENODEV;
+	}
+
+	rc = _spdk_lvs_verify_lvol_name(lvs, name);
+	if (rc < 0) {
+		return rc;
+	}
+
 	bs = lvs->blobstore;
 
 	num_clusters = divide_round_up(sz, spdk_bs_get_cluster_size(bs));
 	free_clusters = spdk_bs_free_cluster_count(bs);
-	if (num_clusters > free_clusters) {
+	if (!thin_provision && num_clusters > free_clusters) {
 		SPDK_ERRLOG("Not enough free clusters left (%zu) on lvol store to add lvol %zu clusters\n",
 			    free_clusters, num_clusters);
 		return -ENOMEM;
@@ -983,14 +1000,264 @@ spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, uint64_t sz,
 	lvol->lvol_store = lvs;
 	lvol->num_clusters = num_clusters;
 	lvol->close_only = false;
+	lvol->thin_provision = thin_provision;
 	strncpy(lvol->name, name, SPDK_LVS_NAME_MAX);
 	req->lvol = lvol;
 
-	spdk_bs_create_blob(lvs->blobstore, _spdk_lvol_create_cb, req);
+	spdk_blob_opts_init(&opts);
+	opts.thin_provision = thin_provision;
+
+	spdk_bs_create_blob_ext(lvs->blobstore, &opts, _spdk_lvol_create_cb, req);
 
 	return 0;
 }
 
+static void
+_spdk_lvol_snapshot_clone_close_cb(void *cb_arg, int lvolerrno)
+{
+	if (lvolerrno < 0) {
+		SPDK_ERRLOG("Could not close blob\n");
+	}
+}
+
+static void
+_spdk_lvol_snapshot_clone_open_cb(void *cb_arg, struct spdk_blob *blob, int lvolerrno)
+{
+	struct spdk_lvol_with_handle_req *req = cb_arg;
+	struct spdk_lvol *lvol = req->lvol;
+	char uuid[UUID_STRING_LEN];
+
+	if (lvolerrno < 0) {
+		SPDK_ERRLOG("Cannot open blob of lvol %s\n", lvol->name);
+		free(lvol);
+		goto end;
+	}
+
+	lvol->blob = blob;
+	lvol->blob_id = spdk_blob_get_id(blob);
+
+	uuid_unparse(lvol->lvol_store->uuid, uuid);
+	lvol->old_name = spdk_sprintf_alloc("%s_%"PRIu64, uuid, (uint64_t)lvol->blob_id);
+	if (!lvol->old_name) {
+		/* The blob stays on disk and shows up again when the lvol store is loaded */
+		SPDK_ERRLOG("Cannot alloc memory for lvol name\n");
+		spdk_blob_close(blob, _spdk_lvol_snapshot_clone_close_cb, NULL);
+		free(lvol);
+		lvolerrno = -ENOMEM;
+		goto end;
+	}
+
+	TAILQ_INSERT_TAIL(&lvol->lvol_store->lvols, lvol, link);
+	lvol->ref_count++;
+
+end:
+	req->cb_fn(req->cb_arg, lvolerrno < 0 ? NULL : lvol, lvolerrno);
+	free(req);
+}
+
+static void
+_spdk_lvol_snapshot_clone_cb(void *cb_arg, spdk_blob_id blobid, int lvolerrno)
+{
+	struct spdk_lvol_with_handle_req *req = cb_arg;
+
+	if (lvolerrno < 0) {
+		free(req->lvol);
+		req->cb_fn(req->cb_arg, NULL, lvolerrno);
+		free(req);
+		return;
+	}
+
+	spdk_bs_open_blob(req->lvol->lvol_store->blobstore, blobid,
+			  _spdk_lvol_snapshot_clone_open_cb, req);
+}
+
+static char *g_lvol_xattr_names[] = {"name"};
+
+static void
+_spdk_lvol_get_xattr_value(void *xattr_ctx, const char *name, const void **value,
+			   size_t *value_len)
+{
+	struct spdk_lvol *lvol = xattr_ctx;
+
+	assert(strcmp(name, "name") == 0);
+	*value = lvol->name;
+	*value_len = strnlen(lvol->name, SPDK_LVOL_NAME_MAX) + 1;
+}
+
+static struct spdk_lvol_with_handle_req *
+_spdk_lvol_snapshot_clone_prepare(struct spdk_lvol *origlvol, const char *name,
+				  struct spdk_blob_xattr_opts *xattrs,
+				  spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	struct spdk_lvol *lvol;
+
+	req = calloc(1, sizeof(*req));
+	if (!req) {
+		SPDK_ERRLOG("Cannot alloc memory for lvol request pointer\n");
+		return NULL;
+	}
+
+	lvol = calloc(1, sizeof(*lvol));
+	if (!lvol) {
+		SPDK_ERRLOG("Cannot alloc memory for lvol base pointer\n");
+		free(req);
+		return NULL;
+	}
+
+	lvol->lvol_store = origlvol->lvol_store;
+	lvol->num_clusters = origlvol->num_clusters;
+	lvol->close_only = false;
+	strncpy(lvol->name, name, SPDK_LVOL_NAME_MAX);
+
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+	req->lvol = lvol;
+
+	xattrs->count = SPDK_COUNTOF(g_lvol_xattr_names);
+	xattrs->names = g_lvol_xattr_names;
+	xattrs->ctx = lvol;
+	xattrs->get_value = _spdk_lvol_get_xattr_value;
+
+	return req;
+}
+
+int
+spdk_lvol_create_snapshot(struct spdk_lvol *origlvol, const char *snapshot_name,
+			  spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	struct spdk_blob_xattr_opts xattrs;
+	int rc;
+
+	if (origlvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		return -ENODEV;
+	}
+
+	rc = _spdk_lvs_verify_lvol_name(origlvol->lvol_store, snapshot_name);
+	if (rc < 0) {
+		return rc;
+	}
+
+	req = _spdk_lvol_snapshot_clone_prepare(origlvol, snapshot_name, &xattrs, cb_fn, cb_arg);
+	if (!req) {
+		return -ENOMEM;
+	}
+
+	/* The snapshot takes over the clusters, the original allocates on write from now on */
+	req->lvol->thin_provision = origlvol->thin_provision;
+	origlvol->thin_provision = true;
+
+	spdk_bs_create_snapshot(origlvol->lvol_store->blobstore, origlvol->blob_id, &xattrs,
+				_spdk_lvol_snapshot_clone_cb, req);
+
+	return 0;
+}
+
+int
+spdk_lvol_create_clone(struct spdk_lvol *snapshot, const char *clone_name,
+		       spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_with_handle_req *req;
+	struct spdk_blob_xattr_opts xattrs;
+	int rc;
+
+	if (snapshot == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		return -ENODEV;
+	}
+
+	rc = _spdk_lvs_verify_lvol_name(snapshot->lvol_store, clone_name);
+	if (rc < 0) {
+		return rc;
+	}
+
+	req = _spdk_lvol_snapshot_clone_prepare(snapshot, clone_name, &xattrs, cb_fn, cb_arg);
+	if (!req) {
+		return -ENOMEM;
+	}
+
+	req->lvol->thin_provision = true;
+
+	spdk_bs_create_clone(snapshot->lvol_store->blobstore, snapshot->blob_id, &xattrs,
+			     _spdk_lvol_snapshot_clone_cb, req);
+
+	return 0;
+}
+
+static void
+_spdk_lvol_inflate_cb(void *cb_arg, int lvolerrno)
+{
+	struct spdk_lvol_req *req = cb_arg;
+
+	spdk_bs_free_io_channel(req->channel);
+
+	if (lvolerrno < 0) {
+		SPDK_ERRLOG("Could not inflate lvol %s\n", req->lvol->name);
+	} else if (!req->decouple) {
+		req->lvol->thin_provision = false;
+	}
+
+	req->cb_fn(req->cb_arg, lvolerrno);
+	free(req);
+}
+
+static void
+_spdk_lvol_inflate(struct spdk_lvol *lvol, bool decouple, spdk_lvol_op_complete cb_fn,
+		   void *cb_arg)
+{
+	struct spdk_lvol_req *req;
+	struct spdk_blob_store *bs;
+
+	assert(cb_fn != NULL);
+
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		cb_fn(cb_arg, -ENODEV);
+		return;
+	}
+
+	req = calloc(1, sizeof(*req));
+	if (!req) {
+		SPDK_ERRLOG("Cannot alloc memory for lvol request pointer\n");
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	bs = lvol->lvol_store->blobstore;
+
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+	req->lvol = lvol;
+	req->decouple = decouple;
+	req->channel = spdk_bs_alloc_io_channel(bs);
+	if (!req->channel) {
+		SPDK_ERRLOG("Cannot alloc io channel for lvol inflate request\n");
+		free(req);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	if (decouple) {
+		spdk_bs_blob_decouple_parent(bs, req->channel, lvol->blob_id, _spdk_lvol_inflate_cb, req);
+	} else {
+		spdk_bs_inflate_blob(bs, req->channel, lvol->blob_id, _spdk_lvol_inflate_cb, req);
+	}
+}
+
+void
+spdk_lvol_inflate(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	_spdk_lvol_inflate(lvol, false, cb_fn, cb_arg);
+}
+
+void
+spdk_lvol_decouple_parent(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	_spdk_lvol_inflate(lvol, true, cb_fn, cb_arg);
+}
+
 static void
 _spdk_lvol_resize_cb(void *cb_arg, int lvolerrno)
 {
@@ -1012,8 +1279,8 @@ spdk_lvol_resize(struct spdk_lvol *lvol, uint64_t sz,
 	uint64_t used_clusters = lvol->num_clusters;
 	uint64_t new_clusters = divide_round_up(sz, spdk_bs_get_cluster_size(lvs->blobstore));
 
-	/* Check if size of lvol increasing */
-	if (new_clusters > used_clusters) {
+	/* Check if size of lvol increasing.  Thin provisioned lvols claim clusters on write. */
+	if (new_clusters > used_clusters && !lvol->thin_provision) {
 		/* Check if there is enough clusters left to resize */
 		if (new_clusters - used_clusters > free_clusters) {
 			SPDK_ERRLOG("Not enough free clusters left on lvol store to resize lvol to %zu clusters\n", sz);
@@ -489,7 +489,7 @@ _spdk_nbd_poll(struct spdk_nbd_disk *nbd)
 	return 0;
 }
 
-static void
+static int
 spdk_nbd_poll(void *arg)
 {
 	struct spdk_nbd_disk *nbd = arg;
@@ -503,6 +503,8 @@ spdk_nbd_poll(void *arg)
 			     buf, rc);
 		spdk_nbd_stop(nbd);
 	}
+
+	return rc;
 }
 
 static void *
@@ -62,19 +62,23 @@ spdk_nvmf_tgt_opts_init(struct spdk_nvmf_tgt_opts *opts)
 	opts->max_io_size = SPDK_NVMF_DEFAULT_MAX_IO_SIZE;
 }
 
-static void
+static int
 spdk_nvmf_poll_group_poll(void *ctx)
 {
 	struct spdk_nvmf_poll_group *group = ctx;
 	int rc;
+	int count = 0;
 	struct spdk_nvmf_transport_poll_group *tgroup;
 
 	TAILQ_FOREACH(tgroup, &group->tgroups, link) {
 		rc = spdk_nvmf_transport_poll_group_poll(tgroup);
 		if (rc < 0) {
-			return;
+			return -1;
 		}
+		count += rc;
 	}
+
+	return count;
 }
 
 static int
@@ -328,14 +332,17 @@ spdk_nvmf_tgt_get_transport(struct spdk_nvmf_tgt *tgt, enum spdk_nvme_transport_
 	return NULL;
 }
 
-void
+int
 spdk_nvmf_tgt_accept(struct spdk_nvmf_tgt *tgt, new_qpair_fn cb_fn)
 {
 	struct spdk_nvmf_transport *transport, *tmp;
+	int count = 0;
 
 	TAILQ_FOREACH_SAFE(transport, &tgt->transports, link, tmp) {
-		spdk_nvmf_transport_accept(transport, cb_fn);
+		count += spdk_nvmf_transport_accept(transport, cb_fn);
 	}
+
+	return count;
 }
 
 struct spdk_nvmf_poll_group *
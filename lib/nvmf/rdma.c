@@ -1398,23 +1398,24 @@ spdk_nvmf_rdma_stop_listen(struct spdk_nvmf_transport *transport,
 	return 0;
 }
 
-static void
+static int
 spdk_nvmf_rdma_accept(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn)
 {
 	struct spdk_nvmf_rdma_transport *rtransport;
 	struct rdma_cm_event		*event;
-	int				rc;
+	int				rc, count = 0;
 	char buf[64];
 
 	rtransport = SPDK_CONTAINEROF(transport, struct spdk_nvmf_rdma_transport, transport);
 
 	if (rtransport->event_channel == NULL) {
-		return;
+		return 0;
 	}
 
 	while (1) {
 		rc = rdma_get_cm_event(rtransport->event_channel, &event);
 		if (rc == 0) {
+			count++;
 			SPDK_DEBUGLOG(SPDK_LOG_RDMA, "Acceptor Event: %s\n", CM_EVENT_STR[event->event]);
 
 			switch (event->event) {
@@ -1451,6 +1452,8 @@ spdk_nvmf_rdma_accept(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn)
 			break;
 		}
 	}
+
+	return count;
 }
 
 static void
@@ -103,10 +103,10 @@ spdk_nvmf_transport_stop_listen(struct spdk_nvmf_transport *transport,
 	return transport->ops->stop_listen(transport, trid);
 }
 
-void
+int
 spdk_nvmf_transport_accept(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn)
 {
-	transport->ops->accept(transport, cb_fn);
+	return transport->ops->accept(transport, cb_fn);
 }
 
 void
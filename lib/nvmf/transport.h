@@ -76,9 +76,10 @@ struct spdk_nvmf_transport_ops {
 			   const struct spdk_nvme_transport_id *trid);
 
 	/**
-	 * Check for new connections on the transport.
+	 * Check for new connections on the transport.  Returns the number of
+	 *  connection manager events processed.
 	 */
-	void (*accept)(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn);
+	int (*accept)(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn);
 
 	/**
 	 * Fill out a discovery log entry for a specific listen address.
@@ -141,7 +142,7 @@ int spdk_nvmf_transport_listen(struct spdk_nvmf_transport *transport,
 int spdk_nvmf_transport_stop_listen(struct spdk_nvmf_transport *transport,
 				    const struct spdk_nvme_transport_id *trid);
 
-void spdk_nvmf_transport_accept(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn);
+int spdk_nvmf_transport_accept(struct spdk_nvmf_transport *transport, new_qpair_fn cb_fn);
 
 void spdk_nvmf_transport_listener_discover(struct spdk_nvmf_transport *transport,
 		struct spdk_nvme_transport_id *trid,
@@ -32,7 +32,8 @@
  */
 
 #include "rocksdb/env.h"
-#include <set>
+#include "rocksdb/version.h"
+#include <vector>
 
 extern "C" {
 #include "spdk/env.h"
@@ -51,6 +52,8 @@ namespace rocksdb
 struct spdk_filesystem *g_fs = NULL;
 struct spdk_bs_dev *g_bs_dev;
 uint32_t g_lcore = 0;
+/* Cores other than g_lcore, which blobfs spreads the data path requests of files across */
+std::vector<uint32_t> g_io_cores;
 std::string g_bdev_name;
 volatile bool g_spdk_ready = false;
 struct sync_args {
@@ -77,6 +80,15 @@ __send_request(fs_request_fn fn, void *arg)
 	spdk_event_call(event);
 }
 
+static void
+__send_io_request(uint32_t thread_index, fs_request_fn fn, void *arg)
+{
+	struct spdk_event *event;
+
+	event = spdk_event_allocate(g_io_cores[thread_index], __call_fn, (void *)fn, arg);
+	spdk_event_call(event);
+}
+
 static std::string
 sanitize_path(const std::string &input, const std::string &mount_directory)
 {
@@ -109,12 +121,23 @@ sanitize_path(const std::string &input, const std::string &mount_directory)
 	return name;
 }
 
+static void
+add_dir_entry(void *ctx, const char *name, bool is_dir)
+{
+	std::vector<std::string> *result = (std::vector<std::string> *)ctx;
+
+	result->push_back(name);
+}
+
 class SpdkSequentialFile : public SequentialFile
 {
 	struct spdk_file *mFile;
 	uint64_t mOffset;
 public:
-	SpdkSequentialFile(struct spdk_file *file) : mFile(file), mOffset(0) {}
+	SpdkSequentialFile(struct spdk_file *file) : mFile(file), mOffset(0)
+	{
+		spdk_file_set_access_hint(mFile, SPDK_FILE_ACCESS_SEQUENTIAL);
+	}
 	virtual ~SpdkSequentialFile();
 
 	virtual Status Read(size_t n, Slice *result, char *scratch) override;
@@ -148,6 +171,7 @@ SpdkSequentialFile::Skip(uint64_t n)
 Status
 SpdkSequentialFile::InvalidateCache(size_t offset, size_t length)
 {
+	spdk_file_invalidate_cache(mFile, offset, length);
 	return Status::OK();
 }
 
@@ -159,12 +183,23 @@ public:
 	virtual ~SpdkRandomAccessFile();
 
 	virtual Status Read(uint64_t offset, size_t n, Slice *result, char *scratch) const override;
+#if ROCKSDB_MAJOR > 6 || (ROCKSDB_MAJOR == 6 && ROCKSDB_MINOR >= 4)
+	virtual Status MultiRead(ReadRequest *reqs, size_t num_reqs) override;
+#endif
+	virtual Status Prefetch(uint64_t offset, size_t n) override;
+	virtual void Hint(AccessPattern pattern) override;
 	virtual Status InvalidateCache(size_t offset, size_t length) override;
 };
 
 SpdkRandomAccessFile::SpdkRandomAccessFile(const std::string &fname, const EnvOptions &options)
 {
-	spdk_fs_open_file(g_fs, g_sync_args.channel, fname.c_str(), SPDK_BLOBFS_OPEN_CREATE, &mFile);
+	uint32_t flags = SPDK_BLOBFS_OPEN_CREATE;
+
+	/* Compaction inputs are read once, so keep them from pushing other files out of the cache */
+	if (options.use_direct_reads) {
+		flags |= SPDK_BLOBFS_OPEN_DIRECT;
+	}
+	spdk_fs_open_file(g_fs, g_sync_args.channel, fname.c_str(), flags, &mFile);
 }
 
 SpdkRandomAccessFile::~SpdkRandomAccessFile(void)
@@ -180,9 +215,64 @@ SpdkRandomAccessFile::Read(uint64_t offset, size_t n, Slice *result, char *scrat
 	return Status::OK();
 }
 
+#if ROCKSDB_MAJOR > 6 || (ROCKSDB_MAJOR == 6 && ROCKSDB_MINOR >= 4)
+Status
+SpdkRandomAccessFile::MultiRead(ReadRequest *reqs, size_t num_reqs)
+{
+	std::vector<struct spdk_file_read_req> file_reqs(num_reqs);
+	size_t i;
+
+	for (i = 0; i < num_reqs; i++) {
+		file_reqs[i].payload = reqs[i].scratch;
+		file_reqs[i].offset = reqs[i].offset;
+		file_reqs[i].length = reqs[i].len;
+	}
+
+	spdk_file_read_batch(mFile, g_sync_args.channel, file_reqs.data(), num_reqs);
+
+	for (i = 0; i < num_reqs; i++) {
+		if (file_reqs[i].result < 0) {
+			reqs[i].status = Status::IOError(strerror(-file_reqs[i].result));
+			reqs[i].result = Slice();
+		} else {
+			reqs[i].status = Status::OK();
+			reqs[i].result = Slice(reqs[i].scratch, file_reqs[i].result);
+		}
+	}
+	return Status::OK();
+}
+#endif
+
+Status
+SpdkRandomAccessFile::Prefetch(uint64_t offset, size_t n)
+{
+	spdk_file_prefetch(mFile, offset, n);
+	return Status::OK();
+}
+
+void
+SpdkRandomAccessFile::Hint(AccessPattern pattern)
+{
+	switch (pattern) {
+	case RANDOM:
+		spdk_file_set_access_hint(mFile, SPDK_FILE_ACCESS_RANDOM);
+		break;
+	case SEQUENTIAL:
+		spdk_file_set_access_hint(mFile, SPDK_FILE_ACCESS_SEQUENTIAL);
+		break;
+	case DONTNEED:
+		spdk_file_invalidate_cache(mFile, 0, 0);
+		break;
+	default:
+		spdk_file_set_access_hint(mFile, SPDK_FILE_ACCESS_NORMAL);
+		break;
+	}
+}
+
 Status
 SpdkRandomAccessFile::InvalidateCache(size_t offset, size_t length)
 {
+	spdk_file_invalidate_cache(mFile, offset, length);
 	return Status::OK();
 }
 
@@ -244,12 +334,20 @@ public:
 	}
 	virtual Status InvalidateCache(size_t offset, size_t length) override
 	{
+		if (mFile != NULL) {
+			spdk_file_invalidate_cache(mFile, offset, length);
+		}
 		return Status::OK();
 	}
 #ifdef ROCKSDB_FALLOCATE_PRESENT
 	virtual Status Allocate(uint64_t offset, uint64_t len) override
 	{
-		spdk_file_truncate(mFile, g_sync_args.channel, offset + len);
+		int rc;
+
+		rc = spdk_file_allocate(mFile, g_sync_args.channel, offset + len);
+		if (rc != 0) {
+			return Status::IOError(spdk_file_get_name(mFile), strerror(-rc));
+		}
 		return Status::OK();
 	}
 	virtual Status RangeSync(uint64_t offset, uint64_t nbytes) override
@@ -444,42 +542,16 @@ public:
 	virtual Status GetChildren(const std::string &dir,
 				   std::vector<std::string> *result) override
 	{
-		std::string::size_type pos;
-		std::set<std::string> dir_and_file_set;
-		std::string full_path;
-		std::string filename;
 		std::string dir_name;
 
 		if (dir.find("archive") != std::string::npos) {
 			return Status::OK();
 		}
 		if (dir.compare(0, mDirectory.length(), mDirectory) == 0) {
-			spdk_fs_iter iter;
-			struct spdk_file *file;
 			dir_name = sanitize_path(dir, mDirectory);
 
-			iter = spdk_fs_iter_first(g_fs);
-			while (iter != NULL) {
-				file = spdk_fs_iter_get_file(iter);
-				full_path = spdk_file_get_name(file);
-				if (strncmp(dir_name.c_str(), full_path.c_str(), dir_name.length())) {
-					iter = spdk_fs_iter_next(iter);
-					continue;
-				}
-				pos = full_path.find("/", dir_name.length() + 1);
-
-				if (pos != std::string::npos) {
-					filename = full_path.substr(dir_name.length() + 1, pos - dir_name.length() - 1);
-				} else {
-					filename = full_path.substr(dir_name.length() + 1);
-				}
-				dir_and_file_set.insert(filename);
-				iter = spdk_fs_iter_next(iter);
-			}
-
-			for (auto &s : dir_and_file_set) {
-				result->push_back(s);
-			}
+			/* A directory without files does not exist in blobfs, so it has no children */
+			spdk_fs_read_dir(g_fs, g_sync_args.channel, dir_name.c_str(), add_dir_entry, result);
 
 			result->push_back(".");
 			result->push_back("..");
@@ -528,11 +600,36 @@ void SpdkEnv::StartThread(void (*function)(void *arg), void *arg)
 	EnvWrapper::StartThread(SpdkStartThreadWrapper, state);
 }
 
+static void
+set_io_cores(struct spdk_filesystem *fs)
+{
+	uint32_t core;
+	int rc;
+
+	SPDK_ENV_FOREACH_CORE(core) {
+		if (core != g_lcore) {
+			g_io_cores.push_back(core);
+		}
+	}
+
+	if (g_io_cores.empty()) {
+		/* Single core, everything runs on g_lcore */
+		return;
+	}
+
+	rc = spdk_fs_set_io_threads(fs, g_io_cores.size(), __send_io_request);
+	if (rc != 0) {
+		SPDK_ERRLOG("could not spread blobfs I/O across cores (err %d)\n", rc);
+		g_io_cores.clear();
+	}
+}
+
 static void
 fs_load_cb(void *ctx, struct spdk_filesystem *fs, int fserrno)
 {
 	if (fserrno == 0) {
 		g_fs = fs;
+		set_io_cores(fs);
 	}
 	g_spdk_ready = true;
 }
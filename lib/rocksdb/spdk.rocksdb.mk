@@ -54,7 +54,7 @@ CXXFLAGS += -fno-sanitize=address
 endif
 
 SPDK_LIB_LIST = event_bdev event_copy
-SPDK_LIB_LIST += blobfs bdev copy event util conf trace \
+SPDK_LIB_LIST += blobfs blobfs_rpc bdev copy event util conf trace \
 		log jsonrpc json rpc
 
 AM_LINK += $(COPY_MODULES_LINKER_ARGS) $(BLOCKDEV_MODULES_LINKER_ARGS)
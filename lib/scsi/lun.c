@@ -225,15 +225,19 @@ spdk_scsi_lun_execute_tasks(struct spdk_scsi_lun *lun)
 	}
 }
 
-static void
+static int
 spdk_scsi_lun_hotplug(void *arg)
 {
 	struct spdk_scsi_lun *lun = (struct spdk_scsi_lun *)arg;
 
-	if (!spdk_scsi_lun_has_pending_tasks(lun)) {
-		spdk_scsi_lun_free_io_channel(lun);
-		spdk_scsi_lun_delete(lun);
+	if (spdk_scsi_lun_has_pending_tasks(lun)) {
+		return 0;
 	}
+
+	spdk_scsi_lun_free_io_channel(lun);
+	spdk_scsi_lun_delete(lun);
+
+	return 1;
 }
 
 static void
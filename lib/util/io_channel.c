@@ -77,9 +77,12 @@ struct spdk_io_channel {
 
 struct spdk_thread {
 	pthread_t thread_id;
+	/* Set for threads tied to a pthread by spdk_allocate_thread(). */
+	bool bound;
 	spdk_thread_pass_msg msg_fn;
 	spdk_start_poller start_poller_fn;
 	spdk_stop_poller stop_poller_fn;
+	spdk_poller_interrupt_fd interrupt_fd_fn;
 	void *thread_ctx;
 	TAILQ_HEAD(, spdk_io_channel) io_channels;
 	TAILQ_ENTRY(spdk_thread) tailq;
@@ -88,8 +91,11 @@ struct spdk_thread {
 
 static TAILQ_HEAD(, spdk_thread) g_threads = TAILQ_HEAD_INITIALIZER(g_threads);
 
+/* Thread made current on this pthread with spdk_set_thread(), if any. */
+static __thread struct spdk_thread *tls_thread;
+
 static struct spdk_thread *
-_get_thread(void)
+_get_bound_thread(void)
 {
 	pthread_t thread_id;
 	struct spdk_thread *thread;
@@ -98,7 +104,7 @@ _get_thread(void)
 
 	thread = NULL;
 	TAILQ_FOREACH(thread, &g_threads, tailq) {
-		if (thread->thread_id == thread_id) {
+		if (thread->bound && thread->thread_id == thread_id) {
 			return thread;
 		}
 	}
@@ -106,6 +112,16 @@ _get_thread(void)
 	return NULL;
 }
 
+static struct spdk_thread *
+_get_thread(void)
+{
+	if (tls_thread) {
+		return tls_thread;
+	}
+
+	return _get_bound_thread();
+}
+
 static void
 _set_thread_name(const char *thread_name)
 {
@@ -118,6 +134,32 @@ _set_thread_name(const char *thread_name)
 #endif
 }
 
+static struct spdk_thread *
+_spdk_thread_alloc(spdk_thread_pass_msg msg_fn,
+		   spdk_start_poller start_poller_fn,
+		   spdk_stop_poller stop_poller_fn,
+		   void *thread_ctx, const char *name)
+{
+	struct spdk_thread *thread;
+
+	thread = calloc(1, sizeof(*thread));
+	if (!thread) {
+		SPDK_ERRLOG("Unable to allocate memory for thread\n");
+		return NULL;
+	}
+
+	thread->msg_fn = msg_fn;
+	thread->start_poller_fn = start_poller_fn;
+	thread->stop_poller_fn = stop_poller_fn;
+	thread->thread_ctx = thread_ctx;
+	TAILQ_INIT(&thread->io_channels);
+	if (name) {
+		thread->name = strdup(name);
+	}
+
+	return thread;
+}
+
 struct spdk_thread *
 spdk_allocate_thread(spdk_thread_pass_msg msg_fn,
 		     spdk_start_poller start_poller_fn,
@@ -128,30 +170,24 @@ spdk_allocate_thread(spdk_thread_pass_msg msg_fn,
 
 	pthread_mutex_lock(&g_devlist_mutex);
 
-	thread = _get_thread();
+	thread = _get_bound_thread();
 	if (thread) {
 		SPDK_ERRLOG("Double allocated SPDK thread\n");
 		pthread_mutex_unlock(&g_devlist_mutex);
 		return NULL;
 	}
 
-	thread = calloc(1, sizeof(*thread));
+	thread = _spdk_thread_alloc(msg_fn, start_poller_fn, stop_poller_fn, thread_ctx, name);
 	if (!thread) {
-		SPDK_ERRLOG("Unable to allocate memory for thread\n");
 		pthread_mutex_unlock(&g_devlist_mutex);
 		return NULL;
 	}
 
 	thread->thread_id = pthread_self();
-	thread->msg_fn = msg_fn;
-	thread->start_poller_fn = start_poller_fn;
-	thread->stop_poller_fn = stop_poller_fn;
-	thread->thread_ctx = thread_ctx;
-	TAILQ_INIT(&thread->io_channels);
+	thread->bound = true;
 	TAILQ_INSERT_TAIL(&g_threads, thread, tailq);
 	if (name) {
 		_set_thread_name(name);
-		thread->name = strdup(name);
 	}
 
 	pthread_mutex_unlock(&g_devlist_mutex);
@@ -166,13 +202,17 @@ spdk_free_thread(void)
 
 	pthread_mutex_lock(&g_devlist_mutex);
 
-	thread = _get_thread();
+	thread = _get_bound_thread();
 	if (!thread) {
 		SPDK_ERRLOG("No thread allocated\n");
 		pthread_mutex_unlock(&g_devlist_mutex);
 		return;
 	}
 
+	if (tls_thread == thread) {
+		tls_thread = NULL;
+	}
+
 	TAILQ_REMOVE(&g_threads, thread, tailq);
 	free(thread->name);
 	free(thread);
@@ -180,14 +220,80 @@ spdk_free_thread(void)
 	pthread_mutex_unlock(&g_devlist_mutex);
 }
 
+struct spdk_thread *
+spdk_thread_create(spdk_thread_pass_msg msg_fn,
+		   spdk_start_poller start_poller_fn,
+		   spdk_stop_poller stop_poller_fn,
+		   void *thread_ctx, const char *name)
+{
+	struct spdk_thread *thread;
+
+	thread = _spdk_thread_alloc(msg_fn, start_poller_fn, stop_poller_fn, thread_ctx, name);
+	if (!thread) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&g_devlist_mutex);
+	TAILQ_INSERT_TAIL(&g_threads, thread, tailq);
+	pthread_mutex_unlock(&g_devlist_mutex);
+
+	return thread;
+}
+
+void
+spdk_thread_destroy(struct spdk_thread *thread)
+{
+	assert(!thread->bound);
+
+	if (!TAILQ_EMPTY(&thread->io_channels)) {
+		SPDK_ERRLOG("Thread %s destroyed with I/O channels still allocated\n",
+			    thread->name ? thread->name : "(unnamed)");
+	}
+
+	pthread_mutex_lock(&g_devlist_mutex);
+	if (tls_thread == thread) {
+		tls_thread = NULL;
+	}
+	TAILQ_REMOVE(&g_threads, thread, tailq);
+	pthread_mutex_unlock(&g_devlist_mutex);
+
+	free(thread->name);
+	free(thread);
+}
+
+struct spdk_thread *
+spdk_set_thread(struct spdk_thread *thread)
+{
+	struct spdk_thread *prev = tls_thread;
+
+	tls_thread = thread;
+
+	return prev;
+}
+
+void
+spdk_thread_set_interrupt_fd_fn(spdk_poller_interrupt_fd interrupt_fd_fn)
+{
+	struct spdk_thread *thread;
+
+	thread = spdk_get_thread();
+	if (thread) {
+		thread->interrupt_fd_fn = interrupt_fd_fn;
+	}
+}
+
 struct spdk_thread *
 spdk_get_thread(void)
 {
 	struct spdk_thread *thread;
 
+	if (tls_thread) {
+		return tls_thread;
+	}
+
 	pthread_mutex_lock(&g_devlist_mutex);
 
-	thread = _get_thread();
+	thread = _get_bound_thread();
 	if (!thread) {
 		SPDK_ERRLOG("No thread allocated\n");
 	}
@@ -252,6 +358,32 @@ spdk_poller_unregister(struct spdk_poller **ppoller)
 	}
 }
 
+int
+spdk_poller_add_interrupt_fd(struct spdk_poller *poller, int fd)
+{
+	struct spdk_thread *thread;
+
+	thread = spdk_get_thread();
+	if (!thread || !thread->interrupt_fd_fn) {
+		return -ENOTSUP;
+	}
+
+	return thread->interrupt_fd_fn(poller, fd, true, thread->thread_ctx);
+}
+
+void
+spdk_poller_remove_interrupt_fd(struct spdk_poller *poller, int fd)
+{
+	struct spdk_thread *thread;
+
+	thread = spdk_get_thread();
+	if (!thread || !thread->interrupt_fd_fn) {
+		return;
+	}
+
+	thread->interrupt_fd_fn(poller, fd, false, thread->thread_ctx);
+}
+
 struct call_thread {
 	struct spdk_thread *cur_thread;
 	spdk_thread_fn fn;
@@ -269,7 +269,7 @@ process_blk_request(struct spdk_vhost_blk_task *task, struct spdk_vhost_blk_dev
 	return 0;
 }
 
-static void
+static int
 process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue *vq)
 {
 	struct spdk_vhost_blk_task *task;
@@ -279,7 +279,7 @@ process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue *vq)
 
 	reqs_cnt = spdk_vhost_vq_avail_ring_get(vq, reqs, SPDK_COUNTOF(reqs));
 	if (!reqs_cnt) {
-		return;
+		return 0;
 	}
 
 	for (i = 0; i < reqs_cnt; i++) {
@@ -315,22 +315,27 @@ process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue *vq)
 			SPDK_DEBUGLOG(SPDK_LOG_VHOST_BLK, "====== Task %p req_idx %d failed ======\n", task, reqs[i]);
 		}
 	}
+
+	return reqs_cnt;
 }
 
-static void
+static int
 vdev_worker(void *arg)
 {
 	struct spdk_vhost_blk_dev *bvdev = arg;
 	uint16_t q_idx;
+	int count = 0;
 
 	for (q_idx = 0; q_idx < bvdev->vdev.num_queues; q_idx++) {
-		process_vq(bvdev, &bvdev->vdev.virtqueue[q_idx]);
+		count += process_vq(bvdev, &bvdev->vdev.virtqueue[q_idx]);
 	}
 
 	spdk_vhost_dev_used_signal(&bvdev->vdev);
+
+	return count;
 }
 
-static void
+static int
 no_bdev_process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue *vq)
 {
 	struct iovec iovs[SPDK_VHOST_IOVS_MAX];
@@ -338,7 +343,7 @@ no_bdev_process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue
 	uint16_t iovcnt, req_idx;
 
 	if (spdk_vhost_vq_avail_ring_get(vq, &req_idx, 1) != 1) {
-		return;
+		return 0;
 	}
 
 	iovcnt = SPDK_COUNTOF(iovs);
@@ -348,19 +353,24 @@ no_bdev_process_vq(struct spdk_vhost_blk_dev *bvdev, struct spdk_vhost_virtqueue
 	}
 
 	spdk_vhost_vq_used_ring_enqueue(&bvdev->vdev, vq, req_idx, 0);
+
+	return 1;
 }
 
-static void
+static int
 no_bdev_vdev_worker(void *arg)
 {
 	struct spdk_vhost_blk_dev *bvdev = arg;
 	uint16_t q_idx;
+	int count = 0;
 
 	for (q_idx = 0; q_idx < bvdev->vdev.num_queues; q_idx++) {
-		no_bdev_process_vq(bvdev, &bvdev->vdev.virtqueue[q_idx]);
+		count += no_bdev_process_vq(bvdev, &bvdev->vdev.virtqueue[q_idx]);
 	}
 
 	spdk_vhost_dev_used_signal(&bvdev->vdev);
+
+	return count;
 }
 
 static struct spdk_vhost_blk_dev *
@@ -519,7 +529,7 @@ struct spdk_vhost_dev_destroy_ctx {
 	void *event_ctx;
 };
 
-static void
+static int
 destroy_device_poller_cb(void *arg)
 {
 	struct spdk_vhost_dev_destroy_ctx *ctx = arg;
@@ -527,7 +537,7 @@ destroy_device_poller_cb(void *arg)
 	int i;
 
 	if (bvdev->vdev.task_cnt > 0) {
-		return;
+		return 0;
 	}
 
 	for (i = 0; i < bvdev->vdev.num_queues; i++) {
@@ -548,6 +558,8 @@ destroy_device_poller_cb(void *arg)
 	spdk_poller_unregister(&ctx->poller);
 	spdk_vhost_dev_backend_event_done(ctx->event_ctx, 0);
 	spdk_dma_free(ctx);
+
+	return 1;
 }
 
 static int
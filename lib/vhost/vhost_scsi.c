@@ -556,7 +556,7 @@ process_request(struct spdk_vhost_scsi_task *task)
 	return 0;
 }
 
-static void
+static int
 process_controlq(struct spdk_vhost_scsi_dev *svdev, struct spdk_vhost_virtqueue *vq)
 {
 	struct spdk_vhost_scsi_task *task;
@@ -586,9 +586,11 @@ process_controlq(struct spdk_vhost_scsi_dev *svdev, struct spdk_vhost_virtqueue
 		task->used = true;
 		process_ctrl_request(task);
 	}
+
+	return reqs_cnt;
 }
 
-static void
+static int
 process_requestq(struct spdk_vhost_scsi_dev *svdev, struct spdk_vhost_virtqueue *vq)
 {
 	struct spdk_vhost_scsi_task *task;
@@ -637,31 +639,39 @@ process_requestq(struct spdk_vhost_scsi_dev *svdev, struct spdk_vhost_virtqueue
 				      task->req_idx);
 		}
 	}
+
+	return reqs_cnt;
 }
 
-static void
+static int
 vdev_mgmt_worker(void *arg)
 {
 	struct spdk_vhost_scsi_dev *svdev = arg;
+	int count;
 
 	process_removed_devs(svdev);
 	spdk_vhost_vq_used_signal(&svdev->vdev, &svdev->vdev.virtqueue[VIRTIO_SCSI_EVENTQ]);
 
-	process_controlq(svdev, &svdev->vdev.virtqueue[VIRTIO_SCSI_CONTROLQ]);
+	count = process_controlq(svdev, &svdev->vdev.virtqueue[VIRTIO_SCSI_CONTROLQ]);
 	spdk_vhost_vq_used_signal(&svdev->vdev, &svdev->vdev.virtqueue[VIRTIO_SCSI_CONTROLQ]);
+
+	return count;
 }
 
-static void
+static int
 vdev_worker(void *arg)
 {
 	struct spdk_vhost_scsi_dev *svdev = arg;
 	uint32_t q_idx;
+	int count = 0;
 
 	for (q_idx = VIRTIO_SCSI_REQUESTQ; q_idx < svdev->vdev.num_queues; q_idx++) {
-		process_requestq(svdev, &svdev->vdev.virtqueue[q_idx]);
+		count += process_requestq(svdev, &svdev->vdev.virtqueue[q_idx]);
 	}
 
 	spdk_vhost_dev_used_signal(&svdev->vdev);
+
+	return count;
 }
 
 static struct spdk_vhost_scsi_dev *
@@ -1085,7 +1095,7 @@ struct spdk_vhost_dev_destroy_ctx {
 	void *event_ctx;
 };
 
-static void
+static int
 destroy_device_poller_cb(void *arg)
 {
 	struct spdk_vhost_dev_destroy_ctx *ctx = arg;
@@ -1093,7 +1103,7 @@ destroy_device_poller_cb(void *arg)
 	uint32_t i;
 
 	if (svdev->vdev.task_cnt > 0) {
-		return;
+		return 0;
 	}
 
 
@@ -1116,6 +1126,8 @@ destroy_device_poller_cb(void *arg)
 	spdk_poller_unregister(&ctx->poller);
 	spdk_vhost_dev_backend_event_done(ctx->event_ctx, 0);
 	spdk_dma_free(ctx);
+
+	return 1;
 }
 
 static int
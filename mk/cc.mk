@@ -0,0 +1,4 @@
+CC=cc
+CXX=g++
+CCAR=ar
+CC_TYPE=gcc
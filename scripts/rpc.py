@@ -362,6 +362,8 @@ p.set_defaults(func=construct_lvol_store)
 def construct_lvol_bdev(args):
     num_bytes = (args.size * 1024 * 1024)
     params = {'lvol_name': args.lvol_name, 'size': num_bytes}
+    if args.thin_provision:
+        params['thin_provision'] = args.thin_provision
     if (args.uuid and args.lvs_name) or (not args.uuid and not args.lvs_name):
         print("You need to specify either uuid or name of lvolstore")
     else:
@@ -373,10 +375,54 @@ def construct_lvol_bdev(args):
 p = subparsers.add_parser('construct_lvol_bdev', help='Add a bdev with an logical volume backend')
 p.add_argument('-u', '--uuid', help='lvol store UUID', required=False)
 p.add_argument('-l', '--lvs_name', help='lvol store name', required=False)
+p.add_argument('-t', '--thin-provision', action='store_true', help='create lvol bdev as thin provisioned')
 p.add_argument('lvol_name', help='name for this lvol')
 p.add_argument('size', help='size in MiB for this bdev', type=int)
 p.set_defaults(func=construct_lvol_bdev)
 
+def snapshot_lvol_bdev(args):
+    params = {
+        'lvol_name': args.lvol_name,
+        'snapshot_name': args.snapshot_name
+    }
+    print_array(jsonrpc_call('snapshot_lvol_bdev', params))
+p = subparsers.add_parser('snapshot_lvol_bdev', help='Create a snapshot of an lvol bdev')
+p.add_argument('lvol_name', help='lvol bdev name')
+p.add_argument('snapshot_name', help='lvol snapshot name')
+p.set_defaults(func=snapshot_lvol_bdev)
+
+
+def clone_lvol_bdev(args):
+    params = {
+        'snapshot_name': args.snapshot_name,
+        'clone_name': args.clone_name
+    }
+    print_array(jsonrpc_call('clone_lvol_bdev', params))
+p = subparsers.add_parser('clone_lvol_bdev', help='Create a clone of an lvol snapshot')
+p.add_argument('snapshot_name', help='lvol snapshot bdev name')
+p.add_argument('clone_name', help='lvol clone name')
+p.set_defaults(func=clone_lvol_bdev)
+
+
+def inflate_lvol_bdev(args):
+    params = {
+        'name': args.name
+    }
+    jsonrpc_call('inflate_lvol_bdev', params)
+p = subparsers.add_parser('inflate_lvol_bdev', help='Make an lvol bdev independent of its snapshots')
+p.add_argument('name', help='lvol bdev name')
+p.set_defaults(func=inflate_lvol_bdev)
+
+
+def decouple_parent_lvol_bdev(args):
+    params = {
+        'name': args.name
+    }
+    jsonrpc_call('decouple_parent_lvol_bdev', params)
+p = subparsers.add_parser('decouple_parent_lvol_bdev', help='Make an lvol bdev independent of its immediate snapshot')
+p.add_argument('name', help='lvol bdev name')
+p.set_defaults(func=decouple_parent_lvol_bdev)
+
 # Logical volume resize feature is disabled, as it is currently work in progress
 #
 # def resize_lvol_bdev(args):
@@ -414,6 +460,29 @@ p = subparsers.add_parser('get_lvol_stores', help='Display current logical volum
 p.set_defaults(func=get_lvol_stores)
 
 
+def set_blobfs_cache_size(args):
+    params = {'size_in_mb': args.size_in_mb}
+    print(jsonrpc_call('set_blobfs_cache_size', params))
+
+p = subparsers.add_parser('set_blobfs_cache_size', help='Set the size of the blobfs cache')
+p.add_argument('size_in_mb', help='cache size in MiB', type=int)
+p.set_defaults(func=set_blobfs_cache_size)
+
+
+def get_blobfs_cache_stats(args):
+    print_dict(jsonrpc_call('get_blobfs_cache_stats'))
+
+p = subparsers.add_parser('get_blobfs_cache_stats', help='Display blobfs cache size and statistics')
+p.set_defaults(func=get_blobfs_cache_stats)
+
+
+def get_fuse_stats(args):
+    print_dict(jsonrpc_call('get_fuse_stats'))
+
+p = subparsers.add_parser('get_fuse_stats', help='Display request counts and latencies of the blobfs FUSE daemon')
+p.set_defaults(func=get_fuse_stats)
+
+
 def set_trace_flag(args):
     params = {'flag': args.flag}
     jsonrpc_call('set_trace_flag', params)
@@ -861,5 +930,22 @@ p.add_argument('-e', '--enable', action='store_true', help='Enable context switc
 p.add_argument('-d', '--disable', action='store_true', help='Disable context switch monitoring')
 p.set_defaults(func=context_switch_monitor)
 
+def get_reactor_scheduler(args):
+    print_dict(jsonrpc_call('get_reactor_scheduler'))
+
+p = subparsers.add_parser('get_reactor_scheduler', help='Display reactor load and scheduler decisions')
+p.set_defaults(func=get_reactor_scheduler)
+
+def set_reactor_scheduler(args):
+    params = {'name': args.name}
+    if args.period_us:
+        params['period_us'] = args.period_us
+    jsonrpc_call('set_reactor_scheduler', params)
+
+p = subparsers.add_parser('set_reactor_scheduler', help='Select the reactor scheduler policy')
+p.add_argument('name', help='Scheduler name: static or balanced')
+p.add_argument('-p', '--period-us', help='Scheduler period in microseconds', type=int)
+p.set_defaults(func=set_reactor_scheduler)
+
 args = parser.parse_args()
 args.func(args)
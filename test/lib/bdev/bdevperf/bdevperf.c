@@ -451,7 +451,7 @@ bdevperf_submit_io(struct io_target *target, int queue_depth)
 	}
 }
 
-static void
+static int
 end_target(void *arg)
 {
 	struct io_target *target = arg;
@@ -462,9 +462,11 @@ end_target(void *arg)
 	}
 
 	target->is_draining = true;
+
+	return 1;
 }
 
-static void reset_target(void *arg);
+static int reset_target(void *arg);
 
 static void
 reset_cb(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
@@ -485,7 +487,7 @@ reset_cb(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
 			      10 * 1000000);
 }
 
-static void
+static int
 reset_target(void *arg)
 {
 	struct io_target *target = arg;
@@ -509,6 +511,8 @@ reset_target(void *arg)
 		target->is_draining = true;
 		g_run_failed = true;
 	}
+
+	return 1;
 }
 
 static void
@@ -596,11 +600,13 @@ performance_dump(uint64_t io_time_in_usec)
 
 }
 
-static void
+static int
 performance_statistics_thread(void *arg)
 {
 	g_show_performance_period_num++;
 	performance_dump(g_show_performance_period_num * g_show_performance_period_in_usec);
+
+	return 1;
 }
 
 static int
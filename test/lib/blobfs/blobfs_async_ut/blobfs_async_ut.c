@@ -61,6 +61,12 @@ spdk_conf_section_get_intval(struct spdk_conf_section *sp, const char *key)
 	return -1;
 }
 
+DEFINE_STUB(spdk_env_get_first_core, uint32_t, (void), UINT32_MAX);
+DEFINE_STUB(spdk_env_get_next_core, uint32_t, (uint32_t prev_core), UINT32_MAX);
+DEFINE_STUB(spdk_env_get_current_core, uint32_t, (void), UINT32_MAX);
+DEFINE_STUB(spdk_env_get_socket_id, uint32_t, (uint32_t core), 0);
+DEFINE_STUB(spdk_env_get_socket_id_of_cpu, int, (uint32_t cpu), 0);
+
 static void
 _fs_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
 {
@@ -63,6 +63,40 @@ spdk_conf_section_get_intval(struct spdk_conf_section *sp, const char *key)
 	return -1;
 }
 
+/* Two cores, each on a socket of its own */
+static uint32_t g_ut_core;
+
+uint32_t
+spdk_env_get_first_core(void)
+{
+	return 0;
+}
+
+uint32_t
+spdk_env_get_next_core(uint32_t prev_core)
+{
+	return prev_core == 0 ? 1 : UINT32_MAX;
+}
+
+uint32_t
+spdk_env_get_current_core(void)
+{
+	return g_ut_core;
+}
+
+uint32_t
+spdk_env_get_socket_id(uint32_t core)
+{
+	return core;
+}
+
+/* Threads outside of the SPDK cores always run on socket 1 */
+int
+spdk_env_get_socket_id_of_cpu(uint32_t cpu)
+{
+	return 1;
+}
+
 static void
 _fs_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
 {
@@ -74,9 +108,10 @@ struct ut_request {
 	void *arg;
 	volatile int done;
 	int from_ut;
+	TAILQ_ENTRY(ut_request) link;
 };
 
-static struct ut_request *g_req = NULL;
+static TAILQ_HEAD(, ut_request) g_reqs = TAILQ_HEAD_INITIALIZER(g_reqs);
 static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void
@@ -92,7 +127,7 @@ send_request(fs_request_fn fn, void *arg)
 	req->from_ut = 0;
 
 	pthread_mutex_lock(&g_mutex);
-	g_req = req;
+	TAILQ_INSERT_TAIL(&g_reqs, req, link);
 	pthread_mutex_unlock(&g_mutex);
 }
 
@@ -108,7 +143,7 @@ ut_send_request(fs_request_fn fn, void *arg)
 	req.from_ut = 1;
 
 	pthread_mutex_lock(&g_mutex);
-	g_req = &req;
+	TAILQ_INSERT_TAIL(&g_reqs, &req, link);
 	pthread_mutex_unlock(&g_mutex);
 
 	while (1) {
@@ -119,12 +154,6 @@ ut_send_request(fs_request_fn fn, void *arg)
 		}
 		pthread_mutex_unlock(&g_mutex);
 	}
-
-	/*
-	 * Make sure the address of the local req variable is not in g_req when we exit this
-	 * function to make static analysis tools happy.
-	 */
-	g_req = NULL;
 }
 
 static void
@@ -300,6 +329,917 @@ cache_append_no_cache(void)
 	ut_send_request(_fs_unload, NULL);
 }
 
+static uint32_t g_io_thread_requests[2];
+
+static void
+send_io_request(uint32_t thread_index, fs_request_fn fn, void *arg)
+{
+	SPDK_CU_ASSERT_FATAL(thread_index < 2);
+	g_io_thread_requests[thread_index]++;
+	send_request(fn, arg);
+}
+
+static void
+cache_write_io_threads(void)
+{
+	int rc;
+	char buf[100];
+	uint32_t thread_index;
+	struct spdk_io_channel *channel;
+
+	ut_send_request(_fs_init, NULL);
+
+	rc = spdk_fs_set_io_threads(g_fs, 0, send_io_request);
+	CU_ASSERT(rc == -EINVAL);
+	rc = spdk_fs_set_io_threads(g_fs, 2, send_io_request);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_set_io_threads(g_fs, 2, send_io_request);
+	CU_ASSERT(rc == -EBUSY);
+
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	memset(buf, 0x5A, sizeof(buf));
+
+	/* The sync flushes the cache through the file's I/O thread */
+	memset(g_io_thread_requests, 0, sizeof(g_io_thread_requests));
+	rc = spdk_file_write(g_file, channel, buf, 0, sizeof(buf));
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(g_file, channel);
+	CU_ASSERT(spdk_file_get_length(g_file) == sizeof(buf));
+
+	thread_index = g_file->blobid % 2;
+	CU_ASSERT(g_io_thread_requests[thread_index] > 0);
+	CU_ASSERT(g_io_thread_requests[!thread_index] == 0);
+
+	/* Reads that miss the cache go through the same thread */
+	cache_free_buffers(g_file);
+	memset(buf, 0, sizeof(buf));
+	g_io_thread_requests[thread_index] = 0;
+	CU_ASSERT(spdk_file_read(g_file, channel, buf, 0, sizeof(buf)) == sizeof(buf));
+	CU_ASSERT(g_io_thread_requests[thread_index] > 0);
+	CU_ASSERT(buf[0] == 0x5A && buf[sizeof(buf) - 1] == 0x5A);
+
+	spdk_file_close(g_file, channel);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+cache_eviction(void)
+{
+	int rc;
+	char *buf;
+	struct spdk_io_channel *channel;
+	struct spdk_file *file_a, *file_b, *file_c;
+	struct spdk_fs_cache_stats stats;
+
+	/* Room for 8 cache buffers */
+	spdk_fs_set_cache_size(2);
+	ut_send_request(_fs_init, NULL);
+
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+
+	buf = calloc(1, 4 * CACHE_BUFFER_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+	memset(buf, 0x5A, 4 * CACHE_BUFFER_SIZE);
+
+	/* a caches 2 clean buffers at high priority, c 1 clean buffer at low priority */
+	rc = spdk_fs_open_file(g_fs, channel, "file_a", SPDK_BLOBFS_OPEN_CREATE, &file_a);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(file_a != NULL);
+	spdk_file_set_priority(file_a, SPDK_FILE_PRIORITY_HIGH);
+	rc = spdk_file_write(file_a, channel, buf, 0, 2 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(file_a, channel);
+
+	rc = spdk_fs_open_file(g_fs, channel, "file_c", SPDK_BLOBFS_OPEN_CREATE, &file_c);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(file_c != NULL);
+	rc = spdk_file_write(file_c, channel, buf, 0, CACHE_BUFFER_SIZE);
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(file_c, channel);
+
+	/* Each file also holds the empty buffer it appends to next */
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.bytes_cached == 5 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(stats.evictions == 0);
+
+	/* b needs 5 buffers, so the buffer of c is evicted and then just one of a */
+	rc = spdk_fs_open_file(g_fs, channel, "file_b", SPDK_BLOBFS_OPEN_CREATE, &file_b);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(file_b != NULL);
+	rc = spdk_file_write(file_b, channel, buf, 0, 4 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(file_b, channel);
+
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.bytes_cached == 8 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(stats.evictions == 2);
+	CU_ASSERT(spdk_tree_find_buffer(file_c->tree, 0) == NULL);
+	CU_ASSERT((spdk_tree_find_buffer(file_a->tree, 0) == NULL) !=
+		  (spdk_tree_find_buffer(file_a->tree, CACHE_BUFFER_SIZE) == NULL));
+
+	/* Buffers stay cached once read, evicted data is read from the blob */
+	memset(buf, 0, 100);
+	CU_ASSERT(spdk_file_read(file_b, channel, buf, 0, 100) == 100);
+	CU_ASSERT(buf[0] == 0x5A && buf[99] == 0x5A);
+	memset(buf, 0, 100);
+	CU_ASSERT(spdk_file_read(file_c, channel, buf, 0, 100) == 100);
+	CU_ASSERT(buf[0] == 0x5A && buf[99] == 0x5A);
+	CU_ASSERT(spdk_tree_find_buffer(file_b->tree, 0) != NULL);
+
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.hits == 1);
+	CU_ASSERT(stats.misses == 1);
+
+	/* Shrinking the cache evicts all 4 low priority buffers of b before the one of a */
+	spdk_fs_set_cache_size(1);
+	CU_ASSERT(spdk_fs_get_cache_size() == 1);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.bytes_cached == 4 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(stats.evictions == 6);
+	CU_ASSERT(spdk_tree_find_buffer(file_b->tree, 0) == NULL);
+	CU_ASSERT((spdk_tree_find_buffer(file_a->tree, 0) != NULL) ||
+		  (spdk_tree_find_buffer(file_a->tree, CACHE_BUFFER_SIZE) != NULL));
+
+	/* Growing the cache adds memory, a pool on each socket */
+	CU_ASSERT(g_cache_pool_count == 2);
+	spdk_fs_set_cache_size(16);
+	CU_ASSERT(spdk_fs_get_cache_size() == 16);
+	CU_ASSERT(g_cache_pool_count == 4);
+	CU_ASSERT(g_cache_pool_buffers == 64);
+
+	spdk_file_close(file_a, channel);
+	spdk_file_close(file_b, channel);
+	spdk_file_close(file_c, channel);
+	CU_ASSERT(spdk_fs_delete_file(g_fs, channel, "file_a") == 0);
+	CU_ASSERT(spdk_fs_delete_file(g_fs, channel, "file_b") == 0);
+	CU_ASSERT(spdk_fs_delete_file(g_fs, channel, "file_c") == 0);
+
+	free(buf);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+	spdk_fs_set_cache_size(BLOBFS_CACHE_SIZE / (1024 * 1024));
+}
+
+static void
+_fs_nop(void *arg)
+{
+}
+
+/* Read 64 KiB chunks, letting the readahead each read starts finish before the next read */
+static void
+read_chunks(struct spdk_file *file, struct spdk_io_channel *channel, char *buf,
+	    uint64_t offset, uint64_t length)
+{
+	uint64_t end = offset + length;
+
+	for (; offset < end; offset += 64 * 1024) {
+		CU_ASSERT(spdk_file_read(file, channel, buf, offset, 64 * 1024) == 64 * 1024);
+		CU_ASSERT(buf[0] == 0x5A && buf[64 * 1024 - 1] == 0x5A);
+		ut_send_request(_fs_nop, NULL);
+	}
+}
+
+static void
+cache_readahead(void)
+{
+	int rc;
+	char *buf;
+	uint64_t file_size;
+	struct spdk_io_channel *channel;
+	struct spdk_fs_cache_stats stats;
+
+	ut_send_request(_fs_init, NULL);
+
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+
+	file_size = 8 * CACHE_BUFFER_SIZE;
+	buf = calloc(1, file_size);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+	memset(buf, 0x5A, file_size);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+	rc = spdk_file_write(g_file, channel, buf, 0, file_size);
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(g_file, channel);
+	cache_free_buffers(g_file);
+
+	/* A sequential reader gets every buffer after the first one read ahead */
+	read_chunks(g_file, channel, buf, 0, file_size);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == 7);
+	CU_ASSERT(stats.readahead_hits == 7);
+
+	spdk_file_invalidate_cache(g_file, 0, 0);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.bytes_cached == 0);
+
+	/* Random files are not read ahead */
+	spdk_file_set_access_hint(g_file, SPDK_FILE_ACCESS_RANDOM);
+	read_chunks(g_file, channel, buf, 0, 2 * CACHE_BUFFER_SIZE);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == 7);
+
+	/* Sequential files are read ahead by the whole window from the first read */
+	spdk_file_set_access_hint(g_file, SPDK_FILE_ACCESS_SEQUENTIAL);
+	spdk_fs_set_readahead_limits(3 * CACHE_BUFFER_SIZE, 0);
+	read_chunks(g_file, channel, buf, 0, 64 * 1024);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == 10);
+	CU_ASSERT(spdk_tree_find_buffer(g_file->tree, 3 * CACHE_BUFFER_SIZE) != NULL);
+	CU_ASSERT(spdk_tree_find_buffer(g_file->tree, 4 * CACHE_BUFFER_SIZE) == NULL);
+
+	/* A read elsewhere restarts the sequential run, so nothing more is read ahead */
+	spdk_file_invalidate_cache(g_file, 0, 0);
+	spdk_file_set_access_hint(g_file, SPDK_FILE_ACCESS_NORMAL);
+	read_chunks(g_file, channel, buf, 0, 64 * 1024);
+	read_chunks(g_file, channel, buf, 4 * CACHE_BUFFER_SIZE, 64 * 1024);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == 10);
+
+	/* Only one buffer may wait to be read */
+	spdk_fs_set_readahead_limits(3 * CACHE_BUFFER_SIZE, CACHE_BUFFER_SIZE);
+	read_chunks(g_file, channel, buf, 0, 4 * 64 * 1024);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == 11);
+	CU_ASSERT(stats.readahead_hits == 7);
+
+	spdk_fs_set_readahead_limits(CACHE_READAHEAD_FILE_MAX, 0);
+
+	spdk_file_close(g_file, channel);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	free(buf);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+file_direct_io(void)
+{
+	struct spdk_io_channel *channel;
+	struct spdk_file *file;
+	struct iovec iovs[2];
+	uint8_t *buf[2], data[200];
+	const void *pinned;
+	int64_t len;
+	int rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	buf[0] = spdk_dma_malloc(4096, 4096, NULL);
+	buf[1] = spdk_dma_malloc(4096, 4096, NULL);
+	SPDK_CU_ASSERT_FATAL(buf[0] != NULL && buf[1] != NULL);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile",
+			       SPDK_BLOBFS_OPEN_CREATE | SPDK_BLOBFS_OPEN_DIRECT, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	/* Aligned appends go straight from the caller's buffers to the blob */
+	memset(buf[0], 0x5a, 4096);
+	memset(buf[1], 0xa5, 4096);
+	iovs[0].iov_base = buf[0];
+	iovs[0].iov_len = 4096;
+	iovs[1].iov_base = buf[1];
+	iovs[1].iov_len = 4096;
+	rc = spdk_file_writev(g_file, channel, iovs, 2, 0);
+	CU_ASSERT(rc == 0);
+
+	/* Unaligned appends bounce through a buffer, still bypassing the cache */
+	memset(data, 0x33, sizeof(data));
+	rc = spdk_file_write(g_file, channel, data, 8192, 100);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_file_get_length(g_file) == 8292);
+	CU_ASSERT(g_file->last == NULL);
+	CU_ASSERT(g_file->tree->present_mask == 0);
+
+	memset(buf[0], 0, 4096);
+	memset(buf[1], 0, 4096);
+	len = spdk_file_readv(g_file, channel, iovs, 2, 0);
+	CU_ASSERT(len == 8192);
+	CU_ASSERT(buf[0][0] == 0x5a && buf[0][4095] == 0x5a);
+	CU_ASSERT(buf[1][0] == 0xa5 && buf[1][4095] == 0xa5);
+
+	memset(data, 0, sizeof(data));
+	len = spdk_file_read(g_file, channel, data, 8190, sizeof(data));
+	CU_ASSERT(len == 102);
+	CU_ASSERT(data[0] == 0xa5 && data[1] == 0xa5);
+	CU_ASSERT(data[2] == 0x33 && data[101] == 0x33);
+	CU_ASSERT(g_file->tree->present_mask == 0);
+
+	/* Nothing was cached, so there is no buffer to lend */
+	len = spdk_file_pin_buffer(g_file, 0, 100, &pinned);
+	CU_ASSERT(len == -ENODATA);
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+
+	/* Reads of data only in dirty cache buffers fall back to the cache */
+	rc = spdk_fs_open_file(g_fs, channel, "testfile2", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+	CU_ASSERT(g_file->direct == false);
+
+	memset(buf[0], 0x77, 4096);
+	rc = spdk_file_write(g_file, channel, buf[0], 0, 4096);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_file->last != NULL);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile2", SPDK_BLOBFS_OPEN_DIRECT, &file);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(file == g_file);
+	CU_ASSERT(g_file->direct == true);
+
+	memset(buf[1], 0, 4096);
+	len = spdk_file_readv(g_file, channel, &iovs[1], 1, 0);
+	CU_ASSERT(len == 4096);
+	CU_ASSERT(buf[1][0] == 0x77 && buf[1][4095] == 0x77);
+
+	/* Cached data can be lent instead of copied */
+	len = spdk_file_pin_buffer(g_file, 100, 50, &pinned);
+	CU_ASSERT(len == 50);
+	SPDK_CU_ASSERT_FATAL(pinned != NULL);
+	CU_ASSERT(((const uint8_t *)pinned)[0] == 0x77 && ((const uint8_t *)pinned)[49] == 0x77);
+	CU_ASSERT(g_file->last->pin_count == 1);
+	spdk_file_unpin_buffer(g_file, 100);
+	CU_ASSERT(g_file->last->pin_count == 0);
+
+	rc = spdk_file_close(file, channel);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_file->direct == true);
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_file->direct == false);
+
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile2");
+	CU_ASSERT(rc == 0);
+
+	spdk_dma_free(buf[0]);
+	spdk_dma_free(buf[1]);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static int g_dev_writes;
+static int g_syncs_done;
+
+static void
+count_dev_write(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payload,
+		uint64_t lba, uint32_t lba_count, struct spdk_bs_dev_cb_args *cb_args)
+{
+	g_dev_writes++;
+	dev_write(dev, channel, payload, lba, lba_count, cb_args);
+}
+
+static void
+count_dev_writev(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
+		 struct iovec *iov, int iovcnt, uint64_t lba, uint32_t lba_count,
+		 struct spdk_bs_dev_cb_args *cb_args)
+{
+	g_dev_writes++;
+	dev_writev(dev, channel, iov, iovcnt, lba, lba_count, cb_args);
+}
+
+static void
+_sync_done(void *ctx, int fserrno)
+{
+	CU_ASSERT(fserrno == 0);
+	g_syncs_done++;
+}
+
+struct ut_sync_args {
+	struct spdk_io_channel	*channel;
+	int			count;
+};
+
+/* Issue the syncs together, before the data flush they trigger can run */
+static void
+_file_syncs(void *arg)
+{
+	struct ut_sync_args *args = arg;
+	int i;
+
+	for (i = 0; i < args->count; i++) {
+		_file_sync(g_file, spdk_io_channel_get_ctx(args->channel), _sync_done, NULL);
+	}
+}
+
+static int
+ut_write_and_sync(struct spdk_io_channel *channel, int count)
+{
+	struct ut_sync_args args = { .channel = channel, .count = count };
+	char buf[100];
+	int rc;
+
+	memset(buf, 0x5a, sizeof(buf));
+	rc = spdk_file_write(g_file, channel, buf, g_file->append_pos, sizeof(buf));
+	CU_ASSERT(rc == 0);
+
+	g_dev_writes = 0;
+	g_syncs_done = 0;
+	ut_send_request(_file_syncs, &args);
+	/* The flush and the md sync are queued behind the syncs */
+	ut_send_request(_fs_nop, NULL);
+	CU_ASSERT(g_syncs_done == count);
+
+	return g_dev_writes;
+}
+
+static void
+file_group_commit(void)
+{
+	struct spdk_io_channel *channel;
+	const void *value;
+	size_t value_len;
+	int writes, rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	g_fs->bdev->write = count_dev_write;
+	g_fs->bdev->writev = count_dev_writev;
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	/* Concurrent syncs share one data flush and one md sync */
+	writes = ut_write_and_sync(channel, 1);
+	CU_ASSERT(writes >= 2);
+	CU_ASSERT(ut_write_and_sync(channel, 4) == writes);
+	CU_ASSERT(g_file->length_xattr == 200);
+
+	/* A stored length past the flushed data needs no md sync */
+	spdk_file_truncate(g_file, channel, 1024 * 1024);
+	CU_ASSERT(g_file->length_xattr == 1024 * 1024);
+	CU_ASSERT(ut_write_and_sync(channel, 3) == 1);
+	CU_ASSERT(g_file->length_flushed == 300);
+	rc = spdk_blob_get_xattr_value(g_file->blob, "length", &value, &value_len);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(*(const uint64_t *)value == 1024 * 1024);
+
+	g_fs->bdev->write = dev_write;
+	g_fs->bdev->writev = dev_writev;
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+fail_dev_write(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payload,
+	       uint64_t lba, uint32_t lba_count, struct spdk_bs_dev_cb_args *cb_args)
+{
+	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, -EIO);
+}
+
+static void
+fail_dev_writev(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
+		struct iovec *iov, int iovcnt, uint64_t lba, uint32_t lba_count,
+		struct spdk_bs_dev_cb_args *cb_args)
+{
+	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, -EIO);
+}
+
+static void
+file_sync_flush_error(void)
+{
+	struct spdk_io_channel *channel;
+	char buf[100];
+	int rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	memset(buf, 0x5a, sizeof(buf));
+	rc = spdk_file_write(g_file, channel, buf, 0, sizeof(buf));
+	CU_ASSERT(rc == 0);
+
+	/* A failed flush completes the sync with its error */
+	g_fs->bdev->write = fail_dev_write;
+	g_fs->bdev->writev = fail_dev_writev;
+	rc = spdk_file_sync(g_file, channel);
+	CU_ASSERT(rc == -EIO);
+	CU_ASSERT(g_file->length_flushed == 0);
+	CU_ASSERT(TAILQ_EMPTY(&g_file->sync_requests));
+
+	/* The next sync flushes the data again */
+	g_fs->bdev->write = dev_write;
+	g_fs->bdev->writev = dev_writev;
+	rc = spdk_file_sync(g_file, channel);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_file->length_flushed == sizeof(buf));
+	CU_ASSERT(g_file->length_xattr == sizeof(buf));
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+file_read_batch(void)
+{
+	struct spdk_io_channel *channel;
+	struct spdk_file_read_req reqs[3];
+	struct spdk_fs_cache_stats stats;
+	struct spdk_file *file;
+	uint64_t file_size, readahead_buffers;
+	uint8_t data[3][200];
+	char *buf;
+	int i, rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	file_size = 4 * CACHE_BUFFER_SIZE;
+	buf = calloc(1, file_size);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+	for (i = 0; i < 4; i++) {
+		memset(buf + i * CACHE_BUFFER_SIZE, i + 1, CACHE_BUFFER_SIZE);
+	}
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+	rc = spdk_file_write(g_file, channel, buf, 0, file_size);
+	CU_ASSERT(rc == 0);
+	spdk_file_sync(g_file, channel);
+	cache_free_buffers(g_file);
+
+	/* All ranges are sent at once, and the last one is cut short by the end of the file */
+	reqs[0].offset = 10;
+	reqs[0].length = 100;
+	reqs[1].offset = 2 * CACHE_BUFFER_SIZE + 10;
+	reqs[1].length = 200;
+	reqs[2].offset = file_size - 50;
+	reqs[2].length = 200;
+	for (i = 0; i < 3; i++) {
+		reqs[i].payload = data[i];
+	}
+	memset(data, 0, sizeof(data));
+	rc = spdk_file_read_batch(g_file, channel, reqs, 3);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(reqs[0].result == 100);
+	CU_ASSERT(reqs[1].result == 200);
+	CU_ASSERT(reqs[2].result == 50);
+	CU_ASSERT(data[0][0] == 1 && data[0][99] == 1);
+	CU_ASSERT(data[1][0] == 3 && data[1][199] == 3);
+	CU_ASSERT(data[2][0] == 4 && data[2][49] == 4 && data[2][50] == 0);
+
+	/* Prefetch fills the cache buffers of the range without waiting for them */
+	spdk_file_invalidate_cache(g_file, 0, 0);
+	spdk_fs_get_cache_stats(&stats);
+	readahead_buffers = stats.readahead_buffers;
+	spdk_file_prefetch(g_file, CACHE_BUFFER_SIZE + 5, CACHE_BUFFER_SIZE);
+	ut_send_request(_fs_nop, NULL);
+	spdk_fs_get_cache_stats(&stats);
+	CU_ASSERT(stats.readahead_buffers == readahead_buffers + 2);
+	CU_ASSERT(spdk_tree_find_filled_buffer(g_file->tree, CACHE_BUFFER_SIZE) != NULL);
+	CU_ASSERT(spdk_tree_find_filled_buffer(g_file->tree, 2 * CACHE_BUFFER_SIZE) != NULL);
+	CU_ASSERT(spdk_tree_find_buffer(g_file->tree, 3 * CACHE_BUFFER_SIZE) == NULL);
+
+	/* Direct files are read in a batch too, and never prefetched */
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_DIRECT, &file);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(file == g_file);
+	spdk_file_invalidate_cache(g_file, 0, 0);
+	spdk_file_prefetch(g_file, 0, file_size);
+	ut_send_request(_fs_nop, NULL);
+	memset(data, 0, sizeof(data));
+	rc = spdk_file_read_batch(g_file, channel, reqs, 3);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(reqs[1].result == 200);
+	CU_ASSERT(reqs[2].result == 50);
+	CU_ASSERT(data[1][0] == 3 && data[1][199] == 3);
+	CU_ASSERT(data[2][0] == 4 && data[2][49] == 4);
+	CU_ASSERT(g_file->tree->present_mask == 0);
+
+	rc = spdk_file_close(file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	free(buf);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+file_preallocate(void)
+{
+	struct spdk_io_channel *channel;
+	uint64_t cluster_sz, offset;
+	char *buf;
+	int rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	cluster_sz = g_fs->bs_opts.cluster_sz;
+	buf = calloc(1, CACHE_BUFFER_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	/* Appends double the blob each time they run past its end */
+	for (offset = 0; offset < 2 * cluster_sz + CACHE_BUFFER_SIZE; offset += CACHE_BUFFER_SIZE) {
+		rc = spdk_file_write(g_file, channel, buf, offset, CACHE_BUFFER_SIZE);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 4);
+
+	/* Closing releases the clusters past the end of the file */
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", 0, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 3);
+
+	/* Allocated space does not change the length, and is released the same way */
+	rc = spdk_file_allocate(g_file, channel, 8 * cluster_sz);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 8);
+	CU_ASSERT(spdk_file_get_length(g_file) == 2 * cluster_sz + CACHE_BUFFER_SIZE);
+	rc = spdk_file_allocate(g_file, channel, cluster_sz);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 8);
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", 0, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 3);
+
+	/* Space the blobstore does not have cannot be reserved */
+	rc = spdk_file_allocate(g_file, channel, 1024 * cluster_sz);
+	CU_ASSERT(rc == -ENOSPC);
+	CU_ASSERT(spdk_blob_get_num_clusters(g_file->blob) == 3);
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	free(buf);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
+static void
+cache_numa_pools(void)
+{
+	struct spdk_io_channel *channel;
+	struct cache_buffer *cache_buf;
+	char *buf;
+	int rc;
+
+	/* Room for 4 cache buffers, 2 on each socket */
+	spdk_fs_set_cache_size(1);
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+	CU_ASSERT(g_cache_pool_count == 2);
+	CU_ASSERT(g_cache_pools[0].socket_id == 0);
+	CU_ASSERT(g_cache_pools[1].socket_id == 1);
+
+	buf = calloc(1, 2 * CACHE_BUFFER_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	rc = spdk_fs_open_file(g_fs, channel, "testfile", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_file != NULL);
+
+	/* Buffers come from the socket of the writer until its pool runs out */
+	g_ut_core = 1;
+	rc = spdk_file_write(g_file, channel, buf, 0, 2 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(rc == 0);
+	g_ut_core = 0;
+
+	cache_buf = spdk_tree_find_buffer(g_file->tree, 0);
+	SPDK_CU_ASSERT_FATAL(cache_buf != NULL);
+	CU_ASSERT(cache_buf->pool->socket_id == 1);
+	cache_buf = spdk_tree_find_buffer(g_file->tree, CACHE_BUFFER_SIZE);
+	SPDK_CU_ASSERT_FATAL(cache_buf != NULL);
+	CU_ASSERT(cache_buf->pool->socket_id == 1);
+	SPDK_CU_ASSERT_FATAL(g_file->last != NULL);
+	CU_ASSERT(g_file->last->offset == 2 * CACHE_BUFFER_SIZE);
+	CU_ASSERT(g_file->last->pool->socket_id == 0);
+
+	/* Threads outside the SPDK cores look up the socket of their OS CPU instead */
+	CU_ASSERT(__cache_local_socket() == 0);
+	g_ut_core = UINT32_MAX;
+	CU_ASSERT(__cache_local_socket() == 1);
+	g_ut_core = 0;
+
+	rc = spdk_file_close(g_file, channel);
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "testfile");
+	CU_ASSERT(rc == 0);
+
+	free(buf);
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+	CU_ASSERT(g_cache_pool_count == 0);
+	spdk_fs_set_cache_size(BLOBFS_CACHE_SIZE / (1024 * 1024));
+}
+
+struct ut_dir_entries {
+	char	names[8][SPDK_FILE_NAME_MAX + 1];
+	bool	is_dir[8];
+	int	count;
+};
+
+static void
+ut_add_dir_entry(void *ctx, const char *name, bool is_dir)
+{
+	struct ut_dir_entries *entries = ctx;
+
+	SPDK_CU_ASSERT_FATAL(entries->count < 8);
+	snprintf(entries->names[entries->count], sizeof(entries->names[0]), "%s", name);
+	entries->is_dir[entries->count] = is_dir;
+	entries->count++;
+}
+
+static int
+ut_find_dir_entry(struct ut_dir_entries *entries, const char *name, bool is_dir)
+{
+	int i;
+
+	for (i = 0; i < entries->count; i++) {
+		if (!strcmp(entries->names[i], name) && entries->is_dir[i] == is_dir) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void
+fs_read_dir_entries(void)
+{
+	struct ut_dir_entries entries;
+	struct spdk_file_stat stat;
+	struct spdk_io_channel *channel;
+	char name[32];
+	int i, rc;
+
+	ut_send_request(_fs_init, NULL);
+	spdk_allocate_thread(_fs_send_msg, NULL, NULL, NULL, "thread0");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	CU_ASSERT(channel != NULL);
+
+	rc = spdk_fs_create_file(g_fs, channel, "/a/b/file1");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_create_file(g_fs, channel, "/a/file2");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_create_file(g_fs, channel, "/file3");
+	CU_ASSERT(rc == 0);
+
+	memset(&entries, 0, sizeof(entries));
+	rc = spdk_fs_read_dir(g_fs, channel, "/", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(entries.count == 2);
+	CU_ASSERT(ut_find_dir_entry(&entries, "a", true) >= 0);
+	CU_ASSERT(ut_find_dir_entry(&entries, "file3", false) >= 0);
+
+	memset(&entries, 0, sizeof(entries));
+	rc = spdk_fs_read_dir(g_fs, channel, "/a/", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(entries.count == 2);
+	CU_ASSERT(ut_find_dir_entry(&entries, "b", true) >= 0);
+	CU_ASSERT(ut_find_dir_entry(&entries, "file2", false) >= 0);
+
+	/* Moving the only file of /a/b to another directory removes /a/b */
+	rc = spdk_fs_rename_file(g_fs, channel, "/a/b/file1", "/c/file1");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_read_dir(g_fs, channel, "/a/b", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == -ENOENT);
+
+	memset(&entries, 0, sizeof(entries));
+	rc = spdk_fs_read_dir(g_fs, channel, "/c", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(entries.count == 1);
+	CU_ASSERT(ut_find_dir_entry(&entries, "file1", false) == 0);
+
+	rc = spdk_fs_file_stat(g_fs, channel, "/a/b/file1", &stat);
+	CU_ASSERT(rc == -ENOENT);
+	rc = spdk_fs_file_stat(g_fs, channel, "/c/file1", &stat);
+	CU_ASSERT(rc == 0);
+
+	rc = spdk_fs_delete_file(g_fs, channel, "/c/file1");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_read_dir(g_fs, channel, "/c", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == -ENOENT);
+
+	/* Enough nested directories to grow the directory index */
+	for (i = 0; i < 24; i++) {
+		snprintf(name, sizeof(name), "/d%d/a/b/c/file", i);
+		rc = spdk_fs_create_file(g_fs, channel, name);
+		CU_ASSERT(rc == 0);
+	}
+	for (i = 0; i < 24; i++) {
+		snprintf(name, sizeof(name), "/d%d/a/b/c", i);
+		memset(&entries, 0, sizeof(entries));
+		rc = spdk_fs_read_dir(g_fs, channel, name, ut_add_dir_entry, &entries);
+		CU_ASSERT(rc == 0);
+		CU_ASSERT(entries.count == 1);
+		CU_ASSERT(ut_find_dir_entry(&entries, "file", false) == 0);
+
+		snprintf(name, sizeof(name), "/d%d/a/b/c/file", i);
+		rc = spdk_fs_file_stat(g_fs, channel, name, &stat);
+		CU_ASSERT(rc == 0);
+		rc = spdk_fs_delete_file(g_fs, channel, name);
+		CU_ASSERT(rc == 0);
+	}
+
+	memset(&entries, 0, sizeof(entries));
+	rc = spdk_fs_read_dir(g_fs, channel, "", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(entries.count == 2);
+	CU_ASSERT(ut_find_dir_entry(&entries, "a", true) >= 0);
+	CU_ASSERT(ut_find_dir_entry(&entries, "file3", false) >= 0);
+
+	rc = spdk_fs_delete_file(g_fs, channel, "/a/file2");
+	CU_ASSERT(rc == 0);
+	rc = spdk_fs_delete_file(g_fs, channel, "/file3");
+	CU_ASSERT(rc == 0);
+
+	memset(&entries, 0, sizeof(entries));
+	rc = spdk_fs_read_dir(g_fs, channel, "/", ut_add_dir_entry, &entries);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(entries.count == 0);
+
+	spdk_fs_free_io_channel(channel);
+	spdk_free_thread();
+
+	ut_send_request(_fs_unload, NULL);
+}
+
 static void
 fs_delete_file_without_close(void)
 {
@@ -351,16 +1291,24 @@ spdk_thread(void *arg)
 
 	while (1) {
 		pthread_mutex_lock(&g_mutex);
-		if (g_req != NULL) {
-			req = g_req;
-			req->fn(req->arg);
-			req->done = 1;
-			if (!req->from_ut) {
-				free(req);
-			}
-			g_req = NULL;
+		req = TAILQ_FIRST(&g_reqs);
+		if (req != NULL) {
+			TAILQ_REMOVE(&g_reqs, req, link);
 		}
 		pthread_mutex_unlock(&g_mutex);
+		if (req == NULL) {
+			continue;
+		}
+
+		/* Run the request unlocked, it may wait on a file lock held by the UT thread */
+		req->fn(req->arg);
+		if (!req->from_ut) {
+			free(req);
+		} else {
+			pthread_mutex_lock(&g_mutex);
+			req->done = 1;
+			pthread_mutex_unlock(&g_mutex);
+		}
 	}
 
 	return NULL;
@@ -387,6 +1335,16 @@ int main(int argc, char **argv)
 		CU_add_test(suite, "write_null_buffer", cache_write_null_buffer) == NULL ||
 		CU_add_test(suite, "create_sync", fs_create_sync) == NULL ||
 		CU_add_test(suite, "append_no_cache", cache_append_no_cache) == NULL ||
+		CU_add_test(suite, "write_io_threads", cache_write_io_threads) == NULL ||
+		CU_add_test(suite, "cache_eviction", cache_eviction) == NULL ||
+		CU_add_test(suite, "cache_readahead", cache_readahead) == NULL ||
+		CU_add_test(suite, "read_dir", fs_read_dir_entries) == NULL ||
+		CU_add_test(suite, "direct_io", file_direct_io) == NULL ||
+		CU_add_test(suite, "group_commit", file_group_commit) == NULL ||
+		CU_add_test(suite, "sync_flush_error", file_sync_flush_error) == NULL ||
+		CU_add_test(suite, "read_batch", file_read_batch) == NULL ||
+		CU_add_test(suite, "preallocate", file_preallocate) == NULL ||
+		CU_add_test(suite, "numa_pools", cache_numa_pools) == NULL ||
 		CU_add_test(suite, "delete_file_without_close", fs_delete_file_without_close) == NULL
 	) {
 		CU_cleanup_registry();
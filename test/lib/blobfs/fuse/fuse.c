@@ -39,10 +39,13 @@
 
 #include "spdk/blobfs.h"
 #include "spdk/bdev.h"
+#include "spdk/env.h"
 #include "spdk/event.h"
 #include "spdk/io_channel.h"
 #include "spdk/blob_bdev.h"
 #include "spdk/log.h"
+#include "spdk/rpc.h"
+#include "spdk/util.h"
 
 struct fuse *g_fuse;
 char *g_bdev_name;
@@ -51,12 +54,78 @@ pthread_t g_fuse_thread;
 
 struct spdk_bs_dev *g_bs_dev;
 struct spdk_filesystem *g_fs;
-struct spdk_io_channel *g_channel;
-struct spdk_file *g_file;
 int g_fserrno;
 int g_fuse_argc = 0;
 char **g_fuse_argv = NULL;
 
+/*
+ * FUSE requests are served by the worker threads of libfuse.  Each one gets its own SPDK
+ *  thread and sync channel the first time it calls into blobfs, which are freed when the
+ *  worker exits.
+ */
+struct fuse_thread_ctx {
+	struct spdk_io_channel	*channel;
+	bool			allocated_thread;
+};
+
+static pthread_key_t g_thread_key;
+static __thread struct fuse_thread_ctx *g_thread_ctx;
+
+enum fuse_op_type {
+	FUSE_OP_GETATTR,
+	FUSE_OP_READDIR,
+	FUSE_OP_MKNOD,
+	FUSE_OP_UNLINK,
+	FUSE_OP_TRUNCATE,
+	FUSE_OP_OPEN,
+	FUSE_OP_RELEASE,
+	FUSE_OP_READ,
+	FUSE_OP_WRITE,
+	FUSE_OP_FSYNC,
+	FUSE_OP_RENAME,
+	FUSE_OP_COUNT,
+};
+
+static const char *g_op_names[FUSE_OP_COUNT] = {
+	"getattr", "readdir", "mknod", "unlink", "truncate", "open", "release",
+	"read", "write", "fsync", "rename",
+};
+
+struct fuse_op_stats {
+	uint64_t	count;
+	uint64_t	errors;
+	uint64_t	ticks;
+	uint64_t	max_ticks;
+};
+
+static struct fuse_op_stats g_op_stats[FUSE_OP_COUNT];
+
+static void
+fuse_op_done(enum fuse_op_type op, uint64_t start, int rc)
+{
+	struct fuse_op_stats *stats = &g_op_stats[op];
+	uint64_t ticks, max_ticks;
+
+	ticks = spdk_get_ticks() - start;
+	__atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->ticks, ticks, __ATOMIC_RELAXED);
+	if (rc < 0) {
+		__atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+	}
+
+	max_ticks = __atomic_load_n(&stats->max_ticks, __ATOMIC_RELAXED);
+	while (ticks > max_ticks &&
+	       !__atomic_compare_exchange_n(&stats->max_ticks, &max_ticks, ticks, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+static uint64_t
+ticks_to_us(uint64_t ticks)
+{
+	return ticks * 1000 * 1000 / spdk_get_ticks_hz();
+}
+
 static void
 __call_fn(void *arg1, void *arg2)
 {
@@ -75,78 +144,162 @@ __send_request(fs_request_fn fn, void *arg)
 	spdk_event_call(event);
 }
 
+static void
+_fuse_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
+{
+	/* Not supported */
+	assert(false);
+}
+
+static void
+fuse_thread_exit(void *arg)
+{
+	struct fuse_thread_ctx *ctx = arg;
+
+	spdk_fs_free_io_channel(ctx->channel);
+	if (ctx->allocated_thread) {
+		spdk_free_thread();
+	}
+	free(ctx);
+}
+
+static struct spdk_io_channel *
+fuse_get_channel(void)
+{
+	struct fuse_thread_ctx *ctx = g_thread_ctx;
+
+	if (ctx != NULL) {
+		return ctx->channel;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	assert(ctx != NULL);
+
+	/* The single threaded loop runs on a reactor, which already has an SPDK thread */
+	if (spdk_get_thread() == NULL) {
+		spdk_allocate_thread(_fuse_send_msg, NULL, NULL, NULL, "spdk_fuse");
+		ctx->allocated_thread = true;
+	}
+	ctx->channel = spdk_fs_alloc_io_channel_sync(g_fs);
+
+	g_thread_ctx = ctx;
+	pthread_setspecific(g_thread_key, ctx);
+	return ctx->channel;
+}
+
+static int
+fuse_dir_stat(struct stat *stbuf)
+{
+	stbuf->st_mode = S_IFDIR | 0755;
+	stbuf->st_nlink = 2;
+	return 0;
+}
+
+static void
+fuse_dir_entry_nop(void *ctx, const char *name, bool is_dir)
+{
+}
+
 static int
 spdk_fuse_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi)
 {
+	struct spdk_io_channel *channel = fuse_get_channel();
 	struct spdk_file_stat stat;
+	uint64_t start = spdk_get_ticks();
 	int rc;
 
 	if (!strcmp(path, "/")) {
-		stbuf->st_mode = S_IFDIR | 0755;
-		stbuf->st_nlink = 2;
-		return 0;
+		rc = fuse_dir_stat(stbuf);
+		fuse_op_done(FUSE_OP_GETATTR, start, rc);
+		return rc;
 	}
 
-	rc = spdk_fs_file_stat(g_fs, g_channel, &path[1], &stat);
+	rc = spdk_fs_file_stat(g_fs, channel, &path[1], &stat);
 	if (rc == 0) {
 		stbuf->st_mode = S_IFREG | 0644;
 		stbuf->st_nlink = 1;
 		stbuf->st_size = stat.size;
+	} else if (rc == -ENOENT &&
+		   spdk_fs_read_dir(g_fs, channel, &path[1], fuse_dir_entry_nop, NULL) == 0) {
+		/* Directories are the paths before the last '/' of file names */
+		rc = fuse_dir_stat(stbuf);
 	}
 
+	fuse_op_done(FUSE_OP_GETATTR, start, rc);
 	return rc;
 }
 
+struct fuse_readdir_ctx {
+	void		*buf;
+	fuse_fill_dir_t	filler;
+};
+
+static void
+fuse_fill_dir_entry(void *_ctx, const char *name, bool is_dir)
+{
+	struct fuse_readdir_ctx *ctx = _ctx;
+
+	ctx->filler(ctx->buf, name, NULL, 0, 0);
+}
+
 static int
 spdk_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 		  off_t offset, struct fuse_file_info *fi,
 		  enum fuse_readdir_flags flags)
 {
-	struct spdk_file *file;
-	const char *filename;
-	spdk_fs_iter iter;
+	struct fuse_readdir_ctx ctx = { .buf = buf, .filler = filler };
+	uint64_t start = spdk_get_ticks();
+	int rc;
 
 	filler(buf, ".", NULL, 0, 0);
 	filler(buf, "..", NULL, 0, 0);
 
-	iter = spdk_fs_iter_first(g_fs);
-	while (iter != NULL) {
-		file = spdk_fs_iter_get_file(iter);
-		iter = spdk_fs_iter_next(iter);
-		filename = spdk_file_get_name(file);
-		filler(buf, filename, NULL, 0, 0);
-	}
+	rc = spdk_fs_read_dir(g_fs, fuse_get_channel(), &path[1], fuse_fill_dir_entry, &ctx);
 
-	return 0;
+	fuse_op_done(FUSE_OP_READDIR, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_mknod(const char *path, mode_t mode, dev_t rdev)
 {
-	return spdk_fs_create_file(g_fs, g_channel, &path[1]);
+	uint64_t start = spdk_get_ticks();
+	int rc;
+
+	rc = spdk_fs_create_file(g_fs, fuse_get_channel(), &path[1]);
+
+	fuse_op_done(FUSE_OP_MKNOD, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_unlink(const char *path)
 {
-	return spdk_fs_delete_file(g_fs, g_channel, &path[1]);
+	uint64_t start = spdk_get_ticks();
+	int rc;
+
+	rc = spdk_fs_delete_file(g_fs, fuse_get_channel(), &path[1]);
+
+	fuse_op_done(FUSE_OP_UNLINK, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_truncate(const char *path, off_t size, struct fuse_file_info *fi)
 {
+	struct spdk_io_channel *channel = fuse_get_channel();
 	struct spdk_file *file;
+	uint64_t start = spdk_get_ticks();
 	int rc;
 
-	rc = spdk_fs_open_file(g_fs, g_channel, &path[1], 0, &file);
-	if (rc != 0) {
-		return -rc;
+	rc = spdk_fs_open_file(g_fs, channel, &path[1], 0, &file);
+	if (rc == 0) {
+		spdk_file_truncate(file, channel, size);
+		spdk_file_close(file, channel);
 	}
 
-	spdk_file_truncate(file, g_channel, size);
-	spdk_file_close(file, g_channel);
-
-	return 0;
+	fuse_op_done(FUSE_OP_TRUNCATE, start, rc);
+	return rc;
 }
 
 static int
@@ -159,31 +312,42 @@ static int
 spdk_fuse_open(const char *path, struct fuse_file_info *info)
 {
 	struct spdk_file *file;
+	uint64_t start = spdk_get_ticks();
 	int rc;
 
-	rc = spdk_fs_open_file(g_fs, g_channel, &path[1], 0, &file);
-	if (rc != 0) {
-		return -rc;
+	rc = spdk_fs_open_file(g_fs, fuse_get_channel(), &path[1], 0, &file);
+	if (rc == 0) {
+		info->fh = (uintptr_t)file;
 	}
 
-	info->fh = (uintptr_t)file;
-	return 0;
+	fuse_op_done(FUSE_OP_OPEN, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_release(const char *path, struct fuse_file_info *info)
 {
 	struct spdk_file *file = (struct spdk_file *)info->fh;
+	uint64_t start = spdk_get_ticks();
+	int rc;
 
-	return spdk_file_close(file, g_channel);
+	rc = spdk_file_close(file, fuse_get_channel());
+
+	fuse_op_done(FUSE_OP_RELEASE, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_read(const char *path, char *buf, size_t len, off_t offset, struct fuse_file_info *info)
 {
 	struct spdk_file *file = (struct spdk_file *)info->fh;
+	uint64_t start = spdk_get_ticks();
+	int64_t rc;
 
-	return spdk_file_read(file, g_channel, buf, offset, len);
+	rc = spdk_file_read(file, fuse_get_channel(), buf, offset, len);
+
+	fuse_op_done(FUSE_OP_READ, start, rc);
+	return rc;
 }
 
 static int
@@ -191,9 +355,12 @@ spdk_fuse_write(const char *path, const char *buf, size_t len, off_t offset,
 		struct fuse_file_info *info)
 {
 	struct spdk_file *file = (struct spdk_file *)info->fh;
+	uint64_t start = spdk_get_ticks();
 	int rc;
 
-	rc = spdk_file_write(file, g_channel, (void *)buf, offset, len);
+	rc = spdk_file_write(file, fuse_get_channel(), (void *)buf, offset, len);
+
+	fuse_op_done(FUSE_OP_WRITE, start, rc);
 	if (rc == 0) {
 		return len;
 	} else {
@@ -210,13 +377,26 @@ spdk_fuse_flush(const char *path, struct fuse_file_info *info)
 static int
 spdk_fuse_fsync(const char *path, int datasync, struct fuse_file_info *info)
 {
-	return 0;
+	struct spdk_file *file = (struct spdk_file *)info->fh;
+	uint64_t start = spdk_get_ticks();
+	int rc;
+
+	rc = spdk_file_sync(file, fuse_get_channel());
+
+	fuse_op_done(FUSE_OP_FSYNC, start, rc);
+	return rc;
 }
 
 static int
 spdk_fuse_rename(const char *old_path, const char *new_path, unsigned int flags)
 {
-	return spdk_fs_rename_file(g_fs, g_channel, &old_path[1], &new_path[1]);
+	uint64_t start = spdk_get_ticks();
+	int rc;
+
+	rc = spdk_fs_rename_file(g_fs, fuse_get_channel(), &old_path[1], &new_path[1]);
+
+	fuse_op_done(FUSE_OP_RENAME, start, rc);
+	return rc;
 }
 
 static struct fuse_operations spdk_fuse_oper = {
@@ -235,6 +415,66 @@ static struct fuse_operations spdk_fuse_oper = {
 	.rename		= spdk_fuse_rename,
 };
 
+static void
+spdk_rpc_get_fuse_stats(struct spdk_jsonrpc_request *request,
+			const struct spdk_json_val *params)
+{
+	struct spdk_json_write_ctx *w;
+	uint64_t count, ticks;
+	int op;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "get_fuse_stats requires no parameters");
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	if (w == NULL) {
+		return;
+	}
+
+	spdk_json_write_object_begin(w);
+	for (op = 0; op < FUSE_OP_COUNT; op++) {
+		count = __atomic_load_n(&g_op_stats[op].count, __ATOMIC_RELAXED);
+		ticks = __atomic_load_n(&g_op_stats[op].ticks, __ATOMIC_RELAXED);
+
+		spdk_json_write_name(w, g_op_names[op]);
+		spdk_json_write_object_begin(w);
+		spdk_json_write_name(w, "count");
+		spdk_json_write_uint64(w, count);
+		spdk_json_write_name(w, "errors");
+		spdk_json_write_uint64(w, __atomic_load_n(&g_op_stats[op].errors, __ATOMIC_RELAXED));
+		spdk_json_write_name(w, "avg_latency_us");
+		spdk_json_write_uint64(w, count > 0 ? ticks_to_us(ticks) / count : 0);
+		spdk_json_write_name(w, "max_latency_us");
+		spdk_json_write_uint64(w, ticks_to_us(__atomic_load_n(&g_op_stats[op].max_ticks,
+						       __ATOMIC_RELAXED)));
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_object_end(w);
+
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("get_fuse_stats", spdk_rpc_get_fuse_stats)
+
+static void
+print_op_stats(void)
+{
+	int op;
+
+	printf("%-10s %12s %8s %14s %14s\n", "op", "count", "errors", "avg lat (us)", "max lat (us)");
+	for (op = 0; op < FUSE_OP_COUNT; op++) {
+		if (g_op_stats[op].count == 0) {
+			continue;
+		}
+		printf("%-10s %12" PRIu64 " %8" PRIu64 " %14" PRIu64 " %14" PRIu64 "\n", g_op_names[op],
+		       g_op_stats[op].count, g_op_stats[op].errors,
+		       ticks_to_us(g_op_stats[op].ticks) / g_op_stats[op].count,
+		       ticks_to_us(g_op_stats[op].max_ticks));
+	}
+}
+
 static void
 construct_targets(void)
 {
@@ -251,10 +491,24 @@ construct_targets(void)
 	printf("Mounting BlobFS on bdev %s\n", spdk_bdev_get_name(bdev));
 }
 
+static void
+unload_cb(void *ctx, int fserrno)
+{
+	print_op_stats();
+	spdk_app_stop(0);
+}
+
+static void
+unload_fs_fn(void *arg1, void *arg2)
+{
+	spdk_fs_unload(g_fs, unload_cb, NULL);
+}
+
 static void
 start_fuse_fn(void *arg1, void *arg2)
 {
 	struct fuse_args args = FUSE_ARGS_INIT(g_fuse_argc, g_fuse_argv);
+	struct spdk_event *event;
 	int rc;
 	struct fuse_cmdline_opts opts = {};
 
@@ -276,10 +530,24 @@ start_fuse_fn(void *arg1, void *arg2)
 
 	fuse_daemonize(true /* true = run in foreground */);
 
-	fuse_loop(g_fuse);
+	if (opts.singlethread) {
+		fuse_loop(g_fuse);
+	} else {
+		fuse_loop_mt(g_fuse, opts.clone_fd);
+	}
+
+	/* The worker threads have exited and freed their channels, so only this one is left */
+	if (g_thread_ctx != NULL) {
+		pthread_setspecific(g_thread_key, NULL);
+		fuse_thread_exit(g_thread_ctx);
+		g_thread_ctx = NULL;
+	}
 
 	fuse_unmount(g_fuse);
 	fuse_destroy(g_fuse);
+
+	event = spdk_event_allocate(0, unload_fs_fn, NULL, NULL);
+	spdk_event_call(event);
 }
 
 static void
@@ -288,7 +556,6 @@ init_cb(void *ctx, struct spdk_filesystem *fs, int fserrno)
 	struct spdk_event *event;
 
 	g_fs = fs;
-	g_channel = spdk_fs_alloc_io_channel_sync(g_fs);
 	event = spdk_event_allocate(1, start_fuse_fn, NULL, NULL);
 	spdk_event_call(event);
 }
@@ -301,18 +568,11 @@ spdk_fuse_run(void *arg1, void *arg2)
 }
 
 static void
-shutdown_cb(void *ctx, int fserrno)
+spdk_fuse_shutdown(void)
 {
+	/* The filesystem is unloaded once the FUSE loop has returned */
 	fuse_session_exit(fuse_get_session(g_fuse));
 	pthread_kill(g_fuse_thread, SIGINT);
-	spdk_fs_free_io_channel(g_channel);
-	spdk_app_stop(0);
-}
-
-static void
-spdk_fuse_shutdown(void)
-{
-	spdk_fs_unload(g_fs, shutdown_cb, NULL);
 }
 
 int main(int argc, char **argv)
@@ -320,7 +580,8 @@ int main(int argc, char **argv)
 	struct spdk_app_opts opts = {};
 
 	if (argc < 4) {
-		fprintf(stderr, "usage: %s <conffile> <bdev name> <mountpoint>\n", argv[0]);
+		fprintf(stderr, "usage: %s <conffile> <bdev name> <mountpoint> [fuse options]\n", argv[0]);
+		fprintf(stderr, "  requests are served by several threads unless -s is given\n");
 		exit(1);
 	}
 
@@ -336,6 +597,8 @@ int main(int argc, char **argv)
 	g_fuse_argc = argc - 2;
 	g_fuse_argv = &argv[2];
 
+	pthread_key_create(&g_thread_key, fuse_thread_exit);
+
 	spdk_app_start(&opts, spdk_fuse_run, NULL, NULL);
 	spdk_app_fini();
 
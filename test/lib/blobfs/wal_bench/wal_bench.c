@@ -0,0 +1,369 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * WAL style benchmark for blobfs - writer threads append records to one file under a
+ *  lock, as a database write leader would, and sync the file outside of it, so that
+ *  concurrent syncs can be committed together.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/blobfs.h"
+#include "spdk/bdev.h"
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/io_channel.h"
+#include "spdk/blob_bdev.h"
+#include "spdk/log.h"
+#include "spdk/util.h"
+
+struct wal_writer {
+	pthread_t	tid;
+	uint64_t	syncs;
+	uint64_t	sync_ticks;
+	uint64_t	max_sync_ticks;
+	int		rc;
+};
+
+static const char *g_config_file = "wal_bench.conf";
+static const char *g_bdev_name = "Malloc0";
+static uint32_t g_num_writers = 4;
+static uint32_t g_record_size = 512;
+static uint32_t g_num_records = 10000;
+static uint32_t g_sync_interval = 1;
+static uint64_t g_prealloc_mb;
+
+static struct spdk_bs_dev *g_bs_dev;
+static struct spdk_filesystem *g_fs;
+static struct spdk_file *g_file;
+static pthread_mutex_t g_append_lock = PTHREAD_MUTEX_INITIALIZER;
+/* End of the records appended so far - short of the file length when preallocated */
+static uint64_t g_append_offset;
+static struct wal_writer *g_writers;
+static pthread_t g_control_tid;
+static int g_rc;
+
+static void
+usage(char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-c configuration file (default %s)]\n", g_config_file);
+	printf("\t[-b bdev to initialize the filesystem on (default %s)]\n", g_bdev_name);
+	printf("\t[-t number of writer threads (default %u)]\n", g_num_writers);
+	printf("\t[-s record size in bytes (default %u)]\n", g_record_size);
+	printf("\t[-n records per writer (default %u)]\n", g_num_records);
+	printf("\t[-i records between syncs of each writer (default %u)]\n", g_sync_interval);
+	printf("\t[-p MB to preallocate the WAL file to (default 0)]\n");
+	printf("All data on the bdev is destroyed.\n");
+}
+
+static void
+__call_fn(void *arg1, void *arg2)
+{
+	fs_request_fn fn;
+
+	fn = (fs_request_fn)arg1;
+	fn(arg2);
+}
+
+static void
+__send_request(fs_request_fn fn, void *arg)
+{
+	struct spdk_event *event;
+
+	event = spdk_event_allocate(0, __call_fn, (void *)fn, arg);
+	spdk_event_call(event);
+}
+
+static void
+_wal_send_msg(spdk_thread_fn fn, void *ctx, void *thread_ctx)
+{
+	/* Not supported */
+	assert(false);
+}
+
+static void *
+wal_writer_fn(void *arg)
+{
+	struct wal_writer *writer = arg;
+	struct spdk_io_channel *channel;
+	uint64_t start, ticks;
+	uint32_t i;
+	void *buf;
+	int rc = 0;
+
+	spdk_allocate_thread(_wal_send_msg, NULL, NULL, NULL, "wal_writer");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	buf = malloc(g_record_size);
+	if (channel == NULL || buf == NULL) {
+		writer->rc = -ENOMEM;
+		goto out;
+	}
+	memset(buf, 0x5a, g_record_size);
+
+	for (i = 0; i < g_num_records; i++) {
+		pthread_mutex_lock(&g_append_lock);
+		rc = spdk_file_write(g_file, channel, buf, g_append_offset, g_record_size);
+		if (rc == 0) {
+			g_append_offset += g_record_size;
+		}
+		pthread_mutex_unlock(&g_append_lock);
+		if (rc != 0) {
+			break;
+		}
+
+		if ((i + 1) % g_sync_interval == 0 || i + 1 == g_num_records) {
+			start = spdk_get_ticks();
+			rc = spdk_file_sync(g_file, channel);
+			ticks = spdk_get_ticks() - start;
+			if (rc != 0) {
+				break;
+			}
+			writer->syncs++;
+			writer->sync_ticks += ticks;
+			writer->max_sync_ticks = spdk_max(writer->max_sync_ticks, ticks);
+		}
+	}
+	writer->rc = rc;
+
+out:
+	free(buf);
+	if (channel != NULL) {
+		spdk_fs_free_io_channel(channel);
+	}
+	spdk_free_thread();
+	return NULL;
+}
+
+static void
+wal_unload_cb(void *ctx, int fserrno)
+{
+	spdk_app_stop(g_rc != 0 ? g_rc : fserrno);
+}
+
+static void
+wal_unload(void *arg1, void *arg2)
+{
+	pthread_join(g_control_tid, NULL);
+	spdk_fs_unload(g_fs, wal_unload_cb, NULL);
+}
+
+static void
+wal_report(uint64_t ticks)
+{
+	uint64_t tsc_rate = spdk_get_ticks_hz();
+	uint64_t records, syncs = 0, sync_ticks = 0, max_sync_ticks = 0;
+	double seconds;
+	uint32_t i;
+
+	for (i = 0; i < g_num_writers; i++) {
+		syncs += g_writers[i].syncs;
+		sync_ticks += g_writers[i].sync_ticks;
+		max_sync_ticks = spdk_max(max_sync_ticks, g_writers[i].max_sync_ticks);
+	}
+
+	records = (uint64_t)g_num_writers * g_num_records;
+	seconds = (double)ticks / tsc_rate;
+	printf("%u writers, %u byte records, sync every %u records, %" PRIu64 " MB preallocated\n",
+	       g_num_writers, g_record_size, g_sync_interval, g_prealloc_mb);
+	printf("%" PRIu64 " records in %.3f s: %.0f records/s, %.2f MB/s\n", records, seconds,
+	       records / seconds, records * g_record_size / seconds / (1024 * 1024));
+	if (syncs > 0) {
+		printf("%" PRIu64 " syncs: %.0f syncs/s, avg latency %.1f us, max latency %.1f us\n",
+		       syncs, syncs / seconds, (double)sync_ticks * 1000000 / tsc_rate / syncs,
+		       (double)max_sync_ticks * 1000000 / tsc_rate);
+	}
+}
+
+static void *
+wal_control_fn(void *arg)
+{
+	struct spdk_io_channel *channel;
+	struct spdk_event *event;
+	uint64_t start;
+	uint32_t i;
+	int rc;
+
+	spdk_allocate_thread(_wal_send_msg, NULL, NULL, NULL, "wal_control");
+	channel = spdk_fs_alloc_io_channel_sync(g_fs);
+	if (channel == NULL) {
+		g_rc = -ENOMEM;
+		goto out;
+	}
+
+	rc = spdk_fs_open_file(g_fs, channel, "wal", SPDK_BLOBFS_OPEN_CREATE, &g_file);
+	if (rc != 0) {
+		SPDK_ERRLOG("could not create the WAL file (err %d)\n", rc);
+		g_rc = rc;
+		goto free_channel;
+	}
+	spdk_file_set_priority(g_file, SPDK_FILE_PRIORITY_HIGH);
+	if (g_prealloc_mb > 0) {
+		/* The stored length then covers the records, so syncs skip the metadata update */
+		spdk_file_truncate(g_file, channel, g_prealloc_mb * 1024 * 1024);
+	}
+
+	start = spdk_get_ticks();
+	for (i = 0; i < g_num_writers; i++) {
+		if (pthread_create(&g_writers[i].tid, NULL, wal_writer_fn, &g_writers[i]) != 0) {
+			g_writers[i].rc = -errno;
+			g_writers[i].tid = 0;
+		}
+	}
+	for (i = 0; i < g_num_writers; i++) {
+		if (g_writers[i].tid != 0) {
+			pthread_join(g_writers[i].tid, NULL);
+		}
+		if (g_writers[i].rc != 0) {
+			SPDK_ERRLOG("writer %u failed (err %d)\n", i, g_writers[i].rc);
+			g_rc = g_writers[i].rc;
+		}
+	}
+	if (g_rc == 0) {
+		wal_report(spdk_get_ticks() - start);
+	}
+
+	spdk_file_close(g_file, channel);
+	spdk_fs_delete_file(g_fs, channel, "wal");
+free_channel:
+	spdk_fs_free_io_channel(channel);
+out:
+	spdk_free_thread();
+
+	event = spdk_event_allocate(0, wal_unload, NULL, NULL);
+	spdk_event_call(event);
+	return NULL;
+}
+
+static void
+wal_init_cb(void *ctx, struct spdk_filesystem *fs, int fserrno)
+{
+	if (fserrno != 0) {
+		SPDK_ERRLOG("could not initialize the filesystem (err %d)\n", fserrno);
+		spdk_app_stop(fserrno);
+		return;
+	}
+
+	g_fs = fs;
+	/* The sync API blocks, so run it on threads of its own */
+	if (pthread_create(&g_control_tid, NULL, wal_control_fn, NULL) != 0) {
+		g_rc = -errno;
+		spdk_fs_unload(g_fs, wal_unload_cb, NULL);
+	}
+}
+
+static void
+wal_start(void *arg1, void *arg2)
+{
+	struct spdk_bdev *bdev;
+
+	bdev = spdk_bdev_get_by_name(g_bdev_name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev %s not found\n", g_bdev_name);
+		spdk_app_stop(-ENODEV);
+		return;
+	}
+
+	g_bs_dev = spdk_bdev_create_bs_dev(bdev, NULL, NULL);
+	if (g_bs_dev == NULL) {
+		SPDK_ERRLOG("could not create blobstore device on bdev %s\n", g_bdev_name);
+		spdk_app_stop(-ENOMEM);
+		return;
+	}
+
+	printf("Initializing filesystem on bdev %s\n", g_bdev_name);
+	spdk_fs_init(g_bs_dev, __send_request, wal_init_cb, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts = {};
+	int op, rc;
+
+	while ((op = getopt(argc, argv, "b:c:i:n:p:s:t:")) != -1) {
+		switch (op) {
+		case 'b':
+			g_bdev_name = optarg;
+			break;
+		case 'c':
+			g_config_file = optarg;
+			break;
+		case 'i':
+			g_sync_interval = atoi(optarg);
+			break;
+		case 'n':
+			g_num_records = atoi(optarg);
+			break;
+		case 'p':
+			g_prealloc_mb = strtoull(optarg, NULL, 10);
+			break;
+		case 's':
+			g_record_size = atoi(optarg);
+			break;
+		case 't':
+			g_num_writers = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (g_num_writers == 0 || g_record_size == 0 || g_num_records == 0 || g_sync_interval == 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	g_writers = calloc(g_num_writers, sizeof(*g_writers));
+	if (g_writers == NULL) {
+		return -ENOMEM;
+	}
+
+	spdk_app_opts_init(&opts);
+	opts.name = "wal_bench";
+	opts.config_file = g_config_file;
+	opts.reactor_mask = "0x1";
+	opts.mem_size = 1024;
+	opts.rpc_addr = NULL;
+
+	spdk_fs_set_cache_size(512);
+
+	rc = spdk_app_start(&opts, wal_start, NULL, NULL);
+	spdk_app_fini();
+
+	free(g_writers);
+	return rc;
+}
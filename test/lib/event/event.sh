@@ -8,4 +8,6 @@ timing_enter event
 $testdir/event_perf/event_perf -m 0xF -t 1
 $testdir/reactor/reactor -t 1
 $testdir/reactor_perf/reactor_perf -t 1
+$testdir/reactor_perf/reactor_perf -m 0xF -t 3 -w 8 -u 50 -S balanced
+$testdir/reactor_perf/reactor_perf -m 0xF -t 3 -T 64 -S balanced
 timing_exit event
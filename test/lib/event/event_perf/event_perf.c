@@ -33,9 +33,6 @@
 
 #include "spdk/stdinc.h"
 
-#include <rte_config.h>
-#include <rte_lcore.h>
-
 #include "spdk/env.h"
 #include "spdk/event.h"
 #include "spdk_internal/event.h"
@@ -47,7 +44,9 @@ static uint64_t g_tsc_end;
 
 static int g_time_in_sec;
 
-static uint64_t call_count[RTE_MAX_LCORE];
+#define MAX_LCORE 128
+
+static uint64_t call_count[MAX_LCORE];
 
 static bool g_app_stopped = false;
 
@@ -55,7 +54,7 @@ static void
 submit_new_event(void *arg1, void *arg2)
 {
 	struct spdk_event *event;
-	static __thread uint32_t next_lcore = RTE_MAX_LCORE;
+	static __thread uint32_t next_lcore = MAX_LCORE;
 
 	if (spdk_get_ticks() > g_tsc_end) {
 		if (__sync_bool_compare_and_swap(&g_app_stopped, false, true)) {
@@ -64,8 +63,11 @@ submit_new_event(void *arg1, void *arg2)
 		return;
 	}
 
-	if (next_lcore == RTE_MAX_LCORE) {
-		next_lcore = rte_get_next_lcore(rte_lcore_id(), 0, 1);
+	if (next_lcore == MAX_LCORE) {
+		next_lcore = spdk_env_get_next_core(spdk_env_get_current_core());
+		if (next_lcore == UINT32_MAX) {
+			next_lcore = spdk_env_get_first_core();
+		}
 	}
 
 	call_count[next_lcore]++;
@@ -41,12 +41,184 @@ static int g_time_in_sec;
 static int g_queue_depth;
 static struct spdk_poller *test_end_poller;
 static uint64_t g_call_count = 0;
+static uint64_t g_lw_msg_count = 0;
+
+/*
+ * Work items used to create a skewed load.  All of them start on the master
+ *  core; the reactor scheduler is expected to spread them out.
+ */
+struct work_item {
+	struct spdk_poller	*poller;
+	uint32_t		lcore;
+	uint64_t		calls;
+};
+
+static struct work_item *g_work_items;
+static int g_num_work_items;
+static uint64_t g_work_usec = 10;
+static const char *g_scheduler;
+static bool g_work_stopped;
+
+/*
+ * Lightweight threads, spread round-robin across the reactors, each passing a
+ *  message to itself and hopping to the next core every LW_THREAD_MOVE_INTERVAL
+ *  messages.
+ */
+#define LW_THREAD_MOVE_INTERVAL	100000
+
+struct lw_thread {
+	struct spdk_thread	*thread;
+	uint64_t		msgs;
+};
+
+static struct lw_thread *g_lw_threads;
+static int g_num_lw_threads;
+static int g_lw_threads_running;
+static uint32_t g_master_core;
+static bool g_test_stopping;
+
+static int __migrate_work(uint32_t dst_lcore, void *ctx);
 
 static void
+print_work_distribution(void)
+{
+	struct spdk_reactor_stats stats;
+	uint32_t lcore;
+	int i, items;
+
+	SPDK_ENV_FOREACH_CORE(lcore) {
+		items = 0;
+		for (i = 0; i < g_num_work_items; i++) {
+			if (g_work_items[i].lcore == lcore) {
+				items++;
+			}
+		}
+		if (spdk_reactor_get_stats(lcore, &stats) != 0) {
+			continue;
+		}
+		printf("lcore %2u: %4d work items, load %3u%%\n", lcore, items, stats.load);
+	}
+}
+
+static int
 __test_end(void *arg)
 {
 	printf("test_end\n");
+	spdk_poller_unregister(&test_end_poller);
+	if (g_num_work_items > 0) {
+		g_work_stopped = true;
+		spdk_reactor_unregister_migrate_handler(__migrate_work, NULL);
+		print_work_distribution();
+	}
+	if (g_lw_threads_running > 0) {
+		/* The last lightweight thread to exit stops the app. */
+		g_test_stopping = true;
+		return 0;
+	}
 	spdk_app_stop(0);
+	return 0;
+}
+
+static void
+__lw_thread_exited(void *arg1, void *arg2)
+{
+	if (--g_lw_threads_running == 0) {
+		spdk_app_stop(0);
+	}
+}
+
+static void
+__lw_thread_msg(void *ctx)
+{
+	struct lw_thread *lw = ctx;
+	uint32_t lcore;
+
+	if (g_test_stopping) {
+		spdk_reactor_exit_thread();
+		spdk_event_call(spdk_event_allocate(g_master_core, __lw_thread_exited, NULL, NULL));
+		return;
+	}
+
+	lw->msgs++;
+	if (lw->msgs % LW_THREAD_MOVE_INTERVAL == 0) {
+		lcore = spdk_env_get_next_core(spdk_env_get_current_core());
+		if (lcore == UINT32_MAX) {
+			lcore = spdk_env_get_first_core();
+		}
+		spdk_reactor_move_thread(lw->thread, lcore);
+	}
+
+	spdk_thread_send_msg(lw->thread, __lw_thread_msg, lw);
+}
+
+static int
+__start_lw_threads(void)
+{
+	char name[32];
+	uint32_t lcore;
+	int i;
+
+	g_master_core = spdk_env_get_current_core();
+	lcore = spdk_env_get_first_core();
+	for (i = 0; i < g_num_lw_threads; i++) {
+		snprintf(name, sizeof(name), "lw_thread_%d", i);
+		g_lw_threads[i].thread = spdk_reactor_create_thread(name, lcore);
+		if (g_lw_threads[i].thread == NULL) {
+			fprintf(stderr, "could not create lightweight thread %d\n", i);
+			return -1;
+		}
+		g_lw_threads_running++;
+		spdk_thread_send_msg(g_lw_threads[i].thread, __lw_thread_msg, &g_lw_threads[i]);
+
+		lcore = spdk_env_get_next_core(lcore);
+		if (lcore == UINT32_MAX) {
+			lcore = spdk_env_get_first_core();
+		}
+	}
+
+	return 0;
+}
+
+static int
+__do_work(void *arg)
+{
+	struct work_item *item = arg;
+
+	if (g_work_stopped) {
+		spdk_poller_unregister(&item->poller);
+		return 0;
+	}
+
+	spdk_delay_us(g_work_usec);
+	item->calls++;
+
+	return 1;
+}
+
+static void
+__start_work(void *arg1, void *arg2)
+{
+	struct work_item *item = arg1;
+
+	item->lcore = spdk_env_get_current_core();
+	item->poller = spdk_poller_register(__do_work, item, 0);
+}
+
+static int
+__migrate_work(uint32_t dst_lcore, void *ctx)
+{
+	uint32_t lcore = spdk_env_get_current_core();
+	int i;
+
+	for (i = 0; i < g_num_work_items; i++) {
+		if (g_work_items[i].lcore == lcore && g_work_items[i].poller != NULL) {
+			spdk_poller_unregister(&g_work_items[i].poller);
+			spdk_event_call(spdk_event_allocate(dst_lcore, __start_work, &g_work_items[i], NULL));
+			return 0;
+		}
+	}
+
+	return -ENOENT;
 }
 
 static void
@@ -75,6 +247,23 @@ test_start(void *arg1, void *arg2)
 	for (i = 0; i < g_queue_depth; i++) {
 		__submit_next(NULL, NULL);
 	}
+
+	if (g_num_work_items > 0) {
+		if (g_scheduler != NULL && spdk_reactor_set_scheduler(g_scheduler, 0) != 0) {
+			fprintf(stderr, "unknown scheduler %s\n", g_scheduler);
+			spdk_poller_unregister(&test_end_poller);
+			spdk_app_stop(-1);
+			return;
+		}
+		spdk_reactor_register_migrate_handler(__migrate_work, NULL);
+		for (i = 0; i < g_num_work_items; i++) {
+			__start_work(&g_work_items[i], NULL);
+		}
+	}
+
+	if (g_num_lw_threads > 0 && __start_lw_threads() != 0) {
+		g_test_stopping = true;
+	}
 }
 
 static void
@@ -83,6 +272,10 @@ test_cleanup(void)
 	printf("test_abort\n");
 
 	spdk_poller_unregister(&test_end_poller);
+	if (g_lw_threads_running > 0) {
+		g_test_stopping = true;
+		return;
+	}
 	spdk_app_stop(0);
 }
 
@@ -91,15 +284,20 @@ usage(const char *program_name)
 {
 	printf("%s options\n", program_name);
 	printf("\t[-d Allowed delay when passing messages between cores in microseconds]\n");
+	printf("\t[-m core mask for distributing work items]\n");
 	printf("\t[-q Queue depth (default: 1)]\n");
+	printf("\t[-S reactor scheduler (e.g. static, balanced)]\n");
 	printf("\t[-t time in seconds]\n");
+	printf("\t[-T number of lightweight threads passing messages (default: 0)]\n");
+	printf("\t[-u microseconds each work item spins per call (default: 10)]\n");
+	printf("\t[-w number of work items started on the master core (default: 0)]\n");
 }
 
 int
 main(int argc, char **argv)
 {
 	struct spdk_app_opts opts;
-	int op;
+	int op, i;
 
 	spdk_app_opts_init(&opts);
 	opts.name = "reactor_perf";
@@ -108,17 +306,32 @@ main(int argc, char **argv)
 	g_time_in_sec = 0;
 	g_queue_depth = 1;
 
-	while ((op = getopt(argc, argv, "d:q:t:")) != -1) {
+	while ((op = getopt(argc, argv, "d:m:q:S:t:T:u:w:")) != -1) {
 		switch (op) {
 		case 'd':
 			opts.max_delay_us = atoi(optarg);
 			break;
+		case 'm':
+			opts.reactor_mask = optarg;
+			break;
 		case 'q':
 			g_queue_depth = atoi(optarg);
 			break;
+		case 'S':
+			g_scheduler = optarg;
+			break;
 		case 't':
 			g_time_in_sec = atoi(optarg);
 			break;
+		case 'T':
+			g_num_lw_threads = atoi(optarg);
+			break;
+		case 'u':
+			g_work_usec = strtoull(optarg, NULL, 10);
+			break;
+		case 'w':
+			g_num_work_items = atoi(optarg);
+			break;
 		default:
 			usage(argv[0]);
 			exit(1);
@@ -130,13 +343,37 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (g_num_work_items > 0) {
+		g_work_items = calloc(g_num_work_items, sizeof(*g_work_items));
+		if (g_work_items == NULL) {
+			fprintf(stderr, "could not allocate work items\n");
+			exit(1);
+		}
+	}
+
+	if (g_num_lw_threads > 0) {
+		g_lw_threads = calloc(g_num_lw_threads, sizeof(*g_lw_threads));
+		if (g_lw_threads == NULL) {
+			fprintf(stderr, "could not allocate lightweight threads\n");
+			exit(1);
+		}
+	}
+
 	opts.shutdown_cb = test_cleanup;
 
 	spdk_app_start(&opts, test_start, NULL, NULL);
 
 	spdk_app_fini();
+	free(g_work_items);
 
 	printf("Performance: %8ju events per second\n", g_call_count / g_time_in_sec);
+	if (g_num_lw_threads > 0) {
+		for (i = 0; i < g_num_lw_threads; i++) {
+			g_lw_msg_count += g_lw_threads[i].msgs;
+		}
+		printf("Performance: %8ju thread messages per second\n", g_lw_msg_count / g_time_in_sec);
+		free(g_lw_threads);
+	}
 
 	return 0;
 }
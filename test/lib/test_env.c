@@ -155,6 +155,7 @@ spdk_memzone_free(const char *name)
 
 struct test_mempool {
 	size_t	count;
+	size_t	ele_size;
 };
 
 struct spdk_mempool *
@@ -169,6 +170,7 @@ spdk_mempool_create(const char *name, size_t count,
 	}
 
 	mp->count = count;
+	mp->ele_size = ele_size;
 
 	return (struct spdk_mempool *)mp;
 }
@@ -185,13 +187,18 @@ void *
 spdk_mempool_get(struct spdk_mempool *_mp)
 {
 	struct test_mempool *mp = (struct test_mempool *)_mp;
+	size_t ele_size = 0x1000;
 	void *buf;
 
 	if (mp && mp->count == 0) {
 		return NULL;
 	}
 
-	if (posix_memalign(&buf, 64, 0x1000)) {
+	if (mp && mp->ele_size > ele_size) {
+		ele_size = mp->ele_size;
+	}
+
+	if (posix_memalign(&buf, 64, ele_size)) {
 		return NULL;
 	} else {
 		if (mp) {
@@ -359,6 +359,150 @@ part_test(void)
 	spdk_bdev_unregister(&bdev_base, NULL, NULL);
 }
 
+static const char *g_ut_init_order[8];
+static int g_ut_init_count;
+static int g_ut_init_cb_rc;
+static int g_ut_init_cb_calls;
+
+static int
+ut_module_init(const char *name, int rc)
+{
+	SPDK_CU_ASSERT_FATAL(g_ut_init_count < (int)SPDK_COUNTOF(g_ut_init_order));
+	g_ut_init_order[g_ut_init_count++] = name;
+	return rc;
+}
+
+static int ut_dep_a_init(void) { return ut_module_init("ut_dep_a", 0); }
+static int ut_dep_b_init(void) { return ut_module_init("ut_dep_b", 0); }
+static int ut_dep_c_init(void) { return ut_module_init("ut_dep_c", 0); }
+static int ut_dep_d_init(void) { return ut_module_init("ut_dep_d", 0); }
+static int ut_dep_e_init(void) { return ut_module_init("ut_dep_e", 0); }
+static int ut_dep_fail_init(void) { return ut_module_init("ut_dep_fail", -1); }
+
+/*
+ * These modules are not registered, so they are only initialized by the tests below,
+ *  which swap them in for the registered ones.  The dependencies are registered
+ *  normally.
+ */
+static struct spdk_bdev_module_if g_ut_dep_a = { .name = "ut_dep_a", .module_init = ut_dep_a_init };
+static struct spdk_bdev_module_if g_ut_dep_b = { .name = "ut_dep_b", .module_init = ut_dep_b_init };
+static struct spdk_bdev_module_if g_ut_dep_c = { .name = "ut_dep_c", .module_init = ut_dep_c_init };
+static struct spdk_bdev_module_if g_ut_dep_d = { .name = "ut_dep_d", .module_init = ut_dep_d_init };
+static struct spdk_bdev_module_if g_ut_dep_e = { .name = "ut_dep_e", .module_init = ut_dep_e_init };
+static struct spdk_bdev_module_if g_ut_dep_fail = { .name = "ut_dep_fail", .module_init = ut_dep_fail_init };
+
+SPDK_BDEV_MODULE_DEPEND(ut_dep_c, ut_dep_b)
+SPDK_BDEV_MODULE_DEPEND(ut_dep_d, ut_dep_a)
+
+static void
+ut_init_cb(void *cb_arg, int rc)
+{
+	g_ut_init_cb_rc = rc;
+	g_ut_init_cb_calls++;
+}
+
+static void
+ut_modules_add(struct spdk_bdev_module_if *module, bool async_init)
+{
+	module->async_init = async_init;
+	module->action_in_progress = async_init ? 1 : 0;
+	module->init_started = false;
+	module->init_done = false;
+	TAILQ_INSERT_TAIL(&g_bdev_mgr.bdev_modules, module, tailq);
+}
+
+static void
+ut_modules_begin(void)
+{
+	g_ut_init_count = 0;
+	g_ut_init_cb_calls = 0;
+	g_ut_init_cb_rc = 0;
+	g_init_cb_fn = ut_init_cb;
+	g_init_cb_arg = NULL;
+	g_bdev_mgr.init_complete = false;
+	g_bdev_mgr.module_init_complete = false;
+	g_bdev_mgr.module_init_failed = false;
+}
+
+static void
+module_init_depends(void)
+{
+	TAILQ_HEAD(, spdk_bdev_module_if) registered = TAILQ_HEAD_INITIALIZER(registered);
+
+	TAILQ_CONCAT(&registered, &g_bdev_mgr.bdev_modules, tailq);
+
+	/*
+	 * C depends on B and D depends on A.  A and B initialize asynchronously; E has no
+	 *  dependencies.  C comes first in the list but has to wait for B.
+	 */
+	ut_modules_begin();
+	ut_modules_add(&g_ut_dep_c, false);
+	ut_modules_add(&g_ut_dep_b, true);
+	ut_modules_add(&g_ut_dep_a, true);
+	ut_modules_add(&g_ut_dep_d, false);
+	ut_modules_add(&g_ut_dep_e, false);
+	CU_ASSERT(spdk_bdev_module_depends_verify() == 0);
+
+	CU_ASSERT(spdk_bdev_modules_init() == 0);
+	CU_ASSERT(g_ut_init_count == 3);
+	CU_ASSERT(strcmp(g_ut_init_order[0], "ut_dep_b") == 0);
+	CU_ASSERT(strcmp(g_ut_init_order[1], "ut_dep_a") == 0);
+	CU_ASSERT(strcmp(g_ut_init_order[2], "ut_dep_e") == 0);
+	CU_ASSERT(!g_ut_dep_c.init_started);
+	CU_ASSERT(!g_ut_dep_d.init_started);
+	CU_ASSERT(!g_bdev_mgr.module_init_complete);
+
+	/* A finishes before B, which only unblocks D. */
+	spdk_bdev_module_init_done(&g_ut_dep_a);
+	CU_ASSERT(g_ut_init_count == 4);
+	CU_ASSERT(strcmp(g_ut_init_order[3], "ut_dep_d") == 0);
+	CU_ASSERT(g_ut_dep_d.init_done);
+	CU_ASSERT(!g_ut_dep_c.init_started);
+	CU_ASSERT(!g_bdev_mgr.module_init_complete);
+	CU_ASSERT(g_ut_init_cb_calls == 0);
+
+	spdk_bdev_module_init_done(&g_ut_dep_b);
+	CU_ASSERT(g_ut_init_count == 5);
+	CU_ASSERT(strcmp(g_ut_init_order[4], "ut_dep_c") == 0);
+	CU_ASSERT(g_ut_dep_c.init_done);
+	CU_ASSERT(g_bdev_mgr.module_init_complete);
+	CU_ASSERT(g_ut_init_cb_calls == 1);
+	CU_ASSERT(g_ut_init_cb_rc == 0);
+
+	TAILQ_INIT(&g_bdev_mgr.bdev_modules);
+
+	/*
+	 * A is still initializing when a module after it fails.  Nothing after the failed
+	 *  module may be started, including once A completes, and the failure is reported
+	 *  only by the caller of spdk_bdev_modules_init().
+	 */
+	ut_modules_begin();
+	ut_modules_add(&g_ut_dep_a, true);
+	ut_modules_add(&g_ut_dep_fail, false);
+	ut_modules_add(&g_ut_dep_e, false);
+
+	CU_ASSERT(spdk_bdev_modules_init() != 0);
+	CU_ASSERT(g_ut_init_count == 2);
+	CU_ASSERT(!g_ut_dep_e.init_started);
+
+	spdk_bdev_module_init_done(&g_ut_dep_a);
+	CU_ASSERT(g_ut_init_count == 2);
+	CU_ASSERT(!g_ut_dep_e.init_started);
+	CU_ASSERT(!g_bdev_mgr.module_init_complete);
+	CU_ASSERT(g_ut_init_cb_calls == 0);
+
+	TAILQ_INIT(&g_bdev_mgr.bdev_modules);
+
+	/* The registered dependencies name modules that are not in the list. */
+	ut_modules_begin();
+	ut_modules_add(&g_ut_dep_d, false);
+	CU_ASSERT(spdk_bdev_module_depends_verify() != 0);
+
+	TAILQ_INIT(&g_bdev_mgr.bdev_modules);
+	TAILQ_CONCAT(&g_bdev_mgr.bdev_modules, &registered, tailq);
+	g_init_cb_fn = NULL;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -379,7 +523,8 @@ main(int argc, char **argv)
 		CU_add_test(suite, "bytes_to_blocks_test", bytes_to_blocks_test) == NULL ||
 		CU_add_test(suite, "io_valid", io_valid_test) == NULL ||
 		CU_add_test(suite, "open_write", open_write_test) == NULL ||
-		CU_add_test(suite, "part", part_test) == NULL
+		CU_add_test(suite, "part", part_test) == NULL ||
+		CU_add_test(suite, "module_init_depends", module_init_depends) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
@@ -123,7 +123,7 @@ spdk_bdev_module_finish_done(void)
 }
 
 uint64_t
-spdk_bs_get_page_size(struct spdk_blob_store *bs)
+spdk_bs_get_io_unit_size(struct spdk_blob_store *bs)
 {
 	return SPDK_BS_PAGE_SIZE;
 }
@@ -386,6 +386,14 @@ spdk_bs_io_readv_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
 	CU_ASSERT(length == g_io->u.bdev.num_blocks);
 }
 
+void
+spdk_bs_io_flush_blob(struct spdk_blob *blob, struct spdk_io_channel *channel,
+		      spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	CU_ASSERT(blob == NULL);
+	CU_ASSERT(channel == g_ch);
+}
+
 void
 spdk_bdev_module_list_add(struct spdk_bdev_module_if *bdev_module)
 {
@@ -453,7 +461,7 @@ _lvol_create(struct spdk_lvol_store *lvs)
 
 int
 spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
-		 spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+		 bool thin_provision, spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
 {
 	struct spdk_lvol *lvol;
 
@@ -463,6 +471,36 @@ spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
 	return 0;
 }
 
+int
+spdk_lvol_create_snapshot(struct spdk_lvol *lvol, const char *snapshot_name,
+			  spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol *snap;
+
+	snap = _lvol_create(lvol->lvol_store);
+	cb_fn(cb_arg, snap, 0);
+
+	return 0;
+}
+
+int
+spdk_lvol_create_clone(struct spdk_lvol *lvol, const char *clone_name,
+		       spdk_lvol_op_with_handle_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol *clone;
+
+	clone = _lvol_create(lvol->lvol_store);
+	cb_fn(cb_arg, clone, 0);
+
+	return 0;
+}
+
+uint64_t
+spdk_blob_get_num_clones(struct spdk_blob *blob)
+{
+	return 0;
+}
+
 static void
 lvol_store_op_complete(void *cb_arg, int lvserrno)
 {
@@ -512,7 +550,7 @@ ut_lvs_destroy(void)
 
 	/* Suuccessfully create lvol, which should be unloaded with lvs later */
 	g_lvolerrno = -1;
-	rc = vbdev_lvol_create(lvs, "lvol", sz, vbdev_lvol_create_complete, NULL);
+	rc = vbdev_lvol_create(lvs, "lvol", sz, false, vbdev_lvol_create_complete, NULL);
 	CU_ASSERT(rc == 0);
 	CU_ASSERT(g_lvolerrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
@@ -546,7 +584,7 @@ ut_lvol_init(void)
 
 	/* Successful lvol create */
 	g_lvolerrno = -1;
-	rc = vbdev_lvol_create(g_lvs, "lvol", sz, vbdev_lvol_create_complete, NULL);
+	rc = vbdev_lvol_create(g_lvs, "lvol", sz, false, vbdev_lvol_create_complete, NULL);
 	SPDK_CU_ASSERT_FATAL(rc == 0);
 	CU_ASSERT(g_lvol != NULL);
 	CU_ASSERT(g_lvolerrno == 0);
@@ -564,6 +602,73 @@ ut_lvol_init(void)
 
 }
 
+static void
+ut_lvol_snapshot(void)
+{
+	int sz = 10;
+	int rc;
+	struct spdk_lvol *lvol, *snapshot, *clone;
+
+	g_lvs = calloc(1, sizeof(*g_lvs));
+	SPDK_CU_ASSERT_FATAL(g_lvs != NULL);
+	TAILQ_INIT(&g_lvs->lvols);
+	g_lvs_bdev = calloc(1, sizeof(*g_lvs_bdev));
+	SPDK_CU_ASSERT_FATAL(g_lvs_bdev != NULL);
+	g_base_bdev = calloc(1, sizeof(*g_base_bdev));
+	SPDK_CU_ASSERT_FATAL(g_base_bdev != NULL);
+
+	g_lvs_bdev->lvs = g_lvs;
+	g_lvs_bdev->bdev = g_base_bdev;
+
+	uuid_generate_time(g_lvs->uuid);
+
+	TAILQ_INSERT_TAIL(&g_spdk_lvol_pairs, g_lvs_bdev, lvol_stores);
+
+	g_lvolerrno = -1;
+	rc = vbdev_lvol_create(g_lvs, "lvol", sz, false, vbdev_lvol_create_complete, NULL);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol = g_lvol;
+
+	/* The snapshot and the clone are exposed as bdevs of their own */
+	g_lvolerrno = -1;
+	rc = vbdev_lvol_create_snapshot(lvol, "snap", vbdev_lvol_create_complete, NULL);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	snapshot = g_lvol;
+	CU_ASSERT(snapshot != lvol);
+	CU_ASSERT(snapshot->bdev != NULL);
+	CU_ASSERT(vbdev_lvol_get_from_bdev(snapshot->bdev) == snapshot);
+
+	g_lvolerrno = -1;
+	rc = vbdev_lvol_create_clone(snapshot, "clone", vbdev_lvol_create_complete, NULL);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	clone = g_lvol;
+	CU_ASSERT(clone->bdev != NULL);
+
+	CU_ASSERT(vbdev_lvol_get_from_bdev(g_base_bdev) == NULL);
+
+	g_lvol = clone;
+	vbdev_lvol_destruct(clone);
+	CU_ASSERT(g_lvol == NULL);
+	g_lvol = snapshot;
+	vbdev_lvol_destruct(snapshot);
+	CU_ASSERT(g_lvol == NULL);
+	g_lvol = lvol;
+	vbdev_lvol_destruct(lvol);
+	CU_ASSERT(g_lvol == NULL);
+
+	TAILQ_REMOVE(&g_spdk_lvol_pairs, g_lvs_bdev, lvol_stores);
+
+	free(g_lvs);
+	free(g_lvs_bdev);
+	free(g_base_bdev);
+}
+
 static void
 ut_lvol_hotremove(void)
 {
@@ -696,7 +801,7 @@ ut_lvol_resize(void)
 
 	/* Successful lvol create */
 	g_lvolerrno = -1;
-	rc = vbdev_lvol_create(g_lvs, "lvol", sz, vbdev_lvol_create_complete, NULL);
+	rc = vbdev_lvol_create(g_lvs, "lvol", sz, false, vbdev_lvol_create_complete, NULL);
 	CU_ASSERT(rc == 0);
 	CU_ASSERT(g_lvolerrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
@@ -754,7 +859,7 @@ ut_lvs_unload(void)
 
 	/* Suuccessfully create lvol, which should be destroyed with lvs later */
 	g_lvolerrno = -1;
-	rc = vbdev_lvol_create(lvs, "lvol", sz, vbdev_lvol_create_complete, NULL);
+	rc = vbdev_lvol_create(lvs, "lvol", sz, false, vbdev_lvol_create_complete, NULL);
 	CU_ASSERT(rc == 0);
 	CU_ASSERT(g_lvolerrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
@@ -856,10 +961,10 @@ ut_vbdev_lvol_io_type_supported(void)
 	CU_ASSERT(ret == true);
 	ret = vbdev_lvol_io_type_supported(lvol, SPDK_BDEV_IO_TYPE_WRITE_ZEROES);
 	CU_ASSERT(ret == true);
+	ret = vbdev_lvol_io_type_supported(lvol, SPDK_BDEV_IO_TYPE_FLUSH);
+	CU_ASSERT(ret == true);
 
 	/* Unsupported types */
-	ret = vbdev_lvol_io_type_supported(lvol, SPDK_BDEV_IO_TYPE_FLUSH);
-	CU_ASSERT(ret == false);
 	ret = vbdev_lvol_io_type_supported(lvol, SPDK_BDEV_IO_TYPE_NVME_ADMIN);
 	CU_ASSERT(ret == false);
 	ret = vbdev_lvol_io_type_supported(lvol, SPDK_BDEV_IO_TYPE_NVME_IO);
@@ -941,6 +1046,7 @@ int main(int argc, char **argv)
 		CU_add_test(suite, "ut_lvs_destroy", ut_lvs_destroy) == NULL ||
 		CU_add_test(suite, "ut_lvs_unload", ut_lvs_unload) == NULL ||
 		CU_add_test(suite, "ut_lvol_resize", ut_lvol_resize) == NULL ||
+		CU_add_test(suite, "ut_lvol_snapshot", ut_lvol_snapshot) == NULL ||
 		CU_add_test(suite, "lvol_hotremove", ut_lvol_hotremove) == NULL ||
 		CU_add_test(suite, "ut_vbdev_lvol_get_io_channel", ut_vbdev_lvol_get_io_channel) == NULL ||
 		CU_add_test(suite, "ut_vbdev_lvol_io_type_supported", ut_vbdev_lvol_io_type_supported) == NULL ||
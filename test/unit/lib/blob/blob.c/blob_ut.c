@@ -265,6 +265,89 @@ blob_open(void)
 	g_bs = NULL;
 }
 
+static void
+blob_open_hash(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts opts;
+	struct spdk_blob *blob[4];
+	spdk_blob_id blobid[4];
+	uint32_t i;
+
+	dev = init_dev();
+	spdk_bs_opts_init(&opts);
+	opts.num_md_pages = 2 * SPDK_BLOB_HASH_BUCKETS;
+
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	/*
+	 * Blob ids follow the metadata pages, so the first two blobs share their
+	 *  buckets with the two blobs created one full round of buckets later.
+	 */
+	for (i = 0; i < SPDK_BLOB_HASH_BUCKETS + 2; i++) {
+		spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+		if (i < 2) {
+			blobid[i] = g_blobid;
+		} else if (i >= SPDK_BLOB_HASH_BUCKETS) {
+			blobid[i - SPDK_BLOB_HASH_BUCKETS + 2] = g_blobid;
+		}
+	}
+	CU_ASSERT(_spdk_bs_blob_hash_bucket(bs, blobid[0]) == _spdk_bs_blob_hash_bucket(bs, blobid[2]));
+	CU_ASSERT(_spdk_bs_blob_hash_bucket(bs, blobid[1]) == _spdk_bs_blob_hash_bucket(bs, blobid[3]));
+	CU_ASSERT(_spdk_bs_blob_hash_bucket(bs, blobid[0]) != _spdk_bs_blob_hash_bucket(bs, blobid[1]));
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(_spdk_blob_lookup(bs, blobid[i]) == NULL);
+		spdk_bs_open_blob(bs, blobid[i], blob_op_with_handle_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+		blob[i] = g_blob;
+	}
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(_spdk_blob_lookup(bs, blobid[i]) == __blob_to_data(blob[i]));
+	}
+
+	/* Opening a blob again finds it in its bucket instead of loading another copy */
+	spdk_bs_open_blob(bs, blobid[2], blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob == blob[2]);
+	spdk_blob_close(blob[2], blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Closing a blob removes only that blob from a shared bucket */
+	spdk_blob_close(blob[0], blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_close(blob[3], blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[0]) == NULL);
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[1]) == __blob_to_data(blob[1]));
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[2]) == __blob_to_data(blob[2]));
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[3]) == NULL);
+
+	spdk_bs_open_blob(bs, blobid[0], blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob[0] = g_blob;
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[0]) == __blob_to_data(blob[0]));
+	CU_ASSERT(_spdk_blob_lookup(bs, blobid[2]) == __blob_to_data(blob[2]));
+
+	for (i = 0; i < 3; i++) {
+		spdk_blob_close(blob[i], blob_op_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(_spdk_blob_lookup(bs, blobid[i]) == NULL);
+	}
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
 static void
 blob_create(void)
 {
@@ -379,6 +462,7 @@ blob_resize(void)
 	struct spdk_blob *blob;
 	spdk_blob_id blobid;
 	uint64_t free_clusters;
+	uint64_t released_lba;
 	int rc;
 
 	dev = init_dev();
@@ -414,6 +498,7 @@ blob_resize(void)
 	/* Shrink the blob to 3 clusters. This will not actually release
 	 * the old clusters until the blob is synced.
 	 */
+	released_lba = __blob_to_data(blob)->active.clusters[3];
 	rc = spdk_blob_resize(blob, 3);
 	CU_ASSERT(rc == 0);
 	/* Verify there are still 5 clusters in use */
@@ -428,6 +513,14 @@ blob_resize(void)
 	rc = spdk_blob_resize(blob, 10);
 	CU_ASSERT(rc == 0);
 	CU_ASSERT((free_clusters - 10) == spdk_bs_free_cluster_count(bs));
+	/* The lowest free clusters, including the ones just released, are claimed first */
+	CU_ASSERT(__blob_to_data(blob)->active.clusters[3] == released_lba);
+
+	/* Growing past the free clusters fails without claiming any of them. */
+	rc = spdk_blob_resize(blob, free_clusters + 1);
+	CU_ASSERT(rc == -ENOSPC);
+	CU_ASSERT((free_clusters - 10) == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
 
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	CU_ASSERT(g_bserrno == 0);
@@ -776,7 +869,9 @@ blob_rw_verify_iov_nomem(void)
 	spdk_blob_id blobid;
 	uint8_t payload_write[10 * 4096];
 	struct iovec iov_write[3];
+	struct iovec iov_many[20];
 	uint32_t req_count;
+	size_t i;
 	int rc;
 
 	dev = init_dev();
@@ -815,8 +910,36 @@ blob_rw_verify_iov_nomem(void)
 	iov_write[2].iov_len = 4 * 4096;
 	MOCK_SET(calloc, void *, NULL);
 	req_count = bs_channel_get_req_count(channel);
+	/* A split that fits in the request set's own iov array does not allocate. */
+	g_bserrno = -1;
 	spdk_bs_io_writev_blob(blob, channel, iov_write, 3, 250, 10, blob_op_complete, NULL);
-	CU_ASSERT(g_bserrno = -ENOMEM);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(req_count == bs_channel_get_req_count(channel));
+
+	/* One that does not fit fails cleanly when its iov array cannot be allocated. */
+	for (i = 0; i < SPDK_COUNTOF(iov_many); i++) {
+		iov_many[i].iov_base = payload_write + i * 2048;
+		iov_many[i].iov_len = 2048;
+	}
+	g_bserrno = 0;
+	spdk_bs_io_writev_blob(blob, channel, iov_many, SPDK_COUNTOF(iov_many), 250, 10,
+			       blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -ENOMEM);
+	CU_ASSERT(req_count == bs_channel_get_req_count(channel));
+	MOCK_SET(calloc, void *, (void *)MOCK_PASS_THRU);
+
+	g_bserrno = -1;
+	spdk_bs_io_writev_blob(blob, channel, iov_many, SPDK_COUNTOF(iov_many), 250, 10,
+			       blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(req_count == bs_channel_get_req_count(channel));
+
+	/* The iov array stays with the request set, so the next split does not allocate. */
+	MOCK_SET(calloc, void *, NULL);
+	g_bserrno = -1;
+	spdk_bs_io_writev_blob(blob, channel, iov_many, SPDK_COUNTOF(iov_many), 250, 10,
+			       blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(req_count == bs_channel_get_req_count(channel));
 	MOCK_SET(calloc, void *, (void *)MOCK_PASS_THRU);
 
@@ -830,6 +953,111 @@ blob_rw_verify_iov_nomem(void)
 	g_bs = NULL;
 }
 
+static void
+blob_io_queued(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_bs_channel *ch;
+	struct spdk_bs_opts opts;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq[4];
+	spdk_blob_id blobid;
+	uint8_t payload_write[4096];
+	uint8_t payload_write2[4096];
+	uint8_t payload_read[4096];
+	int rc, i;
+
+	dev = init_dev();
+	spdk_bs_opts_init(&opts);
+	opts.max_channel_ops = 2;
+
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	ch = spdk_io_channel_get_ctx(channel);
+
+	spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	rc = spdk_blob_resize(blob, 1);
+	CU_ASSERT(rc == 0);
+
+	/* Hold every request set of the channel */
+	cpl.type = SPDK_BS_CPL_TYPE_NONE;
+	CU_ASSERT(bs_channel_get_req_count(channel) == 2);
+	for (i = 0; i < 2; i++) {
+		seq[i] = spdk_bs_sequence_start(channel, &cpl);
+		SPDK_CU_ASSERT_FATAL(seq[i] != NULL);
+	}
+
+	/* The pool grows instead of failing the I/O */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	g_bserrno = -1;
+	spdk_bs_io_write_blob(blob, channel, payload_write, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(ch->num_reqs == 4);
+	CU_ASSERT(bs_channel_get_req_count(channel) == 2);
+
+	for (i = 2; i < 4; i++) {
+		seq[i] = spdk_bs_sequence_start(channel, &cpl);
+		SPDK_CU_ASSERT_FATAL(seq[i] != NULL);
+	}
+
+	/* When the pool cannot grow, the I/O waits for a request set */
+	MOCK_SET(calloc, void *, NULL);
+	memset(payload_read, 0, sizeof(payload_read));
+	g_bserrno = -1;
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(!TAILQ_EMPTY(&ch->queued_io));
+	MOCK_SET(calloc, void *, (void *)MOCK_PASS_THRU);
+
+	/* Later I/O waits behind the queued read even though the pool could grow again */
+	memset(payload_write2, 0x5A, sizeof(payload_write2));
+	spdk_bs_io_write_blob(blob, channel, payload_write2, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(ch->num_reqs == 4);
+	CU_ASSERT(TAILQ_NEXT(TAILQ_FIRST(&ch->queued_io), link) != NULL);
+
+	spdk_bs_sequence_finish(seq[0], 0);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(TAILQ_EMPTY(&ch->queued_io));
+	CU_ASSERT(memcmp(payload_write, payload_read, sizeof(payload_write)) == 0);
+
+	g_bserrno = -1;
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write2, payload_read, sizeof(payload_write2)) == 0);
+
+	for (i = 1; i < 4; i++) {
+		spdk_bs_sequence_finish(seq[i], 0);
+	}
+	CU_ASSERT(bs_channel_get_req_count(channel) == 4);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_free_io_channel(channel);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
 static void
 blob_rw_iov_read_only(void)
 {
@@ -1786,7 +2014,7 @@ blob_dirty_shutdown(void)
 	int rc;
 	int index;
 	struct spdk_bs_dev *dev;
-	spdk_blob_id blobid1, blobid2, blobid3;
+	spdk_blob_id blobid1, blobid2, blobid3, blobid4;
 	struct spdk_blob *blob;
 	uint64_t length;
 	const void *value;
@@ -1794,6 +2022,11 @@ blob_dirty_shutdown(void)
 	uint32_t page_num;
 	struct spdk_blob_md_page *page;
 	struct spdk_bs_opts opts;
+	char xattr_name[32];
+	char xattr_value[100];
+	uint64_t free_clusters;
+	uint64_t num_md_pages;
+	uint32_t chain_page;
 
 	dev = init_dev();
 	spdk_bs_opts_init(&opts);
@@ -2047,6 +2280,62 @@ blob_dirty_shutdown(void)
 	g_blob = NULL;
 	g_blobid = SPDK_BLOBID_INVALID;
 
+	/* Create a blob whose cluster map is on the last page of a metadata chain */
+	spdk_bs_create_blob(g_bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid4 = g_blobid;
+
+	spdk_bs_open_blob(g_bs, blobid4, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	memset(xattr_value, 0x5A, sizeof(xattr_value));
+	for (index = 0; index < 100; index++) {
+		snprintf(xattr_name, sizeof(xattr_name), "xattr_%d", index);
+		rc = spdk_blob_set_xattr(blob, xattr_name, xattr_value, sizeof(xattr_value));
+		CU_ASSERT(rc == 0);
+	}
+	rc = spdk_blob_resize(blob, 5);
+	CU_ASSERT(rc == 0);
+
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	num_md_pages = __blob_to_data(blob)->active.num_pages;
+	CU_ASSERT(num_md_pages > 2);
+	chain_page = __blob_to_data(blob)->active.pages[num_md_pages - 1];
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+	free_clusters = spdk_bs_free_cluster_count(g_bs);
+
+	/* Dirty shutdown */
+	_spdk_bs_free(g_bs);
+	/* reload the blobstore */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts);
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* The whole chain was replayed, including the clusters on its last page */
+	CU_ASSERT(spdk_bs_free_cluster_count(g_bs) == free_clusters);
+	CU_ASSERT(spdk_bit_array_get(g_bs->used_md_pages, chain_page));
+
+	spdk_bs_open_blob(g_bs, blobid4, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
 	spdk_bs_unload(g_bs, bs_op_complete, NULL);
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
@@ -2265,6 +2554,860 @@ bs_version(void)
 	CU_ASSERT(super->used_blobid_mask_len == 0);
 }
 
+static void
+blob_thin_provision(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid;
+	uint64_t free_clusters, cluster_num;
+	uint8_t payload_read[10 * 4096];
+	uint8_t payload_write[10 * 4096];
+	struct iovec iov_read[2];
+	struct iovec iov_write[2];
+	uint8_t zero[10 * 4096];
+
+	dev = init_dev();
+	memset(g_dev_buffer, 0, DEV_BUFFER_SIZE);
+	memset(zero, 0, sizeof(zero));
+
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	/* Creating a thin provisioned blob does not claim any clusters */
+	spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+
+	g_bserrno = -1;
+	g_blobid = SPDK_BLOBID_INVALID;
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	blobid = g_blobid;
+
+	g_blob = NULL;
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == true);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	/* Unallocated clusters read back as zeroes */
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	spdk_bs_io_read_blob(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, sizeof(payload_read)) == 0);
+
+	/* Fill the cluster that will be allocated next with stale data */
+	cluster_num = spdk_bit_array_find_first_clear(bs->used_clusters, 0);
+	memset(&g_dev_buffer[cluster_num * bs->cluster_sz], 0xCC, bs->cluster_sz);
+
+	/* The first write to a cluster allocates it */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_bs_io_write_blob(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 1);
+	CU_ASSERT(__blob_to_data(blob)->active.clusters[0] == _spdk_bs_cluster_to_lba(bs, cluster_num));
+	CU_ASSERT(__blob_to_data(blob)->state == SPDK_BLOB_STATE_DIRTY);
+
+	spdk_bs_io_read_blob(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, sizeof(payload_write)) == 0);
+
+	/* The rest of the new cluster was zeroed */
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, 4096) == 0);
+
+	/* Writes queued behind an allocation on the same channel allocate each cluster once */
+	g_scheduler_delay = true;
+	spdk_bs_io_write_blob(blob, channel, payload_write, 256 + 0, 1, blob_op_complete, NULL);
+	spdk_bs_io_write_blob(blob, channel, payload_write, 256 + 1, 1, blob_op_complete, NULL);
+	_bs_flush_scheduler();
+	g_scheduler_delay = false;
+	_bs_flush_scheduler();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2);
+
+	/* A vectored write across a cluster boundary allocates both clusters */
+	iov_write[0].iov_base = payload_write;
+	iov_write[0].iov_len = 4 * 4096;
+	iov_write[1].iov_base = payload_write + 4 * 4096;
+	iov_write[1].iov_len = 6 * 4096;
+	spdk_bs_io_writev_blob(blob, channel, iov_write, 2, 3 * 256 - 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 4 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 4);
+
+	/* A vectored read of an unallocated cluster returns zeroes */
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	iov_read[0].iov_base = payload_read;
+	iov_read[0].iov_len = 4 * 4096;
+	iov_read[1].iov_base = payload_read + 4 * 4096;
+	iov_read[1].iov_len = 6 * 4096;
+	spdk_bs_io_readv_blob(blob, channel, iov_read, 2, 4 * 256 + 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, sizeof(payload_read)) == 0);
+
+	/* Flushing the blob persists the cluster map */
+	g_bserrno = -1;
+	spdk_bs_io_flush_blob(blob, channel, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(__blob_to_data(blob)->state == SPDK_BLOB_STATE_CLEAN);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_free_io_channel(channel);
+
+	/* The allocated clusters survive a reload */
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	CU_ASSERT(free_clusters - 4 == spdk_bs_free_cluster_count(bs));
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == true);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 4);
+
+	spdk_bs_io_read_blob(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, sizeof(payload_write)) == 0);
+
+	/* Shrinking releases only the clusters that were allocated */
+	spdk_blob_resize(blob, 1);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_delete_blob(bs, blobid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	spdk_bs_free_io_channel(channel);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_cluster_placement(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob[2];
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid[2];
+	uint64_t io_units_per_cluster;
+	uint64_t *clusters;
+	uint8_t payload[4096];
+	int i, j;
+
+	dev = init_dev();
+
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+
+	for (i = 0; i < 2; i++) {
+		spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+		blobid[i] = g_blobid;
+
+		spdk_bs_open_blob(bs, blobid[i], blob_op_with_handle_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+		blob[i] = g_blob;
+	}
+	io_units_per_cluster = bs->cluster_sz / spdk_bs_get_io_unit_size(bs);
+
+	/* Write both blobs one cluster at a time, taking turns */
+	memset(payload, 0x5A, sizeof(payload));
+	for (j = 0; j < 4; j++) {
+		for (i = 0; i < 2; i++) {
+			spdk_bs_io_write_blob(blob[i], channel, payload, j * io_units_per_cluster, 1,
+					      blob_op_complete, NULL);
+			CU_ASSERT(g_bserrno == 0);
+		}
+	}
+
+	/* Each blob still got a contiguous run of clusters */
+	for (i = 0; i < 2; i++) {
+		clusters = __blob_to_data(blob[i])->active.clusters;
+		for (j = 1; j < 4; j++) {
+			CU_ASSERT(clusters[j] == clusters[0] + j * _spdk_bs_cluster_to_lba(bs, 1));
+		}
+	}
+	CU_ASSERT(__blob_to_data(blob[0])->active.clusters[0] != __blob_to_data(blob[1])->active.clusters[0]);
+
+	for (i = 0; i < 2; i++) {
+		spdk_blob_close(blob[i], blob_op_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+		spdk_bs_delete_blob(bs, blobid[i], blob_op_complete, NULL);
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	spdk_bs_free_io_channel(channel);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_fsck(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_bs_fsck_report report;
+	spdk_blob_id blobid;
+	uint64_t data_cluster, free_cluster, free_page;
+	uint32_t num_md_pages, chain_page;
+	char xattr_name[32];
+	char xattr_value[100];
+	int index, rc;
+
+	dev = init_dev();
+
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	/* One blob with a single page of metadata */
+	spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	rc = spdk_blob_resize(blob, 5);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	data_cluster = _spdk_bs_lba_to_cluster(bs, __blob_to_data(blob)->active.clusters[0]);
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* And one with a chain of pages */
+	spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	memset(xattr_value, 0x5A, sizeof(xattr_value));
+	for (index = 0; index < 100; index++) {
+		snprintf(xattr_name, sizeof(xattr_name), "xattr_%d", index);
+		rc = spdk_blob_set_xattr(blob, xattr_name, xattr_value, sizeof(xattr_value));
+		CU_ASSERT(rc == 0);
+	}
+	rc = spdk_blob_resize(blob, 2);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	num_md_pages = __blob_to_data(blob)->active.num_pages;
+	CU_ASSERT(num_md_pages > 2);
+	chain_page = __blob_to_data(blob)->active.pages[num_md_pages - 1];
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_blob = NULL;
+
+	/* A consistent blobstore */
+	spdk_bs_fsck(bs, &report, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(report.num_blobs == 2);
+	CU_ASSERT(report.num_md_pages == 1 + num_md_pages);
+	CU_ASSERT(report.num_clusters == 7);
+	CU_ASSERT(report.orphan_md_pages == 0);
+	CU_ASSERT(report.unmarked_md_pages == 0);
+	CU_ASSERT(report.crc_md_pages == 0);
+	CU_ASSERT(report.invalid_md_pages == 0);
+	CU_ASSERT(report.orphan_blobids == 0);
+	CU_ASSERT(report.unmarked_blobids == 0);
+	CU_ASSERT(report.leaked_clusters == 0);
+	CU_ASSERT(report.unmarked_clusters == 0);
+	CU_ASSERT(report.shared_clusters == 0);
+
+	/* Masks out of step with the metadata */
+	free_cluster = spdk_bit_array_find_first_clear(bs->used_clusters, 0);
+	free_page = spdk_bit_array_find_first_clear(bs->used_md_pages, 0);
+	spdk_bit_array_clear(bs->used_clusters, data_cluster);
+	spdk_bit_array_set(bs->used_clusters, free_cluster);
+	spdk_bit_array_set(bs->used_md_pages, free_page);
+	spdk_bit_array_set(bs->used_blobids, free_page);
+
+	spdk_bs_fsck(bs, &report, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(report.num_blobs == 2);
+	CU_ASSERT(report.unmarked_clusters == 1);
+	CU_ASSERT(report.leaked_clusters == 1);
+	CU_ASSERT(report.orphan_md_pages == 1);
+	CU_ASSERT(report.orphan_blobids == 1);
+	CU_ASSERT(report.unmarked_md_pages == 0);
+
+	spdk_bit_array_set(bs->used_clusters, data_cluster);
+	spdk_bit_array_clear(bs->used_clusters, free_cluster);
+	spdk_bit_array_clear(bs->used_md_pages, free_page);
+	spdk_bit_array_clear(bs->used_blobids, free_page);
+
+	/* A corrupted page ends the chain, leaving its clusters leaked */
+	g_dev_buffer[(bs->md_start + chain_page) * SPDK_BS_PAGE_SIZE + 100] ^= 0xFF;
+
+	spdk_bs_fsck(bs, &report, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(report.num_blobs == 2);
+	CU_ASSERT(report.num_md_pages == num_md_pages);
+	CU_ASSERT(report.crc_md_pages == 1);
+	CU_ASSERT(report.orphan_md_pages == 1);
+	CU_ASSERT(report.leaked_clusters == 2);
+	CU_ASSERT(report.unmarked_clusters == 0);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_snapshot_clone(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob, *snapshot;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid, snapshotid, snapshotid2, cloneid;
+	uint64_t free_clusters;
+	uint8_t payload_read[4096];
+	uint8_t payload_a[4096];
+	uint8_t payload_b[4096];
+	uint8_t zero[4096];
+
+	dev = init_dev();
+	memset(g_dev_buffer, 0, DEV_BUFFER_SIZE);
+	memset(payload_a, 0xAA, sizeof(payload_a));
+	memset(payload_b, 0xBB, sizeof(payload_b));
+	memset(zero, 0, sizeof(zero));
+
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	spdk_blob_opts_init(&opts);
+	opts.num_clusters = 2;
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	spdk_bs_io_write_blob(blob, channel, payload_a, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_io_write_blob(blob, channel, payload_a, 256, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Taking a snapshot only writes metadata; the clusters move to the snapshot */
+	g_blobid = SPDK_BLOBID_INVALID;
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_is_clone(blob) == true);
+	CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == true);
+	CU_ASSERT(spdk_blob_get_parent_snapshot(blob) == snapshotid);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+	CU_ASSERT(spdk_blob_is_snapshot(snapshot) == true);
+	CU_ASSERT(spdk_blob_get_num_clones(snapshot) == 1);
+	CU_ASSERT(spdk_blob_resize(snapshot, 4) == -EPERM);
+	spdk_bs_io_write_blob(snapshot, channel, payload_b, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -EPERM);
+
+	/* Unwritten clusters of the blob read from the snapshot */
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_a, sizeof(payload_read)) == 0);
+
+	/* The first write copies the cluster and leaves the snapshot untouched */
+	spdk_bs_io_write_blob(blob, channel, payload_b, 1, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 3 == spdk_bs_free_cluster_count(bs));
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_a, sizeof(payload_read)) == 0);
+	spdk_bs_io_read_blob(blob, channel, payload_read, 1, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_b, sizeof(payload_read)) == 0);
+	spdk_bs_io_read_blob(snapshot, channel, payload_read, 1, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, sizeof(payload_read)) == 0);
+
+	/* A clone shares everything with the snapshot */
+	g_blobid = SPDK_BLOBID_INVALID;
+	spdk_bs_create_clone(bs, snapshotid, NULL, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	cloneid = g_blobid;
+	CU_ASSERT(spdk_blob_get_num_clones(snapshot) == 2);
+	CU_ASSERT(free_clusters - 3 == spdk_bs_free_cluster_count(bs));
+
+	/* Only snapshots can be cloned */
+	spdk_bs_create_clone(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == -EINVAL);
+
+	/* A snapshot with clones cannot be deleted */
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -EBUSY);
+
+	/* Snapshot of a clone: the chain is blob -> snapshot2 -> snapshot */
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid2 = g_blobid;
+	CU_ASSERT(spdk_blob_get_parent_snapshot(blob) == snapshotid2);
+	spdk_bs_io_read_blob(blob, channel, payload_read, 256, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_a, sizeof(payload_read)) == 0);
+
+	/* Decoupling copies only what snapshot2 holds and reparents to its snapshot */
+	spdk_bs_blob_decouple_parent(bs, channel, blobid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_parent_snapshot(blob) == snapshotid);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 1);
+	spdk_bs_delete_blob(bs, snapshotid2, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 3 == spdk_bs_free_cluster_count(bs));
+
+	/* Inflating allocates the remaining clusters and drops the parent */
+	spdk_bs_inflate_blob(bs, channel, blobid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_is_clone(blob) == false);
+	CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == false);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2);
+	spdk_bs_io_read_blob(blob, channel, payload_read, 256, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_a, sizeof(payload_read)) == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_free_io_channel(channel);
+
+	/* The chain survives a reload */
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	spdk_bs_open_blob(bs, cloneid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	CU_ASSERT(spdk_blob_get_parent_snapshot(g_blob) == snapshotid);
+	spdk_blob_close(g_blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	CU_ASSERT(spdk_blob_is_snapshot(g_blob) == true);
+	CU_ASSERT(spdk_blob_get_num_clones(g_blob) == 1);
+	spdk_blob_close(g_blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Once the last clone is gone the snapshot can be deleted */
+	spdk_bs_delete_blob(bs, cloneid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_delete_blob(bs, blobid, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_io_unit(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid;
+	uint64_t io_units_per_cluster;
+	uint8_t payload_read[4 * 4096];
+	uint8_t payload_write[4 * 4096];
+	uint8_t zero[4 * 4096];
+	struct iovec iov_read[2];
+	struct iovec iov_write[2];
+
+	/* Blob I/O is addressed in blocks of the backing device */
+	dev = init_dev();
+	dev->blocklen = 512;
+	dev->blockcnt = DEV_BUFFER_SIZE / dev->blocklen;
+	memset(g_dev_buffer, 0, DEV_BUFFER_SIZE);
+	memset(zero, 0, sizeof(zero));
+
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	CU_ASSERT(spdk_bs_get_io_unit_size(bs) == 512);
+	CU_ASSERT(spdk_bs_get_page_size(bs) == SPDK_BS_PAGE_SIZE);
+	io_units_per_cluster = spdk_bs_get_cluster_size(bs) / 512;
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 2;
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_io_units(blob) == 2 * io_units_per_cluster);
+
+	/* A single 512 byte write leaves its neighbours alone */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_bs_io_write_blob(blob, channel, payload_write, 3, 1, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 1);
+
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	spdk_bs_io_read_blob(blob, channel, payload_read, 0, 8, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, 3 * 512) == 0);
+	CU_ASSERT(memcmp(payload_read + 3 * 512, payload_write, 512) == 0);
+	CU_ASSERT(memcmp(payload_read + 4 * 512, zero, 4 * 512) == 0);
+
+	/* Vectored I/O split at a cluster boundary that is not page aligned in the request */
+	iov_write[0].iov_base = payload_write;
+	iov_write[0].iov_len = 3 * 512;
+	iov_write[1].iov_base = payload_write + 3 * 512;
+	iov_write[1].iov_len = 4 * 512;
+	spdk_bs_io_writev_blob(blob, channel, iov_write, 2, io_units_per_cluster - 5, 7,
+			       blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2);
+
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	iov_read[0].iov_base = payload_read;
+	iov_read[0].iov_len = 1 * 512;
+	iov_read[1].iov_base = payload_read + 1 * 512;
+	iov_read[1].iov_len = 8 * 512;
+	spdk_bs_io_readv_blob(blob, channel, iov_read, 2, io_units_per_cluster - 6, 9,
+			      blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, zero, 512) == 0);
+	CU_ASSERT(memcmp(payload_read + 512, payload_write, 7 * 512) == 0);
+	CU_ASSERT(memcmp(payload_read + 8 * 512, zero, 512) == 0);
+
+	/* I/O past the end of the blob is rejected */
+	spdk_bs_io_read_blob(blob, channel, payload_read, 2 * io_units_per_cluster - 1, 2,
+			     blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -EINVAL);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_free_io_channel(channel);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_md_commit(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_blob_data *blob_data;
+	spdk_blob_id blobid;
+	struct spdk_bs_opts opts;
+	char name[32];
+	char value[100];
+	const void *read_value;
+	size_t read_len;
+	uint64_t ios, pages, num_pages, old_page;
+	int rc, i;
+
+	dev = init_dev();
+	spdk_bs_opts_init(&opts);
+
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	blob_data = __blob_to_data(blob);
+
+	/* Enough xattrs to need several metadata pages */
+	memset(value, 0xA5, sizeof(value));
+	for (i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "xattr_%d", i);
+		rc = spdk_blob_set_xattr(blob, name, value, sizeof(value));
+		CU_ASSERT(rc == 0);
+	}
+
+	ios = bs->md_commit_ios;
+	pages = bs->md_commit_pages;
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	num_pages = blob_data->active.num_pages;
+	CU_ASSERT(num_pages > 2);
+	CU_ASSERT(bs->md_commit_pages - pages == num_pages);
+	/* The contiguous chain is written with one I/O, then the root page */
+	CU_ASSERT(bs->md_commit_ios - ios == 2);
+
+	/* The new chain goes to new pages, and the old ones are freed */
+	old_page = blob_data->active.pages[1];
+	rc = spdk_blob_set_xattr(blob, "xattr_0", "new", 4);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blob_data->active.pages[1] != old_page);
+	CU_ASSERT(!spdk_bit_array_get(bs->used_md_pages, old_page));
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	/* Load the blob store and check that the metadata made it to disk */
+	dev = init_dev();
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	rc = spdk_blob_get_xattr_value(blob, "xattr_0", &read_value, &read_len);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(read_len == 4);
+	CU_ASSERT(memcmp(read_value, "new", 4) == 0);
+	rc = spdk_blob_get_xattr_value(blob, "xattr_99", &read_value, &read_len);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(read_len == sizeof(value));
+	CU_ASSERT(memcmp(read_value, value, sizeof(value)) == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_md_commit_write_fail(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_blob_data *blob_data;
+	spdk_blob_id blobid;
+	struct spdk_bs_opts opts;
+	char name[32];
+	char value[100];
+	const void *read_value;
+	size_t read_len;
+	uint32_t failed_pages[16];
+	uint32_t num_failed, page;
+	uint64_t i, j;
+	int rc;
+
+	dev = init_dev();
+	spdk_bs_opts_init(&opts);
+
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	spdk_bs_create_blob(bs, blob_op_with_id_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	blob_data = __blob_to_data(blob);
+
+	memset(value, 0xA5, sizeof(value));
+	for (i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "xattr_%d", (int)i);
+		rc = spdk_blob_set_xattr(blob, name, value, sizeof(value));
+		CU_ASSERT(rc == 0);
+	}
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	/* The chain write fails, so the root page was never written and the new pages are freed */
+	page = spdk_bit_array_find_first_clear(bs->used_md_pages, 0);
+	g_dev_write_fail_lba = _spdk_bs_page_to_lba(bs, bs->md_start + page);
+	rc = spdk_blob_set_xattr(blob, "xattr_0", "one", 4);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -EIO);
+	CU_ASSERT(!spdk_bit_array_get(bs->used_md_pages, page));
+	CU_ASSERT(blob_data->num_failed_pages == 0);
+
+	/*
+	 * The root page write fails after it reached the disk.  The root on disk points at
+	 *  the new chain, so its pages must not be handed out again.
+	 */
+	g_dev_write_fail_lba = _spdk_bs_page_to_lba(bs, bs->md_start + _spdk_bs_blobid_to_page(blobid));
+	rc = spdk_blob_set_xattr(blob, "xattr_0", "two", 4);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == -EIO);
+	num_failed = blob_data->active.num_pages - 1;
+	SPDK_CU_ASSERT_FATAL(num_failed > 0 && num_failed <= SPDK_COUNTOF(failed_pages));
+	CU_ASSERT(blob_data->num_failed_pages == num_failed);
+	for (i = 0; i < num_failed; i++) {
+		failed_pages[i] = blob_data->active.pages[i + 1];
+		CU_ASSERT(spdk_bit_array_get(bs->used_md_pages, failed_pages[i]));
+	}
+
+	/* The next successful sync writes a new chain elsewhere and then frees them */
+	g_dev_write_fail_lba = UINT64_MAX;
+	rc = spdk_blob_set_xattr(blob, "xattr_0", "three", 6);
+	CU_ASSERT(rc == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blob_data->num_failed_pages == 0);
+	for (i = 0; i < num_failed; i++) {
+		for (j = 1; j < blob_data->active.num_pages; j++) {
+			CU_ASSERT(blob_data->active.pages[j] != failed_pages[i]);
+		}
+		CU_ASSERT(!spdk_bit_array_get(bs->used_md_pages, failed_pages[i]));
+	}
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	dev = init_dev();
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+
+	spdk_bs_open_blob(g_bs, blobid, blob_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	rc = spdk_blob_get_xattr_value(blob, "xattr_0", &read_value, &read_len);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(read_len == 6);
+	CU_ASSERT(memcmp(read_value, "three", 6) == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_unload(g_bs, bs_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
@@ -2283,6 +3426,7 @@ int main(int argc, char **argv)
 	if (
 		CU_add_test(suite, "blob_init", blob_init) == NULL ||
 		CU_add_test(suite, "blob_open", blob_open) == NULL ||
+		CU_add_test(suite, "blob_open_hash", blob_open_hash) == NULL ||
 		CU_add_test(suite, "blob_create", blob_create) == NULL ||
 		CU_add_test(suite, "blob_delete", blob_delete) == NULL ||
 		CU_add_test(suite, "blob_resize", blob_resize) == NULL ||
@@ -2293,6 +3437,7 @@ int main(int argc, char **argv)
 		CU_add_test(suite, "blob_rw_verify", blob_rw_verify) == NULL ||
 		CU_add_test(suite, "blob_rw_verify_iov", blob_rw_verify_iov) == NULL ||
 		CU_add_test(suite, "blob_rw_verify_iov_nomem", blob_rw_verify_iov_nomem) == NULL ||
+		CU_add_test(suite, "blob_io_queued", blob_io_queued) == NULL ||
 		CU_add_test(suite, "blob_rw_iov_read_only", blob_rw_iov_read_only) == NULL ||
 		CU_add_test(suite, "blob_iter", blob_iter) == NULL ||
 		CU_add_test(suite, "blob_xattr", blob_xattr) == NULL ||
@@ -2309,7 +3454,14 @@ int main(int argc, char **argv)
 		CU_add_test(suite, "super_block_crc", super_block_crc) == NULL ||
 		CU_add_test(suite, "blob_dirty_shutdown", blob_dirty_shutdown) == NULL ||
 		CU_add_test(suite, "blob_flags", blob_flags) == NULL ||
-		CU_add_test(suite, "bs_version", bs_version) == NULL
+		CU_add_test(suite, "bs_version", bs_version) == NULL ||
+		CU_add_test(suite, "blob_thin_provision", blob_thin_provision) == NULL ||
+		CU_add_test(suite, "blob_cluster_placement", blob_cluster_placement) == NULL ||
+		CU_add_test(suite, "blob_fsck", blob_fsck) == NULL ||
+		CU_add_test(suite, "blob_snapshot_clone", blob_snapshot_clone) == NULL ||
+		CU_add_test(suite, "blob_io_unit", blob_io_unit) == NULL ||
+		CU_add_test(suite, "blob_md_commit", blob_md_commit) == NULL ||
+		CU_add_test(suite, "blob_md_commit_write_fail", blob_md_commit_write_fail) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
@@ -36,6 +36,9 @@
 #define DEV_BUFFER_BLOCKCNT (DEV_BUFFER_SIZE / DEV_BUFFER_BLOCKLEN)
 uint8_t *g_dev_buffer;
 
+/* A write that covers this LBA still reaches the buffer, but completes with -EIO */
+uint64_t g_dev_write_fail_lba = UINT64_MAX;
+
 /* Define here for UT only. */
 struct spdk_io_channel {
 	struct spdk_thread		*thread;
@@ -65,8 +68,8 @@ dev_read(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payload
 {
 	uint64_t offset, length;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	memcpy(payload, &g_dev_buffer[offset], length);
 	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, 0);
@@ -79,11 +82,12 @@ dev_write(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payloa
 {
 	uint64_t offset, length;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	memcpy(&g_dev_buffer[offset], payload, length);
-	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, 0);
+	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg,
+		       (g_dev_write_fail_lba >= lba && g_dev_write_fail_lba < lba + lba_count) ? -EIO : 0);
 }
 
 static void
@@ -107,8 +111,8 @@ dev_readv(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 	uint64_t offset, length;
 	int i;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	__check_iov(iov, iovcnt, length);
 
@@ -129,8 +133,8 @@ dev_writev(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 	uint64_t offset, length;
 	int i;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	__check_iov(iov, iovcnt, length);
 
@@ -139,7 +143,8 @@ dev_writev(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 		offset += iov[i].iov_len;
 	}
 
-	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, 0);
+	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg,
+		       (g_dev_write_fail_lba >= lba && g_dev_write_fail_lba < lba + lba_count) ? -EIO : 0);
 }
 
 static void
@@ -156,8 +161,8 @@ dev_unmap(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 {
 	uint64_t offset, length;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, 0);
 }
@@ -169,8 +174,8 @@ dev_write_zeroes(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 {
 	uint64_t offset, length;
 
-	offset = lba * DEV_BUFFER_BLOCKLEN;
-	length = lba_count * DEV_BUFFER_BLOCKLEN;
+	offset = lba * dev->blocklen;
+	length = lba_count * dev->blocklen;
 	SPDK_CU_ASSERT_FATAL(offset + length <= DEV_BUFFER_SIZE);
 	memset(&g_dev_buffer[offset], 0, length);
 	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, 0);
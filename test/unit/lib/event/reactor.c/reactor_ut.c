@@ -0,0 +1,324 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+#include "spdk_internal/mock.h"
+
+#include "lib/test_env.c"
+#include "reactor.c"
+
+#define UT_NUM_CORES	2
+
+static uint32_t g_ut_core;
+
+uint32_t
+spdk_env_get_current_core(void)
+{
+	return g_ut_core;
+}
+
+uint32_t
+spdk_env_get_first_core(void)
+{
+	return 0;
+}
+
+uint32_t
+spdk_env_get_last_core(void)
+{
+	return UT_NUM_CORES - 1;
+}
+
+uint32_t
+spdk_env_get_next_core(uint32_t prev_core)
+{
+	return prev_core + 1 < UT_NUM_CORES ? prev_core + 1 : UINT32_MAX;
+}
+
+uint32_t
+spdk_env_get_socket_id(uint32_t core)
+{
+	return 0;
+}
+
+DEFINE_STUB(spdk_env_thread_launch_pinned, int, (uint32_t core, thread_start_fn fn, void *arg), 0);
+DEFINE_STUB_V(spdk_env_thread_wait_all, (void));
+
+void
+spdk_mempool_put_bulk(struct spdk_mempool *mp, void *const *ele_arr, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		spdk_mempool_put(mp, ele_arr[i]);
+	}
+}
+
+#define UT_RING_SIZE	64
+
+struct spdk_ring {
+	void	*ents[UT_RING_SIZE];
+	size_t	head;
+	size_t	count;
+};
+
+struct spdk_ring *
+spdk_ring_create(enum spdk_ring_type type, size_t count, int socket_id)
+{
+	return calloc(1, sizeof(struct spdk_ring));
+}
+
+void
+spdk_ring_free(struct spdk_ring *ring)
+{
+	free(ring);
+}
+
+size_t
+spdk_ring_count(struct spdk_ring *ring)
+{
+	return ring->count;
+}
+
+size_t
+spdk_ring_enqueue(struct spdk_ring *ring, void **objs, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count && ring->count < UT_RING_SIZE; i++) {
+		ring->ents[(ring->head + ring->count++) % UT_RING_SIZE] = objs[i];
+	}
+
+	return i;
+}
+
+size_t
+spdk_ring_dequeue(struct spdk_ring *ring, void **objs, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count && ring->count > 0; i++) {
+		objs[i] = ring->ents[ring->head];
+		ring->head = (ring->head + 1) % UT_RING_SIZE;
+		ring->count--;
+	}
+
+	return i;
+}
+
+/* One iteration of _spdk_reactor_run() on lcore, without the timers and sleeping */
+static void
+ut_reactor_poll(uint32_t lcore)
+{
+	struct spdk_reactor *reactor = spdk_reactor_get(lcore);
+	struct spdk_reactor_thread *rthread, *tmp;
+	bool busy = false;
+
+	g_ut_core = lcore;
+	_spdk_event_queue_run_batch(reactor);
+
+	TAILQ_FOREACH_SAFE(rthread, &reactor->threads, link, tmp) {
+		if (rthread == reactor->default_thread) {
+			continue;
+		}
+		_spdk_reactor_thread_poll(reactor, rthread, false, &busy);
+		_spdk_reactor_thread_yield(reactor, rthread);
+	}
+
+	reactor->current_thread = reactor->default_thread;
+	spdk_set_thread(NULL);
+}
+
+static struct spdk_reactor_thread *
+ut_find_thread(uint32_t lcore, struct spdk_thread *thread)
+{
+	struct spdk_reactor_thread *rthread;
+
+	TAILQ_FOREACH(rthread, &spdk_reactor_get(lcore)->threads, link) {
+		if (rthread->thread == thread) {
+			return rthread;
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t g_msg_core;
+static int g_msg_count;
+
+static void
+ut_record_msg(void *ctx)
+{
+	g_msg_core = spdk_env_get_current_core();
+	g_msg_count++;
+}
+
+static void
+ut_exit_thread_msg(void *ctx)
+{
+	spdk_reactor_exit_thread();
+}
+
+static int
+ut_reactors_init(void)
+{
+	return spdk_reactors_init(0, false);
+}
+
+static int
+ut_reactors_fini(void)
+{
+	spdk_reactors_fini();
+	return 0;
+}
+
+static void
+thread_move(void)
+{
+	struct spdk_thread *thread;
+	struct spdk_reactor_thread *rthread;
+
+	thread = spdk_reactor_create_thread("ut_move", 0);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	CU_ASSERT(ut_find_thread(0, thread) == NULL);
+	ut_reactor_poll(0);
+	rthread = ut_find_thread(0, thread);
+	SPDK_CU_ASSERT_FATAL(rthread != NULL);
+
+	g_msg_count = 0;
+	spdk_thread_send_msg(thread, ut_record_msg, NULL);
+	ut_reactor_poll(0);
+	CU_ASSERT(g_msg_count == 1);
+	CU_ASSERT(g_msg_core == 0);
+
+	CU_ASSERT(spdk_reactor_move_thread(thread, UT_NUM_CORES) == -EINVAL);
+	CU_ASSERT(spdk_reactor_move_thread(thread, 1) == 0);
+
+	/* The move is a message, so the thread leaves once it has run it */
+	ut_reactor_poll(0);
+	CU_ASSERT(ut_find_thread(0, thread) == NULL);
+	CU_ASSERT(rthread->reactor == spdk_reactor_get(1));
+
+	/* Messages sent while the thread is between reactors run on the new one */
+	spdk_thread_send_msg(thread, ut_record_msg, NULL);
+	CU_ASSERT(rthread->num_msgs == 1);
+	ut_reactor_poll(1);
+	CU_ASSERT(ut_find_thread(1, thread) == rthread);
+	CU_ASSERT(g_msg_count == 2);
+	CU_ASSERT(g_msg_core == 1);
+	CU_ASSERT(rthread->num_msgs == 0);
+
+	/* Moving to the current reactor is a no-op */
+	CU_ASSERT(spdk_reactor_move_thread(thread, 1) == 0);
+	ut_reactor_poll(1);
+	CU_ASSERT(ut_find_thread(1, thread) == rthread);
+	CU_ASSERT(rthread->move_lcore == SPDK_REACTOR_THREAD_NO_MOVE);
+
+	spdk_thread_send_msg(thread, ut_exit_thread_msg, NULL);
+	ut_reactor_poll(1);
+	CU_ASSERT(ut_find_thread(1, thread) == NULL);
+}
+
+static struct spdk_thread *g_exit_thread;
+
+static void
+ut_exit_msg(void *ctx)
+{
+	spdk_reactor_exit_thread();
+	/* Sent after the exit request, but still run before the thread goes away */
+	spdk_thread_send_msg(g_exit_thread, ut_record_msg, NULL);
+}
+
+static void
+thread_exit(void)
+{
+	struct spdk_reactor *reactor = spdk_reactor_get(0);
+
+	g_exit_thread = spdk_reactor_create_thread("ut_exit", 0);
+	SPDK_CU_ASSERT_FATAL(g_exit_thread != NULL);
+	ut_reactor_poll(0);
+	SPDK_CU_ASSERT_FATAL(ut_find_thread(0, g_exit_thread) != NULL);
+
+	/* The default thread of a reactor cannot exit */
+	reactor->current_thread = reactor->default_thread;
+	spdk_reactor_exit_thread();
+	CU_ASSERT(!reactor->default_thread->exiting);
+
+	g_msg_count = 0;
+	spdk_thread_send_msg(g_exit_thread, ut_exit_msg, NULL);
+	ut_reactor_poll(0);
+	CU_ASSERT(ut_find_thread(0, g_exit_thread) != NULL);
+	CU_ASSERT(g_msg_count == 0);
+
+	ut_reactor_poll(0);
+	CU_ASSERT(g_msg_count == 1);
+	CU_ASSERT(ut_find_thread(0, g_exit_thread) == NULL);
+	CU_ASSERT(TAILQ_FIRST(&reactor->threads) == reactor->default_thread);
+	CU_ASSERT(TAILQ_NEXT(reactor->default_thread, link) == NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("reactor", ut_reactors_init, ut_reactors_fini);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "thread_move", thread_move) == NULL ||
+		CU_add_test(suite, "thread_exit", thread_exit) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+
+	CU_basic_run_tests();
+
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return num_failures;
+}
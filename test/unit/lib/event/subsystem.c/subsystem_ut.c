@@ -53,9 +53,24 @@ spdk_env_get_current_core(void)
 	return 0;
 }
 
+uint64_t
+spdk_get_ticks(void)
+{
+	return 0;
+}
+
+uint64_t
+spdk_get_ticks_hz(void)
+{
+	return 1000000;
+}
+
+static bool g_app_started;
+
 static void
 ut_event_fn(void *arg1, void *arg2)
 {
+	g_app_started = true;
 }
 
 struct spdk_event *
@@ -85,6 +100,8 @@ set_up_subsystem(struct spdk_subsystem *subsystem, const char *name)
 	subsystem->fini = NULL;
 	subsystem->config = NULL;
 	subsystem->name = name;
+	subsystem->init_started = false;
+	subsystem->init_done = false;
 }
 
 static void
@@ -246,6 +263,155 @@ subsystem_sort_test_missing_dependency(void)
 
 }
 
+static int g_ut_init_calls;
+
+static void
+ut_init_async(void)
+{
+	/* Completes later through spdk_subsystem_init_done(). */
+	g_ut_init_calls++;
+}
+
+static void
+ut_init_sync_b(void)
+{
+	g_ut_init_calls++;
+	spdk_subsystem_init_done(&g_ut_subsystems[1], 0);
+}
+
+static void
+ut_init_sync_c(void)
+{
+	g_ut_init_calls++;
+	spdk_subsystem_init_done(&g_ut_subsystems[2], 0);
+}
+
+static void
+subsystem_init_concurrent(void)
+{
+	struct spdk_event *app_start_event;
+
+	/*
+	 * B depends on A, which initializes asynchronously.  C depends on nothing, so it
+	 *  should be initialized while A is still in progress.
+	 */
+	subsystem_clear();
+	set_up_subsystem(&g_ut_subsystems[0], "A");
+	g_ut_subsystems[0].init = ut_init_async;
+	set_up_subsystem(&g_ut_subsystems[1], "B");
+	g_ut_subsystems[1].init = ut_init_sync_b;
+	set_up_subsystem(&g_ut_subsystems[2], "C");
+	g_ut_subsystems[2].init = ut_init_sync_c;
+	spdk_add_subsystem(&g_ut_subsystems[0]);
+	spdk_add_subsystem(&g_ut_subsystems[1]);
+	spdk_add_subsystem(&g_ut_subsystems[2]);
+
+	set_up_depends(&g_ut_subsystem_deps[0], "B", "A");
+	spdk_add_subsystem_depend(&g_ut_subsystem_deps[0]);
+
+	g_subsystems_initialized = false;
+	g_app_started = false;
+	g_ut_init_calls = 0;
+	app_start_event = spdk_event_allocate(0, ut_event_fn, NULL, NULL);
+	spdk_subsystem_init(app_start_event);
+
+	CU_ASSERT(g_ut_init_calls == 2);
+	CU_ASSERT(g_ut_subsystems[0].init_started && !g_ut_subsystems[0].init_done);
+	CU_ASSERT(!g_ut_subsystems[1].init_started);
+	CU_ASSERT(g_ut_subsystems[2].init_done);
+	CU_ASSERT(!g_app_started);
+
+	spdk_subsystem_init_done(&g_ut_subsystems[0], 0);
+	CU_ASSERT(g_ut_init_calls == 3);
+	CU_ASSERT(g_ut_subsystems[1].init_done);
+	CU_ASSERT(g_app_started);
+}
+
+static void
+subsystem_init_async_out_of_order(void)
+{
+	struct spdk_event *app_start_event;
+
+	/*
+	 * A and B are independent and both initialize asynchronously, so both are in
+	 *  flight at once.  C depends on both.  B finishing first must not be mistaken
+	 *  for A finishing.
+	 */
+	subsystem_clear();
+	set_up_subsystem(&g_ut_subsystems[0], "A");
+	g_ut_subsystems[0].init = ut_init_async;
+	set_up_subsystem(&g_ut_subsystems[1], "B");
+	g_ut_subsystems[1].init = ut_init_async;
+	set_up_subsystem(&g_ut_subsystems[2], "C");
+	g_ut_subsystems[2].init = ut_init_sync_c;
+	spdk_add_subsystem(&g_ut_subsystems[0]);
+	spdk_add_subsystem(&g_ut_subsystems[1]);
+	spdk_add_subsystem(&g_ut_subsystems[2]);
+
+	set_up_depends(&g_ut_subsystem_deps[0], "C", "A");
+	spdk_add_subsystem_depend(&g_ut_subsystem_deps[0]);
+	set_up_depends(&g_ut_subsystem_deps[1], "C", "B");
+	spdk_add_subsystem_depend(&g_ut_subsystem_deps[1]);
+
+	g_subsystems_initialized = false;
+	g_init_failed = false;
+	g_app_started = false;
+	g_ut_init_calls = 0;
+	global_rc = 0;
+	app_start_event = spdk_event_allocate(0, ut_event_fn, NULL, NULL);
+	spdk_subsystem_init(app_start_event);
+
+	CU_ASSERT(g_ut_init_calls == 2);
+	CU_ASSERT(g_ut_subsystems[0].init_started && !g_ut_subsystems[0].init_done);
+	CU_ASSERT(g_ut_subsystems[1].init_started && !g_ut_subsystems[1].init_done);
+	CU_ASSERT(!g_ut_subsystems[2].init_started);
+
+	spdk_subsystem_init_done(&g_ut_subsystems[1], 0);
+	CU_ASSERT(g_ut_subsystems[1].init_done);
+	CU_ASSERT(!g_ut_subsystems[0].init_done);
+	CU_ASSERT(!g_ut_subsystems[2].init_started);
+	CU_ASSERT(!g_app_started);
+
+	spdk_subsystem_init_done(&g_ut_subsystems[0], 0);
+	CU_ASSERT(g_ut_init_calls == 3);
+	CU_ASSERT(g_ut_subsystems[2].init_done);
+	CU_ASSERT(g_app_started);
+	CU_ASSERT(global_rc == 0);
+
+	/*
+	 * Same layout, but A fails after B has finished.  C must not be started and the
+	 *  app must be stopped with A's error.
+	 */
+	subsystem_clear();
+	set_up_subsystem(&g_ut_subsystems[0], "A");
+	g_ut_subsystems[0].init = ut_init_async;
+	set_up_subsystem(&g_ut_subsystems[1], "B");
+	g_ut_subsystems[1].init = ut_init_async;
+	set_up_subsystem(&g_ut_subsystems[2], "C");
+	g_ut_subsystems[2].init = ut_init_sync_c;
+	spdk_add_subsystem(&g_ut_subsystems[0]);
+	spdk_add_subsystem(&g_ut_subsystems[1]);
+	spdk_add_subsystem(&g_ut_subsystems[2]);
+	spdk_add_subsystem_depend(&g_ut_subsystem_deps[0]);
+	spdk_add_subsystem_depend(&g_ut_subsystem_deps[1]);
+
+	g_subsystems_initialized = false;
+	g_init_failed = false;
+	g_app_started = false;
+	g_ut_init_calls = 0;
+	global_rc = 0;
+	app_start_event = spdk_event_allocate(0, ut_event_fn, NULL, NULL);
+	spdk_subsystem_init(app_start_event);
+
+	spdk_subsystem_init_done(&g_ut_subsystems[1], 0);
+	spdk_subsystem_init_done(&g_ut_subsystems[0], -EIO);
+	CU_ASSERT(global_rc == -EIO);
+	CU_ASSERT(!g_ut_subsystems[0].init_done);
+	CU_ASSERT(!g_ut_subsystems[2].init_started);
+	CU_ASSERT(!g_app_started);
+	free(app_start_event);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -269,6 +435,10 @@ main(int argc, char **argv)
 			       subsystem_sort_test_depends_on_multiple) == NULL
 		|| CU_add_test(suite, "subsystem_sort_test_missing_dependency",
 			       subsystem_sort_test_missing_dependency) == NULL
+		|| CU_add_test(suite, "subsystem_init_concurrent",
+			       subsystem_init_concurrent) == NULL
+		|| CU_add_test(suite, "subsystem_init_async_out_of_order",
+			       subsystem_init_async_out_of_order) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
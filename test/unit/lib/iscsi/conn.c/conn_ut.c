@@ -0,0 +1,378 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+#include "spdk_internal/mock.h"
+
+#include "iscsi/conn.c"
+
+struct spdk_iscsi_globals g_spdk_iscsi;
+
+struct spdk_event {
+	uint32_t		lcore;
+	spdk_event_fn		fn;
+	void			*arg1;
+	void			*arg2;
+	TAILQ_ENTRY(spdk_event)	tailq;
+};
+
+static TAILQ_HEAD(, spdk_event) g_events = TAILQ_HEAD_INITIALIZER(g_events);
+static uint32_t g_ut_lcore;
+
+#define UT_NUM_LCORES	4
+
+DEFINE_STUB(spdk_app_get_shm_id, int, (void), 0);
+DEFINE_STUB_V(spdk_clear_all_transfer_task, (struct spdk_iscsi_conn *conn,
+		struct spdk_scsi_lun *lun));
+DEFINE_STUB_V(spdk_del_transfer_task, (struct spdk_iscsi_conn *conn, uint32_t CmdSN));
+DEFINE_STUB_V(spdk_free_sess, (struct spdk_iscsi_sess *sess));
+DEFINE_STUB(spdk_iscsi_build_iovecs, int, (struct spdk_iscsi_conn *conn, struct iovec *iovec,
+		struct spdk_iscsi_pdu *pdu), 0);
+DEFINE_STUB(spdk_iscsi_conn_handle_queued_datain_tasks, int, (struct spdk_iscsi_conn *conn), 0);
+DEFINE_STUB(spdk_iscsi_conn_params_init, int, (struct iscsi_param **params), 0);
+DEFINE_STUB(spdk_iscsi_execute, int, (struct spdk_iscsi_conn *conn, struct spdk_iscsi_pdu *pdu),
+	    0);
+DEFINE_STUB_V(spdk_iscsi_fini_done, (void));
+DEFINE_STUB(spdk_iscsi_is_deferred_free_pdu, bool, (struct spdk_iscsi_pdu *pdu), false);
+DEFINE_STUB_V(spdk_iscsi_param_free, (struct iscsi_param *params));
+DEFINE_STUB(spdk_iscsi_read_pdu, int, (struct spdk_iscsi_conn *conn,
+				       struct spdk_iscsi_pdu **_pdu), 0);
+DEFINE_STUB(spdk_iscsi_send_nopin, int, (struct spdk_iscsi_conn *conn), 0);
+DEFINE_STUB_V(spdk_iscsi_task_mgmt_response, (struct spdk_iscsi_conn *conn,
+		struct spdk_iscsi_task *task));
+DEFINE_STUB_V(spdk_iscsi_task_response, (struct spdk_iscsi_conn *conn,
+		struct spdk_iscsi_task *task));
+DEFINE_STUB(spdk_iscsi_tgt_node_cleanup_luns, int, (struct spdk_iscsi_conn *conn,
+		struct spdk_iscsi_tgt_node *target), 0);
+DEFINE_STUB_V(spdk_net_framework_clear_socket_association, (int sock));
+DEFINE_STUB(spdk_net_framework_idle_time, int, (void), 0);
+DEFINE_STUB(spdk_poller_add_interrupt_fd, int, (struct spdk_poller *poller, int fd), 0);
+DEFINE_STUB_V(spdk_poller_remove_interrupt_fd, (struct spdk_poller *poller, int fd));
+DEFINE_STUB_V(spdk_put_pdu, (struct spdk_iscsi_pdu *pdu));
+DEFINE_STUB(spdk_reactor_register_migrate_handler, int, (spdk_reactor_migrate_fn fn, void *ctx),
+	    0);
+DEFINE_STUB_V(spdk_reactor_unregister_migrate_handler, (spdk_reactor_migrate_fn fn, void *ctx));
+DEFINE_STUB(spdk_scsi_dev_allocate_io_channels, int, (struct spdk_scsi_dev *dev), 0);
+DEFINE_STUB_V(spdk_scsi_dev_free_io_channels, (struct spdk_scsi_dev *dev));
+DEFINE_STUB(spdk_scsi_port_get_name, const char *, (const struct spdk_scsi_port *port), NULL);
+DEFINE_STUB_V(spdk_scsi_task_put, (struct spdk_scsi_task *task));
+DEFINE_STUB(spdk_sock_close, int, (int sock), 0);
+DEFINE_STUB(spdk_sock_getaddr, int, (int sock, char *saddr, int slen, char *caddr, int clen), 0);
+DEFINE_STUB(spdk_sock_recv, ssize_t, (int sock, void *buf, size_t len), 0);
+DEFINE_STUB(spdk_sock_set_recvbuf, int, (int sock, int sz), 0);
+DEFINE_STUB(spdk_sock_set_recvlowat, int, (int sock, int nbytes), 0);
+DEFINE_STUB(spdk_sock_set_sendbuf, int, (int sock, int sz), 0);
+DEFINE_STUB(spdk_sock_writev, ssize_t, (int sock, struct iovec *iov, int iovcnt), 0);
+DEFINE_STUB(spdk_get_ticks, uint64_t, (void), 0);
+DEFINE_STUB(spdk_get_ticks_hz, uint64_t, (void), 1000000);
+
+uint32_t
+spdk_env_get_current_core(void)
+{
+	return g_ut_lcore;
+}
+
+uint32_t
+spdk_env_get_first_core(void)
+{
+	return 0;
+}
+
+uint32_t
+spdk_env_get_last_core(void)
+{
+	return UT_NUM_LCORES - 1;
+}
+
+uint32_t
+spdk_env_get_next_core(uint32_t prev_core)
+{
+	return prev_core + 1 < UT_NUM_LCORES ? prev_core + 1 : UINT32_MAX;
+}
+
+struct spdk_poller *
+spdk_poller_register(spdk_poller_fn fn, void *arg, uint64_t period_microseconds)
+{
+	return (struct spdk_poller *)arg;
+}
+
+void
+spdk_poller_unregister(struct spdk_poller **ppoller)
+{
+	*ppoller = NULL;
+}
+
+struct spdk_event *
+spdk_event_allocate(uint32_t lcore, spdk_event_fn fn, void *arg1, void *arg2)
+{
+	struct spdk_event *event;
+
+	event = calloc(1, sizeof(*event));
+	SPDK_CU_ASSERT_FATAL(event != NULL);
+
+	event->lcore = lcore;
+	event->fn = fn;
+	event->arg1 = arg1;
+	event->arg2 = arg2;
+
+	return event;
+}
+
+void
+spdk_event_call(struct spdk_event *event)
+{
+	TAILQ_INSERT_TAIL(&g_events, event, tailq);
+}
+
+/* Run the queued events, each on the lcore it was sent to */
+static void
+ut_run_events(void)
+{
+	struct spdk_event *event;
+	uint32_t lcore = g_ut_lcore;
+
+	while ((event = TAILQ_FIRST(&g_events)) != NULL) {
+		TAILQ_REMOVE(&g_events, event, tailq);
+		g_ut_lcore = event->lcore;
+		event->fn(event->arg1, event->arg2);
+		free(event);
+	}
+
+	g_ut_lcore = lcore;
+}
+
+static struct spdk_iscsi_portal g_portal = { .cpumask = 0x3 };
+
+static void
+ut_target_init(struct spdk_iscsi_tgt_node *target, struct spdk_iscsi_sess *sess)
+{
+	memset(target, 0, sizeof(*target));
+	pthread_mutex_init(&target->mutex, NULL);
+
+	memset(sess, 0, sizeof(*sess));
+	sess->session_type = SESSION_TYPE_NORMAL;
+	sess->target = target;
+}
+
+/* Set up a running full feature connection on lcore 0 */
+static struct spdk_iscsi_conn *
+ut_conn_init(int id, struct spdk_iscsi_sess *sess)
+{
+	struct spdk_iscsi_conn *conn = &g_conns_array[id];
+
+	memset(conn, 0, sizeof(*conn));
+	conn->id = id;
+	conn->is_valid = 1;
+	conn->full_feature = 1;
+	conn->state = ISCSI_CONN_STATE_RUNNING;
+	conn->portal = &g_portal;
+	conn->sess = sess;
+	conn->dev = (struct spdk_scsi_dev *)0xdeadbeef;
+	conn->lcore = 0;
+	spdk_iscsi_conn_full_feature_migrate(conn, NULL);
+	TAILQ_INIT(&conn->write_pdu_list);
+	TAILQ_INIT(&conn->queued_r2t_tasks);
+	TAILQ_INIT(&conn->active_r2t_tasks);
+	TAILQ_INIT(&conn->queued_datain_tasks);
+
+	g_num_connections[0]++;
+	sess->target->num_active_conns++;
+	sess->target->lcore = 0;
+
+	return conn;
+}
+
+static int
+ut_conns_init(void)
+{
+	g_conns_array = calloc(MAX_ISCSI_CONNECTIONS, sizeof(*g_conns_array));
+	g_num_connections = calloc(UT_NUM_LCORES, sizeof(*g_num_connections));
+	if (g_conns_array == NULL || g_num_connections == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_init(&g_conns_mutex, NULL);
+
+	return 0;
+}
+
+static int
+ut_conns_fini(void)
+{
+	free(g_conns_array);
+	free(g_num_connections);
+
+	return 0;
+}
+
+static void
+ut_conns_reset(void)
+{
+	memset(g_conns_array, 0, MAX_ISCSI_CONNECTIONS * sizeof(*g_conns_array));
+	memset(g_num_connections, 0, UT_NUM_LCORES * sizeof(*g_num_connections));
+	g_portal.cpumask = 0x3;
+	g_ut_lcore = 0;
+}
+
+static void
+rebalance_moves_target(void)
+{
+	struct spdk_iscsi_tgt_node target1, target2;
+	struct spdk_iscsi_sess sess1, sess2;
+	struct spdk_iscsi_conn *conn1, *conn2, *conn3;
+
+	ut_conns_reset();
+	ut_target_init(&target1, &sess1);
+	ut_target_init(&target2, &sess2);
+	conn1 = ut_conn_init(0, &sess1);
+	conn2 = ut_conn_init(1, &sess2);
+	conn3 = ut_conn_init(2, &sess1);
+	conn2->pending_task_cnt = 1;
+
+	/* Every connection to the idle target node moves, the busy one stays */
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == 0);
+	CU_ASSERT(target1.lcore == 1);
+	CU_ASSERT(conn1->poller == NULL);
+	CU_ASSERT(conn3->poller == NULL);
+	CU_ASSERT(conn2->poller != NULL);
+	CU_ASSERT(target1.num_active_conns == 2);
+	ut_run_events();
+	CU_ASSERT(conn1->lcore == 1 && conn1->poller != NULL);
+	CU_ASSERT(conn3->lcore == 1 && conn3->poller != NULL);
+	CU_ASSERT(conn2->lcore == 0);
+	CU_ASSERT(target1.num_active_conns == 2);
+	CU_ASSERT(target2.num_active_conns == 1);
+	CU_ASSERT(g_num_connections[0] == 1);
+	CU_ASSERT(g_num_connections[1] == 2);
+
+	/* Nothing left on lcore 0 that can move */
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == -ENOENT);
+	CU_ASSERT(TAILQ_EMPTY(&g_events));
+}
+
+static void
+rebalance_outstanding_work(void)
+{
+	struct spdk_iscsi_tgt_node target;
+	struct spdk_iscsi_sess sess;
+	struct spdk_iscsi_conn *conn;
+	struct spdk_iscsi_pdu pdu = {};
+	struct spdk_iscsi_task task = {};
+
+	ut_conns_reset();
+	ut_target_init(&target, &sess);
+	conn = ut_conn_init(0, &sess);
+
+	/* A queued PDU keeps the connection in place */
+	TAILQ_INSERT_TAIL(&conn->write_pdu_list, &pdu, tailq);
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == -ENOENT);
+	TAILQ_REMOVE(&conn->write_pdu_list, &pdu, tailq);
+
+	/* So does a queued data-in task */
+	TAILQ_INSERT_TAIL(&conn->queued_datain_tasks, &task, link);
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == -ENOENT);
+	TAILQ_REMOVE(&conn->queued_datain_tasks, &task, link);
+
+	/* And data-in in flight */
+	conn->data_in_cnt = 1;
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == -ENOENT);
+	conn->data_in_cnt = 0;
+
+	CU_ASSERT(TAILQ_EMPTY(&g_events));
+	CU_ASSERT(target.lcore == 0);
+
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == 0);
+	ut_run_events();
+	CU_ASSERT(conn->lcore == 1);
+}
+
+static void
+rebalance_busy_target(void)
+{
+	struct spdk_iscsi_tgt_node target;
+	struct spdk_iscsi_sess sess;
+	struct spdk_iscsi_conn *conn1, *conn2;
+
+	ut_conns_reset();
+	ut_target_init(&target, &sess);
+	conn1 = ut_conn_init(0, &sess);
+	conn2 = ut_conn_init(1, &sess);
+
+	/* One busy connection keeps every connection to the target node in place */
+	conn2->pending_task_cnt = 1;
+	CU_ASSERT(spdk_iscsi_conn_rebalance(1, NULL) == -EBUSY);
+	CU_ASSERT(conn1->poller != NULL);
+	CU_ASSERT(target.lcore == 0);
+	conn2->pending_task_cnt = 0;
+
+	/* The portal does not allow the destination lcore */
+	CU_ASSERT(spdk_iscsi_conn_rebalance(2, NULL) == -ENOENT);
+
+	CU_ASSERT(TAILQ_EMPTY(&g_events));
+	CU_ASSERT(conn1->lcore == 0 && conn2->lcore == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("iscsi_conn_suite", ut_conns_init, ut_conns_fini);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "rebalance moves target", rebalance_moves_target) == NULL
+		|| CU_add_test(suite, "rebalance outstanding work", rebalance_outstanding_work) == NULL
+		|| CU_add_test(suite, "rebalance busy target", rebalance_busy_target) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
@@ -359,6 +359,43 @@ create_cb_null(void *io_device, void *ctx_buf)
 	return -1;
 }
 
+static int g_interrupt_fd;
+static bool g_interrupt_enable;
+
+static int
+_interrupt_fd(struct spdk_poller *poller, int fd, bool enable, void *thread_ctx)
+{
+	g_interrupt_fd = fd;
+	g_interrupt_enable = enable;
+	return 0;
+}
+
+static void
+poller_interrupt_fd(void)
+{
+	struct spdk_poller *poller = (struct spdk_poller *)0x1;
+	int rc;
+
+	spdk_allocate_thread(_send_msg, NULL, NULL, NULL, NULL);
+
+	/* Threads that did not opt in always poll. */
+	rc = spdk_poller_add_interrupt_fd(poller, 10);
+	CU_ASSERT(rc == -ENOTSUP);
+
+	spdk_thread_set_interrupt_fd_fn(_interrupt_fd);
+
+	rc = spdk_poller_add_interrupt_fd(poller, 10);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_interrupt_fd == 10);
+	CU_ASSERT(g_interrupt_enable == true);
+
+	spdk_poller_remove_interrupt_fd(poller, 10);
+	CU_ASSERT(g_interrupt_fd == 10);
+	CU_ASSERT(g_interrupt_enable == false);
+
+	spdk_free_thread();
+}
+
 static void
 channel(void)
 {
@@ -413,6 +450,42 @@ channel(void)
 	CU_ASSERT(TAILQ_EMPTY(&g_threads));
 }
 
+static void
+thread_create(void)
+{
+	struct spdk_thread *bound, *thread;
+	struct spdk_io_channel *ch;
+
+	spdk_allocate_thread(_send_msg, NULL, NULL, NULL, "bound");
+	bound = spdk_get_thread();
+	SPDK_CU_ASSERT_FATAL(bound != NULL);
+
+	/* A created thread does not become current until it is set. */
+	thread = spdk_thread_create(_send_msg, NULL, NULL, NULL, "created");
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	CU_ASSERT(spdk_get_thread() == bound);
+	CU_ASSERT(strcmp(spdk_thread_get_name(thread), "created") == 0);
+
+	CU_ASSERT(spdk_set_thread(thread) == NULL);
+	CU_ASSERT(spdk_get_thread() == thread);
+
+	/* Channels are allocated on behalf of the current thread. */
+	spdk_io_device_register(&device1, create_cb_1, destroy_cb_1, sizeof(ctx1));
+	ch = spdk_get_io_channel(&device1);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	CU_ASSERT(spdk_io_channel_get_thread(ch) == thread);
+	spdk_put_io_channel(ch);
+	spdk_io_device_unregister(&device1, NULL);
+
+	/* Passing NULL reverts to the thread bound to this pthread. */
+	CU_ASSERT(spdk_set_thread(NULL) == thread);
+	CU_ASSERT(spdk_get_thread() == bound);
+
+	spdk_thread_destroy(thread);
+	spdk_free_thread();
+	CU_ASSERT(TAILQ_EMPTY(&g_threads));
+}
+
 int
 main(int argc, char **argv)
 {
@@ -436,7 +509,9 @@ main(int argc, char **argv)
 		CU_add_test(suite, "for_each_channel_remove", for_each_channel_remove) == NULL ||
 		CU_add_test(suite, "for_each_channel_unreg", for_each_channel_unreg) == NULL ||
 		CU_add_test(suite, "thread_name", thread_name) == NULL ||
-		CU_add_test(suite, "channel", channel) == NULL
+		CU_add_test(suite, "poller_interrupt_fd", poller_interrupt_fd) == NULL ||
+		CU_add_test(suite, "channel", channel) == NULL ||
+		CU_add_test(suite, "thread_create", thread_create) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
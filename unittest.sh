@@ -61,6 +61,7 @@ $valgrind test/lib/blobfs/blobfs_async_ut/blobfs_async_ut
 # blobfs_sync_ut hangs when run under valgrind, so don't use $valgrind
 test/lib/blobfs/blobfs_sync_ut/blobfs_sync_ut
 
+$valgrind test/unit/lib/event/reactor.c/reactor_ut
 $valgrind test/unit/lib/event/subsystem.c/subsystem_ut
 
 $valgrind test/unit/lib/nvme/nvme.c/nvme_ut
@@ -95,6 +96,7 @@ $valgrind test/unit/lib/scsi/scsi_bdev.c/scsi_bdev_ut
 
 $valgrind test/unit/lib/lvol/lvol.c/lvol_ut
 
+$valgrind test/unit/lib/iscsi/conn.c/conn_ut
 $valgrind test/unit/lib/iscsi/param.c/param_ut
 $valgrind test/unit/lib/iscsi/tgt_node.c/tgt_node_ut test/unit/lib/iscsi/tgt_node.c/tgt_node.conf
 $valgrind test/unit/lib/iscsi/iscsi.c/iscsi_ut